@@ -3,6 +3,12 @@
 #include "types.h"
 #include "mp3_view.h"
 #include "mp3_edit.h"
+#include "mp3_scan.h"
+#include "mp3_batch.h"
+#include "mp3_stream.h"
+#include "mp3_daemon.h"
+#include "mp3_art.h"
+#include "mp3_stats.h"
 
 /**
  * Main function that controls the flow of the program based on the user arguments.
@@ -16,12 +22,40 @@
  */
 int main(int argc, char *argv[])
 {
-    // Check if there are sufficient arguments provided
-    if(argc < 3)
+    // Take out the output format, the banners only go with the text format
+    OutputFormat format;
+    if(parse_format_option(&argc, argv, &format) == e_failure)
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : INVALID FORMAT\n");
+        printf("USAGE :\nPass the format like: --format=text/ndjson/csv/tsv\n");
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+    FILE *info = format == format_text ? stdout : stderr;
+
+    // Statistics of each file go with its details, the totals are printed at exit
+    if(parse_stats_option(&argc, argv))
+    {
+        stats_print_at_exit(argc > 1 && Check_operation(argv[1]) == stream ? stderr : info);
+    }
+
+    // Padding reserved by rewrites, and whether tags with more are compacted
+    if(parse_padding_option(&argc, argv) == e_failure)
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : INVALID PADDING\n");
+        printf("USAGE :\nPass the padding like: --padding=bytes[K/M] or --padding=percent%%\n");
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+
+    // Check if there are sufficient arguments provided (streaming only needs the option)
+    if(argc < 3 && !(argc == 2 && Check_operation(argv[1]) == stream))
     {
         printf("-------------------------------------------------------------------------------\n\n");
         printf("ERROR: ./a.out : INVALID ARGUMENTS\n");
-        printf("USAGE :\nTo view please pass like: ./a.out -v mp3filename\nTo edit please pass like: ./a.out -e -t/-a/-A/-m/-y/-c changing_text mp3filename\nTo get help pass like: ./a.out --help\n");
+        printf("USAGE :\nTo view please pass like: ./a.out -v mp3filename [--extract-art picture_file]\nTo scan a directory pass like: ./a.out -r directory [threads] [queue_depth]\nTo edit please pass like: ./a.out -e -t/-a/-A/-m/-y/-c changing_text [...] mp3filename\nTo edit from a manifest pass like: ./a.out -b manifest [threads] [files[,milliseconds]]\nTo stream through a pipe pass like: ./a.out -s [-t/-a/-A/-m/-y/-c changing_text ...] < in.mp3 > out.mp3\nTo serve requests on a socket pass like: ./a.out -D socket_path [lru_entries]\nTo get help pass like: ./a.out --help\n");
         printf("-------------------------------------------------------------------------------\n");
         return e_failure;
     }
@@ -30,71 +64,247 @@ int main(int argc, char *argv[])
     if(Check_operation(argv[1]) == view)
     {
         Mp3ViewInfo mp3View;
-        // Validate the mp3 file for viewing
+        TagCache cache;
+        Arena arena;
+        RecordBuffer record = { NULL, 0, 0 };
+        // Validate the mp3 file for viewing and the optional picture file
         if(read_and_validation_view(argv, &mp3View) == e_failure)
         {
             return e_failure;
         }
-        printf("----------------------------------------[[ SELECTED VIEW DETAILS ]]----------------------------------------\n\n");
-        printf("-----------------------------------------------------------------------------------------------------\n");
-        printf("                               <<<<  MP3 TAG READER AND EDITOR FOR ID3 v2.3  >>>>                        \n");
-        printf("-----------------------------------------------------------------------------------------------------\n");
-        
-        // View the mp3 file details
-        if(view_info(&mp3View) == e_failure)
+        if(argc > 3 && (argc != 5 || strcmp(argv[3], "--extract-art") != 0))
+        {
+            printf("-------------------------------------------------------------------------------\n\n");
+            printf("ERROR: ./a.out : INVALID ARGUMENTS\n");
+            printf("USAGE :\nTo view please pass like: ./a.out -v mp3filename [--extract-art picture_file]\n");
+            printf("-------------------------------------------------------------------------------\n");
+            return e_failure;
+        }
+        // The tag and the frame texts are taken from the arena
+        arena_init(&arena, arena_limit());
+        mp3View.arena = &arena;
+        // Use the tag cache when MP3_TAG_CACHE names a cache file
+        if(cache_open_env(&cache) == e_success)
+        {
+            mp3View.cache = &cache;
+        }
+        mp3View.format = format;
+        mp3View.record = &record;
+        if(format == format_text)
+        {
+            printf("----------------------------------------[[ SELECTED VIEW DETAILS ]]----------------------------------------\n\n");
+            printf("-----------------------------------------------------------------------------------------------------\n");
+            printf("                               <<<<  MP3 TAG READER AND EDITOR FOR ID3 v2.2-v2.4  >>>>                    \n");
+            printf("-----------------------------------------------------------------------------------------------------\n");
+        }
+        format_header(&record, format);
+
+        // View the mp3 file details, a record is written out at once
+        FileStats stats;
+        stats_begin(&stats);
+        Status status = view_info(&mp3View);
+        if(record.len > 0)
+        {
+            fwrite(record.data, 1, record.len, stdout);
+        }
+        stats_end(&stats, info, argv[2]);
+        record_free(&record);
+        arena_free(&arena);
+        if(mp3View.cache != NULL)
+        {
+            cache_close(&cache);
+        }
+        if(status == e_failure)
+        {
+            fprintf(info, "Error in viewing information\n");
+            return e_failure;
+        }
+        if(format == format_text)
+        {
+            printf("-----------------------------------------------------------------------------------------------------\n\n");
+        }
+
+        // Write the cover picture straight from the file when asked
+        if(argc == 5 && extract_art(argv[2], argv[4], info) == e_failure)
+        {
+            fprintf(info, "Error in extracting the picture\n");
+            return e_failure;
+        }
+        if(format == format_text)
+        {
+            printf("---------------------------------[[ DETAILS DISPLAYED SUCCESSFULLY ]]--------------------------------------\n\n");
+        }
+    }
+    // Check if the operation is 'scan'
+    else if(Check_operation(argv[1]) == scan)
+    {
+        ScanInfo mp3Scan;
+        TagCache cache;
+        // Validate the directory and the thread count
+        if(read_and_validation_scan(argc, argv, &mp3Scan) == e_failure)
+        {
+            return e_failure;
+        }
+        // Use the tag cache when MP3_TAG_CACHE names a cache file
+        if(cache_open_env(&cache) == e_success)
+        {
+            mp3Scan.cache = &cache;
+        }
+        mp3Scan.format = format;
+        if(format == format_text)
+        {
+            printf("----------------------------------------[[ SELECTED SCAN DETAILS ]]----------------------------------------\n\n");
+        }
+
+        // View every mp3 file below the directory
+        Status status = scan_info(&mp3Scan);
+        if(mp3Scan.cache != NULL)
+        {
+            fprintf(info, "CACHE    :   %u hits, %u misses\n", cache.hits, cache.misses);
+            cache_close(&cache);
+        }
+        if(status == e_failure)
         {
-            printf("Error in viewing information\n");
+            fprintf(info, "Error in viewing some files\n");
             return e_failure;
         }
-        printf("-----------------------------------------------------------------------------------------------------\n\n");
-        printf("---------------------------------[[ DETAILS DISPLAYED SUCCESSFULLY ]]--------------------------------------\n\n");
+        if(format == format_text)
+        {
+            printf("---------------------------------[[ DETAILS DISPLAYED SUCCESSFULLY ]]--------------------------------------\n\n");
+        }
     }
     // Check if the operation is 'edit'
     else if(Check_operation(argv[1]) == edit)
     {
         Mp3EditInfo mp3Edit;
-        // Check if the user has passed enough arguments for editing
-        if(argc < 5)
+        // Check if the user has passed enough arguments for editing (option and text pairs, then the file;
+        // only the file when compacting)
+        if((argc < 5 && !(argc == 3 && padding_policy().compact)) || argc % 2 == 0)
         {
             printf("-------------------------------------------------------------------------------\n\n");
             printf("ERROR: ./a.out : INVALID ARGUMENTS\n");
-            printf("USAGE :To edit please pass like: ./a.out -e -t/-a/-A/-m/-y/-c changing_text mp3filename\n");
+            printf("USAGE :To edit please pass like: ./a.out -e -t/-a/-A/-m/-y/-c changing_text [-t/-a/-A/-m/-y/-c changing_text ...] mp3filename\nTo compact a tag pass like: ./a.out -e --compact [--padding=bytes] mp3filename\n");
             printf("-------------------------------------------------------------------------------\n");
             return e_failure;
         }
         
         // Validate the mp3 file for editing
-        if(read_and_validation_edit(argv, &mp3Edit) == e_failure)
+        if(read_and_validation_edit(argc, argv, &mp3Edit) == e_failure)
         {
             return e_failure;
         }
         
-        // Set output file name to "Modified.mp3"
-        strcpy(mp3Edit.out_fname, "Modified.mp3");
-        
         printf("----------------------------------------SELECTED EDIT DETAILS----------------------------------------\n\n");
         printf("----------SELECTED EDIT OPTION----------\n\n");
         
         // Edit the mp3 file's information
-        if(edit_info(&mp3Edit) == e_failure)
+        FileStats stats;
+        stats_begin(&stats);
+        Status status = edit_info(&mp3Edit);
+        stats_end(&stats, stdout, mp3Edit.src_fname);
+        free_edit(&mp3Edit);
+        if(status == e_failure)
         {
             printf("Error in editing information\n");
             return e_failure;
         }
     }
+    // Check if the operation is 'batch'
+    else if(Check_operation(argv[1]) == batch)
+    {
+        BatchInfo mp3Batch;
+        // Validate the manifest and the thread count
+        if(read_and_validation_batch(argc, argv, &mp3Batch) == e_failure)
+        {
+            return e_failure;
+        }
+        printf("----------------------------------------[[ SELECTED BATCH EDIT ]]----------------------------------------\n\n");
+
+        // Apply every line of the manifest
+        if(batch_info(&mp3Batch) == e_failure)
+        {
+            printf("Error in editing some files\n");
+            return e_failure;
+        }
+        printf("---------------------------------[[ FILES EDITED SUCCESSFULLY ]]--------------------------------------\n\n");
+    }
+    // Check if the operation is 'stream'
+    else if(Check_operation(argv[1]) == stream)
+    {
+        StreamInfo mp3Stream;
+        // Validate the option and text pairs, stdout only carries the MP3 data
+        if(read_and_validation_stream(argc, argv, &mp3Stream) == e_failure)
+        {
+            return e_failure;
+        }
+
+        // View or edit the tag while forwarding the file
+        FileStats stats;
+        stats_begin(&stats);
+        Status status = stream_info(&mp3Stream);
+        stats_end(&stats, stderr, "stdin");
+        free_edit(&mp3Stream.edit);
+        if(status == e_failure)
+        {
+            fprintf(stderr, "Error in streaming information\n");
+            return e_failure;
+        }
+    }
+    // Check if the operation is 'serve'
+    else if(Check_operation(argv[1]) == serve)
+    {
+        DaemonInfo mp3Daemon;
+        TagCache cache;
+        // Validate the socket path and the LRU size
+        if(read_and_validation_daemon(argc, argv, &mp3Daemon) == e_failure)
+        {
+            return e_failure;
+        }
+        // Files missing from the LRU are looked up in the tag cache when MP3_TAG_CACHE names one
+        if(cache_open_env(&cache) == e_success)
+        {
+            mp3Daemon.cache = &cache;
+        }
+
+        // Serve requests until SIGINT or SIGTERM
+        Status status = daemon_info(&mp3Daemon);
+        if(mp3Daemon.cache != NULL)
+        {
+            fprintf(stderr, "CACHE    :   %u hits, %u misses\n", cache.hits, cache.misses);
+            cache_close(&cache);
+        }
+        if(status == e_failure)
+        {
+            return e_failure;
+        }
+    }
     // Check if the operation is 'help'
     else if(Check_operation(argv[1]) == help)
     {
         // Display the help menu with usage instructions
         printf("---------------------------------Help Menu---------------------------------\n\n");
-        printf("1. -v -> to view mp3 file contents\n");
-        printf("2. -e -> to edit mp3 file contents\n");
+        printf("1. -v -> to view mp3 file contents (pictures, objects and private frames are listed with their size)\n");
+        printf("\t     --extract-art picture_file -> also write the cover picture (-v mp3filename --extract-art cover.jpg)\n");
+        printf("   -r -> to view every mp3 file below a directory (-r directory [threads] [queue_depth])\n");
+        printf("2. -e -> to edit mp3 file contents (several options may be given, they are applied in one pass)\n");
         printf("\t2.1. -t -> to edit song title\n");
         printf("\t2.2. -a -> to edit artist name\n");
         printf("\t2.3. -A -> to edit album name\n");
         printf("\t2.4. -y -> to edit year\n");
         printf("\t2.5. -m -> to edit content\n");
-        printf("\t2.6. -c -> to edit comment\n\n");
+        printf("\t2.6. -c -> to edit comment\n");
+        printf("   -b -> to edit many mp3 files from a manifest (-b manifest [threads] [files[,milliseconds]])\n");
+        printf("\t     each line is: path<TAB>option or frame id<TAB>text[...]\n");
+        printf("\t     or a JSON object: {\"path\": \"file.mp3\", \"TIT2\": \"text\", ...}\n");
+        printf("\t     files[,milliseconds] flushes that many edited files (or the files of that long) together before reporting them\n");
+        printf("   -s -> to view or edit an mp3 file piped from stdin to stdout (-s [-t/-a/-A/-m/-y/-c text ...])\n");
+        printf("\t     the details are printed to stderr\n");
+        printf("   -D -> to serve view and edit requests on a Unix domain socket (-D socket_path [lru_entries])\n");
+        printf("\t     each request is one line: VIEW<TAB>path, EDIT<TAB>manifest line or STATS\n");
+        printf("   --format=text/ndjson/csv/tsv -> with -v or -r, print one record per file instead of labelled lines\n");
+        printf("   --stats -> print the time of each phase and the I/O calls of every file, and the totals at exit\n");
+        printf("   --padding=bytes[K/M]/percent%% -> with -e, -b, -s or -D, the padding a rewrite leaves (default 1K, at least the old padding)\n");
+        printf("   --compact -> with -e, -b, -s or -D, trim the padding to the --padding size, fields may then be left out\n\n");
         printf("---------------------------------------------------------------------------\n\n");
     }
     else
@@ -116,7 +326,11 @@ int main(int argc, char *argv[])
  * Returns:
  *   OperationType: The type of operation requested by the user. It can be:
  *                  - view: If the user wants to view the MP3 file.
+ *                  - scan: If the user wants to view every MP3 file below a directory.
  *                  - edit: If the user wants to edit the MP3 file.
+ *                  - batch: If the user wants to edit many MP3 files from a manifest.
+ *                  - stream: If the user wants to view or edit an MP3 file piped through stdin and stdout.
+ *                  - serve: If the user wants to serve view and edit requests over a Unix domain socket.
  *                  - help: If the user requests help information.
  *                  - unsupported: If the operation is not recognized.
  */
@@ -127,10 +341,26 @@ OperationType Check_operation(char *argv)
     {
         return view;
     }
+    else if(strcmp(argv, "-r") == 0)
+    {
+        return scan;
+    }
     else if(strcmp(argv, "-e") == 0)
     {
         return edit;
     }
+    else if(strcmp(argv, "-b") == 0)
+    {
+        return batch;
+    }
+    else if(strcmp(argv, "-s") == 0)
+    {
+        return stream;
+    }
+    else if(strcmp(argv, "-D") == 0)
+    {
+        return serve;
+    }
     else if(strcmp(argv, "--help") == 0)
     {
         return help;
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "types.h"
+#include "mp3_frame.h"
+#include "mp3_tail.h"
+#include "mp3_arena.h"
+#include "mp3_aio.h"
+
+/**
+ * Sets up an io_uring instance and maps its rings.
+ * 
+ * Parameters:
+ *   aio (AioReader*): A pointer to the reader to be set up.
+ *   queue_depth (uint): Maximum number of requests in flight.
+ * 
+ * Returns:
+ *   Status: e_success if io_uring is ready, e_failure if it is unavailable.
+ */
+Status aio_init(AioReader *aio, uint queue_depth)
+{
+    struct io_uring_params params;
+    memset(aio, 0, sizeof(*aio));
+    memset(&params, 0, sizeof(params));
+    aio->tag_limit = arena_limit();
+
+    aio->ring_fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (aio->ring_fd < 0)
+    {
+        aio->ring_fd = -1;
+        return e_failure;
+    }
+    aio->queue_depth = params.sq_entries;
+
+    // Make sure the kernel knows the operations used by the reader
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    if (probe == NULL || syscall(__NR_io_uring_register, aio->ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0 ||
+        probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) ||
+        !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+    {
+        free(probe);
+        aio_close(aio);
+        return e_failure;
+    }
+    free(probe);
+
+    // Map the rings, newer kernels share one mapping for both of them
+    aio->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint);
+    aio->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (aio->cq_ring_size > aio->sq_ring_size)
+        {
+            aio->sq_ring_size = aio->cq_ring_size;
+        }
+        aio->cq_ring_size = aio->sq_ring_size;
+    }
+    aio->sq_ring = mmap(NULL, aio->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ring_fd, IORING_OFF_SQ_RING);
+    if (aio->sq_ring == MAP_FAILED)
+    {
+        aio->sq_ring = NULL;
+        aio_close(aio);
+        return e_failure;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        aio->cq_ring = aio->sq_ring;
+    }
+    else
+    {
+        aio->cq_ring = mmap(NULL, aio->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ring_fd, IORING_OFF_CQ_RING);
+        if (aio->cq_ring == MAP_FAILED)
+        {
+            aio->cq_ring = NULL;
+            aio_close(aio);
+            return e_failure;
+        }
+    }
+    aio->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    aio->sqes = mmap(NULL, aio->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ring_fd, IORING_OFF_SQES);
+    if (aio->sqes == MAP_FAILED)
+    {
+        aio->sqes = NULL;
+        aio_close(aio);
+        return e_failure;
+    }
+
+    char *sq = aio->sq_ring;
+    char *cq = aio->cq_ring;
+    aio->sq_head = (uint *)(sq + params.sq_off.head);
+    aio->sq_tail = (uint *)(sq + params.sq_off.tail);
+    aio->sq_mask = (uint *)(sq + params.sq_off.ring_mask);
+    aio->sq_array = (uint *)(sq + params.sq_off.array);
+    aio->cq_head = (uint *)(cq + params.cq_off.head);
+    aio->cq_tail = (uint *)(cq + params.cq_off.tail);
+    aio->cq_mask = (uint *)(cq + params.cq_off.ring_mask);
+    aio->cqes = cq + params.cq_off.cqes;
+
+    return e_success;
+}
+
+/**
+ * Takes the next free submission queue entry and clears it.
+ * The queue has as many entries as requests may be in flight, so it is never full.
+ */
+static struct io_uring_sqe *get_sqe(AioReader *aio)
+{
+    uint tail = *aio->sq_tail;
+    uint index = tail & *aio->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)aio->sqes)[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    aio->sq_array[index] = index;
+    __atomic_store_n(aio->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    return sqe;
+}
+
+/**
+ * Queues an openat() of the request's file.
+ */
+static void queue_open(AioReader *aio, TagRequest *req)
+{
+    struct io_uring_sqe *sqe = get_sqe(aio);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long)req->path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = (unsigned long)req;
+    stats_count_to(&req->stats, count_opens, 1);
+}
+
+/**
+ * Queues a read of the request's file into a buffer at a file offset.
+ */
+static void queue_read(AioReader *aio, TagRequest *req, void *buffer, uint count, unsigned long long offset)
+{
+    struct io_uring_sqe *sqe = get_sqe(aio);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = req->fd;
+    sqe->addr = (unsigned long)buffer;
+    sqe->len = count;
+    sqe->off = offset;
+    sqe->user_data = (unsigned long)req;
+}
+
+/**
+ * Finishes a request: closes the file, releases the probe buffer and calls the callback.
+ * The tail tags are kept even when the tag could not be read.
+ */
+static void finish_request(TagRequest *req, Status status, TagDoneFn done, void *arg)
+{
+    if (req->fd >= 0)
+    {
+        close(req->fd);
+        req->fd = -1;
+    }
+    free(req->probe);
+    req->probe = NULL;
+    req->status = status;
+    if (status == e_failure)
+    {
+        free(req->tag);
+        req->tag = NULL;
+    }
+    if (req->tail == NULL)
+    {
+        req->tail_size = 0;
+    }
+    done(req, arg);
+}
+
+/**
+ * Takes the header from the first read of a file and copies the start of the tag.
+ * A tag that runs past the end of the file is refused before its buffer is allocated, as
+ * load_tag() refuses it. A tag that doesn't fit in the arena of a worker is refused as
+ * too_large, for load_tag() to read without its binary payloads.
+ * 
+ * Parameters:
+ *   req (TagRequest*): The request, with file_size set.
+ *   count (uint): Bytes returned by the first read.
+ *   limit (size_t): The arena limit of the workers.
+ * 
+ * Returns:
+ *   Status: e_success if the header is valid, e_failure otherwise.
+ */
+static Status take_probe(TagRequest *req, uint count, size_t limit)
+{
+    // Keep whatever header bytes were read, so the caller can tell why it failed
+    memset(req->header, 0, ID3_HEADER_SIZE);
+    memcpy(req->header, req->probe, count < ID3_HEADER_SIZE ? count : ID3_HEADER_SIZE);
+    if (count < ID3_HEADER_SIZE || strncmp((char *)req->probe, "ID3", 3) != 0)
+    {
+        return e_failure;
+    }
+    req->tag_size = syncsafe_to_int(req->header + 6);
+    if ((unsigned long long)req->tag_size + ID3_HEADER_SIZE > req->file_size)
+    {
+        return e_failure;
+    }
+    if (req->tag_size >= limit)
+    {
+        req->too_large = 1;
+        return e_failure;
+    }
+
+    req->tag = malloc(req->tag_size + 1);
+    if (req->tag == NULL)
+    {
+        return e_failure;
+    }
+    req->have = count - ID3_HEADER_SIZE < req->tag_size ? count - ID3_HEADER_SIZE : req->tag_size;
+    memcpy(req->tag, req->probe + ID3_HEADER_SIZE, req->have);
+
+    return e_success;
+}
+
+/**
+ * Keeps only the tail tags of the last block of a file, which was read into req->tail.
+ * 
+ * Parameters:
+ *   req (TagRequest*): The request.
+ *   count (int): Bytes returned by the read, the block is dropped unless it was read whole.
+ */
+static void take_tail(TagRequest *req, int count)
+{
+    uint size = count == (int)req->tail_size ? find_tail_tags(req->tail, count) : 0;
+    if (size == 0)
+    {
+        free(req->tail);
+        req->tail = NULL;
+        req->tail_size = 0;
+        return;
+    }
+    memmove(req->tail, req->tail + req->tail_size - size, size);
+    req->tail_size = size;
+}
+
+/**
+ * Ends the reads of the tag: queues the read of the last block of the file, or finishes the
+ * request when the file is empty or memory runs out. The tag status is kept until then.
+ * 
+ * Parameters:
+ *   aio (AioReader*): A pointer to the reader.
+ *   req (TagRequest*): The request.
+ *   status (Status): Whether the header and the whole tag were read.
+ *   to_submit (uint*): Number of entries queued and not submitted yet.
+ *   done (TagDoneFn): Callback for every finished request.
+ *   arg (void*): Argument passed to the callback.
+ */
+static void queue_tail(AioReader *aio, TagRequest *req, Status status, uint *to_submit, TagDoneFn done, void *arg)
+{
+    uint count = req->file_size < TAIL_PROBE_SIZE ? req->file_size : TAIL_PROBE_SIZE;
+    req->status = status;
+    req->tail = count > 0 ? malloc(count) : NULL;
+    if (req->tail == NULL)
+    {
+        aio->in_flight--;
+        finish_request(req, status, done, arg);
+        return;
+    }
+    req->tail_size = count;
+    queue_read(aio, req, req->tail, count, req->file_size - count);
+    (*to_submit)++;
+}
+
+/**
+ * Opens every file and reads its ID3 tag through io_uring.
+ * Each file goes through openat, one read of AIO_PROBE_SIZE bytes and, only for tags
+ * larger than that, more reads of the rest of the tag, then one read of its last
+ * TAIL_PROBE_SIZE bytes for the tail tags. Up to the queue depth files are in flight at any time.
+ * 
+ * Parameters:
+ *   aio (AioReader*): A pointer to the reader set up by aio_init().
+ *   reqs (TagRequest*): The requests, only path has to be set.
+ *   count (uint): Number of requests.
+ *   done (TagDoneFn): Callback for every finished request.
+ *   arg (void*): Argument passed to the callback.
+ * 
+ * Returns:
+ *   Status: e_success if all requests were processed, e_failure if the ring failed.
+ */
+Status aio_read_tags(AioReader *aio, TagRequest *reqs, uint count, TagDoneFn done, void *arg)
+{
+    uint next = 0;
+    uint to_submit = 0;
+    aio->in_flight = 0;
+
+    while (next < count || aio->in_flight > 0)
+    {
+        // Keep the queue full with new files
+        while (next < count && aio->in_flight < aio->queue_depth)
+        {
+            TagRequest *req = &reqs[next++];
+            req->fd = -1;
+            req->tag = NULL;
+            req->have = 0;
+            req->tail = NULL;
+            req->tail_size = 0;
+            req->file_size = 0;
+            req->too_large = 0;
+            memset(req->header, 0, ID3_HEADER_SIZE);
+            memset(&req->stats, 0, sizeof(req->stats));
+            req->probe = malloc(AIO_PROBE_SIZE);
+            if (req->probe == NULL)
+            {
+                finish_request(req, e_failure, done, arg);
+                continue;
+            }
+            queue_open(aio, req);
+            aio->in_flight++;
+            to_submit++;
+        }
+        if (aio->in_flight == 0)
+        {
+            continue;
+        }
+
+        // Submit the queued entries and wait for at least one completion
+        int ret = syscall(__NR_io_uring_enter, aio->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR)
+        {
+            return e_failure;
+        }
+        if (ret > 0)
+        {
+            to_submit -= ret;
+        }
+
+        // Handle every completion, each one may queue the next step of its file
+        uint head = *aio->cq_head;
+        while (head != __atomic_load_n(aio->cq_tail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe *cqe = &((struct io_uring_cqe *)aio->cqes)[head & *aio->cq_mask];
+            TagRequest *req = (TagRequest *)(unsigned long)cqe->user_data;
+            int res = cqe->res;
+            head++;
+
+            if (req->fd < 0)
+            {
+                // openat() finished, read the header and the start of the tag
+                if (res < 0)
+                {
+                    aio->in_flight--;
+                    finish_request(req, e_failure, done, arg);
+                    continue;
+                }
+                // The size tells where the tail tags are, fstat() doesn't touch the disk
+                struct stat st;
+                req->fd = res;
+                req->file_size = fstat(res, &st) == 0 ? st.st_size : 0;
+                queue_read(aio, req, req->probe, AIO_PROBE_SIZE, 0);
+                to_submit++;
+            }
+            else if (req->tail != NULL)
+            {
+                // Read of the last block finished, the request is done
+                stats_count_to(&req->stats, count_reads, 1);
+                stats_count_to(&req->stats, count_bytes_read, res > 0 ? res : 0);
+                take_tail(req, res);
+                aio->in_flight--;
+                finish_request(req, req->status, done, arg);
+            }
+            else if (req->tag == NULL)
+            {
+                // First read finished
+                stats_count_to(&req->stats, count_reads, 1);
+                stats_count_to(&req->stats, count_bytes_read, res > 0 ? res : 0);
+                if (res < 0 || take_probe(req, res, aio->tag_limit) == e_failure)
+                {
+                    queue_tail(aio, req, e_failure, &to_submit, done, arg);
+                }
+                else if (req->have < req->tag_size)
+                {
+                    queue_read(aio, req, req->tag + req->have, req->tag_size - req->have, ID3_HEADER_SIZE + req->have);
+                    to_submit++;
+                }
+                else
+                {
+                    queue_tail(aio, req, e_success, &to_submit, done, arg);
+                }
+            }
+            else
+            {
+                // Read of the rest of the tag finished, short reads are continued
+                stats_count_to(&req->stats, count_reads, 1);
+                stats_count_to(&req->stats, count_bytes_read, res > 0 ? res : 0);
+                if (res <= 0)
+                {
+                    queue_tail(aio, req, e_failure, &to_submit, done, arg);
+                    continue;
+                }
+                req->have += res;
+                if (req->have < req->tag_size)
+                {
+                    queue_read(aio, req, req->tag + req->have, req->tag_size - req->have, ID3_HEADER_SIZE + req->have);
+                    to_submit++;
+                }
+                else
+                {
+                    queue_tail(aio, req, e_success, &to_submit, done, arg);
+                }
+            }
+        }
+        __atomic_store_n(aio->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return e_success;
+}
+
+/**
+ * Blocking fallback of aio_read_tags(): reads the requests one by one with pread().
+ * 
+ * Parameters:
+ *   reqs (TagRequest*): The requests, only path has to be set.
+ *   count (uint): Number of requests.
+ *   done (TagDoneFn): Callback for every finished request.
+ *   arg (void*): Argument passed to the callback.
+ */
+void blocking_read_tags(TagRequest *reqs, uint count, TagDoneFn done, void *arg)
+{
+    size_t limit = arena_limit();
+    for (uint i = 0; i < count; i++)
+    {
+        TagRequest *req = &reqs[i];
+        req->tag = NULL;
+        req->have = 0;
+        req->tail = NULL;
+        req->tail_size = 0;
+        req->too_large = 0;
+        memset(req->header, 0, ID3_HEADER_SIZE);
+        memset(&req->stats, 0, sizeof(req->stats));
+
+        // The opens and reads are counted for the file, not for this thread
+        FileStats *previous = stats_attach(&req->stats);
+        req->probe = malloc(AIO_PROBE_SIZE);
+        req->fd = stats_open(req->path, O_RDONLY | O_CLOEXEC, 0);
+        struct stat st;
+        req->file_size = req->fd >= 0 && fstat(req->fd, &st) == 0 ? st.st_size : 0;
+        ssize_t bytes = req->probe != NULL && req->fd >= 0 ? stats_pread(req->fd, req->probe, AIO_PROBE_SIZE, 0) : -1;
+        Status status = bytes >= 0 && take_probe(req, bytes, limit) == e_success ? e_success : e_failure;
+        while (status == e_success && req->have < req->tag_size)
+        {
+            bytes = stats_pread(req->fd, req->tag + req->have, req->tag_size - req->have, ID3_HEADER_SIZE + req->have);
+            if (bytes <= 0)
+            {
+                status = e_failure;
+                break;
+            }
+            req->have += bytes;
+        }
+
+        // One more read for the tags at the end of the file
+        if (req->fd >= 0 && req->file_size > 0 && (req->tail = malloc(TAIL_PROBE_SIZE)) != NULL)
+        {
+            unsigned char *tags;
+            req->tail_size = read_tail_tags(req->fd, req->file_size, req->tail, &tags);
+            memmove(req->tail, tags, req->tail_size);
+            if (req->tail_size == 0)
+            {
+                free(req->tail);
+                req->tail = NULL;
+            }
+        }
+        stats_attach(previous);
+        finish_request(req, status, done, arg);
+    }
+}
+
+/**
+ * Unmaps the rings and closes the io_uring instance.
+ * 
+ * Parameters:
+ *   aio (AioReader*): A pointer to the reader.
+ */
+void aio_close(AioReader *aio)
+{
+    if (aio->sqes != NULL)
+    {
+        munmap(aio->sqes, aio->sqes_size);
+    }
+    if (aio->cq_ring != NULL && aio->cq_ring != aio->sq_ring)
+    {
+        munmap(aio->cq_ring, aio->cq_ring_size);
+    }
+    if (aio->sq_ring != NULL)
+    {
+        munmap(aio->sq_ring, aio->sq_ring_size);
+    }
+    if (aio->ring_fd >= 0)
+    {
+        close(aio->ring_fd);
+    }
+    memset(aio, 0, sizeof(*aio));
+    aio->ring_fd = -1;
+}
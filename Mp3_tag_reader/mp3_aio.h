@@ -0,0 +1,104 @@
+#ifndef MP3_AIO_H
+#define MP3_AIO_H
+
+#include "types.h"
+#include "mp3_stats.h"
+
+// Bytes read by the first read of every file, enough for the header and most tags
+#define AIO_PROBE_SIZE 4096
+
+// Structure to store one file whose ID3 tag is read by the asynchronous reader
+typedef struct TagRequest
+{
+    const char *path;          // File name of the MP3 file
+    uint id;                   // Identifier chosen by the caller (e.g., index in a file list)
+    unsigned char header[10];  // ID3 tag header
+    unsigned char *tag;        // Frame region of the tag (malloc'd, owned by the caller afterwards)
+    uint tag_size;             // Size of the frame region
+    uint have;                 // Bytes of the frame region read so far
+    unsigned char *tail;       // ID3v1, Lyrics3 and APE tags at the end of the file (malloc'd, owned by
+                               // the caller afterwards), NULL if there are none
+    uint tail_size;            // Size of the tail tags
+    unsigned long long file_size;  // Size of the file, tells where its last block starts
+    int fd;                    // File descriptor while the file is open
+    Status status;             // e_success if the header and the whole tag were read
+    int from_cache;            // 1 if the caller filled the request from a cache instead of reading it
+    int too_large;             // 1 if the tag doesn't fit in the arena whole and was left unread
+    unsigned char *probe;      // Buffer of the first read
+    FileStats stats;           // Opens and reads done for the file, with --stats
+} TagRequest;
+
+// Callback called once for every request when its tag is read (or failed)
+typedef void (*TagDoneFn)(TagRequest *req, void *arg);
+
+// Structure to store an io_uring instance and its mapped rings
+typedef struct AioReader
+{
+    int ring_fd;               // io_uring file descriptor, -1 when not set up
+    uint queue_depth;          // Number of entries of the submission queue
+
+    void *sq_ring;             // Mapped submission queue ring
+    void *cq_ring;             // Mapped completion queue ring
+    void *sqes;                // Mapped submission queue entries
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    uint *sq_head, *sq_tail, *sq_mask, *sq_array;
+    uint *cq_head, *cq_tail, *cq_mask;
+    void *cqes;
+
+    uint in_flight;            // Requests submitted and not completed yet
+    size_t tag_limit;          // Largest tag read, the arena limit of the workers the tags go to
+} AioReader;
+
+// Function Prototypes
+
+/**
+ * Sets up an io_uring instance with the given queue depth.
+ * Fails when io_uring or one of the operations used (openat, read) is not available,
+ * in which case the caller uses blocking reads instead.
+ * 
+ * @param aio (AioReader*): The reader to be set up.
+ * @param queue_depth (uint): Maximum number of requests in flight.
+ * 
+ * @returns Status: e_success if io_uring is ready, e_failure if it is unavailable.
+ */
+Status aio_init(AioReader *aio, uint queue_depth);
+
+
+/**
+ * Opens every file and reads its ID3 tag header and frame region, then its last TAIL_PROBE_SIZE
+ * bytes for the tail tags, keeping up to the queue depth open/read requests in flight. The callback is called as each request completes,
+ * in completion order.
+ * 
+ * @param aio (AioReader*): The reader set up by aio_init().
+ * @param reqs (TagRequest*): The requests, only path has to be set.
+ * @param count (uint): Number of requests.
+ * @param done (TagDoneFn): Callback for every finished request.
+ * @param arg (void*): Argument passed to the callback.
+ * 
+ * @returns Status: e_success if all requests were processed, e_failure if the ring failed.
+ */
+Status aio_read_tags(AioReader *aio, TagRequest *reqs, uint count, TagDoneFn done, void *arg);
+
+
+/**
+ * Blocking fallback of aio_read_tags(): reads the requests one by one with pread().
+ * 
+ * @param reqs (TagRequest*): The requests, only path has to be set.
+ * @param count (uint): Number of requests.
+ * @param done (TagDoneFn): Callback for every finished request.
+ * @param arg (void*): Argument passed to the callback.
+ */
+void blocking_read_tags(TagRequest *reqs, uint count, TagDoneFn done, void *arg);
+
+
+/**
+ * Unmaps the rings and closes the io_uring instance.
+ * 
+ * @param aio (AioReader*): The reader.
+ */
+void aio_close(AioReader *aio);
+
+#endif
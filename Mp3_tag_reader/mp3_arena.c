@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "types.h"
+#include "mp3_arena.h"
+
+// Every allocation is rounded up to this alignment
+#define ARENA_ALIGN 16
+
+/**
+ * Prepares an empty arena. No memory is allocated until the first arena_alloc().
+ * 
+ * Parameters:
+ *   arena (Arena*): The arena.
+ *   limit (size_t): Largest number of bytes handed out between two resets.
+ */
+void arena_init(Arena *arena, size_t limit)
+{
+    arena->blocks = NULL;
+    arena->limit = limit;
+    arena->used = 0;
+}
+
+/**
+ * Returns the arena limit set in the MP3_ARENA_LIMIT environment variable, in bytes with an
+ * optional K, M or G suffix, or ARENA_DEFAULT_LIMIT when it is not set or invalid.
+ * 
+ * Returns:
+ *   size_t: The arena limit.
+ */
+size_t arena_limit(void)
+{
+    const char *value = getenv("MP3_ARENA_LIMIT");
+    if (value == NULL || *value == '\0')
+    {
+        return ARENA_DEFAULT_LIMIT;
+    }
+
+    char *end;
+    unsigned long long limit = strtoull(value, &end, 10);
+    uint shift = 0;
+    switch (*end)
+    {
+        case 'G': case 'g': shift += 10; /* fall through */
+        case 'M': case 'm': shift += 10; /* fall through */
+        case 'K': case 'k': shift += 10; end++; break;
+        default: break;
+    }
+
+    // The range is checked before the suffix is applied, so a large value can't wrap around
+    if (*end != '\0' || *value == '-' || limit == 0 || limit > (unsigned long long)SIZE_MAX >> shift)
+    {
+        return ARENA_DEFAULT_LIMIT;
+    }
+    return limit << shift;
+}
+
+/**
+ * Adds a new block of at least size bytes in front of the block list.
+ * 
+ * Parameters:
+ *   arena (Arena*): The arena.
+ *   size (size_t): Smallest usable size of the block.
+ * 
+ * Returns:
+ *   ArenaBlock*: The new block, or NULL if memory runs out.
+ */
+static ArenaBlock *add_block(Arena *arena, size_t size)
+{
+    // Blocks double in size so a large tag needs only a few of them, but never
+    // past what the limit still allows to be handed out
+    size_t block_size = arena->blocks != NULL ? arena->blocks->size * 2 : ARENA_BLOCK_SIZE;
+    if (block_size > arena->limit - arena->used)
+    {
+        block_size = arena->limit - arena->used;
+    }
+    if (block_size < size)
+    {
+        block_size = size;
+    }
+
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + block_size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    block->next = arena->blocks;
+    block->size = block_size;
+    block->used = 0;
+    arena->blocks = block;
+    return block;
+}
+
+/**
+ * Hands out size bytes aligned for any type. The memory stays valid until the next reset.
+ * 
+ * Parameters:
+ *   arena (Arena*): The arena.
+ *   size (size_t): Number of bytes.
+ * 
+ * Returns:
+ *   void*: The memory, or NULL if the limit would be passed or memory runs out.
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size == 0 || size > arena->limit - arena->used)
+    {
+        return NULL;
+    }
+
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->size - block->used < size)
+    {
+        block = add_block(arena, size);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+/**
+ * Grows the last memory handed out to new_size bytes, in place when its block has room.
+ * Otherwise it is moved to a new block and its old bytes are no longer counted, so a buffer
+ * grown a piece at a time is charged only for its final size. The old block isn't released
+ * before the reset, so the bytes stay readable while they are copied.
+ * 
+ * Parameters:
+ *   arena (Arena*): The arena.
+ *   ptr (void*): The last memory handed out, or NULL for a new buffer.
+ *   size (size_t): Its size.
+ *   new_size (size_t): The size wanted.
+ * 
+ * Returns:
+ *   void*: The memory with its first size bytes kept, or NULL if the limit would be passed or memory runs out.
+ */
+void *arena_grow(Arena *arena, void *ptr, size_t size, size_t new_size)
+{
+    if (ptr == NULL)
+    {
+        return arena_alloc(arena, new_size);
+    }
+
+    size_t old_size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    size_t grow = ((new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1)) - old_size;
+    ArenaBlock *block = arena->blocks;
+    if (new_size <= old_size)
+    {
+        return ptr;
+    }
+    if (block == NULL || (unsigned char *)ptr + old_size != block->data + block->used ||
+        old_size > arena->used)
+    {
+        return NULL;
+    }
+    if (grow <= block->size - block->used && grow <= arena->limit - arena->used)
+    {
+        block->used += grow;
+        arena->used += grow;
+        return ptr;
+    }
+
+    // Give the old bytes back, then move
+    block->used -= old_size;
+    arena->used -= old_size;
+    void *moved = arena_alloc(arena, new_size);
+    if (moved == NULL)
+    {
+        block->used += old_size;
+        arena->used += old_size;
+        return NULL;
+    }
+    memcpy(moved, ptr, size);
+    return moved;
+}
+
+/**
+ * Releases everything handed out at once. A single block of at most ARENA_BLOCK_SIZE bytes is
+ * kept for the next file. When the last file needed more, its blocks are returned to the system
+ * and a fresh first block is allocated, so one large file doesn't pin its peak memory for the
+ * rest of a long run.
+ * 
+ * Parameters:
+ *   arena (Arena*): The arena.
+ */
+void arena_reset(Arena *arena)
+{
+    if (arena->blocks != NULL && (arena->blocks->next != NULL || arena->blocks->size > ARENA_BLOCK_SIZE))
+    {
+        arena_free(arena);
+        add_block(arena, 0);
+    }
+
+    if (arena->blocks != NULL)
+    {
+        arena->blocks->used = 0;
+    }
+    arena->used = 0;
+}
+
+/**
+ * Returns all memory of the arena to the system.
+ * 
+ * Parameters:
+ *   arena (Arena*): The arena.
+ */
+void arena_free(Arena *arena)
+{
+    while (arena->blocks != NULL)
+    {
+        ArenaBlock *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    arena->used = 0;
+}
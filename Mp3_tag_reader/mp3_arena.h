@@ -0,0 +1,94 @@
+#ifndef MP3_ARENA_H
+#define MP3_ARENA_H
+
+#include <stddef.h>
+#include "types.h"
+
+// Size of the first block of an arena, later blocks double until the limit
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Largest number of bytes an arena hands out per file unless MP3_ARENA_LIMIT says otherwise
+#define ARENA_DEFAULT_LIMIT (256UL * 1024 * 1024)
+
+// Structure to store one block of memory owned by an arena
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;  // Block allocated before this one
+    size_t size;              // Usable bytes in data
+    size_t used;              // Bytes already handed out
+    unsigned char data[];     // The memory itself
+} ArenaBlock;
+
+// Structure to store a bump allocator for the frame payloads of one file.
+// Everything is released at once with arena_reset() when the file is done,
+// and the first ARENA_BLOCK_SIZE bytes are kept for the next file.
+typedef struct Arena
+{
+    ArenaBlock *blocks;    // Newest block first, NULL before the first allocation
+    size_t limit;          // Largest number of bytes handed out between two resets
+    size_t used;           // Bytes handed out since the last reset
+} Arena;
+
+// Function Prototypes
+
+/**
+ * Prepares an empty arena. No memory is allocated until the first arena_alloc().
+ * 
+ * @param arena (Arena*): The arena.
+ * @param limit (size_t): Largest number of bytes handed out between two resets.
+ */
+void arena_init(Arena *arena, size_t limit);
+
+
+/**
+ * Returns the arena limit set in the MP3_ARENA_LIMIT environment variable, in bytes with an
+ * optional K, M or G suffix, or ARENA_DEFAULT_LIMIT when it is not set or invalid.
+ * 
+ * @returns size_t: The arena limit.
+ */
+size_t arena_limit(void);
+
+
+/**
+ * Hands out size bytes aligned for any type. The memory stays valid until the next reset.
+ * 
+ * @param arena (Arena*): The arena.
+ * @param size (size_t): Number of bytes.
+ * 
+ * @returns void*: The memory, or NULL if the limit would be passed or memory runs out.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+
+/**
+ * Grows the last memory handed out to new_size bytes, in place when its block has room.
+ * Otherwise it is moved to a new block and its old bytes are no longer counted, so a buffer
+ * grown a piece at a time is charged only for its final size.
+ * 
+ * @param arena (Arena*): The arena.
+ * @param ptr (void*): The last memory handed out, or NULL for a new buffer.
+ * @param size (size_t): Its size.
+ * @param new_size (size_t): The size wanted.
+ * 
+ * @returns void*: The memory with its first size bytes kept, or NULL if the limit would be passed or memory runs out.
+ */
+void *arena_grow(Arena *arena, void *ptr, size_t size, size_t new_size);
+
+
+/**
+ * Releases everything handed out at once. A single block of ARENA_BLOCK_SIZE bytes is kept for
+ * the next file; the memory of a file that needed more is returned to the system.
+ * 
+ * @param arena (Arena*): The arena.
+ */
+void arena_reset(Arena *arena);
+
+
+/**
+ * Returns all memory of the arena to the system.
+ * 
+ * @param arena (Arena*): The arena.
+ */
+void arena_free(Arena *arena);
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "types.h"
+#include "mp3_frame.h"
+#include "mp3_copy.h"
+#include "mp3_art.h"
+
+/**
+ * Finds the end of a text terminated by a null character, two for UTF-16 encodings.
+ * 
+ * Parameters:
+ *   data (const unsigned char*): The text.
+ *   length (uint): Bytes available.
+ *   encoding (unsigned char): ID3 text encoding (0 or 3 single byte, 1 or 2 UTF-16).
+ * 
+ * Returns:
+ *   uint: Number of bytes taken by the text and its terminator, 0 if it isn't terminated.
+ */
+static uint text_end(const unsigned char *data, uint length, unsigned char encoding)
+{
+    if (encoding == 1 || encoding == 2)
+    {
+        for (uint i = 0; i + 1 < length; i += 2)
+        {
+            if (data[i] == 0 && data[i + 1] == 0)
+            {
+                return i + 2;
+            }
+        }
+        return 0;
+    }
+
+    for (uint i = 0; i < length; i++)
+    {
+        if (data[i] == 0)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Takes the picture of an APIC frame from the fields in front of it, when it is the first
+ * picture found or a front cover that replaces another picture.
+ * 
+ * Parameters:
+ *   version (unsigned char): Major version of the tag, ID3v2.2 names a 3 character image format.
+ *   data (const unsigned char*): The start of the frame data.
+ *   want (uint): Bytes of the frame data in memory.
+ *   size (uint): Size of the frame data.
+ *   offset (long long): Offset of the frame data.
+ *   art (ArtInfo*): The picture found so far, replaced by this one when it is taken.
+ *   found (int): 1 if a picture was found before.
+ * 
+ * Returns:
+ *   int: 1 if art describes this picture, 0 otherwise.
+ */
+static int take_art(unsigned char version, const unsigned char *data, uint want, uint size, long long offset, ArtInfo *art, int found)
+{
+    if (want < 2)
+    {
+        return 0;
+    }
+    uint mime = version == 2 ? (want > 4 ? 3 : 0) : text_end(data + 1, want - 1, 0);
+    uint description = mime > 0 && 2 + mime <= want ? text_end(data + 2 + mime, want - 2 - mime, data[0]) : 0;
+    if (mime == 0 || description == 0 || mime >= sizeof(art->mime))
+    {
+        return 0;
+    }
+
+    // Keep the first picture, but a front cover wins over any other picture
+    if (found && (art->type == 3 || data[1 + mime] != 3))
+    {
+        return 0;
+    }
+    uint start = 2 + mime + description;
+    memcpy(art->mime, data + 1, mime);
+    art->mime[mime] = '\0';
+    art->type = data[1 + mime];
+    art->offset = offset + start;
+    art->length = size - start;
+    return 1;
+}
+
+/**
+ * Reads the whole tag, undoes its unsynchronisation and locates the picture in memory.
+ * 
+ * Parameters:
+ *   fd (int): Descriptor of the MP3 file.
+ *   header (unsigned char*): The 10 byte tag header.
+ *   art (ArtInfo*): Filled with the picture, art->data holds the decoded tag.
+ * 
+ * Returns:
+ *   Status: e_success if a picture was found, e_failure otherwise.
+ */
+static Status find_decoded_art(int fd, unsigned char *header, ArtInfo *art)
+{
+    uint tag_size = syncsafe_to_int(header + 6);
+    unsigned char *tag = malloc(tag_size + 1);
+    if (tag == NULL || pread(fd, tag, tag_size, ID3_HEADER_SIZE) != (ssize_t)tag_size)
+    {
+        free(tag);
+        return e_failure;
+    }
+
+    FrameIndex index;
+    memset(&index, 0, sizeof(index));
+    tag_size = resync_tag(header, tag, tag_size);
+    int found = 0;
+    if (build_frame_index(&index, header, tag, tag_size) == e_success)
+    {
+        unsigned short packed = index.parser->version == 3 ? 0x00C0 : index.parser->version == 4 ? 0x000C : 0;
+        for (uint i = 0; i < index.count; i++)
+        {
+            const FrameEntry *entry = &index.frames[i];
+            if (strncmp(entry->id, "APIC", 4) == 0 && !(entry->flags & packed))
+            {
+                found |= take_art(index.parser->version, tag + entry->data, entry->size, entry->size, entry->data, art, found);
+            }
+        }
+    }
+    free_frame_index(&index);
+
+    if (!found)
+    {
+        free(tag);
+        return e_failure;
+    }
+    art->data = tag;
+    return e_success;
+}
+
+/**
+ * Walks the frame headers of the tag by offset and locates the picture to be extracted.
+ * Only the headers and the start of each APIC frame are read. ID3v2.2 pictures (PIC) name
+ * a 3 character image format instead of the MIME type. Compressed or encrypted pictures
+ * can't be copied as they are and are passed over; an unsynchronised tag or picture is
+ * read whole and decoded in memory instead.
+ * 
+ * Parameters:
+ *   fd (int): Descriptor of the MP3 file.
+ *   art (ArtInfo*): Filled with the location of the picture.
+ * 
+ * Returns:
+ *   Status: e_success if a picture was found, e_failure otherwise.
+ */
+Status find_art(int fd, ArtInfo *art)
+{
+    unsigned char header[ID3_HEADER_SIZE];
+    art->data = NULL;
+    if (pread(fd, header, ID3_HEADER_SIZE, 0) != ID3_HEADER_SIZE || strncmp((char *)header, "ID3", 3) != 0)
+    {
+        return e_failure;
+    }
+    const FrameParser *parser = get_frame_parser(header);
+    if (parser == NULL)
+    {
+        return e_failure;
+    }
+    if (header[5] & ID3_UNSYNC_FLAG)
+    {
+        return find_decoded_art(fd, header, art);
+    }
+
+    // The frames start after the extended header, if there is one
+    uint tag_size = syncsafe_to_int(header + 6);
+    unsigned char ext[4];
+    uint have = tag_size < sizeof(ext) ? tag_size : sizeof(ext);
+    uint pos = 0;
+    if (pread(fd, ext, have, ID3_HEADER_SIZE) != (ssize_t)have ||
+        frame_region_start(parser, header, ext, tag_size, &pos) == e_failure)
+    {
+        return e_failure;
+    }
+
+    uint header_size = parser->header_size;
+    unsigned short packed = parser->version == 3 ? 0x00C0 : parser->version == 4 ? 0x000E : 0;
+    int found = 0;
+    while (pos + header_size <= tag_size)
+    {
+        unsigned char frame[FRAME_HEADER_SIZE + FRAME_EXTRA_MAX + ART_HEADER_MAX];
+        FrameEntry entry;
+        if (pread(fd, frame, header_size, ID3_HEADER_SIZE + pos) != (ssize_t)header_size || frame[0] == 0 ||
+            parser->read_header(frame, tag_size - pos - header_size, &entry) == e_failure)
+        {
+            break;
+        }
+
+        if (strncmp(entry.id, "APIC", 4) == 0 && parser->version == 4 && (entry.flags & packed) == FRAME_UNSYNC_FLAG)
+        {
+            return find_decoded_art(fd, header, art);
+        }
+        if (strncmp(entry.id, "APIC", 4) == 0 && !(entry.flags & packed))
+        {
+            // Read only the fields in front of the picture
+            uint want = entry.size < ART_HEADER_MAX ? entry.size : ART_HEADER_MAX;
+            unsigned char *data = frame + entry.data;
+            if (pread(fd, data, want, ID3_HEADER_SIZE + pos + entry.data) != (ssize_t)want)
+            {
+                return e_failure;
+            }
+            found |= take_art(parser->version, data, want, entry.size, ID3_HEADER_SIZE + pos + entry.data, art, found);
+        }
+
+        pos += entry.data + entry.size;
+    }
+
+    return found ? e_success : e_failure;
+}
+
+/**
+ * Finds the front cover of the file, or its first picture when there is no front cover,
+ * and writes the picture bytes to a new file straight from the source file with
+ * copy_file_range() or sendfile(), without reading them into memory.
+ * 
+ * Parameters:
+ *   file_name (const char*): The MP3 file.
+ *   out_name (const char*): The file the picture is written to.
+ *   out (FILE*): Stream the result is printed to.
+ * 
+ * Returns:
+ *   Status: e_success if a picture was written, e_failure if there is none or an error occurs.
+ */
+Status extract_art(const char *file_name, const char *out_name, FILE *out)
+{
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(out, "Error in opening %s\n", file_name);
+        return e_failure;
+    }
+
+    ArtInfo art;
+    if (find_art(fd, &art) == e_failure)
+    {
+        fprintf(out, "No picture found in %s\n", file_name);
+        close(fd);
+        return e_failure;
+    }
+
+    int fd_out = open(out_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_out < 0)
+    {
+        fprintf(out, "Error in creating %s\n", out_name);
+        free(art.data);
+        close(fd);
+        return e_failure;
+    }
+
+    // A decoded picture is written from memory
+    CopyMethod method = copy_buffered;
+    Status status = e_success;
+    if (art.data != NULL)
+    {
+        status = write(fd_out, art.data + art.offset, art.length) == (ssize_t)art.length ? e_success : e_failure;
+        free(art.data);
+    }
+    else
+    {
+        status = copy_file_part(fd_out, fd, art.offset, art.length, &method);
+    }
+    close(fd_out);
+    close(fd);
+    if (status == e_failure)
+    {
+        fprintf(out, "Error in writing %s\n", out_name);
+        return e_failure;
+    }
+
+    fprintf(out, "ART      :   %u bytes of %s written to %s (%s)\n", art.length, art.mime, out_name, copy_method_name(method));
+    return e_success;
+}
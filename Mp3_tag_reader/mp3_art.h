@@ -0,0 +1,48 @@
+#ifndef MP3_ART_H
+#define MP3_ART_H
+
+#include <stdio.h>
+#include "types.h"
+
+// Largest APIC header (encoding, MIME type, picture type and description) looked at
+#define ART_HEADER_MAX 4096
+
+// Structure to store where the picture of an APIC frame lies in the file
+typedef struct ArtInfo
+{
+    char mime[65];         // MIME type of the picture (e.g., "image/jpeg")
+    unsigned char type;    // Picture type (3 is the front cover)
+    long long offset;      // Offset of the first picture byte in the file (in data, when data is set)
+    uint length;           // Number of picture bytes
+    unsigned char *data;   // Decoded tag holding the picture when it was unsynchronised, NULL otherwise
+} ArtInfo;
+
+// Function Prototypes
+
+/**
+ * Finds the front cover of the file, or its first picture when there is no front cover,
+ * and writes the picture bytes to a new file straight from the source file with
+ * copy_file_range() or sendfile(), without reading them into memory.
+ * 
+ * @param file_name (const char*): The MP3 file.
+ * @param out_name (const char*): The file the picture is written to.
+ * @param out (FILE*): Stream the result is printed to.
+ * 
+ * @returns Status: e_success if a picture was written, e_failure if there is none or an error occurs.
+ */
+Status extract_art(const char *file_name, const char *out_name, FILE *out);
+
+
+/**
+ * Walks the frame headers of the tag by offset and locates the picture to be extracted.
+ * Only the headers and the start of each APIC frame are read. An unsynchronised picture
+ * can't be copied as it lies in the file, so its tag is read and decoded into art->data.
+ * 
+ * @param fd (int): Descriptor of the MP3 file.
+ * @param art (ArtInfo*): Filled with the location of the picture; art->data is to be freed by the caller.
+ * 
+ * @returns Status: e_success if a picture was found, e_failure otherwise.
+ */
+Status find_art(int fd, ArtInfo *art);
+
+#endif
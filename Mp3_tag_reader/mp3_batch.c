@@ -0,0 +1,953 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "mp3_edit.h"
+#include "mp3_batch.h"
+#include "mp3_stats.h"
+#include "mp3_text.h"
+
+/**
+ * Validates the arguments of the bulk edit.
+ * 
+ * Parameters:
+ *   argc (int): Number of command-line arguments.
+ *   argv (char*[]): Command-line arguments, the manifest at index 2, the optional thread count at index 3
+ *                   and the optional group commit (files[,milliseconds]) at index 4.
+ *   batch (BatchInfo*): A pointer to the structure where the batch information will be stored.
+ * 
+ * Returns:
+ *   Status: e_success if validation passes, e_failure if there's an error.
+ */
+Status read_and_validation_batch(int argc, char *argv[], BatchInfo *batch)
+{
+    // Check if the manifest can be read
+    if (access(argv[2], R_OK) != 0)
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : %s CAN'T BE READ\n", argv[2]);
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+    batch->manifest = argv[2];
+
+    // Use one worker per online CPU unless a thread count is passed
+    batch->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 3)
+    {
+        batch->threads = atoi(argv[3]);
+    }
+    if (batch->threads < 1)
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : INVALID THREAD COUNT\n");
+        printf("USAGE :\nTo edit from a manifest please pass like: ./a.out -b manifest [threads] [files[,milliseconds]]\n");
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+
+    // Flush every rewrite on its own unless a group commit is passed
+    batch->group_files = batch->group_ms = 0;
+    if (argc > 4)
+    {
+        char *end;
+        long files = strtol(argv[4], &end, 10);
+        long ms = *end == ',' ? strtol(end + 1, &end, 10) : 0;
+        if (files < 1 || ms < 0 || *end != '\0' || end == argv[4])
+        {
+            printf("-------------------------------------------------------------------------------\n\n");
+            printf("ERROR: ./a.out : INVALID GROUP COMMIT\n");
+            printf("USAGE :\nTo edit from a manifest please pass like: ./a.out -b manifest [threads] [files[,milliseconds]]\n");
+            printf("-------------------------------------------------------------------------------\n");
+            return e_failure;
+        }
+        batch->group_files = files;
+        batch->group_ms = ms;
+    }
+
+    return e_success;
+}
+
+/**
+ * Reads the whole manifest into memory.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ * 
+ * Returns:
+ *   Status: e_success if the manifest was read, e_failure if an error occurs.
+ */
+static Status load_manifest(BatchInfo *batch)
+{
+    FILE *fptr = fopen(batch->manifest, "r");
+    if (fptr == NULL)
+    {
+        return e_failure;
+    }
+
+    fseek(fptr, 0, SEEK_END);
+    long size = ftell(fptr);
+    rewind(fptr);
+    batch->text = size >= 0 ? malloc(size + 1) : NULL;
+    if (batch->text == NULL || fread(batch->text, 1, size, fptr) != (size_t)size)
+    {
+        fclose(fptr);
+        return e_failure;
+    }
+    batch->text[size] = '\0';
+
+    fclose(fptr);
+    return e_success;
+}
+
+/**
+ * Adds one frame change to a job. The key is either an edit option (e.g., "-t") or a frame id (e.g., "TIT2").
+ * 
+ * Parameters:
+ *   job (BatchJob*): The job the change belongs to.
+ *   key (char*): The edit option or frame id.
+ *   text (char*): The new text of the frame.
+ * 
+ * Returns:
+ *   Status: e_success if the change was added, e_failure if the job is rejected (job->error is set).
+ */
+static Status add_edit(BatchJob *job, char *key, char *text)
+{
+    char *option = key[0] == '-' ? key : get_frame_option(key);
+    if (option == NULL || get_frame_id(option) == NULL)
+    {
+        job->error = "unsupported frame";
+        return e_failure;
+    }
+    for (int i = 0; i < job->edit_count; i++)
+    {
+        if (strcmp(job->edits[i].frame, option) == 0)
+        {
+            job->error = "frame given more than once";
+            return e_failure;
+        }
+    }
+    if (job->edit_count == MAX_EDITS)
+    {
+        job->error = "too many frames";
+        return e_failure;
+    }
+
+    FrameEdit *edit = &job->edits[job->edit_count++];
+    edit->frame = option;
+    edit->modify_data = text;
+    edit->data_length = strlen(text) + 1;
+    return e_success;
+}
+
+/**
+ * Splits a tab separated line: the path, then key and text pairs.
+ * 
+ * Parameters:
+ *   job (BatchJob*): The job to be filled.
+ *   line (char*): The line, split in place.
+ */
+static void parse_tsv_line(BatchJob *job, char *line)
+{
+    job->path = strsep(&line, "\t");
+    while (line != NULL)
+    {
+        char *key = strsep(&line, "\t");
+        char *text = strsep(&line, "\t");
+        if (text == NULL)
+        {
+            job->error = "frame without text";
+            return;
+        }
+        if (add_edit(job, key, text) == e_failure)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * Skips white space in a JSON line.
+ */
+static char *skip_space(char *pos)
+{
+    while (*pos == ' ' || *pos == '\t')
+    {
+        pos++;
+    }
+    return pos;
+}
+
+/**
+ * Reads the 4 hex digits of a JSON \u escape.
+ */
+static Status json_hex4(const char *src, uint *code)
+{
+    char hex[5] = { 0 };
+    for (int i = 0; i < 4; i++)
+    {
+        if (!isxdigit((unsigned char)src[i]))
+        {
+            return e_failure;
+        }
+        hex[i] = src[i];
+    }
+    *code = strtoul(hex, NULL, 16);
+    return e_success;
+}
+
+/**
+ * Reads a JSON string and removes its escapes in place. \u escapes (surrogate pairs
+ * included) are written as UTF-8, the text the frames are encoded from; U+0000 and
+ * unpaired surrogates are rejected.
+ * 
+ * Parameters:
+ *   pos (char**): Position of the opening quote, moved past the closing quote.
+ * 
+ * Returns:
+ *   char*: The NUL terminated string, or NULL if it is malformed.
+ */
+static char *json_string(char **pos)
+{
+    char *src = *pos;
+    if (*src++ != '"')
+    {
+        return NULL;
+    }
+
+    char *start = src, *dest = src;
+    while (*src != '"')
+    {
+        if (*src == '\0')
+        {
+            return NULL;
+        }
+        if (*src != '\\')
+        {
+            *dest++ = *src++;
+            continue;
+        }
+
+        src++;
+        switch (*src)
+        {
+            case '"': case '\\': case '/': *dest++ = *src; break;
+            case 'b': *dest++ = '\b'; break;
+            case 'f': *dest++ = '\f'; break;
+            case 'n': *dest++ = '\n'; break;
+            case 'r': *dest++ = '\r'; break;
+            case 't': *dest++ = '\t'; break;
+            case 'u':
+            {
+                uint code, low;
+                if (json_hex4(src + 1, &code) == e_failure || code == 0 || (code >= 0xDC00 && code < 0xE000))
+                {
+                    return NULL;
+                }
+                src += 4;
+                if (code >= 0xD800 && code < 0xDC00)
+                {
+                    // A high surrogate needs the low one of its pair
+                    if (src[1] != '\\' || src[2] != 'u' || json_hex4(src + 3, &low) == e_failure ||
+                        low < 0xDC00 || low >= 0xE000)
+                    {
+                        return NULL;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    src += 6;
+                }
+                // The escape is longer than its UTF-8, so the string shrinks
+                dest += text_put_utf8(dest, code);
+                break;
+            }
+            default:
+                return NULL;
+        }
+        src++;
+    }
+
+    *dest = '\0';
+    *pos = src + 1;
+    return start;
+}
+
+/**
+ * Reads a JSON object line: a "path" member and one string member per frame.
+ * 
+ * Parameters:
+ *   job (BatchJob*): The job to be filled.
+ *   line (char*): The line, starting with '{', decoded in place.
+ */
+static void parse_json_line(BatchJob *job, char *line)
+{
+    char *pos = skip_space(line + 1);
+    if (*pos == '}')
+    {
+        job->error = "no path";
+        return;
+    }
+
+    while (1)
+    {
+        char *key = json_string(&pos);
+        pos = key != NULL ? skip_space(pos) : pos;
+        if (key == NULL || *pos++ != ':')
+        {
+            job->error = "malformed JSON";
+            return;
+        }
+        pos = skip_space(pos);
+        char *text = json_string(&pos);
+        if (text == NULL)
+        {
+            job->error = "malformed JSON (values must be strings)";
+            return;
+        }
+
+        if (strcmp(key, "path") == 0)
+        {
+            job->path = text;
+        }
+        else if (add_edit(job, key, text) == e_failure)
+        {
+            return;
+        }
+
+        pos = skip_space(pos);
+        if (*pos == '}')
+        {
+            break;
+        }
+        if (*pos++ != ',')
+        {
+            job->error = "malformed JSON";
+            return;
+        }
+        pos = skip_space(pos);
+    }
+
+    if (*skip_space(pos + 1) != '\0')
+    {
+        job->error = "malformed JSON";
+    }
+}
+
+// Structure to store the file a job edits, as found by stat()
+typedef struct JobFile
+{
+    unsigned long long dev;  // Device of the file
+    unsigned long long ino;  // Inode of the file
+    BatchJob *job;           // The job
+} JobFile;
+
+/**
+ * Compares two jobs by file, then by line, for qsort().
+ */
+static int compare_jobs(const void *a, const void *b)
+{
+    const JobFile *file_a = a, *file_b = b;
+    if (file_a->dev != file_b->dev)
+    {
+        return file_a->dev < file_b->dev ? -1 : 1;
+    }
+    if (file_a->ino != file_b->ino)
+    {
+        return file_a->ino < file_b->ino ? -1 : 1;
+    }
+    return (file_a->job->line > file_b->job->line) - (file_a->job->line < file_b->job->line);
+}
+
+/**
+ * Rejects every job that edits a file already edited by an earlier line, so no two workers
+ * ever write the same file. Files are told apart by device and inode, so two paths of one
+ * file (e.g., "dir/a.mp3" and "dir/../dir/a.mp3", or a link) are caught too. A job whose
+ * file can't be found is left to fail on its own.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ * 
+ * Returns:
+ *   Status: e_success if the jobs were checked, e_failure if memory runs out.
+ */
+static Status reject_duplicates(BatchInfo *batch)
+{
+    JobFile *sorted = malloc((batch->count + 1) * sizeof(JobFile));
+    if (sorted == NULL)
+    {
+        return e_failure;
+    }
+
+    uint n = 0;
+    for (uint i = 0; i < batch->count; i++)
+    {
+        struct stat st;
+        if (batch->jobs[i].error == NULL && stat(batch->jobs[i].path, &st) == 0)
+        {
+            sorted[n].dev = st.st_dev;
+            sorted[n].ino = st.st_ino;
+            sorted[n++].job = &batch->jobs[i];
+        }
+    }
+    qsort(sorted, n, sizeof(JobFile), compare_jobs);
+    for (uint i = 1; i < n; i++)
+    {
+        if (sorted[i].dev == sorted[i - 1].dev && sorted[i].ino == sorted[i - 1].ino)
+        {
+            sorted[i].job->error = "file listed more than once";
+        }
+    }
+
+    free(sorted);
+    return e_success;
+}
+
+/**
+ * Splits the manifest into jobs. Each line is either tab separated (path, then key and text pairs)
+ * or a JSON object with a "path" member and one string member per frame. Empty lines and
+ * lines starting with '#' are skipped. Lines that can't be used become jobs with an error,
+ * so they are reported in order.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information, with the manifest text loaded.
+ * 
+ * Returns:
+ *   Status: e_success if the manifest was split, e_failure if memory runs out.
+ */
+Status parse_manifest(BatchInfo *batch)
+{
+    char *rest = batch->text;
+    uint line_no = 0;
+
+    while (rest != NULL)
+    {
+        char *line = strsep(&rest, "\n");
+        line_no++;
+
+        // Drop the carriage return of CRLF manifests
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r')
+        {
+            line[--len] = '\0';
+        }
+        if (*skip_space(line) == '\0' || line[0] == '#')
+        {
+            continue;
+        }
+
+        // Grow the job list when it is full
+        if (batch->count == batch->capacity)
+        {
+            uint capacity = batch->capacity ? batch->capacity * 2 : 256;
+            BatchJob *jobs = realloc(batch->jobs, capacity * sizeof(BatchJob));
+            if (jobs == NULL)
+            {
+                return e_failure;
+            }
+            batch->jobs = jobs;
+            batch->capacity = capacity;
+        }
+
+        BatchJob *job = &batch->jobs[batch->count++];
+        parse_job(job, line);
+        job->line = line_no;
+    }
+
+    return reject_duplicates(batch);
+}
+
+/**
+ * Fills a job from one manifest line, tab separated or a JSON object. Only MP3 files with
+ * at least one change are accepted; otherwise job->error tells why.
+ * 
+ * Parameters:
+ *   job (BatchJob*): The job to be filled, its path and texts point into the line.
+ *   line (char*): The line without its line break, split and decoded in place.
+ */
+void parse_job(BatchJob *job, char *line)
+{
+    memset(job, 0, sizeof(*job));
+    job->path = "";
+
+    line = skip_space(line);
+    if (line[0] == '{')
+    {
+        parse_json_line(job, line);
+    }
+    else
+    {
+        parse_tsv_line(job, line);
+    }
+
+    // Only MP3 files with at least one change are edited, any MP3 file when compacting
+    char *extn = strrchr(job->path, '.');
+    if (job->error == NULL && (extn == NULL || strcmp(extn, ".mp3") != 0))
+    {
+        job->error = "invalid extension";
+    }
+    if (job->error == NULL && job->edit_count == 0 && !padding_policy().compact)
+    {
+        job->error = "no frames to change";
+    }
+}
+
+/**
+ * Applies one job with the edit structure of the calling thread and stores its result line.
+ * The edit details are captured in memory, only the last line is kept as the reason of a failure.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ *   mp3Edit (Mp3EditInfo*): Edit structure of the thread, its arena is reused from job to job.
+ *   i (uint): Index of the job.
+ */
+static void batch_file(BatchInfo *batch, Mp3EditInfo *mp3Edit, uint i)
+{
+    BatchJob *job = &batch->jobs[i];
+    char *details = NULL;
+    size_t details_len = 0;
+    const char *reason = job->error;
+    Status status = e_failure;
+    FileStats stats;
+    stats_begin(&stats);
+
+    if (reason == NULL)
+    {
+        mp3Edit->src_fname = job->path;
+        memcpy(mp3Edit->edits, job->edits, sizeof(job->edits));
+        mp3Edit->edit_count = job->edit_count;
+        mp3Edit->out = open_memstream(&details, &details_len);
+        if (mp3Edit->out == NULL)
+        {
+            reason = "out of memory";
+        }
+        else
+        {
+            status = edit_info(mp3Edit);
+            fclose(mp3Edit->out);
+
+            // The last line printed by the edit tells why it failed
+            while (details_len > 0 && details[details_len - 1] == '\n')
+            {
+                details[--details_len] = '\0';
+            }
+            char *last = details != NULL ? strrchr(details, '\n') : NULL;
+            reason = last != NULL ? last + 1 : details;
+        }
+    }
+
+    char *result = NULL;
+    size_t result_len = 0;
+    FILE *out = open_memstream(&result, &result_len);
+    if (out != NULL)
+    {
+        if (status == e_success)
+        {
+            fprintf(out, "OK       :   %s (%s, padding %u consumed, %u reserved)\n", job->path,
+                    mp3Edit->in_place ? "IN PLACE" : "REWRITE", mp3Edit->padding_consumed, mp3Edit->padding_reserved);
+        }
+        else
+        {
+            fprintf(out, "FAILED   :   %s (line %u): %s\n", job->path, job->line, reason != NULL ? reason : "unknown error");
+        }
+        stats_end(&stats, out, job->path);
+        fclose(out);
+    }
+    else
+    {
+        stats_end(&stats, stderr, job->path);
+    }
+    free(details);
+
+    // A rewrite of a group commit waits for its group to be flushed before it replaces the file
+    job->edited = status == e_success;
+    job->in_place = job->edited && mp3Edit->in_place;
+    job->temp_fname = mp3Edit->pending_fname;
+    job->dest_fname = mp3Edit->pending_dest;
+    mp3Edit->pending_fname = mp3Edit->pending_dest = NULL;
+
+    pthread_mutex_lock(&batch->lock);
+    batch->results[i] = result != NULL ? result : strdup("");
+    if (status == e_failure)
+    {
+        batch->failed++;
+    }
+    else if (mp3Edit->in_place)
+    {
+        batch->in_place++;
+    }
+    pthread_cond_broadcast(&batch->ready);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * Worker thread: keeps taking the next job until all jobs are handed out.
+ * Each worker keeps one edit structure, so its arena is reused for the tag and frames of
+ * every file.
+ * 
+ * Parameters:
+ *   arg (void*): A pointer to the BatchInfo structure.
+ * 
+ * Returns:
+ *   void*: Always NULL.
+ */
+static void *batch_worker(void *arg)
+{
+    BatchInfo *batch = arg;
+    Mp3EditInfo mp3Edit;
+    init_edit(&mp3Edit);
+    if (batch->group_files > 0)
+    {
+        mp3Edit.fsync = fsync_group;
+    }
+
+    while (1)
+    {
+        // Take the next job, but don't run too far ahead of the printer
+        pthread_mutex_lock(&batch->lock);
+        while (batch->next < batch->count && batch->next >= batch->printed + BATCH_WINDOW)
+        {
+            pthread_cond_wait(&batch->space, &batch->lock);
+        }
+        uint i = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (i >= batch->count)
+        {
+            break;
+        }
+
+        batch_file(batch, &mp3Edit, i);
+    }
+
+    free_edit(&mp3Edit);
+    return NULL;
+}
+
+/**
+ * Flushes the filesystems holding the edited files of a group, with one syncfs() per filesystem
+ * however many files it holds.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ *   first (uint): Index of the first job of the group.
+ *   end (uint): Index after the last job of the group.
+ * 
+ * Returns:
+ *   Status: e_success if every filesystem was flushed, e_failure if an error occurs.
+ */
+static Status sync_group(BatchInfo *batch, uint first, uint end)
+{
+    dev_t synced[16];
+    uint synced_count = 0;
+    Status status = e_success;
+    for (uint i = first; i < end; i++)
+    {
+        BatchJob *job = &batch->jobs[i];
+        const char *path = job->temp_fname != NULL ? job->temp_fname : job->path;
+        struct stat st;
+        if (!job->edited)
+        {
+            continue;
+        }
+        if (stat(path, &st) != 0)
+        {
+            status = e_failure;
+            continue;
+        }
+
+        // Each filesystem is flushed once, the files of the group mostly share one
+        int seen = 0;
+        for (uint j = 0; j < synced_count; j++)
+        {
+            seen |= synced[j] == st.st_dev;
+        }
+        if (seen)
+        {
+            continue;
+        }
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 || syncfs(fd) != 0)
+        {
+            status = e_failure;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (synced_count < sizeof(synced) / sizeof(synced[0]))
+        {
+            synced[synced_count++] = st.st_dev;
+        }
+    }
+    return status;
+}
+
+/**
+ * Replaces the result line of an edited job of a group that couldn't be committed.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ *   i (uint): Index of the job.
+ *   reason (const char*): Why the commit failed.
+ */
+static void fail_commit(BatchInfo *batch, uint i, const char *reason)
+{
+    BatchJob *job = &batch->jobs[i];
+    char *result = NULL;
+    if (asprintf(&result, "FAILED   :   %s (line %u): %s\n", job->path, job->line, reason) < 0)
+    {
+        result = NULL;
+    }
+    free(batch->results[i]);
+    batch->results[i] = result != NULL ? result : strdup("");
+
+    batch->failed++;
+    if (job->in_place)
+    {
+        batch->in_place--;
+    }
+    job->edited = job->in_place = 0;
+}
+
+/**
+ * Commits a group of finished jobs and prints their results: the files written in place and
+ * the rewritten temporary files are flushed, the temporary files are renamed over their
+ * sources and the renames are flushed. Only then is an edit reported as done, so an OK line
+ * always stands for a file on disk. A rewrite whose flush fails is removed, its file is left
+ * as it was. A file edited in place already has its new tag, so when the flush fails it is
+ * reported as edited but not flushed, as is a rewrite whose rename wasn't flushed.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ *   first (uint): Index of the first job of the group.
+ *   end (uint): Index after the last job of the group.
+ */
+static void commit_group(BatchInfo *batch, uint first, uint end)
+{
+    // Without a group commit every rewrite was flushed and renamed by its worker
+    int edited = 0;
+    for (uint i = first; i < end && batch->group_files > 0; i++)
+    {
+        edited |= batch->jobs[i].edited;
+    }
+
+    if (edited)
+    {
+        Status status = sync_group(batch, first, end);
+        int renamed = 0;
+        for (uint i = first; i < end; i++)
+        {
+            BatchJob *job = &batch->jobs[i];
+            if (job->edited && status == e_failure)
+            {
+                fail_commit(batch, i, job->in_place ? "edited but not flushed" : "cannot flush the group commit");
+            }
+            else if (job->temp_fname != NULL && rename(job->temp_fname, job->dest_fname) != 0)
+            {
+                fail_commit(batch, i, "cannot replace the file");
+            }
+            else if (job->temp_fname != NULL)
+            {
+                free(job->temp_fname);
+                job->temp_fname = NULL;
+                renamed = 1;
+            }
+            if (job->temp_fname != NULL)
+            {
+                unlink(job->temp_fname);
+                free(job->temp_fname);
+                job->temp_fname = NULL;
+            }
+            free(job->dest_fname);
+            job->dest_fname = NULL;
+        }
+
+        // The renames are durable once the filesystems are flushed again
+        if (renamed && sync_group(batch, first, end) == e_failure)
+        {
+            for (uint i = first; i < end; i++)
+            {
+                if (batch->jobs[i].edited)
+                {
+                    fail_commit(batch, i, batch->jobs[i].in_place ? "edited but not flushed" : "replaced but not flushed");
+                }
+            }
+        }
+        batch->groups++;
+    }
+
+    for (uint i = first; i < end; i++)
+    {
+        fputs(batch->results[i], stdout);
+        free(batch->results[i]);
+    }
+    fflush(stdout);
+}
+
+/**
+ * Gives the time a group started now has to be committed by, group_ms from now.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ *   deadline (struct timespec*): Set to the time.
+ */
+static void group_deadline(BatchInfo *batch, struct timespec *deadline)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += batch->group_ms / 1000;
+    deadline->tv_nsec += (batch->group_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * Reads the manifest and applies every job on the worker threads.
+ * The main thread prints each result as soon as it and all jobs before it are done,
+ * so the output is always in manifest order. With a group commit, the done jobs are
+ * gathered into groups that are flushed together before their results are printed.
+ * 
+ * Parameters:
+ *   batch (BatchInfo*): A pointer to the structure containing the batch information.
+ * 
+ * Returns:
+ *   Status: e_success if every file was edited, e_failure if any job failed.
+ */
+Status batch_info(BatchInfo *batch)
+{
+    batch->text = NULL;
+    batch->jobs = NULL;
+    batch->count = batch->capacity = 0;
+    if (load_manifest(batch) == e_failure || parse_manifest(batch) == e_failure)
+    {
+        printf("Error in reading manifest %s\n", batch->manifest);
+        free(batch->text);
+        free(batch->jobs);
+        return e_failure;
+    }
+
+    batch->results = calloc(batch->count + 1, sizeof(char *));
+    if (batch->results == NULL)
+    {
+        return e_failure;
+    }
+    batch->next = batch->printed = batch->failed = batch->in_place = batch->groups = 0;
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_cond_init(&batch->ready, NULL);
+    pthread_cond_init(&batch->space, NULL);
+
+    // Start the workers, never more than there are jobs
+    int threads = batch->threads < (int)batch->count ? batch->threads : (int)batch->count;
+    pthread_t *workers = malloc((threads + 1) * sizeof(pthread_t));
+    int started = 0;
+    while (workers != NULL && started < threads && pthread_create(&workers[started], NULL, batch_worker, batch) == 0)
+    {
+        started++;
+    }
+
+    // Without any worker the jobs are applied on this thread
+    Mp3EditInfo mp3Edit;
+    init_edit(&mp3Edit);
+    if (batch->group_files > 0)
+    {
+        mp3Edit.fsync = fsync_group;
+    }
+
+    // Print the results in order as they become ready; with a group commit they are held until
+    // group_files edited files are ready or the first of them waited group_ms
+    uint group_first = 0;
+    uint group_edited = 0;
+    struct timespec deadline;
+    for (uint i = 0; i < batch->count; i++)
+    {
+        if (started == 0)
+        {
+            batch_file(batch, &mp3Edit, i);
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        while (batch->results[i] == NULL)
+        {
+            if (group_first < i && batch->group_ms > 0 &&
+                pthread_cond_timedwait(&batch->ready, &batch->lock, &deadline) == ETIMEDOUT)
+            {
+                pthread_mutex_unlock(&batch->lock);
+                commit_group(batch, group_first, i);
+                pthread_mutex_lock(&batch->lock);
+                group_first = i;
+                group_edited = 0;
+            }
+            else if (group_first == i || batch->group_ms == 0)
+            {
+                pthread_cond_wait(&batch->ready, &batch->lock);
+            }
+        }
+        pthread_mutex_unlock(&batch->lock);
+
+        if (batch->group_files == 0)
+        {
+            commit_group(batch, i, i + 1);
+            group_first = i + 1;
+        }
+        else
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            if (group_first == i)
+            {
+                group_deadline(batch, &deadline);
+            }
+            group_edited += batch->jobs[i].edited;
+            if (group_edited >= batch->group_files || (batch->group_ms > 0 &&
+                (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))))
+            {
+                commit_group(batch, group_first, i + 1);
+                group_first = i + 1;
+                group_edited = 0;
+            }
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        batch->printed = i + 1;
+        pthread_cond_broadcast(&batch->space);
+        pthread_mutex_unlock(&batch->lock);
+    }
+    if (group_first < batch->count)
+    {
+        commit_group(batch, group_first, batch->count);
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    if (started == 0)
+    {
+        free_edit(&mp3Edit);
+    }
+
+    printf("FILES    :   %u edited (%u in place, %u rewritten), %u failed\n", batch->count - batch->failed,
+           batch->in_place, batch->count - batch->failed - batch->in_place, batch->failed);
+    if (batch->group_files > 0)
+    {
+        printf("COMMITS  :   %u groups of up to %u files or %u ms (0 for no limit)\n", batch->groups, batch->group_files, batch->group_ms);
+    }
+
+    free(batch->text);
+    free(batch->jobs);
+    free(batch->results);
+    pthread_mutex_destroy(&batch->lock);
+    pthread_cond_destroy(&batch->ready);
+    pthread_cond_destroy(&batch->space);
+
+    return batch->failed == 0 ? e_success : e_failure;
+}
@@ -0,0 +1,99 @@
+#ifndef MP3_BATCH_H
+#define MP3_BATCH_H
+
+#include <pthread.h>
+#include "types.h"
+#include "mp3_edit.h"
+
+// Number of jobs the workers may run ahead of the job being printed
+#define BATCH_WINDOW 1024
+
+// Structure to store one file of the manifest with all of its frame changes
+typedef struct BatchJob
+{
+    char *path;            // MP3 file to be edited
+    uint line;             // Line of the manifest the job was read from
+    FrameEdit edits[MAX_EDITS];  // Frame changes, applied together in one pass
+    int edit_count;        // Number of frame changes
+    const char *error;     // Reason the manifest line was rejected, NULL if valid
+
+    int edited;            // 1 once the edit succeeded, acknowledged when its group is committed
+    int in_place;          // 1 if the file was patched in place
+    char *temp_fname;      // Group commit: rewritten file waiting to be renamed over dest_fname
+    char *dest_fname;      // Group commit: resolved path of the file it replaces
+} BatchJob;
+
+// Structure to store the state of a manifest-driven bulk edit
+typedef struct BatchInfo
+{
+    char *manifest;        // Path of the manifest file
+    int threads;           // Number of worker threads
+    uint group_files;      // Group commit: edited files flushed together, 0 to flush every rewrite on its own
+    uint group_ms;         // Group commit: longest time a group waits for more files, 0 for no limit
+    uint groups;           // Number of groups committed
+    char *text;            // Contents of the manifest, the jobs point into it
+
+    BatchJob *jobs;        // Jobs in manifest order
+    uint count;            // Number of jobs
+    uint capacity;         // Allocated entries in jobs
+
+    char **results;        // Result line of each job, NULL until edited
+    uint next;             // Next job to be handed to a worker
+    uint printed;          // Number of jobs whose result was taken, printed or waiting in a group
+    uint failed;           // Number of jobs that failed
+    uint in_place;         // Number of files patched in place
+
+    pthread_mutex_t lock;  // Protects next, printed, failed, in_place and results
+    pthread_cond_t ready;  // Signalled when a result is stored
+    pthread_cond_t space;  // Signalled when a result is printed
+} BatchInfo;
+
+// Function Prototypes
+
+/**
+ * Validates the arguments of the bulk edit.
+ * 
+ * @param argc (int): Number of command-line arguments.
+ * @param argv (char*[]): Command-line arguments, the manifest at index 2, the optional thread count at index 3
+ *                       and the optional group commit (files[,milliseconds]) at index 4.
+ * @param batch (BatchInfo*): Structure to store the batch information.
+ * 
+ * @returns Status: e_success if validation is successful, e_failure if there's an error.
+ */
+Status read_and_validation_batch(int argc, char *argv[], BatchInfo *batch);
+
+
+/**
+ * Reads the manifest and applies every job on the worker threads.
+ * One result line per file is printed in manifest order. With a group commit, the results are
+ * printed once the files of their group are on disk.
+ * 
+ * @param batch (BatchInfo*): Structure containing the batch information.
+ * 
+ * @returns Status: e_success if every file was edited, e_failure if any job failed.
+ */
+Status batch_info(BatchInfo *batch);
+
+
+/**
+ * Splits the manifest into jobs. Each line is either tab separated (path, then key and text pairs)
+ * or a JSON object with a "path" member and one string member per frame.
+ * Lines that can't be used become jobs with an error, so they are reported in order.
+ * 
+ * @param batch (BatchInfo*): Structure containing the batch information, with the manifest text loaded.
+ * 
+ * @returns Status: e_success if the manifest was split, e_failure if memory runs out.
+ */
+Status parse_manifest(BatchInfo *batch);
+
+
+/**
+ * Fills a job from one manifest line, tab separated or a JSON object.
+ * Only MP3 files with at least one change are accepted; otherwise job->error tells why.
+ * 
+ * @param job (BatchJob*): The job to be filled, its path and texts point into the line.
+ * @param line (char*): The line without its line break, split and decoded in place.
+ */
+void parse_job(BatchJob *job, char *line);
+
+#endif
@@ -0,0 +1,562 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "mp3_frame.h"
+#include "mp3_cache.h"
+#include "mp3_tail.h"
+
+// Size of the fixed part of a record: dev, ino, size, mtime, header, tag size, tail size and checksum
+#define RECORD_SIZE (4 * 8 + 10 + 4 + 4 + 4)
+
+// Offset of the checksum in the fixed part, it covers every other byte of the record
+#define RECORD_CHECKSUM (RECORD_SIZE - 4)
+
+// Largest frame region a record can hold, the 28 bits of an ID3 tag size
+#define RECORD_TAG_MAX 0x0FFFFFFF
+
+/**
+ * Hashes the (dev, ino) key of a file.
+ */
+static uint hash_key(unsigned long long dev, unsigned long long ino)
+{
+    unsigned long long h = (ino ^ (dev << 32 | dev >> 32)) * 0x9E3779B97F4A7C15ULL;
+    return (uint)(h >> 32);
+}
+
+/**
+ * Finds the hash table bucket of a key: the bucket holding it, or the empty bucket where it belongs.
+ */
+static uint *find_bucket(TagCache *cache, unsigned long long dev, unsigned long long ino)
+{
+    uint mask = cache->bucket_count - 1;
+    for (uint b = hash_key(dev, ino) & mask; ; b = (b + 1) & mask)
+    {
+        uint slot = cache->buckets[b];
+        if (slot == 0 || (cache->entries[slot - 1].dev == dev && cache->entries[slot - 1].ino == ino))
+        {
+            return &cache->buckets[b];
+        }
+    }
+}
+
+/**
+ * Doubles the hash table and inserts all entries again.
+ */
+static Status grow_buckets(TagCache *cache)
+{
+    uint bucket_count = cache->bucket_count ? cache->bucket_count * 2 : 1024;
+    uint *buckets = calloc(bucket_count, sizeof(uint));
+    if (buckets == NULL)
+    {
+        return e_failure;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = bucket_count;
+
+    for (uint i = 0; i < cache->count; i++)
+    {
+        *find_bucket(cache, cache->entries[i].dev, cache->entries[i].ino) = i + 1;
+    }
+    return e_success;
+}
+
+/**
+ * Adds an entry to the table, replacing the older entry of the same file. Takes ownership of entry->tag and entry->tail.
+ */
+static Status insert_entry(TagCache *cache, CacheEntry *entry)
+{
+    // Keep the hash table at most half full
+    if (2 * (cache->count + 1) > cache->bucket_count && grow_buckets(cache) == e_failure)
+    {
+        return e_failure;
+    }
+
+    uint *bucket = find_bucket(cache, entry->dev, entry->ino);
+    if (*bucket != 0)
+    {
+        CacheEntry *old = &cache->entries[*bucket - 1];
+        free(old->tag);
+        free(old->tail);
+        *old = *entry;
+        return e_success;
+    }
+
+    if (cache->count == cache->capacity)
+    {
+        uint capacity = cache->capacity ? cache->capacity * 2 : 1024;
+        CacheEntry *entries = realloc(cache->entries, capacity * sizeof(CacheEntry));
+        if (entries == NULL)
+        {
+            return e_failure;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+    cache->entries[cache->count++] = *entry;
+    *bucket = cache->count;
+    return e_success;
+}
+
+/**
+ * Adds bytes to a checksum (FNV-1a).
+ */
+static uint checksum_add(uint sum, const unsigned char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        sum = (sum ^ data[i]) * 16777619u;
+    }
+    return sum;
+}
+
+/**
+ * Gives the checksum of a record: its fixed part up to the checksum, the frames and the tail tags.
+ */
+static uint record_checksum(const unsigned char *record, const unsigned char *tag, uint tag_size,
+                            const unsigned char *tail, uint tail_size)
+{
+    uint sum = checksum_add(2166136261u, record, RECORD_CHECKSUM);
+    sum = checksum_add(sum, tag, tag_size);
+    return checksum_add(sum, tail, tail_size);
+}
+
+/**
+ * Writes one entry as a record to a file with a single write(). On a file opened with
+ * O_APPEND the record lands whole, even when other processes append to the same file.
+ */
+static Status write_record(int fd, const CacheEntry *entry)
+{
+    size_t len = RECORD_SIZE + (size_t)entry->tag_size + entry->tail_size;
+    unsigned char *record = malloc(len);
+    if (record == NULL)
+    {
+        return e_failure;
+    }
+    memcpy(record, &entry->dev, 8);
+    memcpy(record + 8, &entry->ino, 8);
+    memcpy(record + 16, &entry->size, 8);
+    memcpy(record + 24, &entry->mtime_ns, 8);
+    memcpy(record + 32, entry->header, 10);
+    memcpy(record + 42, &entry->tag_size, 4);
+    memcpy(record + 46, &entry->tail_size, 4);
+    memcpy(record + RECORD_SIZE, entry->tag, entry->tag_size);
+    memcpy(record + RECORD_SIZE + entry->tag_size, entry->tail, entry->tail_size);
+    uint sum = record_checksum(record, entry->tag, entry->tag_size, entry->tail, entry->tail_size);
+    memcpy(record + RECORD_CHECKSUM, &sum, 4);
+
+    ssize_t written = write(fd, record, len);
+    free(record);
+    return written == (ssize_t)len ? e_success : e_failure;
+}
+
+/**
+ * Locks the cache file (flock) for an operation, reopening it first when another process
+ * replaced it by a compaction since it was opened. Appends take a shared lock, their
+ * single write() to an O_APPEND file keeps records whole; loading and compacting take an
+ * exclusive one, so they never see a record half written.
+ */
+static Status lock_file(TagCache *cache, int operation)
+{
+    while (1)
+    {
+        struct stat fd_st, path_st;
+        if (flock(cache->fd_file, operation) != 0 || fstat(cache->fd_file, &fd_st) != 0)
+        {
+            return e_failure;
+        }
+        if (stat(cache->file_name, &path_st) == 0 && path_st.st_dev == fd_st.st_dev && path_st.st_ino == fd_st.st_ino)
+        {
+            return e_success;
+        }
+
+        // Closing the old file releases its lock
+        int fd = open(cache->file_name, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            return e_failure;
+        }
+        close(cache->fd_file);
+        cache->fd_file = fd;
+    }
+}
+
+/**
+ * Rewrites the cache file with only the newest record of every file, with the cache file
+ * locked. The records go to a file of its own next to the cache file, which then replaces it.
+ */
+static Status compact_file(TagCache *cache)
+{
+    char *temp_name = malloc(strlen(cache->file_name) + 8);
+    if (temp_name == NULL)
+    {
+        return e_failure;
+    }
+    sprintf(temp_name, "%s.XXXXXX", cache->file_name);
+
+    // A shared cache file keeps its permissions, a new one is private
+    struct stat st;
+    int fd = mkstemp(temp_name);
+    Status status = fd >= 0 ? e_success : e_failure;
+    if (status == e_success && stat(cache->file_name, &st) == 0 && fchmod(fd, st.st_mode & 07777) != 0)
+    {
+        status = e_failure;
+    }
+    if (status == e_success && write(fd, CACHE_MAGIC, 8) != 8)
+    {
+        status = e_failure;
+    }
+    for (uint i = 0; status == e_success && i < cache->count; i++)
+    {
+        status = write_record(fd, &cache->entries[i]);
+    }
+    if (fd >= 0 && close(fd) != 0)
+    {
+        status = e_failure;
+    }
+    if (status == e_success && rename(temp_name, cache->file_name) != 0)
+    {
+        status = e_failure;
+    }
+    if (status == e_failure && fd >= 0)
+    {
+        remove(temp_name);
+    }
+
+    free(temp_name);
+    return status;
+}
+
+/**
+ * Loads the cache file named by the MP3_TAG_CACHE environment variable.
+ * 
+ * Parameters:
+ *   cache (TagCache*): A pointer to the cache to be loaded.
+ * 
+ * Returns:
+ *   Status: e_success if the cache is ready, e_failure if no cache is configured or it can't be opened.
+ */
+Status cache_open_env(TagCache *cache)
+{
+    const char *file_name = getenv("MP3_TAG_CACHE");
+    if (file_name == NULL || *file_name == '\0')
+    {
+        return e_failure;
+    }
+    return cache_open(cache, file_name);
+}
+
+/**
+ * Loads a cache file and opens it for appending.
+ * Records are appended as files are parsed, so a file can have several records; the last
+ * one wins. When most records are stale the file is compacted. Other processes may append
+ * to the same file; every record is checked against its checksum before it is used.
+ * 
+ * Parameters:
+ *   cache (TagCache*): A pointer to the cache to be loaded.
+ *   file_name (const char*): The cache file name.
+ * 
+ * Returns:
+ *   Status: e_success if the cache is ready, e_failure if an error occurs.
+ */
+Status cache_open(TagCache *cache, const char *file_name)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->fd_file = -1;
+    cache->file_name = strdup(file_name);
+    if (cache->file_name == NULL || grow_buckets(cache) == e_failure)
+    {
+        cache_close(cache);
+        return e_failure;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+
+    // The file stays open for appending, it is locked while it is loaded
+    cache->fd_file = open(file_name, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    int fd = cache->fd_file >= 0 && lock_file(cache, LOCK_EX) == e_success ? dup(cache->fd_file) : -1;
+    FILE *fptr = fd >= 0 ? fdopen(fd, "r") : NULL;
+    if (fptr == NULL)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        cache_close(cache);
+        return e_failure;
+    }
+
+    // Load every record, a new (empty) file gets the magic and gives an empty cache
+    uint records = 0;
+    int broken = 0;
+    char magic[8];
+    size_t count = fread(magic, 1, 8, fptr);
+    int valid = count == 8 && memcmp(magic, CACHE_MAGIC, 8) == 0;
+    if (count == 0)
+    {
+        valid = write(cache->fd_file, CACHE_MAGIC, 8) == 8;
+    }
+    else
+    {
+        // Never overwrite a file that isn't a cache file
+        if (!valid && (count != 8 || memcmp(magic, CACHE_MAGIC, 7) != 0))
+        {
+            fclose(fptr);
+            cache_close(cache);
+            return e_failure;
+        }
+
+        struct stat file_st;
+        long long file_size = fstat(fileno(fptr), &file_st) == 0 ? (long long)file_st.st_size : 0;
+        unsigned char record[RECORD_SIZE];
+        while (valid && fread(record, RECORD_SIZE, 1, fptr) == 1)
+        {
+            CacheEntry entry;
+            memcpy(&entry.dev, record, 8);
+            memcpy(&entry.ino, record + 8, 8);
+            memcpy(&entry.size, record + 16, 8);
+            memcpy(&entry.mtime_ns, record + 24, 8);
+            memcpy(entry.header, record + 32, 10);
+            memcpy(&entry.tag_size, record + 42, 4);
+            memcpy(&entry.tail_size, record + 46, 4);
+
+            // A record cut short by a crash, with sizes no record can have or with a wrong
+            // checksum ends the file
+            long long left = file_size - ftell(fptr);
+            if (entry.tag_size > RECORD_TAG_MAX || entry.tail_size > TAIL_PROBE_SIZE ||
+                (long long)entry.tag_size + entry.tail_size > left)
+            {
+                break;
+            }
+            entry.tag = malloc(entry.tag_size + 1);
+            entry.tail = malloc(entry.tail_size + 1);
+            uint sum;
+            memcpy(&sum, record + RECORD_CHECKSUM, 4);
+            if (entry.tag == NULL || entry.tail == NULL || fread(entry.tag, 1, entry.tag_size, fptr) != entry.tag_size ||
+                fread(entry.tail, 1, entry.tail_size, fptr) != entry.tail_size ||
+                record_checksum(record, entry.tag, entry.tag_size, entry.tail, entry.tail_size) != sum)
+            {
+                free(entry.tag);
+                free(entry.tail);
+                break;
+            }
+            if (insert_entry(cache, &entry) == e_failure)
+            {
+                free(entry.tag);
+                free(entry.tail);
+                break;
+            }
+            records++;
+        }
+
+        // Records after a bad one are lost, the file is rewritten so new ones aren't appended behind it
+        broken = valid && ftell(fptr) < file_size;
+    }
+    fclose(fptr);
+
+    // Start over a file of another version, or compact the file when most of its records
+    // are stale. Other processes reopen the new file before their next append
+    if (!valid || broken || records > 2 * cache->count + 1024)
+    {
+        if (compact_file(cache) == e_failure)
+        {
+            cache_close(cache);
+            return e_failure;
+        }
+    }
+    flock(cache->fd_file, LOCK_UN);
+
+    return e_success;
+}
+
+/**
+ * Looks up the tag of a file, only if the device, inode, size and modification time match.
+ * 
+ * Parameters:
+ *   cache (TagCache*): A pointer to the cache.
+ *   st (const struct stat*): Status of the file.
+ *   header (unsigned char*): Set to the 10 byte tag header.
+ *   tag (unsigned char**): Set to a malloc'd copy of the cached frames.
+ *   tag_size (uint*): Set to the size of the cached frames.
+ *   tail (unsigned char**): Set to a malloc'd copy of the cached tail tags, NULL if the file has none.
+ *   tail_size (uint*): Set to the size of the cached tail tags.
+ * 
+ * Returns:
+ *   Status: e_success on a hit, e_failure on a miss.
+ */
+Status cache_lookup(TagCache *cache, const struct stat *st, unsigned char *header, unsigned char **tag, uint *tag_size,
+                    unsigned char **tail, uint *tail_size)
+{
+    Status status = e_failure;
+    long long mtime_ns = (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+
+    pthread_mutex_lock(&cache->lock);
+    uint slot = *find_bucket(cache, st->st_dev, st->st_ino);
+    if (slot != 0)
+    {
+        CacheEntry *entry = &cache->entries[slot - 1];
+        if (entry->size == (unsigned long long)st->st_size && entry->mtime_ns == mtime_ns)
+        {
+            *tag = malloc(entry->tag_size + 1);
+            *tail = entry->tail_size > 0 ? malloc(entry->tail_size) : NULL;
+            if (*tag != NULL && (*tail != NULL || entry->tail_size == 0))
+            {
+                memcpy(*tag, entry->tag, entry->tag_size);
+                memcpy(header, entry->header, 10);
+                *tag_size = entry->tag_size;
+                if (*tail != NULL)
+                {
+                    memcpy(*tail, entry->tail, entry->tail_size);
+                }
+                *tail_size = entry->tail_size;
+                status = e_success;
+            }
+            else
+            {
+                free(*tag);
+                free(*tail);
+                *tag = NULL;
+                *tail = NULL;
+            }
+        }
+    }
+    if (status == e_success)
+    {
+        cache->hits++;
+    }
+    else
+    {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return status;
+}
+
+/**
+ * Stores the tag and tail tags of a file in memory and appends them to the cache file.
+ * Every frame is kept whole and the padding is dropped, except binary frames larger than
+ * CACHE_FRAME_MAX bytes, which are kept as stubs so their type and size can still be
+ * reported. Text frames are never cut, so a cache hit shows the same texts as a miss.
+ * The tail tags are kept whole, they never pass TAIL_PROBE_SIZE bytes.
+ * 
+ * Parameters:
+ *   cache (TagCache*): A pointer to the cache.
+ *   st (const struct stat*): Status of the file.
+ *   header (const unsigned char*): The 10 byte tag header, NULL for a file with only tail tags.
+ *   tag (const unsigned char*): The frame region of the tag, NULL for a file with only tail tags.
+ *   tag_size (uint): Size of the frame region.
+ *   tail (const unsigned char*): The tail tags, NULL if there are none.
+ *   tail_size (uint): Size of the tail tags.
+ * 
+ * Returns:
+ *   Status: e_success if the tag is stored, e_failure if an error occurs.
+ */
+Status cache_store(TagCache *cache, const struct stat *st, const unsigned char *header, const unsigned char *tag, uint tag_size,
+                   const unsigned char *tail, uint tail_size)
+{
+    FrameIndex index;
+    memset(&index, 0, sizeof(index));
+    if (tag != NULL && build_frame_index(&index, header, tag, tag_size) == e_failure)
+    {
+        free_frame_index(&index);
+        return e_failure;
+    }
+
+    CacheEntry entry;
+    entry.dev = st->st_dev;
+    entry.ino = st->st_ino;
+    entry.size = st->st_size;
+    entry.mtime_ns = (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+    entry.tag = malloc(index.used + 1);
+    entry.tail = malloc(tail_size + 1);
+    if (entry.tag == NULL || entry.tail == NULL)
+    {
+        free(entry.tag);
+        free(entry.tail);
+        free_frame_index(&index);
+        return e_failure;
+    }
+    entry.tail_size = tail_size;
+    if (tail_size > 0)
+    {
+        memcpy(entry.tail, tail, tail_size);
+    }
+
+    // Keep every frame whole, in its original order, except large binary frames which become
+    // stubs. ID3v2.2 frames can't be stubbed, their large binary frames are kept whole.
+    entry.tag_size = 0;
+    for (uint i = 0; i < index.count; i++)
+    {
+        const FrameEntry *frame = &index.frames[i];
+        uint length = frame->data + frame->size - frame->offset;
+        if (frame->size > CACHE_FRAME_MAX && is_binary_frame(frame->id) && index.parser->header_size == FRAME_HEADER_SIZE)
+        {
+            entry.tag_size += make_stub_frame(index.parser, entry.tag + entry.tag_size, frame, tag);
+        }
+        else
+        {
+            memcpy(entry.tag + entry.tag_size, tag + frame->offset, length);
+            entry.tag_size += length;
+        }
+    }
+    free_frame_index(&index);
+
+    // The extended header is dropped with the padding, a file without a tag keeps a zero header
+    memset(entry.header, 0, 10);
+    if (tag != NULL)
+    {
+        memcpy(entry.header, header, 10);
+        entry.header[5] &= ~ID3_EXTENDED_FLAG;
+        int_to_syncsafe(entry.header + 6, entry.tag_size);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    Status status = lock_file(cache, LOCK_SH);
+    if (status == e_success)
+    {
+        status = write_record(cache->fd_file, &entry);
+        flock(cache->fd_file, LOCK_UN);
+    }
+    if (status == e_success)
+    {
+        status = insert_entry(cache, &entry);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (status == e_failure)
+    {
+        free(entry.tag);
+        free(entry.tail);
+    }
+    return status;
+}
+
+/**
+ * Closes the cache file and releases the cache.
+ * 
+ * Parameters:
+ *   cache (TagCache*): A pointer to the cache.
+ */
+void cache_close(TagCache *cache)
+{
+    if (cache->fd_file >= 0)
+    {
+        close(cache->fd_file);
+    }
+    for (uint i = 0; i < cache->count; i++)
+    {
+        free(cache->entries[i].tag);
+        free(cache->entries[i].tail);
+    }
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache->file_name);
+    memset(cache, 0, sizeof(*cache));
+    cache->fd_file = -1;
+}
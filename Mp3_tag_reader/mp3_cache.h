@@ -0,0 +1,115 @@
+#ifndef MP3_CACHE_H
+#define MP3_CACHE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "types.h"
+
+// Identifies the cache file format, changed whenever the record layout or contents change;
+// a cache file of another version is started over
+#define CACHE_MAGIC "MP3TAGC5"
+
+// Binary frames larger than this (e.g., embedded pictures) are kept as stubs without their payload
+#define CACHE_FRAME_MAX 4096
+
+// Structure to store one cached tag, valid as long as the file has the same key
+typedef struct CacheEntry
+{
+    unsigned long long dev;    // Device of the file
+    unsigned long long ino;    // Inode of the file
+    unsigned long long size;   // Size of the file in bytes
+    long long mtime_ns;        // Modification time in nanoseconds
+    unsigned char header[10];  // ID3 tag header, its size field matches the cached frames (zeros without a tag)
+    uint tag_size;             // Size of the cached frames
+    unsigned char *tag;        // The cached frames in the layout of the tag version
+    uint tail_size;            // Size of the cached tail tags
+    unsigned char *tail;       // The ID3v1, Lyrics3 and APE tags at the end of the file
+} CacheEntry;
+
+// Structure to store the on-disk cache of parsed tags, loaded in memory and appended to
+typedef struct TagCache
+{
+    char *file_name;           // Cache file name
+    int fd_file;               // Cache file, opened with O_APPEND: each record goes out in one write()
+
+    CacheEntry *entries;       // All entries (the newest record of each file)
+    uint count;                // Number of entries
+    uint capacity;             // Allocated entries
+
+    uint *buckets;             // Hash table of entry index + 1 by (dev, ino), 0 when empty
+    uint bucket_count;         // Size of the hash table (a power of 2)
+
+    uint hits;                 // Lookups answered from the cache
+    uint misses;               // Lookups that had to read the file
+    pthread_mutex_t lock;      // Protects the table and the cache file
+} TagCache;
+
+// Function Prototypes
+
+/**
+ * Loads the cache file named by the MP3_TAG_CACHE environment variable.
+ * 
+ * @param cache (TagCache*): The cache to be loaded.
+ * 
+ * @returns Status: e_success if the cache is ready, e_failure if no cache is configured or it can't be opened.
+ */
+Status cache_open_env(TagCache *cache);
+
+
+/**
+ * Loads a cache file (a missing or unreadable file starts an empty cache) and opens it for appending.
+ * Several processes may share the file: records are appended whole and checked on load.
+ * 
+ * @param cache (TagCache*): The cache to be loaded.
+ * @param file_name (const char*): The cache file name.
+ * 
+ * @returns Status: e_success if the cache is ready, e_failure if an error occurs.
+ */
+Status cache_open(TagCache *cache, const char *file_name);
+
+
+/**
+ * Looks up the tag of a file. The entry is only used if the device, inode, size and
+ * modification time of the file are unchanged.
+ * 
+ * @param cache (TagCache*): The cache.
+ * @param st (const struct stat*): Status of the file.
+ * @param header (unsigned char*): Set to the 10 byte tag header.
+ * @param tag (unsigned char**): Set to a malloc'd copy of the cached frames.
+ * @param tag_size (uint*): Set to the size of the cached frames.
+ * @param tail (unsigned char**): Set to a malloc'd copy of the cached tail tags, NULL if the file has none.
+ * @param tail_size (uint*): Set to the size of the cached tail tags.
+ * 
+ * @returns Status: e_success on a hit, e_failure on a miss.
+ */
+Status cache_lookup(TagCache *cache, const struct stat *st, unsigned char *header, unsigned char **tag, uint *tag_size,
+                    unsigned char **tail, uint *tail_size);
+
+
+/**
+ * Stores the tag and tail tags of a file in memory and appends them to the cache file.
+ * Binary frames larger than CACHE_FRAME_MAX are kept as stubs, every other frame whole.
+ * 
+ * @param cache (TagCache*): The cache.
+ * @param st (const struct stat*): Status of the file.
+ * @param header (const unsigned char*): The 10 byte tag header, NULL for a file with only tail tags.
+ * @param tag (const unsigned char*): The frame region of the tag, NULL for a file with only tail tags.
+ * @param tag_size (uint): Size of the frame region.
+ * @param tail (const unsigned char*): The tail tags, NULL if there are none.
+ * @param tail_size (uint): Size of the tail tags.
+ * 
+ * @returns Status: e_success if the tag is stored, e_failure if an error occurs.
+ */
+Status cache_store(TagCache *cache, const struct stat *st, const unsigned char *header, const unsigned char *tag, uint tag_size,
+                   const unsigned char *tail, uint tail_size);
+
+
+/**
+ * Closes the cache file and releases the cache.
+ * 
+ * @param cache (TagCache*): The cache.
+ */
+void cache_close(TagCache *cache);
+
+#endif
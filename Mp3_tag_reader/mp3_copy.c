@@ -0,0 +1,423 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include "types.h"
+#include "mp3_copy.h"
+#include "mp3_stats.h"
+
+// Size of one kernel copy request and of the user space fallback buffer
+#define COPY_CHUNK (1 << 20)
+#define COPY_ALIGN 4096
+
+// Counters for every copy method
+static CopyCounter copy_counters[copy_methods];
+
+/**
+ * Returns the current monotonic time in nanoseconds.
+ */
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Returns the size of the next copy request: one chunk, or less when fewer bytes are left.
+ */
+static size_t next_chunk(size_t left)
+{
+    return left < COPY_CHUNK ? left : COPY_CHUNK;
+}
+
+/**
+ * Counts one kernel side copy call for the current file, as a read and a write of the same bytes.
+ */
+static void count_kernel_copy(ssize_t count)
+{
+    stats_count(count_reads, 1);
+    stats_count(count_writes, 1);
+    stats_count(count_bytes_read, count > 0 ? count : 0);
+    stats_count(count_bytes_written, count > 0 ? count : 0);
+}
+
+/**
+ * Copies with copy_file_range() until length bytes are copied or the source file ends.
+ * 
+ * Parameters:
+ *   fd_dest (int), fd_src (int): The file descriptors.
+ *   off_dest (off_t*), off_src (off_t*): Offsets, moved past the copied data.
+ *   length (size_t): Number of bytes to copy, COPY_ALL for everything.
+ * 
+ * Returns:
+ *   Status: e_success if the copy is done, e_failure if this method is not supported
+ *           before anything was copied (errno tells why otherwise).
+ */
+static Status copy_with_range(int fd_dest, int fd_src, off_t *off_dest, off_t *off_src, size_t length)
+{
+    ssize_t count = 0;
+    while (length > 0 && (count = copy_file_range(fd_src, off_src, fd_dest, off_dest, next_chunk(length), 0)) > 0)
+    {
+        count_kernel_copy(count);
+        length -= count;
+        __atomic_fetch_add(&copy_counters[copy_range].bytes, count, __ATOMIC_RELAXED);
+    }
+    return count >= 0 ? e_success : e_failure;
+}
+
+/**
+ * Copies with sendfile() until length bytes are copied or the source file ends.
+ * sendfile() writes at the current offset of the destination, so it is moved first.
+ * 
+ * Parameters:
+ *   fd_dest (int), fd_src (int): The file descriptors.
+ *   off_dest (off_t*), off_src (off_t*): Offsets, moved past the copied data.
+ *   length (size_t): Number of bytes to copy, COPY_ALL for everything.
+ * 
+ * Returns:
+ *   Status: e_success if the copy is done, e_failure if an error occurs.
+ */
+static Status copy_with_sendfile(int fd_dest, int fd_src, off_t *off_dest, off_t *off_src, size_t length)
+{
+    if (stats_lseek(fd_dest, *off_dest, SEEK_SET) < 0)
+    {
+        return e_failure;
+    }
+
+    ssize_t count = 0;
+    while (length > 0 && (count = sendfile(fd_dest, fd_src, off_src, next_chunk(length))) > 0)
+    {
+        count_kernel_copy(count);
+        length -= count;
+        *off_dest += count;
+        __atomic_fetch_add(&copy_counters[copy_sendfile].bytes, count, __ATOMIC_RELAXED);
+    }
+    return count >= 0 ? e_success : e_failure;
+}
+
+/**
+ * Copies with pread()/pwrite() through a large aligned buffer.
+ * 
+ * Parameters:
+ *   fd_dest (int), fd_src (int): The file descriptors.
+ *   off_dest (off_t*), off_src (off_t*): Offsets, moved past the copied data.
+ *   length (size_t): Number of bytes to copy, COPY_ALL for everything.
+ * 
+ * Returns:
+ *   Status: e_success if the copy is done, e_failure if an error occurs.
+ */
+static Status copy_with_buffer(int fd_dest, int fd_src, off_t *off_dest, off_t *off_src, size_t length)
+{
+    void *buffer;
+    if (posix_memalign(&buffer, COPY_ALIGN, COPY_CHUNK) != 0)
+    {
+        return e_failure;
+    }
+
+    ssize_t count = 0;
+    while (length > 0 && (count = stats_pread(fd_src, buffer, next_chunk(length), *off_src)) > 0)
+    {
+        for (ssize_t done = 0; done < count; )
+        {
+            ssize_t written = stats_pwrite(fd_dest, (char *)buffer + done, count - done, *off_dest);
+            if (written <= 0)
+            {
+                free(buffer);
+                return e_failure;
+            }
+            done += written;
+            *off_dest += written;
+        }
+        length -= count;
+        *off_src += count;
+        __atomic_fetch_add(&copy_counters[copy_buffered].bytes, count, __ATOMIC_RELAXED);
+    }
+
+    free(buffer);
+    return count >= 0 ? e_success : e_failure;
+}
+
+/**
+ * Copies a part of the source file with the fastest method the files support.
+ * 
+ * Parameters:
+ *   fd_dest (int), fd_src (int): The file descriptors.
+ *   off_dest (off_t*), off_src (off_t*): Offsets, moved past the copied data.
+ *   length (size_t): Number of bytes to copy, COPY_ALL for everything.
+ *   method (CopyMethod*): Set to the method that copied the data (may be NULL).
+ * 
+ * Returns:
+ *   Status: e_success if the copy is successful, e_failure if an error occurs.
+ */
+static Status copy_part(int fd_dest, int fd_src, off_t *off_dest, off_t *off_src, size_t length, CopyMethod *method)
+{
+    unsigned long long start = now_ns();
+    unsigned long long phase = stats_start();
+    CopyMethod used = copy_range;
+    off_t start_src = *off_src;
+
+    Status status = copy_with_range(fd_dest, fd_src, off_dest, off_src, length);
+    if (status == e_failure && *off_src == start_src)
+    {
+        // Not supported between these files (e.g., EXDEV, EINVAL), try sendfile()
+        used = copy_sendfile;
+        status = copy_with_sendfile(fd_dest, fd_src, off_dest, off_src, length);
+        if (status == e_failure && *off_src == start_src)
+        {
+            used = copy_buffered;
+            status = copy_with_buffer(fd_dest, fd_src, off_dest, off_src, length);
+        }
+    }
+
+    // Counters are shared by all threads
+    stats_stop(phase_copy, phase);
+    __atomic_fetch_add(&copy_counters[used].nanosec, now_ns() - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&copy_counters[used].calls, 1, __ATOMIC_RELAXED);
+    if (method != NULL)
+    {
+        *method = used;
+    }
+    return status;
+}
+
+/**
+ * Copies everything from the current position of the source file to the current
+ * position of the destination file. The kernel side methods are tried first and the
+ * buffered copy is used when the files don't support them.
+ * 
+ * Parameters:
+ *   fptr_dest (FILE*): Pointer to the destination file.
+ *   fptr_src (FILE*): Pointer to the source file.
+ *   method (CopyMethod*): Set to the method that copied the data (may be NULL).
+ * 
+ * Returns:
+ *   Status: e_success if the copy is successful, e_failure if an error occurs.
+ */
+Status copy_file_data(FILE *fptr_dest, FILE *fptr_src, CopyMethod *method)
+{
+    // Flush pending writes so the file descriptor offsets match the FILE positions
+    if (fflush(fptr_dest) != 0)
+    {
+        return e_failure;
+    }
+    off_t off_src = ftello(fptr_src);
+    off_t off_dest = ftello(fptr_dest);
+    if (off_src < 0 || off_dest < 0)
+    {
+        return e_failure;
+    }
+
+    Status status = copy_part(fileno(fptr_dest), fileno(fptr_src), &off_dest, &off_src, COPY_ALL, method);
+
+    // Move both FILE positions past the copied data
+    if (stats_fseek(fptr_src, off_src, SEEK_SET) != 0 || stats_fseek(fptr_dest, off_dest, SEEK_SET) != 0)
+    {
+        return e_failure;
+    }
+    return status;
+}
+
+/**
+ * Copies length bytes starting at an offset of the source file to the current offset of the
+ * destination file, trying copy_file_range(), sendfile() and a buffered copy in that order.
+ * The source offset is not moved; the destination offset is moved past the copied data.
+ * 
+ * Parameters:
+ *   fd_dest (int): Destination file descriptor.
+ *   fd_src (int): Source file descriptor.
+ *   offset (off_t): Offset of the first byte in the source file.
+ *   length (size_t): Number of bytes to copy.
+ *   method (CopyMethod*): Set to the method that copied the data (may be NULL).
+ * 
+ * Returns:
+ *   Status: e_success if all bytes were copied, e_failure if an error occurs or the source is too short.
+ */
+Status copy_file_part(int fd_dest, int fd_src, off_t offset, size_t length, CopyMethod *method)
+{
+    off_t off_dest = stats_lseek(fd_dest, 0, SEEK_CUR);
+    off_t off_src = offset;
+    if (off_dest < 0)
+    {
+        return e_failure;
+    }
+
+    Status status = copy_part(fd_dest, fd_src, &off_dest, &off_src, length, method);
+    if (stats_lseek(fd_dest, off_dest, SEEK_SET) < 0 || (size_t)(off_src - offset) != length)
+    {
+        return e_failure;
+    }
+    return status;
+}
+
+/**
+ * Moves data with splice() until the end of the source. At least one side must be a pipe.
+ * 
+ * Parameters:
+ *   fd_dest (int), fd_src (int): The file descriptors.
+ *   moved (unsigned long long*): Incremented by the bytes moved.
+ * 
+ * Returns:
+ *   Status: e_success if the copy is done, e_failure if this method is not supported
+ *           before anything was moved (errno tells why otherwise).
+ */
+static Status copy_with_splice(int fd_dest, int fd_src, unsigned long long *moved)
+{
+    ssize_t count;
+    while ((count = splice(fd_src, NULL, fd_dest, NULL, COPY_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0)
+    {
+        count_kernel_copy(count);
+        *moved += count;
+        __atomic_fetch_add(&copy_counters[copy_splice].bytes, count, __ATOMIC_RELAXED);
+    }
+    return count == 0 ? e_success : e_failure;
+}
+
+/**
+ * Copies with read()/write() through one fixed size buffer until the end of the source.
+ * 
+ * Parameters:
+ *   fd_dest (int), fd_src (int): The file descriptors.
+ * 
+ * Returns:
+ *   Status: e_success if the copy is done, e_failure if an error occurs.
+ */
+static Status copy_with_stream(int fd_dest, int fd_src)
+{
+    char *buffer = NULL;
+    if (posix_memalign((void **)&buffer, COPY_ALIGN, COPY_CHUNK) != 0)
+    {
+        return e_failure;
+    }
+
+    ssize_t count;
+    while ((count = stats_read(fd_src, buffer, COPY_CHUNK)) != 0)
+    {
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            free(buffer);
+            return e_failure;
+        }
+        for (ssize_t done = 0; done < count; )
+        {
+            ssize_t written = stats_write(fd_dest, buffer + done, count - done);
+            if (written < 0 && errno != EINTR)
+            {
+                free(buffer);
+                return e_failure;
+            }
+            done += written > 0 ? written : 0;
+        }
+        __atomic_fetch_add(&copy_counters[copy_buffered].bytes, count, __ATOMIC_RELAXED);
+    }
+
+    free(buffer);
+    return e_success;
+}
+
+/**
+ * Copies everything left in the source descriptor to the destination descriptor without
+ * seeking either of them, so pipes and sockets are supported. splice() is tried first
+ * and read()/write() is used when neither side is a pipe.
+ * 
+ * Parameters:
+ *   fd_dest (int): Destination file descriptor.
+ *   fd_src (int): Source file descriptor, read until end of file.
+ *   method (CopyMethod*): Set to the method that copied the data (may be NULL).
+ * 
+ * Returns:
+ *   Status: e_success if the copy is successful, e_failure if an error occurs.
+ */
+Status copy_stream_data(int fd_dest, int fd_src, CopyMethod *method)
+{
+    unsigned long long start = now_ns();
+    unsigned long long phase = stats_start();
+    unsigned long long moved = 0;
+    CopyMethod used = copy_splice;
+
+    Status status = copy_with_splice(fd_dest, fd_src, &moved);
+    if (status == e_failure && moved == 0 && errno == EINVAL)
+    {
+        used = copy_buffered;
+        status = copy_with_stream(fd_dest, fd_src);
+    }
+
+    stats_stop(phase_copy, phase);
+    __atomic_fetch_add(&copy_counters[used].nanosec, now_ns() - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&copy_counters[used].calls, 1, __ATOMIC_RELAXED);
+    if (method != NULL)
+    {
+        *method = used;
+    }
+    return status;
+}
+
+/**
+ * Returns the counters collected for a copy method since the program started.
+ * 
+ * Parameters:
+ *   method (CopyMethod): The copy method.
+ * 
+ * Returns:
+ *   const CopyCounter*: Pointer to the counters of that method.
+ */
+const CopyCounter *get_copy_counter(CopyMethod method)
+{
+    return &copy_counters[method];
+}
+
+/**
+ * Returns a printable name of a copy method.
+ * 
+ * Parameters:
+ *   method (CopyMethod): The copy method.
+ * 
+ * Returns:
+ *   const char*: Name of the method.
+ */
+const char *copy_method_name(CopyMethod method)
+{
+    switch (method)
+    {
+        case copy_range:
+            return "copy_file_range";
+        case copy_sendfile:
+            return "sendfile";
+        case copy_splice:
+            return "splice";
+        case copy_buffered:
+            return "buffered";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * Prints bytes copied and bytes/sec for every copy method that was used.
+ * 
+ * Parameters:
+ *   out (FILE*): Stream the counters are printed to.
+ */
+void print_copy_stats(FILE *out)
+{
+    for (int i = 0; i < copy_methods; i++)
+    {
+        const CopyCounter *counter = &copy_counters[i];
+        if (counter->calls == 0)
+        {
+            continue;
+        }
+        double seconds = counter->nanosec / 1e9;
+        fprintf(out, "COPY PATH : %-16s %llu bytes in %lu call(s), %.0f bytes/sec\n", copy_method_name(i),
+               counter->bytes, counter->calls, seconds > 0 ? counter->bytes / seconds : 0.0);
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef MP3_COPY_H
+#define MP3_COPY_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "types.h"
+
+// Length passed to copy everything up to the end of the source file
+#define COPY_ALL ((size_t)-1)
+
+/**
+ * Enum to represent the method used to move bytes between two files.
+ * They are tried in this order and the first one supported by the files is used.
+ */
+typedef enum
+{
+    copy_range,       // copy_file_range(), done inside the kernel (may share extents)
+    copy_sendfile,    // sendfile(), kernel side copy through the page cache
+    copy_splice,      // splice(), moves pages through a pipe without seeking (streams only)
+    copy_buffered,    // pread()/pwrite() (read()/write() for streams) with a large aligned user space buffer
+    copy_methods      // Number of copy methods
+} CopyMethod;
+
+// Structure to store the counters of one copy method
+typedef struct CopyCounter
+{
+    unsigned long long bytes;       // Total bytes copied with this method
+    unsigned long long nanosec;     // Total time spent copying with this method
+    unsigned long calls;            // Number of copy requests served by this method
+} CopyCounter;
+
+// Function Prototypes
+
+/**
+ * Copies everything from the current position of the source file to the current
+ * position of the destination file, using the fastest method the files support.
+ * Both FILE positions are moved past the copied data afterwards.
+ * 
+ * @param fptr_dest (FILE*): File pointer to the destination file.
+ * @param fptr_src (FILE*): File pointer to the source file.
+ * @param method (CopyMethod*): Set to the method that copied the data (may be NULL).
+ * 
+ * @returns Status: e_success if the copy is successful, e_failure if an error occurs.
+ */
+Status copy_file_data(FILE *fptr_dest, FILE *fptr_src, CopyMethod *method);
+
+
+/**
+ * Copies length bytes starting at an offset of the source file to the current offset of the
+ * destination file, trying copy_file_range(), sendfile() and a buffered copy in that order.
+ * 
+ * @param fd_dest (int): Destination file descriptor.
+ * @param fd_src (int): Source file descriptor.
+ * @param offset (off_t): Offset of the first byte in the source file.
+ * @param length (size_t): Number of bytes to copy.
+ * @param method (CopyMethod*): Set to the method that copied the data (may be NULL).
+ * 
+ * @returns Status: e_success if all bytes were copied, e_failure if an error occurs or the source is too short.
+ */
+Status copy_file_part(int fd_dest, int fd_src, off_t offset, size_t length, CopyMethod *method);
+
+
+/**
+ * Copies everything left in the source descriptor to the destination descriptor without
+ * seeking either of them, so pipes and sockets are supported. splice() is used when one
+ * side is a pipe, read()/write() with a fixed size buffer otherwise.
+ * 
+ * @param fd_dest (int): Destination file descriptor.
+ * @param fd_src (int): Source file descriptor, read until end of file.
+ * @param method (CopyMethod*): Set to the method that copied the data (may be NULL).
+ * 
+ * @returns Status: e_success if the copy is successful, e_failure if an error occurs.
+ */
+Status copy_stream_data(int fd_dest, int fd_src, CopyMethod *method);
+
+
+/**
+ * Returns the counters collected for a copy method since the program started.
+ * 
+ * @param method (CopyMethod): The copy method.
+ * 
+ * @returns const CopyCounter*: Pointer to the counters of that method.
+ */
+const CopyCounter *get_copy_counter(CopyMethod method);
+
+
+/**
+ * Returns a printable name of a copy method (e.g., "copy_file_range").
+ * 
+ * @param method (CopyMethod): The copy method.
+ * 
+ * @returns const char*: Name of the method.
+ */
+const char *copy_method_name(CopyMethod method);
+
+
+/**
+ * Prints bytes copied and bytes/sec for every copy method that was used.
+ * 
+ * @param out (FILE*): Stream the counters are printed to.
+ */
+void print_copy_stats(FILE *out);
+
+#endif
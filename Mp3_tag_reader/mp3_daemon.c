@@ -0,0 +1,862 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "types.h"
+#include "mp3_daemon.h"
+#include "mp3_view.h"
+#include "mp3_batch.h"
+#include "mp3_stats.h"
+
+// Name of each request type, used in the latency report
+static const char *request_names[request_types] = { "view", "edit", "stats", "other" };
+
+// Set by SIGINT and SIGTERM, the event loop stops once it sees it
+static volatile sig_atomic_t daemon_stop;
+
+/**
+ * Returns the current monotonic time in nanoseconds.
+ */
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Signal handler of SIGINT and SIGTERM.
+ */
+static void request_stop(int signum)
+{
+    (void)signum;
+    daemon_stop = 1;
+}
+
+/**
+ * Validates the arguments of the daemon.
+ * 
+ * Parameters:
+ *   argc (int): Number of command-line arguments.
+ *   argv (char*[]): Command-line arguments, the socket path at index 2 and the optional LRU size at index 3.
+ *   server (DaemonInfo*): A pointer to the structure where the daemon information will be stored.
+ * 
+ * Returns:
+ *   Status: e_success if validation passes, e_failure if there's an error.
+ */
+Status read_and_validation_daemon(int argc, char *argv[], DaemonInfo *server)
+{
+    // The path has to fit in the socket address
+    if (strlen(argv[2]) >= sizeof(((struct sockaddr_un *)0)->sun_path))
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : SOCKET PATH %s IS TOO LONG\n", argv[2]);
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+    memset(server, 0, sizeof(*server));
+    server->socket_path = argv[2];
+    server->listen_fd = -1;
+
+    // Keep DAEMON_LRU_DEFAULT parsed files unless a count is passed, 0 keeps none
+    int limit = DAEMON_LRU_DEFAULT;
+    if (argc > 3)
+    {
+        char *end;
+        limit = strtol(argv[3], &end, 10);
+        limit = *end == '\0' ? limit : -1;
+    }
+    if (limit < 0)
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : INVALID LRU SIZE\n");
+        printf("USAGE :\nTo serve requests please pass like: ./a.out -D socket_path [lru_entries]\n");
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+    server->lru.limit = limit;
+
+    return e_success;
+}
+
+/**
+ * Hashes a path (FNV-1a).
+ */
+static uint hash_path(const char *path)
+{
+    uint hash = 2166136261u;
+    for (; *path != '\0'; path++)
+    {
+        hash = (hash ^ (unsigned char)*path) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Finds the entry of a path.
+ * 
+ * Parameters:
+ *   lru (FrameLru*): The LRU.
+ *   path (const char*): The path.
+ * 
+ * Returns:
+ *   LruEntry*: The entry, or NULL if the path has none.
+ */
+static LruEntry *lru_find(FrameLru *lru, const char *path)
+{
+    if (lru->bucket_count == 0)
+    {
+        return NULL;
+    }
+    LruEntry *entry = lru->buckets[hash_path(path) & (lru->bucket_count - 1)];
+    while (entry != NULL && strcmp(entry->path, path) != 0)
+    {
+        entry = entry->chain;
+    }
+    return entry;
+}
+
+/**
+ * Takes an entry out of the recency list.
+ */
+static void lru_unlink(FrameLru *lru, LruEntry *entry)
+{
+    if (entry->newer != NULL)
+    {
+        entry->newer->older = entry->older;
+    }
+    else
+    {
+        lru->newest = entry->older;
+    }
+    if (entry->older != NULL)
+    {
+        entry->older->newer = entry->newer;
+    }
+    else
+    {
+        lru->oldest = entry->newer;
+    }
+    entry->newer = entry->older = NULL;
+}
+
+/**
+ * Puts an entry at the most recently used end of the recency list.
+ */
+static void lru_push(FrameLru *lru, LruEntry *entry)
+{
+    entry->older = lru->newest;
+    entry->newer = NULL;
+    if (lru->newest != NULL)
+    {
+        lru->newest->newer = entry;
+    }
+    lru->newest = entry;
+    if (lru->oldest == NULL)
+    {
+        lru->oldest = entry;
+    }
+}
+
+/**
+ * Removes an entry from the hash table and the recency list and releases it.
+ * 
+ * Parameters:
+ *   lru (FrameLru*): The LRU.
+ *   entry (LruEntry*): The entry.
+ */
+static void lru_remove(FrameLru *lru, LruEntry *entry)
+{
+    LruEntry **link = &lru->buckets[hash_path(entry->path) & (lru->bucket_count - 1)];
+    while (*link != entry)
+    {
+        link = &(*link)->chain;
+    }
+    *link = entry->chain;
+    lru_unlink(lru, entry);
+    lru->count--;
+
+    free(entry->path);
+    free(entry->tag);
+    free_frame_index(&entry->index);
+    free(entry->tail_text);
+    free(entry);
+}
+
+/**
+ * Keeps the parsed file of a view in the LRU, dropping the least recently used file when it
+ * is full. The frame table is taken over from the view, the tag and the tail texts are copied.
+ * 
+ * Parameters:
+ *   lru (FrameLru*): The LRU.
+ *   mp3View (Mp3ViewInfo*): The view, loaded by view_load(); its frame table is emptied.
+ *   st (const struct stat*): The file status taken before the file was loaded.
+ */
+static void lru_store(FrameLru *lru, Mp3ViewInfo *mp3View, const struct stat *st)
+{
+    if (lru->limit == 0 || mp3View->tag_size > DAEMON_ENTRY_MAX)
+    {
+        return;
+    }
+    if (lru->bucket_count == 0)
+    {
+        // Twice as many buckets as entries, rounded up to a power of 2
+        uint count = 16;
+        while (count < 2 * lru->limit && count < (1u << 30))
+        {
+            count *= 2;
+        }
+        lru->buckets = calloc(count, sizeof(LruEntry *));
+        if (lru->buckets == NULL)
+        {
+            return;
+        }
+        lru->bucket_count = count;
+    }
+    if (lru->count == lru->limit)
+    {
+        lru_remove(lru, lru->oldest);
+    }
+
+    // The tail texts go into one allocation
+    size_t text_len = 0;
+    for (int i = 0; i < tail_fields; i++)
+    {
+        text_len += mp3View->tail_tags.fields[i] != NULL ? strlen(mp3View->tail_tags.fields[i]) + 1 : 0;
+    }
+
+    LruEntry *entry = calloc(1, sizeof(LruEntry));
+    if (entry == NULL)
+    {
+        return;
+    }
+    entry->path = strdup(mp3View->file_name);
+    entry->tag = mp3View->tag != NULL ? malloc(mp3View->tag_size + 1) : NULL;
+    entry->tail_text = text_len > 0 ? malloc(text_len) : NULL;
+    if (entry->path == NULL || (mp3View->tag != NULL && entry->tag == NULL) || (text_len > 0 && entry->tail_text == NULL))
+    {
+        free(entry->path);
+        free(entry->tag);
+        free(entry->tail_text);
+        free(entry);
+        return;
+    }
+
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime_ns = (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+    memcpy(entry->header, mp3View->header, sizeof(entry->header));
+    if (entry->tag != NULL)
+    {
+        memcpy(entry->tag, mp3View->tag, mp3View->tag_size);
+    }
+    entry->tag_size = mp3View->tag_size;
+    entry->index = mp3View->index;
+    memset(&mp3View->index, 0, sizeof(mp3View->index));
+
+    entry->tail_tags = mp3View->tail_tags;
+    char *text = entry->tail_text;
+    for (int i = 0; i < tail_fields; i++)
+    {
+        if (mp3View->tail_tags.fields[i] != NULL)
+        {
+            strcpy(text, mp3View->tail_tags.fields[i]);
+            entry->tail_tags.fields[i] = text;
+            text += strlen(text) + 1;
+        }
+    }
+
+    uint bucket = hash_path(entry->path) & (lru->bucket_count - 1);
+    entry->chain = lru->buckets[bucket];
+    lru->buckets[bucket] = entry;
+    lru_push(lru, entry);
+    lru->count++;
+}
+
+/**
+ * Releases every entry of the LRU.
+ */
+static void lru_free(FrameLru *lru)
+{
+    while (lru->oldest != NULL)
+    {
+        lru_remove(lru, lru->oldest);
+    }
+    free(lru->buckets);
+    lru->buckets = NULL;
+    lru->bucket_count = 0;
+}
+
+/**
+ * Serves a VIEW request: the record of the file, as printed by --format=ndjson. A file whose
+ * entry has the same device, inode, size and modification time is answered from the LRU
+ * without being opened; a changed file is parsed again.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ *   path (char*): The MP3 file.
+ */
+static void serve_view(DaemonInfo *server, char *path)
+{
+    Mp3ViewInfo mp3View;
+    memset(&mp3View, 0, sizeof(mp3View));
+    mp3View.file_name = path;
+    mp3View.out = NULL;
+    mp3View.cache = server->cache;
+    mp3View.arena = &server->arena;
+    mp3View.format = format_ndjson;
+    mp3View.record = &server->record;
+
+    struct stat st;
+    int have_stat = stat(path, &st) == 0;
+    LruEntry *entry = lru_find(&server->lru, path);
+    if (entry != NULL && (!have_stat || entry->dev != (unsigned long long)st.st_dev || entry->ino != (unsigned long long)st.st_ino ||
+                          entry->size != (unsigned long long)st.st_size ||
+                          entry->mtime_ns != (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec))
+    {
+        lru_remove(&server->lru, entry);
+        server->lru.stale++;
+        entry = NULL;
+    }
+
+    if (entry != NULL)
+    {
+        // The texts are decoded from the kept tag into the arena of the request
+        server->lru.hits++;
+        lru_unlink(&server->lru, entry);
+        lru_push(&server->lru, entry);
+        memcpy(mp3View.header, entry->header, sizeof(mp3View.header));
+        mp3View.tag = entry->tag;
+        mp3View.tag_size = entry->tag_size;
+        mp3View.index = entry->index;
+        mp3View.tail_tags = entry->tail_tags;
+        unsigned long long start = stats_start();
+        format_record(&mp3View, NULL);
+        stats_stop(phase_output, start);
+        return;
+    }
+
+    server->lru.misses++;
+    Mp3Error error = view_load(&mp3View);
+    unsigned long long start = stats_start();
+    Status status = format_record(&mp3View, error == mp3_ok ? NULL : view_message(error));
+    stats_stop(phase_output, start);
+    if (status == e_success && have_stat)
+    {
+        lru_store(&server->lru, &mp3View, &st);
+    }
+    view_release(&mp3View);
+}
+
+/**
+ * Serves an EDIT request: a manifest line (tab separated or JSON) applied with the edit core.
+ * The entry of the file is dropped, so the next view parses the new tag.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ *   line (char*): The manifest line.
+ */
+static void serve_edit(DaemonInfo *server, char *line)
+{
+    BatchJob job;
+    parse_job(&job, line);
+    const char *error = job.error;
+    Mp3EditInfo *mp3Edit = &server->edit;
+
+    mp3Edit->src_fname = job.path;
+    if (error == NULL)
+    {
+        memcpy(mp3Edit->edits, job.edits, sizeof(job.edits));
+        mp3Edit->edit_count = job.edit_count;
+        if (edit_info(mp3Edit) == e_failure)
+        {
+            error = mp3_strerror(mp3Edit->error);
+        }
+
+        LruEntry *entry = lru_find(&server->lru, job.path);
+        if (entry != NULL)
+        {
+            lru_remove(&server->lru, entry);
+        }
+    }
+
+    RecordBuffer *record = &server->record;
+    record_field(record, format_ndjson, "path", job.path, 1);
+    record_field(record, format_ndjson, "status", error == NULL ? "ok" : "error", 0);
+    record_field(record, format_ndjson, "edit", error != NULL ? NULL : mp3Edit->in_place ? "in_place" : "rewrite", 0);
+    char consumed[16], reserved[16];
+    snprintf(consumed, sizeof(consumed), "%u", mp3Edit->padding_consumed);
+    snprintf(reserved, sizeof(reserved), "%u", mp3Edit->padding_reserved);
+    record_field(record, format_ndjson, "padding_consumed", error != NULL ? NULL : consumed, 0);
+    record_field(record, format_ndjson, "padding_reserved", error != NULL ? NULL : reserved, 0);
+    record_field(record, format_ndjson, "error", error, 0);
+    record_end(record, format_ndjson);
+}
+
+/**
+ * Compares two latencies for qsort().
+ */
+static int compare_latency(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Computes the median and 99th percentile of the latest latencies of a request type.
+ * 
+ * Parameters:
+ *   latency (const LatencyStats*): The latencies.
+ *   p50 (unsigned long long*): Set to the median in nanoseconds.
+ *   p99 (unsigned long long*): Set to the 99th percentile in nanoseconds.
+ */
+static void latency_percentiles(const LatencyStats *latency, unsigned long long *p50, unsigned long long *p99)
+{
+    static unsigned long long sorted[DAEMON_SAMPLES];
+    uint count = latency->count < DAEMON_SAMPLES ? latency->count : DAEMON_SAMPLES;
+    *p50 = *p99 = 0;
+    if (count == 0)
+    {
+        return;
+    }
+    memcpy(sorted, latency->samples, count * sizeof(sorted[0]));
+    qsort(sorted, count, sizeof(sorted[0]), compare_latency);
+    *p50 = sorted[(count - 1) / 2];
+    *p99 = sorted[(count - 1) * 99 / 100];
+}
+
+/**
+ * Serves a STATS request: one JSON object with the count, mean, median, 99th percentile and
+ * largest latency of each request type in microseconds, the LRU counters and the number of clients.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ */
+static void serve_stats(DaemonInfo *server)
+{
+    char text[256];
+    record_append(&server->record, "{", 1);
+    for (int i = 0; i < request_types; i++)
+    {
+        const LatencyStats *latency = &server->latency[i];
+        unsigned long long p50, p99;
+        latency_percentiles(latency, &p50, &p99);
+        int len = snprintf(text, sizeof(text), "\"%s\":{\"count\":%llu,\"mean_us\":%llu,\"p50_us\":%llu,\"p99_us\":%llu,\"max_us\":%llu},",
+                           request_names[i], latency->count, latency->count > 0 ? latency->total / latency->count / 1000 : 0,
+                           p50 / 1000, p99 / 1000, latency->max / 1000);
+        record_append(&server->record, text, len);
+    }
+    int len = snprintf(text, sizeof(text), "\"lru\":{\"entries\":%u,\"hits\":%u,\"misses\":%u,\"stale\":%u},\"clients\":%u}\n",
+                       server->lru.count, server->lru.hits, server->lru.misses, server->lru.stale, server->client_count);
+    record_append(&server->record, text, len);
+}
+
+/**
+ * Serves one request line and appends its response line to server->record. Requests are
+ * "VIEW<TAB>path", "EDIT<TAB>manifest line" and "STATS".
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ *   line (char*): The request without its line break, split in place.
+ * 
+ * Returns:
+ *   RequestType: The type of the request.
+ */
+RequestType serve_request(DaemonInfo *server, char *line)
+{
+    char *command = strsep(&line, "\t");
+    FileStats stats;
+
+    if (strcmp(command, "VIEW") == 0 && line != NULL && *line != '\0')
+    {
+        stats_begin(&stats);
+        serve_view(server, line);
+        stats_end(&stats, stderr, line);
+        return request_view;
+    }
+    if (strcmp(command, "EDIT") == 0 && line != NULL)
+    {
+        stats_begin(&stats);
+        serve_edit(server, line);
+        stats_end(&stats, stderr, server->edit.src_fname);
+        return request_edit;
+    }
+    if (strcmp(command, "STATS") == 0)
+    {
+        serve_stats(server);
+        return request_stats;
+    }
+
+    record_field(&server->record, format_ndjson, "status", "error", 1);
+    record_field(&server->record, format_ndjson, "error", "unknown request (VIEW, EDIT or STATS)", 0);
+    record_end(&server->record, format_ndjson);
+    return request_other;
+}
+
+/**
+ * Adds the latency of one request to the statistics of its type.
+ */
+static void count_latency(LatencyStats *latency, unsigned long long nanosec)
+{
+    latency->samples[latency->count % DAEMON_SAMPLES] = nanosec;
+    latency->count++;
+    latency->total += nanosec;
+    if (nanosec > latency->max)
+    {
+        latency->max = nanosec;
+    }
+}
+
+/**
+ * Serves the complete request lines a client has sent, as long as its pending output stays
+ * under DAEMON_OUTPUT_MAX. The latency of each request counts from the read that brought it in.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ *   client (DaemonClient*): The client.
+ * 
+ * Returns:
+ *   Status: e_success, or e_failure if the client has to be dropped.
+ */
+static Status serve_client(DaemonInfo *server, DaemonClient *client)
+{
+    size_t done = 0;
+    while (done < client->input.len && client->output.len - client->written < DAEMON_OUTPUT_MAX)
+    {
+        char *line = client->input.data + done;
+        char *end = memchr(line, '\n', client->input.len - done);
+        if (end == NULL)
+        {
+            break;
+        }
+        *end = '\0';
+        done = end + 1 - client->input.data;
+        if (end > line && end[-1] == '\r')
+        {
+            end[-1] = '\0';
+        }
+
+        server->record.len = 0;
+        RequestType type = serve_request(server, line);
+        arena_reset(&server->arena);
+        if (record_append(&client->output, server->record.data, server->record.len) == e_failure)
+        {
+            return e_failure;
+        }
+        count_latency(&server->latency[type], now_ns() - client->received);
+    }
+
+    // Keep the start of the next request
+    if (done == 0)
+    {
+        return client->input.len > DAEMON_LINE_MAX ? e_failure : e_success;
+    }
+    memmove(client->input.data, client->input.data + done, client->input.len - done);
+    client->input.len -= done;
+    return client->input.len > DAEMON_LINE_MAX ? e_failure : e_success;
+}
+
+/**
+ * Writes as much pending output to a client as the socket takes.
+ * 
+ * Parameters:
+ *   client (DaemonClient*): The client.
+ * 
+ * Returns:
+ *   Status: e_success, or e_failure if the client has to be dropped.
+ */
+static Status flush_client(DaemonClient *client)
+{
+    while (client->written < client->output.len)
+    {
+        ssize_t count = send(client->fd, client->output.data + client->written, client->output.len - client->written, MSG_NOSIGNAL);
+        if (count < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? e_success : e_failure;
+        }
+        client->written += count;
+    }
+    client->output.len = client->written = 0;
+    return e_success;
+}
+
+/**
+ * Reads what a client has sent, serves its complete requests and writes the responses.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ *   client (DaemonClient*): The client.
+ *   events (short): The poll events of its socket.
+ * 
+ * Returns:
+ *   Status: e_success, or e_failure if the client is done or has to be dropped.
+ */
+static Status handle_client(DaemonInfo *server, DaemonClient *client, short events)
+{
+    if ((events & POLLIN) && !client->closing)
+    {
+        char buffer[16 * 1024];
+        ssize_t count = read(client->fd, buffer, sizeof(buffer));
+        if (count == 0)
+        {
+            client->closing = 1;
+        }
+        else if (count < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            return e_failure;
+        }
+        else if (count > 0)
+        {
+            client->received = now_ns();
+            if (record_append(&client->input, buffer, count) == e_failure)
+            {
+                return e_failure;
+            }
+        }
+    }
+    else if (events & (POLLERR | POLLHUP))
+    {
+        if (!(events & POLLOUT))
+        {
+            return e_failure;
+        }
+    }
+
+    // Output drained by the last write lets held back requests be served
+    if (serve_client(server, client) == e_failure || flush_client(client) == e_failure ||
+        serve_client(server, client) == e_failure || flush_client(client) == e_failure)
+    {
+        return e_failure;
+    }
+    return client->closing && client->output.len == 0 ? e_failure : e_success;
+}
+
+/**
+ * Accepts every pending connection.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ */
+static void accept_clients(DaemonInfo *server)
+{
+    while (1)
+    {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        if (server->client_count == server->client_capacity)
+        {
+            uint capacity = server->client_capacity ? server->client_capacity * 2 : 16;
+            DaemonClient *clients = realloc(server->clients, capacity * sizeof(DaemonClient));
+            if (clients == NULL)
+            {
+                close(fd);
+                return;
+            }
+            server->clients = clients;
+            server->client_capacity = capacity;
+        }
+        DaemonClient *client = &server->clients[server->client_count++];
+        memset(client, 0, sizeof(*client));
+        client->fd = fd;
+    }
+}
+
+/**
+ * Closes a client and releases its buffers.
+ */
+static void drop_client(DaemonClient *client)
+{
+    close(client->fd);
+    record_free(&client->input);
+    record_free(&client->output);
+    client->fd = -1;
+}
+
+/**
+ * Creates the listening socket. A socket file left by a daemon that didn't stop cleanly is replaced.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ * 
+ * Returns:
+ *   Status: e_success if the daemon listens, e_failure if an error occurs.
+ */
+static Status open_socket(DaemonInfo *server)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, server->socket_path);
+
+    struct stat st;
+    if (lstat(server->socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        unlink(server->socket_path);
+    }
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0)
+    {
+        return e_failure;
+    }
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server->listen_fd, 128) != 0)
+    {
+        close(server->listen_fd);
+        server->listen_fd = -1;
+        return e_failure;
+    }
+    return e_success;
+}
+
+/**
+ * Prints the latency of each request type served and the LRU counters.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ *   out (FILE*): Stream the report is printed to.
+ */
+static void print_latency(DaemonInfo *server, FILE *out)
+{
+    for (int i = 0; i < request_types; i++)
+    {
+        const LatencyStats *latency = &server->latency[i];
+        if (latency->count == 0)
+        {
+            continue;
+        }
+        unsigned long long p50, p99;
+        latency_percentiles(latency, &p50, &p99);
+        fprintf(out, "LATENCY  :   %-5s %llu requests, mean %lluus, p50 %lluus, p99 %lluus, max %lluus\n",
+                request_names[i], latency->count, latency->total / latency->count / 1000, p50 / 1000, p99 / 1000, latency->max / 1000);
+    }
+    fprintf(out, "LRU      :   %u entries, %u hits, %u misses, %u stale\n",
+            server->lru.count, server->lru.hits, server->lru.misses, server->lru.stale);
+}
+
+/**
+ * Listens on the socket and serves every client from one poll() loop until SIGINT or SIGTERM.
+ * Requests are served one at a time in the order they are read, so the LRU, the arena and
+ * the edit state need no locking. Clients are read from and written to without blocking; a
+ * client that doesn't read its responses is not read from until they are written.
+ * 
+ * Parameters:
+ *   server (DaemonInfo*): A pointer to the structure containing the daemon information.
+ * 
+ * Returns:
+ *   Status: e_success if the daemon stopped on a signal, e_failure if the socket can't be used.
+ */
+Status daemon_info(DaemonInfo *server)
+{
+    if (open_socket(server) == e_failure)
+    {
+        fprintf(stderr, "ERROR: ./a.out : CAN'T LISTEN ON %s\n", server->socket_path);
+        return e_failure;
+    }
+
+    // Stop on SIGINT and SIGTERM; poll() is interrupted, not restarted
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    arena_init(&server->arena, arena_limit());
+    init_edit(&server->edit);
+    server->edit.out = NULL;
+    server->edit.src_fname = NULL;
+
+    struct pollfd *fds = NULL;
+    uint fds_capacity = 0;
+    Status status = e_success;
+    fprintf(stderr, "LISTENING:   %s\n", server->socket_path);
+
+    while (!daemon_stop)
+    {
+        // The listening socket first, then every client
+        uint count = server->client_count;
+        if (count + 1 > fds_capacity)
+        {
+            struct pollfd *grown = realloc(fds, (count + 1) * 2 * sizeof(struct pollfd));
+            if (grown == NULL)
+            {
+                status = e_failure;
+                break;
+            }
+            fds = grown;
+            fds_capacity = (count + 1) * 2;
+        }
+        fds[0].fd = server->listen_fd;
+        fds[0].events = POLLIN;
+        for (uint i = 0; i < count; i++)
+        {
+            DaemonClient *client = &server->clients[i];
+            fds[i + 1].fd = client->fd;
+            fds[i + 1].events = (client->output.len - client->written < DAEMON_OUTPUT_MAX && !client->closing ? POLLIN : 0) |
+                                (client->written < client->output.len ? POLLOUT : 0);
+        }
+
+        if (poll(fds, count + 1, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            status = e_failure;
+            break;
+        }
+
+        for (uint i = 0; i < count; i++)
+        {
+            if (fds[i + 1].revents != 0 && handle_client(server, &server->clients[i], fds[i + 1].revents) == e_failure)
+            {
+                drop_client(&server->clients[i]);
+            }
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            accept_clients(server);
+        }
+
+        // Close the gaps left by dropped clients
+        uint kept = 0;
+        for (uint i = 0; i < server->client_count; i++)
+        {
+            if (server->clients[i].fd >= 0)
+            {
+                server->clients[kept++] = server->clients[i];
+            }
+        }
+        server->client_count = kept;
+    }
+
+    // Stop listening, then report
+    close(server->listen_fd);
+    unlink(server->socket_path);
+    for (uint i = 0; i < server->client_count; i++)
+    {
+        drop_client(&server->clients[i]);
+    }
+    free(server->clients);
+    free(fds);
+    print_latency(server, stderr);
+
+    lru_free(&server->lru);
+    record_free(&server->record);
+    arena_free(&server->arena);
+    free_edit(&server->edit);
+    return status;
+}
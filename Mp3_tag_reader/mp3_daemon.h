@@ -0,0 +1,149 @@
+#ifndef MP3_DAEMON_H
+#define MP3_DAEMON_H
+
+#include <sys/stat.h>
+#include "types.h"
+#include "mp3_frame.h"
+#include "mp3_tail.h"
+#include "mp3_cache.h"
+#include "mp3_arena.h"
+#include "mp3_format.h"
+#include "mp3_edit.h"
+
+// Parsed files kept in memory unless a count is passed
+#define DAEMON_LRU_DEFAULT 4096
+
+// Tags larger than this are parsed again on every request instead of being kept
+#define DAEMON_ENTRY_MAX (1024 * 1024)
+
+// Longest request line, a client sending a longer one is disconnected
+#define DAEMON_LINE_MAX (64 * 1024)
+
+// A client is not read from while this many response bytes wait to be written to it
+#define DAEMON_OUTPUT_MAX (1024 * 1024)
+
+// Latencies kept per request type for the percentiles, the oldest are replaced
+#define DAEMON_SAMPLES 4096
+
+/**
+ * Enum to represent the requests served by the daemon.
+ */
+typedef enum
+{
+    request_view,     // VIEW<TAB>path: the record of a file
+    request_edit,     // EDIT<TAB>manifest line: changes applied to a file
+    request_stats,    // STATS: request latencies and cache counters
+    request_other,    // Unknown or malformed request
+    request_types     // Number of request types
+} RequestType;
+
+// Structure to store one parsed file of the LRU, valid while the file has the same key
+typedef struct LruEntry
+{
+    char *path;                // Path the file was requested by
+    unsigned long long dev;    // Device of the file
+    unsigned long long ino;    // Inode of the file
+    unsigned long long size;   // Size of the file in bytes
+    long long mtime_ns;        // Modification time in nanoseconds
+
+    unsigned char header[10];  // ID3 tag header (zeros for a file with only tail tags)
+    unsigned char *tag;        // Frame region of the tag, NULL without an ID3v2 tag
+    uint tag_size;             // Size of the frame region
+    FrameIndex index;          // Table of all frames of the tag
+    TailTags tail_tags;        // Fields of the tail tags, the texts point into tail_text
+    char *tail_text;           // All tail tag texts, one allocation
+
+    struct LruEntry *newer;    // Next entry towards the most recently used
+    struct LruEntry *older;    // Next entry towards the least recently used
+    struct LruEntry *chain;    // Next entry of the same hash bucket
+} LruEntry;
+
+// Structure to store the parsed files by path, the least recently used is dropped first
+typedef struct FrameLru
+{
+    LruEntry **buckets;        // Hash table of entries by path
+    uint bucket_count;         // Size of the hash table (a power of 2)
+    LruEntry *newest;          // Most recently used entry
+    LruEntry *oldest;          // Least recently used entry
+    uint count;                // Number of entries
+    uint limit;                // Most entries kept
+
+    uint hits;                 // Requests answered from an entry
+    uint misses;               // Requests that had to parse the file
+    uint stale;                // Entries dropped because their file changed
+} FrameLru;
+
+// Structure to store the latencies of one request type
+typedef struct LatencyStats
+{
+    unsigned long long count;  // Requests served
+    unsigned long long total;  // Sum of their latencies in nanoseconds
+    unsigned long long max;    // Largest latency in nanoseconds
+    unsigned long long samples[DAEMON_SAMPLES];  // Latest latencies, used in turn
+} LatencyStats;
+
+// Structure to store one connected client
+typedef struct DaemonClient
+{
+    int fd;                    // Connected socket
+    RecordBuffer input;        // Bytes received that don't end a line yet
+    RecordBuffer output;       // Responses not written yet
+    size_t written;            // Bytes of output already written
+    unsigned long long received;  // Time of the last read, the latency of its requests counts from it
+    int closing;               // 1 once the client hung up, it is dropped when its output is written
+} DaemonClient;
+
+// Structure to store the state of the daemon
+typedef struct DaemonInfo
+{
+    char *socket_path;         // Path of the Unix domain socket
+    int listen_fd;             // Listening socket
+    TagCache *cache;           // On-disk cache of parsed tags consulted on a miss, NULL if not used
+
+    DaemonClient *clients;     // Connected clients
+    uint client_count;         // Number of connected clients
+    uint client_capacity;      // Allocated entries in clients
+
+    FrameLru lru;              // Parsed files
+    Arena arena;               // Texts of the request being served, reset after each request
+    RecordBuffer record;       // Response being built
+    Mp3EditInfo edit;          // Edit state, its arena is reused for every edit
+    LatencyStats latency[request_types];  // Latencies by request type
+} DaemonInfo;
+
+// Function Prototypes
+
+/**
+ * Validates the arguments of the daemon.
+ * 
+ * @param argc (int): Number of command-line arguments.
+ * @param argv (char*[]): Command-line arguments, the socket path at index 2 and the optional LRU size at index 3.
+ * @param server (DaemonInfo*): Structure to store the daemon information.
+ * 
+ * @returns Status: e_success if validation is successful, e_failure if there's an error.
+ */
+Status read_and_validation_daemon(int argc, char *argv[], DaemonInfo *server);
+
+
+/**
+ * Listens on the socket and serves the requests of every client until SIGINT or SIGTERM.
+ * The latencies are printed to stderr when it stops.
+ * 
+ * @param server (DaemonInfo*): Structure containing the daemon information.
+ * 
+ * @returns Status: e_success if the daemon stopped on a signal, e_failure if the socket can't be used.
+ */
+Status daemon_info(DaemonInfo *server);
+
+
+/**
+ * Serves one request line and appends its response line to server->record.
+ * 
+ * @param server (DaemonInfo*): Structure containing the daemon information.
+ * @param line (char*): The request without its line break, split in place.
+ * 
+ * @returns RequestType: The type of the request, its latency is counted under it.
+ */
+RequestType serve_request(DaemonInfo *server, char *line);
+
+#endif
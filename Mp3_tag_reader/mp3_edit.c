@@ -1,26 +1,57 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "mp3_edit.h"
+#include "mp3_copy.h"
+#include "mp3_frame.h"
+#include "mp3_text.h"
+#include "mp3_stats.h"
 #include "types.h"
 
+// Padding policy of every edit, set by parse_padding_option() before the edits start
+static PaddingPolicy edit_padding = { PADDING_DEFAULT, 0, 0 };
+
+// Table mapping each edit option to its ID3 frame and display label
+static const struct
+{
+    const char *option;    // Command-line option (e.g., "-t")
+    const char *frame_id;  // ID3 frame identifier (e.g., "TIT2")
+    const char *label;     // Label used when reporting the change
+} edit_frames[] =
+{
+    { "-t", "TIT2", "TITLE" },
+    { "-a", "TPE1", "ARTIST" },
+    { "-A", "TALB", "ALBUM" },
+    { "-y", "TYER", "YEAR" },
+    { "-m", "TCON", "CONTENT" },
+    { "-c", "COMM", "COMMENT" },
+};
+
 /**
  * Validates and reads the MP3 file for editing.
  * This function checks if the file has a valid extension (.mp3), verifies the command-line arguments,
- * and stores relevant information into the `mp3Edit` structure.
+ * and stores relevant information into the `mp3Edit` structure. Any number of option and text
+ * pairs may come before the file name; each frame may only be edited once.
  * 
  * Parameters:
- *   argv (char*[]): The command-line arguments, with the fourth argument being the MP3 file name.
+ *   argc (int): The number of command-line arguments.
+ *   argv (char*[]): The command-line arguments, with the last argument being the MP3 file name.
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure where MP3 file information will be stored.
  * 
  * Returns:
  *   Status: e_success if validation passes, e_failure if there's an error.
  */
-Status read_and_validation_edit(char *argv[], Mp3EditInfo *mp3Edit)
+Status read_and_validation_edit(int argc, char *argv[], Mp3EditInfo *mp3Edit)
 {
     char extn[10];
+    char *file_name = argv[argc - 1];
 
     // Check if the file has an extension
-    if (strchr(argv[4], '.') == NULL)
+    if (strchr(file_name, '.') == NULL)
     {
         printf("-------------------------------------------------------------------------------\n\n");
         printf("ERROR: ./a.out : INVALID EXTENSION\n");
@@ -29,7 +60,7 @@ Status read_and_validation_edit(char *argv[], Mp3EditInfo *mp3Edit)
     }
 
     // Extract the file extension
-    strcpy(extn, strchr(argv[4], '.'));
+    strcpy(extn, strchr(file_name, '.'));
 
     // Check if the file extension is ".mp3"
     if (strcmp(extn, ".mp3") != 0)
@@ -40,28 +71,63 @@ Status read_and_validation_edit(char *argv[], Mp3EditInfo *mp3Edit)
         return e_failure;
     }
 
-    // Store file name and other command-line arguments
-    mp3Edit->src_fname = argv[4];
-    if (strcmp(argv[2], "-t") != 0 && strcmp(argv[2], "-a") != 0 && strcmp(argv[2], "-A") != 0 && strcmp(argv[2], "-m") != 0 && strcmp(argv[2], "-y") != 0 && strcmp(argv[2], "-c") != 0)
+    // Store file name and every option with its text, details are printed to stdout
+    mp3Edit->src_fname = file_name;
+    mp3Edit->out = stdout;
+    init_edit(mp3Edit);
+    mp3Edit->edit_count = 0;
+    for (int i = 2; i < argc - 1; i += 2)
     {
-        printf("-------------------------------------------------------------------------------\n\n");
-        printf("ERROR: ./a.out : INVALID ARGUMENTS\n");
-        printf("USAGE :\nTo edit please pass like: ./a.out -e -t/-a/-A/-m/-y/-c changing_text mp3filename\n");
-        printf("-------------------------------------------------------------------------------\n");
-        return e_failure;
-    }
+        int duplicate = 0;
+        for (int j = 0; j < mp3Edit->edit_count; j++)
+        {
+            duplicate |= strcmp(mp3Edit->edits[j].frame, argv[i]) == 0;
+        }
+        if (i + 1 >= argc - 1 || get_frame_id(argv[i]) == NULL || duplicate || mp3Edit->edit_count == MAX_EDITS)
+        {
+            printf("-------------------------------------------------------------------------------\n\n");
+            printf("ERROR: ./a.out : INVALID ARGUMENTS\n");
+            printf("USAGE :\nTo edit please pass like: ./a.out -e -t/-a/-A/-m/-y/-c changing_text [-t/-a/-A/-m/-y/-c changing_text ...] mp3filename\n");
+            printf("-------------------------------------------------------------------------------\n");
+            return e_failure;
+        }
 
-    // Store the frame type and data to be modified
-    mp3Edit->frame = argv[2];
-    mp3Edit->modify_data = argv[3];
-    mp3Edit->data_length = strlen(mp3Edit->modify_data) + 1;
+        // Store the frame type and data to be modified
+        FrameEdit *edit = &mp3Edit->edits[mp3Edit->edit_count++];
+        edit->frame = argv[i];
+        edit->modify_data = argv[i + 1];
+        edit->data_length = strlen(edit->modify_data) + 1;
+    }
 
     return e_success;
 }
 
 /**
- * Edits the MP3 file information based on the specified frame (e.g., title, artist, album).
- * It validates the MP3 file, opens necessary files, and makes the modifications.
+ * Prints a line of the edit details to out; nothing is printed when out is NULL
+ * (e.g., when the edit is made through the library).
+ * 
+ * Parameters:
+ *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ *   format (const char*): The printf format of the line, followed by its arguments.
+ */
+static void edit_report(Mp3EditInfo *mp3Edit, const char *format, ...)
+{
+    if (mp3Edit->out == NULL)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(mp3Edit->out, format, args);
+    va_end(args);
+}
+
+/**
+ * Edits the MP3 file information based on the specified frames (e.g., title, artist, album).
+ * It validates the MP3 file, indexes all frames of the tag once and builds the new frames
+ * with every change applied in a single pass. The new frames then either patch the tag in
+ * place or the file is rewritten once when they don't fit. The reason of a failure is kept
+ * in mp3Edit->error.
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
@@ -71,204 +137,383 @@ Status read_and_validation_edit(char *argv[], Mp3EditInfo *mp3Edit)
  */
 Status edit_info(Mp3EditInfo *mp3Edit)
 {
-    // Open input and output files
-    if (open_files(mp3Edit) == e_failure)
+    // Everything of the previous file is released at once
+    arena_reset(&mp3Edit->arena);
+    mp3Edit->error = mp3_ok;
+
+    // Open the source file
+    unsigned long long start = stats_start();
+    Status status = open_files(mp3Edit);
+    stats_stop(phase_open, start);
+    if (status == e_failure)
     {
-        printf("Error in opening files\n");
+        mp3Edit->error = mp3_err_open;
+        edit_report(mp3Edit, "Error in opening files\n");
         return e_failure;
     }
 
     // Check if the MP3 file has a valid ID3 tag and version
-    if (check_ID3(mp3Edit) == e_failure)
+    start = stats_start();
+    status = check_ID3(mp3Edit);
+    stats_stop(phase_header, start);
+    if (status == e_failure)
     {
-        printf("Invalid Mp3 ID format\n");
+        mp3Edit->error = mp3_err_no_tag;
+        edit_report(mp3Edit, "Invalid Mp3 ID format\n");
+        fclose(mp3Edit->fptr_src);
         return e_failure;
     }
-    if (check_mp3version(mp3Edit) == e_failure)
+    start = stats_start();
+    status = check_mp3version(mp3Edit);
+    stats_stop(phase_header, start);
+    if (status == e_failure)
     {
-        printf("Invalid ID3 version\n");
+        mp3Edit->error = mp3_err_version;
+        edit_report(mp3Edit, "Invalid ID3 version\n");
+        fclose(mp3Edit->fptr_src);
         return e_failure;
     }
 
-    // Copy header to output file
-    if (copy_header(mp3Edit->fptr_out, mp3Edit->fptr_src) == e_failure)
+    // Read the tag once and index all of its frames
+    start = stats_start();
+    status = load_frames(mp3Edit);
+    stats_stop(phase_parse, start);
+    if (status == e_failure)
     {
-        printf("Error in copying header\n");
+        mp3Edit->error = mp3_err_read;
+        edit_report(mp3Edit, "Error in reading ID3 frames\n");
+        close_edit(mp3Edit);
         return e_failure;
     }
 
-    // Modify various frames based on input arguments
-    int flag = 0;
+    for (int i = 0; i < mp3Edit->edit_count; i++)
+    {
+        const char *label = get_frame_label(mp3Edit->edits[i].frame);
+        edit_report(mp3Edit, "----------[ CHANGE THE %s ]-------------\n\n", label);
+        edit_report(mp3Edit, "%s   : %s\n\n", label, mp3Edit->edits[i].modify_data);
+    }
 
-    // Change Title
-    if (do_change(mp3Edit, "TIT2", "-t", &flag) == e_failure || flag)
+    // Build the new frames with all changes applied
+    start = stats_start();
+    status = build_frames(mp3Edit);
+    stats_stop(phase_parse, start);
+    if (status == e_failure)
     {
-        if (flag)
-        {
-            printf("----------[ CHANGE THE TITLE ]-------------\n\n");
-            printf("TITLE   : %s\n\n", mp3Edit->modify_data);
-            fclose(mp3Edit->fptr_src);
-            fclose(mp3Edit->fptr_out);
-            file_copy(mp3Edit);
-            printf("----------<< TITLE CHANGED SUCCESSFULLY >>----------\n\n");
-            return e_success;
-        }
-        printf("Error\n");
+        mp3Edit->error = mp3_err_build;
+        edit_report(mp3Edit, "Error in building frames\n");
+        close_edit(mp3Edit);
         return e_failure;
     }
 
-    // Change Artist
-    if (do_change(mp3Edit, "TPE1", "-a", &flag) == e_failure || flag)
+    // Try to patch the existing tag in place before falling back to a full rewrite
+    int fits = 0;
+    start = stats_start();
+    status = edit_in_place(mp3Edit, &fits);
+    stats_stop(phase_write, start);
+    if (status == e_failure)
     {
-        if (flag)
-        {
-            printf("----------[ CHANGE THE ARTIST ]-------------\n\n");
-            printf("ARTIST   : %s\n\n", mp3Edit->modify_data);
-            fclose(mp3Edit->fptr_src);
-            fclose(mp3Edit->fptr_out);
-            file_copy(mp3Edit);
-            printf("----------<< ARTIST CHANGED SUCCESSFULLY >>----------\n\n");
-            return e_success;
-        }
-        printf("Error\n");
+        mp3Edit->error = mp3_err_write;
+        edit_report(mp3Edit, "Error in editing tag in place\n");
+        close_edit(mp3Edit);
         return e_failure;
     }
-
-    // Change Album
-    if (do_change(mp3Edit, "TALB", "-A", &flag) == e_failure || flag)
+    mp3Edit->in_place = fits;
+    if (fits)
+    {
+        edit_report(mp3Edit, "EDIT PATH : IN PLACE (%u padding bytes left)\n\n", mp3Edit->padding);
+        close_edit(mp3Edit);
+    }
+    else
     {
-        if (flag)
+        if (mp3Edit->encoded_size > mp3Edit->tag_size)
         {
-            printf("----------[ CHANGE THE ALBUM ]-------------\n\n");
-            printf("ALBUM   : %s\n\n", mp3Edit->modify_data);
-            fclose(mp3Edit->fptr_src);
-            fclose(mp3Edit->fptr_out);
-            file_copy(mp3Edit);
-            printf("----------<< ALBUM CHANGED SUCCESSFULLY >>----------\n\n");
-            return e_success;
+            edit_report(mp3Edit, "EDIT PATH : REWRITE (%u bytes of new frames do not fit in %u tag bytes)\n\n", mp3Edit->encoded_size, mp3Edit->tag_size);
         }
-        printf("Error\n");
-        return e_failure;
-    }
+        else
+        {
+            edit_report(mp3Edit, "EDIT PATH : REWRITE (%u padding bytes compacted to %u)\n\n", mp3Edit->tag_size - mp3Edit->encoded_size, padding_reserve(mp3Edit));
+        }
+        // The new file replaces the source only once it is complete, a failed rewrite leaves it as it was
+        if (rewrite_frames(mp3Edit) == e_failure || replace_source(mp3Edit) == e_failure)
+        {
+            mp3Edit->error = mp3_err_write;
+            edit_report(mp3Edit, "Error in rewriting frames\n");
+            close_edit(mp3Edit);
+            return e_failure;
+        }
+        close_edit(mp3Edit);
 
-    // Change Year
-    if (do_change(mp3Edit, "TYER", "-y", &flag) == e_failure || flag)
-    {
-        if (flag)
+        // Report which copy methods moved the payload
+        if (mp3Edit->out != NULL)
         {
-            printf("----------[ CHANGE THE YEAR ]-------------\n\n");
-            printf("YEAR   : %s\n\n", mp3Edit->modify_data);
-            fclose(mp3Edit->fptr_src);
-            fclose(mp3Edit->fptr_out);
-            file_copy(mp3Edit);
-            printf("----------<< YEAR CHANGED SUCCESSFULLY >>----------\n\n");
-            return e_success;
+            print_copy_stats(mp3Edit->out);
         }
-        printf("Error\n");
-        return e_failure;
     }
+    edit_report(mp3Edit, "PADDING   : %u bytes consumed, %u reserved\n\n", mp3Edit->padding_consumed, mp3Edit->padding_reserved);
 
-    // Change Content
-    if (do_change(mp3Edit, "TCON", "-m", &flag) == e_failure || flag)
+    for (int i = 0; i < mp3Edit->edit_count; i++)
+    {
+        edit_report(mp3Edit, "----------<< %s CHANGED SUCCESSFULLY >>----------\n\n", get_frame_label(mp3Edit->edits[i].frame));
+    }
+
+    return e_success;
+}
+
+/**
+ * Reads the whole ID3 tag of the source file, undoes its unsynchronisation and builds the
+ * frame table. The header keeps its unsynchronisation flag, so the new frames are written
+ * the way the tag was.
+ * 
+ * Parameters:
+ *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ * 
+ * Returns:
+ *   Status: e_success if the frames are indexed, e_failure if an error occurs.
+ */
+Status load_frames(Mp3EditInfo *mp3Edit)
+{
+    // The header was read by check_ID3(), the frame region follows it
+    stats_fseek(mp3Edit->fptr_src, ID3_HEADER_SIZE, SEEK_SET);
+    mp3Edit->tag_size = syncsafe_to_int(mp3Edit->header + 6);
+
+    mp3Edit->tag = arena_alloc(&mp3Edit->arena, mp3Edit->tag_size + 1);
+    if (mp3Edit->tag == NULL || stats_fread(mp3Edit->tag, mp3Edit->tag_size, 1, mp3Edit->fptr_src) != 1)
     {
-        if (flag)
-        {
-            printf("----------[ CHANGE THE CONTENT ]-------------\n\n");
-            printf("CONTENT   : %s\n\n", mp3Edit->modify_data);
-            fclose(mp3Edit->fptr_src);
-            fclose(mp3Edit->fptr_out);
-            file_copy(mp3Edit);
-            printf("----------<< CONTENT CHANGED SUCCESSFULLY >>----------\n\n");
-            return e_success;
-        }
-        printf("Error\n");
         return e_failure;
     }
 
-    // Change Comment
-    if (do_change(mp3Edit, "COMM", "-c", &flag) == e_failure || flag)
+    unsigned char header[ID3_HEADER_SIZE];
+    memcpy(header, mp3Edit->header, ID3_HEADER_SIZE);
+    mp3Edit->synced_size = resync_tag(header, mp3Edit->tag, mp3Edit->tag_size);
+    if (build_frame_index(&mp3Edit->index, mp3Edit->header, mp3Edit->tag, mp3Edit->synced_size) == e_failure)
     {
-        if (flag)
-        {
-            printf("----------[ CHANGE THE COMMENT ]-------------\n\n");
-            printf("COMMENT   : %s\n\n", mp3Edit->modify_data);
-            fclose(mp3Edit->fptr_src);
-            fclose(mp3Edit->fptr_out);
-            file_copy(mp3Edit);
-            printf("----------<< COMMENT CHANGED SUCCESSFULLY >>----------\n\n");
-            return e_success;
-        }
-        printf("Error\n");
         return e_failure;
     }
+    mp3Edit->padding = mp3Edit->index.padding;
 
     return e_success;
 }
 
 /**
- * Changes the specified frame in the MP3 file based on the given arguments.
+ * Creates the temporary file of a rewrite in the directory of the source (of the file it
+ * links to), so it can be renamed over it, with the permissions and if possible the owner
+ * of the source.
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
- *   str (char[]): The frame type (e.g., TIT2 for title).
- *   frame (char[]): The argument for the frame to be edited (e.g., "-t").
- *   flag (int*): A flag to indicate whether the change was successful.
  * 
  * Returns:
- *   Status: e_success if the change is successful, e_failure if an error occurs.
+ *   FILE*: The temporary file opened for writing, or NULL if it can't be created.
  */
-Status do_change(Mp3EditInfo *mp3Edit, char str[], char frame[], int *flag)
+static FILE *open_temp_file(Mp3EditInfo *mp3Edit)
 {
-    // Check if the frame matches
-    if (check_frame(mp3Edit, str) == e_failure)
+    struct stat st;
+    mp3Edit->dest_fname = realpath(mp3Edit->src_fname, NULL);
+    if (mp3Edit->dest_fname == NULL || fstat(fileno(mp3Edit->fptr_src), &st) != 0)
     {
-        printf("Frame Matching Error\n");
-        return e_failure;
+        return NULL;
     }
 
-    // Modify data if the frame matches
-    if (strcmp(mp3Edit->frame, frame) == 0)
+    // A hidden name next to the source, e.g., "dir/.song.mp3.Xa81Qz"
+    const char *slash = strrchr(mp3Edit->dest_fname, '/');
+    int length = snprintf(mp3Edit->out_fname, sizeof(mp3Edit->out_fname), "%.*s.%s.XXXXXX",
+                          (int)(slash + 1 - mp3Edit->dest_fname), mp3Edit->dest_fname, slash + 1);
+    if (length < 0 || length >= (int)sizeof(mp3Edit->out_fname))
     {
-        modify_data(mp3Edit);
-        fseek(mp3Edit->fptr_src, mp3Edit->size - 1, SEEK_CUR);
-        copy_remaining(mp3Edit->fptr_out, mp3Edit->fptr_src);
-        *flag = 1;
-        return e_success;
+        mp3Edit->out_fname[0] = '\0';
+        return NULL;
+    }
+    stats_count(count_opens, 1);
+    int fd = mkstemp(mp3Edit->out_fname);
+    if (fd < 0)
+    {
+        mp3Edit->out_fname[0] = '\0';
+        return NULL;
+    }
+
+    if (fchmod(fd, st.st_mode & 07777) != 0)
+    {
+        close(fd);
+        return NULL;
     }
 
-    // Copy the same data if the frame doesn't match
-    if (copy_same(mp3Edit) == e_failure)
+    // Only root can give the file another owner, it then belongs to the editing user
+    if (fchown(fd, st.st_uid, st.st_gid) != 0)
+    {
+        edit_report(mp3Edit, "OWNER     : %s now belongs to the editing user\n\n", mp3Edit->src_fname);
+    }
+    FILE *fptr = fdopen(fd, "w");
+    if (fptr == NULL)
+    {
+        close(fd);
+    }
+    return fptr;
+}
+
+/**
+ * Writes the tag header and the new frames to a temporary file beside the source, followed
+ * by the padding reserved by the padding policy (and the ID3v2.4 footer, with the new size)
+ * and the audio data of the source file.
+ * The frames are written as encoded by build_frames(), unsynchronised if the tag was.
+ * 
+ * Parameters:
+ *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ * 
+ * Returns:
+ *   Status: e_success if the output file is written, e_failure if an error occurs.
+ */
+Status rewrite_frames(Mp3EditInfo *mp3Edit)
+{
+    unsigned long long start = stats_start();
+    mp3Edit->fptr_out = open_temp_file(mp3Edit);
+    stats_stop(phase_open, start);
+    if (mp3Edit->fptr_out == NULL)
     {
-        printf("Error in copying title\n");
         return e_failure;
     }
+    start = stats_start();
 
+    // The header of the source with the size of the new frames and the padding they reserve
+    mp3Edit->padding_reserved = padding_reserve(mp3Edit);
+    unsigned char header[ID3_HEADER_SIZE];
+    memcpy(header, mp3Edit->header, ID3_HEADER_SIZE);
+    int_to_syncsafe(header + 6, mp3Edit->encoded_size + mp3Edit->padding_reserved);
+    unsigned char *size = header + 6;
+
+    // Write the header and all frames at once
+    if (stats_fwrite(header, ID3_HEADER_SIZE, 1, mp3Edit->fptr_out) != 1 ||
+        stats_fwrite(mp3Edit->encoded, mp3Edit->encoded_size, 1, mp3Edit->fptr_out) != 1)
+    {
+        return e_failure;
+    }
+
+    // The padding is written as zeros, the old one may sit at another offset once decoded
+    static const unsigned char zeros[1024];
+    for (uint left = mp3Edit->padding_reserved; left > 0; )
+    {
+        uint count = left < sizeof(zeros) ? left : sizeof(zeros);
+        if (stats_fwrite(zeros, count, 1, mp3Edit->fptr_out) != 1)
+        {
+            return e_failure;
+        }
+        left -= count;
+    }
+
+    // An ID3v2.4 footer repeats the tag size, write it again after the padding
+    uint tag_end = ID3_HEADER_SIZE + mp3Edit->tag_size;
+    if (mp3Edit->index.parser->version == 4 && (mp3Edit->header[5] & ID3_FOOTER_FLAG))
+    {
+        unsigned char footer[ID3_HEADER_SIZE];
+        memcpy(footer, "3DI", 3);
+        memcpy(footer + 3, mp3Edit->header + 3, 3);
+        memcpy(footer + 6, size, 4);
+        if (stats_fwrite(footer, ID3_HEADER_SIZE, 1, mp3Edit->fptr_out) != 1)
+        {
+            return e_failure;
+        }
+        tag_end += ID3_HEADER_SIZE;
+    }
+    stats_stop(phase_write, start);
+
+    // Copy the audio data after the old tag
+    stats_fseek(mp3Edit->fptr_src, tag_end, SEEK_SET);
+    if (copy_remaining(mp3Edit->fptr_out, mp3Edit->fptr_src) == e_failure)
+    {
+        return e_failure;
+    }
+    mp3Edit->padding = mp3Edit->padding_reserved;
     return e_success;
 }
 
 /**
- * Copies the same data from the source to the output file.
- * This is used to copy data when no change is required.
+ * Builds the new frame region in memory: every frame of the tag in its original order,
+ * with each edited frame replaced, followed by the edited frames the tag didn't have.
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
  * 
  * Returns:
- *   Status: e_success if the copy is successful, e_failure if an error occurs.
+ *   Status: e_success if the frames are built, e_failure if an error occurs.
  */
-Status copy_same(Mp3EditInfo *mp3Edit)
+Status build_frames(Mp3EditInfo *mp3Edit)
 {
-    uint size = mp3Edit->size;
-    convert_endianess((char *)&size, sizeof(int));
-    fwrite(&size, 4, 1, mp3Edit->fptr_out);
+    int done[MAX_EDITS] = {0};
 
-    char flag[3];
-    fread(flag, 3, 1, mp3Edit->fptr_src);
-    fwrite(flag, 3, 1, mp3Edit->fptr_out);
+    // The new frames are never larger than the old ones plus every edited frame
+    uint capacity = mp3Edit->index.used;
+    for (int i = 0; i < mp3Edit->edit_count; i++)
+    {
+        capacity += FRAME_HEADER_SIZE + TEXT_FRAME_PREFIX + TEXT_ENCODED_MAX(mp3Edit->edits[i].data_length);
+    }
+    mp3Edit->frames = arena_alloc(&mp3Edit->arena, capacity + 1);
+    if (mp3Edit->frames == NULL)
+    {
+        return e_failure;
+    }
 
-    char data[mp3Edit->size];
-    fread(data, mp3Edit->size - 1, 1, mp3Edit->fptr_src);
-    fwrite(data, mp3Edit->size - 1, 1, mp3Edit->fptr_out);
+    // The extended header stays in front of the frames
+    const FrameParser *parser = mp3Edit->index.parser;
+    uint length = mp3Edit->index.start;
+    memcpy(mp3Edit->frames, mp3Edit->tag, length);
+    mp3Edit->first_change = mp3Edit->index.used;
+    for (uint i = 0; i < mp3Edit->index.count; i++)
+    {
+        const FrameEntry *entry = &mp3Edit->index.frames[i];
+        const unsigned char *old_frame = mp3Edit->tag + entry->offset;
+        uint old_length = entry->data + entry->size - entry->offset;
+
+        // Replace the first frame of each edited type, copy every other frame unchanged
+        int edit = -1;
+        for (int j = 0; j < mp3Edit->edit_count; j++)
+        {
+            if (!done[j] && strncmp(entry->id, get_frame_id(mp3Edit->edits[j].frame), 4) == 0)
+            {
+                edit = j;
+            }
+        }
+        if (edit < 0)
+        {
+            memcpy(mp3Edit->frames + length, old_frame, old_length);
+            length += old_length;
+            continue;
+        }
+
+        done[edit] = 1;
+        if (entry->offset < mp3Edit->first_change)
+        {
+            mp3Edit->first_change = entry->offset;
+        }
+        length += make_frame(parser, mp3Edit->frames + length, entry->id, mp3Edit->tag, entry, mp3Edit->edits[edit].modify_data);
+    }
+
+    // Frames missing from the tag are added after the last frame
+    for (int j = 0; j < mp3Edit->edit_count; j++)
+    {
+        if (!done[j])
+        {
+            length += make_frame(parser, mp3Edit->frames + length, get_frame_id(mp3Edit->edits[j].frame), NULL, NULL, mp3Edit->edits[j].modify_data);
+        }
+    }
+    mp3Edit->frames_size = length;
+
+    // Unsynchronise the new frames when the tag was, they are written that way
+    mp3Edit->encoded = mp3Edit->frames;
+    mp3Edit->encoded_size = length;
+    if (mp3Edit->header[5] & ID3_UNSYNC_FLAG)
+    {
+        mp3Edit->encoded = arena_alloc(&mp3Edit->arena, 2 * length + 1);
+        if (mp3Edit->encoded == NULL)
+        {
+            return e_failure;
+        }
+        mp3Edit->encoded_size = unsync_tag(mp3Edit->header, mp3Edit->encoded, mp3Edit->frames, length);
+    }
+
+    // Frames that grew past the old ones take their bytes from the padding first
+    uint old_used = mp3Edit->tag_size - mp3Edit->padding;
+    uint grown = mp3Edit->encoded_size > old_used ? mp3Edit->encoded_size - old_used : 0;
+    mp3Edit->padding_consumed = grown < mp3Edit->padding ? grown : mp3Edit->padding;
+    mp3Edit->padding_reserved = 0;
 
     return e_success;
 }
@@ -285,178 +530,492 @@ Status copy_same(Mp3EditInfo *mp3Edit)
  */
 Status copy_remaining(FILE *fptr_dest, FILE *fptr_src)
 {
-    char ch;
-    while (fread(&ch, 1, 1, fptr_src) > 0)
+    return copy_file_data(fptr_dest, fptr_src, NULL);
+}
+
+/**
+ * Builds a text frame with the header layout of the tag version. The status flags are taken
+ * from the old frame when there is one; the format flags are always cleared, the text is
+ * written plain. ASCII text is written as ISO-8859-1, other text as UTF-8 for ID3v2.4 and
+ * UTF-16 for older versions. Comments keep the language of the old comment ("eng" for a new
+ * one) and get an empty description.
+ * 
+ * Parameters:
+ *   parser (const FrameParser*): The parser of the tag.
+ *   dest (unsigned char*): Buffer for the frame, at least FRAME_HEADER_SIZE + TEXT_FRAME_PREFIX + TEXT_ENCODED_MAX(text length) bytes.
+ *   frame_id (const char*): Frame identifier with its ID3v2.3 name (e.g., "TIT2").
+ *   tag (const unsigned char*): The tag buffer the old frame is in.
+ *   old (const FrameEntry*): The frame being replaced, or NULL.
+ *   text (const char*): The new text, in UTF-8.
+ * 
+ * Returns:
+ *   uint: Length of the frame including its header.
+ */
+uint make_frame(const FrameParser *parser, unsigned char *dest, const char *frame_id, const unsigned char *tag, const FrameEntry *old, const char *text)
+{
+    uint text_len = strlen(text);
+    unsigned char encoding = text_is_ascii(text, text_len) ? TEXT_LATIN1 : parser->version == 4 ? TEXT_UTF8 : TEXT_UTF16;
+    unsigned char *payload = dest + parser->header_size;
+    uint length = 0;
+
+    payload[length++] = encoding;
+    if (strncmp(frame_id, "COMM", 4) == 0 || strncmp(frame_id, "USLT", 4) == 0)
     {
-        fwrite(&ch, 1, 1, fptr_dest);
+        memcpy(payload + length, old != NULL && old->size >= 4 ? tag + old->data + 1 : (const unsigned char *)"eng", 3);
+        length += 3;
+        payload[length++] = 0;
+        if (encoding == TEXT_UTF16)
+        {
+            payload[length++] = 0;
+        }
     }
-    return e_success;
+    length += text_from_utf8(payload + length, text, text_len, encoding);
+
+    parser->write_header(dest, frame_id, length, old != NULL ? tag + old->offset : NULL);
+    return parser->header_size + length;
 }
 
 /**
- * Modifies the data of the MP3 file based on the given information.
+ * Opens the source MP3 file for reading and in place writing.
+ * The temporary file is only created when the tag has to be rewritten.
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
  * 
  * Returns:
- *   Status: e_success if the modification is successful, e_failure if an error occurs.
+ *   Status: e_success if the file is opened successfully, e_failure if an error occurs.
  */
-Status modify_data(Mp3EditInfo *mp3Edit)
+Status open_files(Mp3EditInfo *mp3Edit)
 {
-    convert_endianess((char *)&mp3Edit->data_length, sizeof(int));
-    fwrite(&mp3Edit->data_length, 4, 1, mp3Edit->fptr_out);
-
-    char flag[3];
-    fread(flag, 3, 1, mp3Edit->fptr_src);
-    fwrite(flag, 3, 1, mp3Edit->fptr_out);
+    mp3Edit->fptr_out = NULL;
 
-    fwrite(mp3Edit->modify_data, strlen(mp3Edit->modify_data), 1, mp3Edit->fptr_out);
+    mp3Edit->fptr_src = stats_fopen(mp3Edit->src_fname, "r+");
+    if (mp3Edit->fptr_src == NULL)
+    {
+        return e_failure;
+    }
 
     return e_success;
 }
 
 /**
- * Copies the header from the source file to the destination file.
+ * Closes the files opened for editing. The arena is kept for the next file.
  * 
  * Parameters:
- *   fptr_dest (FILE*): Pointer to the destination file.
- *   fptr_src (FILE*): Pointer to the source file.
+ *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ */
+void close_edit(Mp3EditInfo *mp3Edit)
+{
+    fclose(mp3Edit->fptr_src);
+    if (mp3Edit->fptr_out != NULL)
+    {
+        fclose(mp3Edit->fptr_out);
+        mp3Edit->fptr_out = NULL;
+    }
+
+    // The temporary file of a rewrite that didn't replace the source is removed
+    if (mp3Edit->out_fname[0] != '\0')
+    {
+        unlink(mp3Edit->out_fname);
+        mp3Edit->out_fname[0] = '\0';
+    }
+    free(mp3Edit->dest_fname);
+    mp3Edit->dest_fname = NULL;
+}
+
+/**
+ * Prepares the arena and the frame table before the first edit.
+ * The arena limit comes from MP3_ARENA_LIMIT, the fsync policy from MP3_FSYNC and the padding
+ * policy from the command line.
+ * 
+ * Parameters:
+ *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ */
+void init_edit(Mp3EditInfo *mp3Edit)
+{
+    arena_init(&mp3Edit->arena, arena_limit());
+    mp3Edit->tag = NULL;
+    mp3Edit->frames = NULL;
+    memset(&mp3Edit->index, 0, sizeof(mp3Edit->index));
+    mp3Edit->fptr_out = NULL;
+    mp3Edit->out_fname[0] = '\0';
+    mp3Edit->dest_fname = NULL;
+    mp3Edit->pending_fname = mp3Edit->pending_dest = NULL;
+    mp3Edit->fsync = fsync_policy();
+    mp3Edit->padding_policy = edit_padding;
+    mp3Edit->padding_consumed = mp3Edit->padding_reserved = 0;
+}
+
+/**
+ * Releases the arena and the frame table kept between edits.
+ * 
+ * Parameters:
+ *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ */
+void free_edit(Mp3EditInfo *mp3Edit)
+{
+    arena_free(&mp3Edit->arena);
+    free_frame_index(&mp3Edit->index);
+    free(mp3Edit->pending_fname);
+    free(mp3Edit->pending_dest);
+    init_edit(mp3Edit);
+}
+
+/**
+ * Reads the tag header and checks if the MP3 file has a valid ID3 tag.
+ * 
+ * Parameters:
+ *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
  * 
  * Returns:
- *   Status: e_success if the header copy is successful, e_failure if an error occurs.
+ *   Status: e_success if the ID3 tag is valid, e_failure if an error occurs.
  */
-Status copy_header(FILE *fptr_dest, FILE *fptr_src)
+Status check_ID3(Mp3EditInfo *mp3Edit)
 {
-    rewind(fptr_dest);
-    rewind(fptr_src);
-    char header[10];
-    fread(header, 10, 1, fptr_src);
-    fwrite(header, 10, 1, fptr_dest);
+    // Read the whole tag header, the version and size are taken from it later
+    if (stats_fread(mp3Edit->header, ID3_HEADER_SIZE, 1, mp3Edit->fptr_src) != 1 ||
+        strncmp((char *)mp3Edit->header, "ID3", 3) != 0)
+    {
+        return e_failure;
+    }
 
     return e_success;
 }
 
 /**
- * Checks if the specified frame exists in the MP3 file.
+ * Checks if the MP3 file uses a supported ID3v2 version (2, 3 or 4).
+ * The major version is the single byte after "ID3" in the header read by check_ID3().
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
- *   str (char[]): The frame type to be checked (e.g., TIT2 for title).
  * 
  * Returns:
- *   Status: e_success if the frame is found, e_failure if an error occurs.
+ *   Status: e_success if the version is supported, e_failure if the version is invalid.
  */
-Status check_frame(Mp3EditInfo *mp3Edit, char str[])
+Status check_mp3version(Mp3EditInfo *mp3Edit)
 {
-    char buffer[4];
-    fread(buffer, 4, 1, mp3Edit->fptr_src);
-
-    if (strcmp(buffer, str) != 0)
+    if (get_frame_parser(mp3Edit->header) == NULL)
     {
         return e_failure;
     }
-    fwrite(buffer, 4, 1, mp3Edit->fptr_out);
-
-    fread(&mp3Edit->size, 4, 1, mp3Edit->fptr_src);
-    convert_endianess((char *)&mp3Edit->size, sizeof(int));
 
     return e_success;
 }
 
 /**
- * Opens the input and output MP3 files for reading and writing, respectively.
+ * Flushes the temporary file of a rewrite as the fsync policy asks and renames it over the
+ * source. The rename replaces the source at once, so the file holds the old tag or the new
+ * one even after a crash, and only the new file is ever written. Under fsync_group the closed
+ * file is handed over to the caller instead, who renames it once it is flushed.
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
  * 
  * Returns:
- *   Status: e_success if the files are opened successfully, e_failure if an error occurs.
+ *   Status: e_success if the source was replaced, e_failure if an error occurs.
  */
-Status open_files(Mp3EditInfo *mp3Edit)
+Status replace_source(Mp3EditInfo *mp3Edit)
 {
-    mp3Edit->fptr_src = fopen(mp3Edit->src_fname, "r");
-    if (mp3Edit->fptr_src == NULL)
+    unsigned long long start = stats_start();
+    int fd = fileno(mp3Edit->fptr_out);
+    int result = fflush(mp3Edit->fptr_out);
+    if (result == 0 && mp3Edit->fsync == fsync_data)
     {
-        return e_failure;
+        result = fdatasync(fd);
+    }
+    else if (result == 0 && mp3Edit->fsync == fsync_full)
+    {
+        result = fsync(fd);
+    }
+    if (fclose(mp3Edit->fptr_out) != 0)
+    {
+        result = -1;
     }
+    mp3Edit->fptr_out = NULL;
 
-    mp3Edit->fptr_out = fopen(mp3Edit->out_fname, "w");
-    if (mp3Edit->fptr_out == NULL)
+    // In a group commit the caller flushes many files at once before renaming them
+    if (mp3Edit->fsync == fsync_group)
     {
+        mp3Edit->pending_fname = result == 0 ? strdup(mp3Edit->out_fname) : NULL;
+        if (mp3Edit->pending_fname == NULL)
+        {
+            stats_stop(phase_write, start);
+            return e_failure;
+        }
+        mp3Edit->pending_dest = mp3Edit->dest_fname;
+        mp3Edit->dest_fname = NULL;
+        mp3Edit->out_fname[0] = '\0';
+        stats_stop(phase_write, start);
+        return e_success;
+    }
+
+    if (result != 0 || rename(mp3Edit->out_fname, mp3Edit->dest_fname) != 0)
+    {
+        stats_stop(phase_write, start);
         return e_failure;
     }
+    mp3Edit->out_fname[0] = '\0';
 
-    return e_success;
+    // The rename itself is only durable once the directory is
+    if (mp3Edit->fsync == fsync_full)
+    {
+        char *slash = strrchr(mp3Edit->dest_fname, '/');
+        *slash = '\0';
+        int dir_fd = open(slash == mp3Edit->dest_fname ? "/" : mp3Edit->dest_fname, O_RDONLY | O_DIRECTORY);
+        *slash = '/';
+        result = dir_fd < 0 ? -1 : fsync(dir_fd);
+        if (dir_fd >= 0)
+        {
+            close(dir_fd);
+        }
+    }
+    stats_stop(phase_write, start);
+
+    return result == 0 ? e_success : e_failure;
+}
+
+/**
+ * Returns the fsync policy named in the MP3_FSYNC environment variable: "none", "data" or
+ * "full", or fsync_data when it is not set or invalid.
+ * 
+ * Returns:
+ *   FsyncPolicy: The policy.
+ */
+FsyncPolicy fsync_policy(void)
+{
+    const char *value = getenv("MP3_FSYNC");
+    if (value != NULL && strcmp(value, "none") == 0)
+    {
+        return fsync_none;
+    }
+    if (value != NULL && strcmp(value, "full") == 0)
+    {
+        return fsync_full;
+    }
+    return fsync_data;
 }
 
 /**
- * Checks if the MP3 file has a valid ID3 tag.
+ * Gives the padding a rewrite reserves after the new frames. The policy's size (or percentage
+ * of the frames) is a minimum: the old padding is kept when it is larger, unless compacting.
+ * ID3v2.4 tags with a footer get none, the standard forbids padding before it.
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
  * 
  * Returns:
- *   Status: e_success if the ID3 tag is valid, e_failure if an error occurs.
+ *   uint: Padding bytes, never more than the tag size can hold.
  */
-Status check_ID3(Mp3EditInfo *mp3Edit)
+uint padding_reserve(const Mp3EditInfo *mp3Edit)
 {
-    char buffer[3];
-    fread(buffer, 3, 1, mp3Edit->fptr_src);
-    if (strcmp(buffer, "ID3") != 0)
+    const PaddingPolicy *policy = &mp3Edit->padding_policy;
+    if (mp3Edit->index.parser != NULL && mp3Edit->index.parser->version == 4 && (mp3Edit->header[5] & ID3_FOOTER_FLAG))
     {
-        return e_failure;
+        return 0;
     }
 
+    unsigned long long reserve = policy->percent ? (unsigned long long)mp3Edit->encoded_size * policy->percent / 100 : policy->bytes;
+    if (!policy->compact && reserve < mp3Edit->padding)
+    {
+        reserve = mp3Edit->padding;
+    }
+    if (reserve > ID3_TAG_MAX - mp3Edit->encoded_size)
+    {
+        reserve = ID3_TAG_MAX - mp3Edit->encoded_size;
+    }
+    return reserve;
+}
+
+/**
+ * Finds the --padding=bytes|percent% and --compact arguments and removes them from the argument
+ * list. The size takes a K or M suffix; a percentage is of the new frames, 100% at most.
+ * 
+ * Parameters:
+ *   argc (int*): Number of command-line arguments, lowered when an option is removed.
+ *   argv (char*[]): Command-line arguments.
+ * 
+ * Returns:
+ *   Status: e_success if the options are valid or not given, e_failure otherwise.
+ */
+Status parse_padding_option(int *argc, char *argv[])
+{
+    for (int i = 1; i < *argc; i++)
+    {
+        if (strcmp(argv[i], "--compact") == 0)
+        {
+            edit_padding.compact = 1;
+        }
+        else if (strncmp(argv[i], "--padding=", 10) == 0)
+        {
+            char *end;
+            const char *value = argv[i] + 10;
+            unsigned long long size = strtoull(value, &end, 10);
+            if (end == value || *value == '-')
+            {
+                return e_failure;
+            }
+            int percent = *end == '%';
+            uint shift = 0;
+            switch (*end)
+            {
+                case 'M': case 'm': shift += 10; /* fall through */
+                case 'K': case 'k': shift += 10; /* fall through */
+                case '%': end++; break;
+                default: break;
+            }
+
+            // The range is checked before the suffix is applied, so a large size can't wrap around
+            unsigned long long max = percent ? 100 : ID3_TAG_MAX >> shift;
+            if (*end != '\0' || size > max)
+            {
+                return e_failure;
+            }
+            edit_padding.bytes = percent ? 0 : size << shift;
+            edit_padding.percent = percent ? size : 0;
+        }
+        else
+        {
+            continue;
+        }
+
+        // Drop the option so the other arguments keep their positions
+        memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char *));
+        (*argc)--;
+        i--;
+    }
     return e_success;
 }
 
 /**
- * Checks if the MP3 file uses ID3v2 version 3.
+ * Gives the padding policy set on the command line.
+ * 
+ * Returns:
+ *   PaddingPolicy: The policy.
+ */
+PaddingPolicy padding_policy(void)
+{
+    return edit_padding;
+}
+
+/**
+ * Tries to apply the edits inside the source file's existing ID3 tag. When compacting, a tag
+ * left with more padding than the policy reserves is rewritten instead.
+ * The new frames built by build_frames() are written back with a single positioned write,
+ * starting at the first changed frame (at the first frame for an unsynchronised tag). The tag
+ * size in the header never changes, so the audio data is not touched.
  * 
  * Parameters:
  *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ *   fits (int*): Set to 1 if the edits were applied in place, 0 if a full rewrite is needed.
  * 
  * Returns:
- *   Status: e_success if the MP3 version is 3, e_failure if the version is invalid.
+ *   Status: e_success if the tag was inspected (and patched when it fits), e_failure if an error occurs.
  */
-Status check_mp3version(Mp3EditInfo *mp3Edit)
+Status edit_in_place(Mp3EditInfo *mp3Edit, int *fits)
 {
-    short version;
-    fread(&version, 2, 1, mp3Edit->fptr_src);
-    if (version != 3)
+    *fits = 0;
+    if (mp3Edit->encoded_size > mp3Edit->tag_size ||
+        (mp3Edit->padding_policy.compact && mp3Edit->tag_size - mp3Edit->encoded_size > padding_reserve(mp3Edit)))
+    {
+        return e_success;
+    }
+
+    // Unsynchronised bytes don't line up with the decoded frames, so the whole region is written
+    uint used = mp3Edit->index.used;
+    uint write_end = used > mp3Edit->frames_size ? used : mp3Edit->frames_size;
+    uint start = mp3Edit->first_change;
+    if (mp3Edit->encoded != mp3Edit->frames || mp3Edit->synced_size != mp3Edit->tag_size)
+    {
+        start = 0;
+        write_end = mp3Edit->tag_size;
+    }
+
+    // Put the new frames into the tag buffer and clear the padding they freed
+    memcpy(mp3Edit->tag + start, mp3Edit->encoded + start, mp3Edit->encoded_size - start);
+    memset(mp3Edit->tag + mp3Edit->encoded_size, 0, write_end - mp3Edit->encoded_size);
+
+    // Patch only the changed part of the tag with one positioned write
+    uint count = write_end - start;
+    if (stats_pwrite(fileno(mp3Edit->fptr_src), mp3Edit->tag + start, count, ID3_HEADER_SIZE + start) != (ssize_t)count)
     {
         return e_failure;
     }
 
+    // Keep the frame table in step with the patched tag
+    unsigned char header[ID3_HEADER_SIZE];
+    memcpy(header, mp3Edit->header, ID3_HEADER_SIZE);
+    mp3Edit->synced_size = resync_tag(header, mp3Edit->tag, mp3Edit->tag_size);
+    if (build_frame_index(&mp3Edit->index, mp3Edit->header, mp3Edit->tag, mp3Edit->synced_size) == e_failure)
+    {
+        return e_failure;
+    }
+    mp3Edit->padding = mp3Edit->index.padding;
+    *fits = 1;
+
     return e_success;
 }
 
 /**
- * Copies the MP3 file from the source to the destination.
- * This is done after changes are made to the file.
+ * Maps an edit option (e.g., "-t") to its ID3 frame identifier (e.g., "TIT2").
  * 
  * Parameters:
- *   mp3Edit (Mp3EditInfo*): A pointer to the structure containing MP3 file information.
+ *   option (char*): The edit option passed on the command line.
  * 
  * Returns:
- *   Status: e_success if the copy is successful, e_failure if an error occurs.
+ *   const char*: The frame identifier, or NULL if the option is unknown.
  */
-Status file_copy(Mp3EditInfo *mp3Edit)
+const char *get_frame_id(char *option)
 {
-    mp3Edit->fptr_src = fopen(mp3Edit->src_fname, "w");
-    mp3Edit->fptr_out = fopen(mp3Edit->out_fname, "r");
-
-    rewind(mp3Edit->fptr_src);
-    rewind(mp3Edit->fptr_out);
+    for (uint i = 0; i < sizeof(edit_frames) / sizeof(edit_frames[0]); i++)
+    {
+        if (strcmp(option, edit_frames[i].option) == 0)
+        {
+            return edit_frames[i].frame_id;
+        }
+    }
+    return NULL;
+}
 
-    char ch;
-    while (fread(&ch, 1, 1, mp3Edit->fptr_out) > 0)
+/**
+ * Maps an edit option (e.g., "-t") to the label used when reporting the change (e.g., "TITLE").
+ * 
+ * Parameters:
+ *   option (char*): The edit option passed on the command line.
+ * 
+ * Returns:
+ *   const char*: The label, or NULL if the option is unknown.
+ */
+const char *get_frame_label(char *option)
+{
+    for (uint i = 0; i < sizeof(edit_frames) / sizeof(edit_frames[0]); i++)
     {
-        fwrite(&ch, 1, 1, mp3Edit->fptr_src);
+        if (strcmp(option, edit_frames[i].option) == 0)
+        {
+            return edit_frames[i].label;
+        }
     }
+    return NULL;
+}
 
-    return e_success;
+/**
+ * Maps an ID3 frame identifier (e.g., "TIT2") to its edit option (e.g., "-t").
+ * 
+ * Parameters:
+ *   frame_id (const char*): The frame identifier.
+ * 
+ * Returns:
+ *   char*: The edit option, or NULL if the frame can't be edited.
+ */
+char *get_frame_option(const char *frame_id)
+{
+    for (uint i = 0; i < sizeof(edit_frames) / sizeof(edit_frames[0]); i++)
+    {
+        if (strcmp(frame_id, edit_frames[i].frame_id) == 0)
+        {
+            return (char *)edit_frames[i].option;
+        }
+    }
+    return NULL;
 }
 
 /**
@@ -469,7 +1028,7 @@ Status file_copy(Mp3EditInfo *mp3Edit)
 void convert_endianess(char *ptr, uint size)
 {
     char temp;
-    for (int i = 0; i < size / 2; i++)
+    for (uint i = 0; i < size / 2; i++)
     {
         temp = ptr[i];
         ptr[i] = ptr[size - i - 1];
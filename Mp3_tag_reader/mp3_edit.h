@@ -1,7 +1,51 @@
 #ifndef MP3_EDIT_H
 #define MP3_EDIT_H
 
+#include <limits.h>
 #include "types.h"
+#include "mp3_frame.h"
+#include "mp3_arena.h"
+#include "mp3_lib.h"
+
+// Maximum number of frames changed by one edit
+#define MAX_EDITS 16
+
+// Most bytes a text frame has in front of its text: the encoding byte, and for a comment
+// the language and the terminator of its empty description
+#define TEXT_FRAME_PREFIX 6
+
+/**
+ * Enum to represent how a rewritten file is flushed before it replaces the source (MP3_FSYNC).
+ */
+typedef enum
+{
+    fsync_none,            // Rename only: safe against a crash of the process, not of the system
+    fsync_data,            // fdatasync() the new file before the rename (default)
+    fsync_full,            // fsync() the new file before the rename and its directory after it
+    fsync_group            // Nothing flushed or renamed, the caller commits the new file with others (batch group commit)
+} FsyncPolicy;
+
+// Padding bytes a rewrite reserves unless --padding is given
+#define PADDING_DEFAULT 1024
+
+// Largest tag size the 28 bits of the header can hold
+#define ID3_TAG_MAX 0x0FFFFFFF
+
+// Structure to store how much padding a rewrite leaves for later edits
+typedef struct PaddingPolicy
+{
+    uint bytes;            // Padding bytes reserved, used when percent is 0
+    uint percent;          // Padding as a percentage of the new frames, 0 for a fixed size
+    int compact;           // 1 to trim padding over the reserve, rewriting tags that have more
+} PaddingPolicy;
+
+// Structure to store one frame change requested on the command line
+typedef struct FrameEdit
+{
+    char *frame;           // The edit option (e.g., "-t" for title)
+    char *modify_data;     // Data to modify (e.g., title, artist)
+    int data_length;       // Length of the modification data
+} FrameEdit;
 
 // Structure to store MP3 file edit information
 typedef struct Mp3EditInfo
@@ -9,14 +53,37 @@ typedef struct Mp3EditInfo
     char *src_fname;       // Source MP3 file name
     FILE *fptr_src;        // File pointer for the source MP3 file
 
-    char out_fname[20];    // Output file name
+    char out_fname[PATH_MAX + 16];  // Temporary file beside the source a rewrite goes to, empty when there is none
+    char *dest_fname;      // Resolved path of the source the temporary file is renamed to
+    char *pending_fname;   // Under fsync_group, the temporary file of the last rewrite, left for the caller (malloc'd)
+    char *pending_dest;    // Under fsync_group, the path it has to be renamed to (malloc'd)
     FILE *fptr_out;        // File pointer for the output MP3 file
-
-    char *modify_data;     // Data to modify (e.g., title, artist)
-    int data_length;       // Length of the modification data
-    char *frame;           // The MP3 frame type (e.g., "TIT2" for title)
-
-    uint size;             // Size of the MP3 frame
+    FsyncPolicy fsync;     // How the temporary file is flushed before it replaces the source
+
+    FrameEdit edits[MAX_EDITS];  // Frame changes, applied together in one pass
+    int edit_count;        // Number of frame changes
+
+    unsigned char header[ID3_HEADER_SIZE];  // ID3 tag header, its version selects the frame parser
+    uint tag_size;         // Size of the ID3 tag excluding the 10 byte header
+    uint synced_size;      // Size of the frame region once its unsynchronisation is undone
+    uint padding;          // Unused padding bytes at the end of the tag
+    PaddingPolicy padding_policy;  // Padding a rewrite reserves, from --padding and --compact
+    uint padding_consumed; // Bytes of the old padding taken by the new frames
+    uint padding_reserved; // Padding written by the last rewrite, 0 after an in-place edit
+
+    FILE *out;             // Stream the edit details are printed to (e.g., stdout), NULL to print nothing
+    int in_place;          // 1 if the last edit patched the tag in place, 0 if it rewrote the file
+    Mp3Error error;        // Why the last edit failed, mp3_ok if it succeeded
+
+    Arena arena;           // Holds the tag and the new frames, reset for every file
+    unsigned char *tag;    // Frame region of the tag, read once
+    FrameIndex index;      // Table of all frames of the tag
+
+    unsigned char *frames; // New frame region with every change applied
+    uint frames_size;      // Size of the new frame region
+    unsigned char *encoded; // New frame region as written, unsynchronised if the tag is (frames otherwise)
+    uint encoded_size;     // Size of the written frame region
+    uint first_change;     // Offset of the first changed byte of the frame region
 } Mp3EditInfo;
 
 // Function Prototypes
@@ -24,49 +91,99 @@ typedef struct Mp3EditInfo
 /**
  * Validates and reads the MP3 file for editing.
  * It checks if the file has a valid extension and stores relevant information into the `mp3Edit` structure.
+ * Any number of option and text pairs may come before the file name.
  * 
- * @param argv (char*[]): Command-line arguments, where the MP3 filename is at index 4.
+ * @param argc (int): Number of command-line arguments.
+ * @param argv (char*[]): Command-line arguments, where the MP3 filename is the last one.
  * @param mp3Edit (Mp3EditInfo*): Structure to store MP3 file information.
  * 
  * @returns Status: e_success if validation is successful, e_failure if there's an error.
  */
-Status read_and_validation_edit(char *argv[], Mp3EditInfo *mp3Edit);
+Status read_and_validation_edit(int argc, char *argv[], Mp3EditInfo *mp3Edit);
 
 
 /**
- * Checks if the specified frame exists in the MP3 file.
+ * Edits the MP3 file's information based on the specified frame.
+ * This function validates the MP3 file, opens necessary files, and applies the modification.
+ * The reason of a failure is kept in mp3Edit->error.
  * 
  * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
- * @param str (char[]): Frame type (e.g., "TIT2" for title).
  * 
- * @returns Status: e_success if the frame exists, e_failure if not.
+ * @returns Status: e_success if editing is successful, e_failure if an error occurs.
  */
-Status check_frame(Mp3EditInfo *mp3Edit, char str[]);
+Status edit_info(Mp3EditInfo *mp3Edit);
 
 
 /**
- * Edits the MP3 file's information based on the specified frame.
- * This function validates the MP3 file, opens necessary files, and applies the modification.
+ * Opens the source MP3 file for reading and in place writing.
+ * The temporary file is only created when the tag has to be rewritten.
  * 
  * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
  * 
- * @returns Status: e_success if editing is successful, e_failure if an error occurs.
+ * @returns Status: e_success if the file is opened successfully, e_failure if an error occurs.
  */
-Status edit_info(Mp3EditInfo *mp3Edit);
+Status open_files(Mp3EditInfo *mp3Edit);
 
 
 /**
- * Opens the input and output MP3 files for reading and writing.
+ * Closes the files opened for editing. The arena is kept for the next file.
  * 
  * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ */
+void close_edit(Mp3EditInfo *mp3Edit);
+
+
+/**
+ * Prepares the arena and the frame table before the first edit, with the padding policy of the command line.
  * 
- * @returns Status: e_success if the files are opened successfully, e_failure if an error occurs.
+ * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
  */
-Status open_files(Mp3EditInfo *mp3Edit);
+void init_edit(Mp3EditInfo *mp3Edit);
+
+
+/**
+ * Releases the arena and the frame table kept between edits.
+ * 
+ * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ */
+void free_edit(Mp3EditInfo *mp3Edit);
+
+
+/**
+ * Reads the whole ID3 tag of the source file, undoes its unsynchronisation and builds the frame table.
+ * 
+ * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ * 
+ * @returns Status: e_success if the frames are indexed, e_failure if an error occurs.
+ */
+Status load_frames(Mp3EditInfo *mp3Edit);
 
 
 /**
- * Checks if the MP3 file has a valid ID3 tag (ID3v2).
+ * Builds the new frame region in memory with every requested change applied: frames keep
+ * their order, edited frames are replaced and frames the tag didn't have are appended.
+ * The frames are also encoded the way they are written, unsynchronised if the tag is.
+ * 
+ * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ * 
+ * @returns Status: e_success if the frames are built, e_failure if an error occurs.
+ */
+Status build_frames(Mp3EditInfo *mp3Edit);
+
+
+/**
+ * Writes the tag header and the new frames to a temporary file beside the source, followed
+ * by the padding and the audio data of the source file.
+ * 
+ * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ * 
+ * @returns Status: e_success if the output file is written, e_failure if an error occurs.
+ */
+Status rewrite_frames(Mp3EditInfo *mp3Edit);
+
+
+/**
+ * Reads the tag header and checks if the MP3 file has a valid ID3 tag (ID3v2).
  * 
  * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
  * 
@@ -76,34 +193,61 @@ Status check_ID3(Mp3EditInfo *mp3Edit);
 
 
 /**
- * Checks if the MP3 file uses ID3v2 version 3.
+ * Checks if the MP3 file uses a supported ID3v2 version (2, 3 or 4).
  * 
- * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information, with the header read by check_ID3().
  * 
- * @returns Status: e_success if version 3 is found, e_failure if not.
+ * @returns Status: e_success if the version is supported, e_failure if not.
  */
 Status check_mp3version(Mp3EditInfo *mp3Edit);
 
 
 /**
- * Copies the header from the source MP3 file to the output file.
+ * Gives the padding a rewrite reserves after the new frames: the fixed size or percentage of
+ * the policy, at least the old padding unless compacting, and none before an ID3v2.4 footer.
  * 
- * @param fptr_dest (FILE*): File pointer to the destination (output) file.
- * @param fptr_src (FILE*): File pointer to the source file.
+ * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information, with the new frames built.
  * 
- * @returns Status: e_success if the header copy is successful, e_failure if an error occurs.
+ * @returns uint: Padding bytes.
  */
-Status copy_header(FILE *fptr_dest, FILE *fptr_src);
+uint padding_reserve(const Mp3EditInfo *mp3Edit);
 
 
 /**
- * Modifies a specified MP3 frame (e.g., title, artist) with the provided data.
+ * Finds the --padding=bytes|percent% and --compact arguments and removes them from the argument
+ * list. The padding policy they give is used by every edit prepared from then on.
  * 
- * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ * @param argc (int*): Number of command-line arguments, lowered when an option is removed.
+ * @param argv (char*[]): Command-line arguments.
+ * 
+ * @returns Status: e_success if the options are valid or not given, e_failure otherwise.
+ */
+Status parse_padding_option(int *argc, char *argv[]);
+
+
+/**
+ * Gives the padding policy set on the command line.
  * 
- * @returns Status: e_success if the modification is successful, e_failure if an error occurs.
+ * @returns PaddingPolicy: The policy, PADDING_DEFAULT bytes without compaction when none was given.
  */
-Status modify_data(Mp3EditInfo *mp3Edit);
+PaddingPolicy padding_policy(void);
+
+
+/**
+ * Builds a text frame in the layout of the tag version, keeping the status flags of the old
+ * frame if there is one. ASCII text is written as ISO-8859-1, other text as UTF-8 (ID3v2.4)
+ * or UTF-16; comments get a language and an empty description.
+ * 
+ * @param parser (const FrameParser*): The parser of the tag.
+ * @param dest (unsigned char*): Buffer for the frame, at least FRAME_HEADER_SIZE + TEXT_FRAME_PREFIX + TEXT_ENCODED_MAX(text length) bytes.
+ * @param frame_id (const char*): Frame identifier with its ID3v2.3 name (e.g., "TIT2").
+ * @param tag (const unsigned char*): The tag buffer the old frame is in.
+ * @param old (const FrameEntry*): The frame being replaced, or NULL.
+ * @param text (const char*): The new text, in UTF-8.
+ * 
+ * @returns uint: Length of the frame including its header.
+ */
+uint make_frame(const FrameParser *parser, unsigned char *dest, const char *frame_id, const unsigned char *tag, const FrameEntry *old, const char *text);
 
 
 /**
@@ -118,36 +262,66 @@ Status copy_remaining(FILE *fptr_dest, FILE *fptr_src);
 
 
 /**
- * Copies the same data from the source file to the output file when no modification is required.
+ * Flushes the rewritten file as the fsync policy asks and renames it over the source, so the
+ * source holds either the old or the new tag at any time. Under fsync_group the file is only
+ * closed and handed over in pending_fname and pending_dest.
  * 
  * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
  * 
- * @returns Status: e_success if the copy is successful, e_failure if an error occurs.
+ * @returns Status: e_success if the source was replaced, e_failure if an error occurs.
+ */
+Status replace_source(Mp3EditInfo *mp3Edit);
+
+
+/**
+ * Returns the fsync policy named in MP3_FSYNC (none, data or full), fsync_data when it is not set.
+ * 
+ * @returns FsyncPolicy: The policy.
  */
-Status copy_same(Mp3EditInfo *mp3Edit);
+FsyncPolicy fsync_policy(void);
 
 
 /**
- * Copies the entire MP3 file from the source to the destination after modifications.
+ * Tries to apply the edits directly inside the source file's existing ID3 tag
+ * (the new frames must be built with build_frames() first). The new frame region is written back
+ * with one positioned write when it fits in the space taken by the old frames plus the tag padding.
  * 
  * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
+ * @param fits (int*): Set to 1 if the edit was applied in place, 0 if a full rewrite is needed.
  * 
- * @returns Status: e_success if the copy is successful, e_failure if an error occurs.
+ * @returns Status: e_success if the tag was inspected (and patched when it fits), e_failure if an error occurs.
  */
-Status file_copy(Mp3EditInfo *mp3Edit);
+Status edit_in_place(Mp3EditInfo *mp3Edit, int *fits);
 
 
 /**
- * Changes the specified MP3 frame (e.g., title, artist) based on the given arguments.
+ * Maps an edit option (e.g., "-t") to its ID3 frame identifier (e.g., "TIT2").
  * 
- * @param mp3Edit (Mp3EditInfo*): Structure containing MP3 file information.
- * @param str (char[]): The frame type (e.g., "TIT2" for title).
- * @param frame (char[]): Argument for the frame (e.g., "-t" for title).
- * @param flag (int*): A flag to indicate if the change was successful.
+ * @param option (char*): The edit option passed on the command line.
+ * 
+ * @returns const char*: The frame identifier, or NULL if the option is unknown.
+ */
+const char *get_frame_id(char *option);
+
+
+/**
+ * Maps an edit option (e.g., "-t") to the label used when reporting the change (e.g., "TITLE").
+ * 
+ * @param option (char*): The edit option passed on the command line.
+ * 
+ * @returns const char*: The label, or NULL if the option is unknown.
+ */
+const char *get_frame_label(char *option);
+
+
+/**
+ * Maps an ID3 frame identifier (e.g., "TIT2") to its edit option (e.g., "-t").
+ * 
+ * @param frame_id (const char*): The frame identifier.
  * 
- * @returns Status: e_success if the change is successful, e_failure if an error occurs.
+ * @returns char*: The edit option, or NULL if the frame can't be edited.
  */
-Status do_change(Mp3EditInfo *mp3Edit, char str[], char frame[], int *flag);
+char *get_frame_option(const char *frame_id);
 
 
 /**
@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "types.h"
+#include "mp3_format.h"
+#include "mp3_text.h"
+
+/**
+ * Finds a --format=text|ndjson|csv|tsv argument and removes it from the argument list.
+ * 
+ * Parameters:
+ *   argc (int*): Number of command-line arguments, lowered when the option is removed.
+ *   argv (char*[]): Command-line arguments.
+ *   format (OutputFormat*): Set to the format given, format_text when there is none.
+ * 
+ * Returns:
+ *   Status: e_success if the format is known or not given, e_failure otherwise.
+ */
+Status parse_format_option(int *argc, char *argv[], OutputFormat *format)
+{
+    static const struct
+    {
+        const char *name;
+        OutputFormat format;
+    } formats[] =
+    {
+        { "text", format_text },
+        { "ndjson", format_ndjson },
+        { "csv", format_csv },
+        { "tsv", format_tsv },
+    };
+
+    *format = format_text;
+    for (int i = 1; i < *argc; i++)
+    {
+        if (strncmp(argv[i], "--format=", 9) != 0)
+        {
+            continue;
+        }
+
+        int known = 0;
+        for (uint j = 0; j < sizeof(formats) / sizeof(formats[0]); j++)
+        {
+            if (strcmp(argv[i] + 9, formats[j].name) == 0)
+            {
+                *format = formats[j].format;
+                known = 1;
+            }
+        }
+        if (!known)
+        {
+            return e_failure;
+        }
+
+        // Drop the option so the other arguments keep their positions
+        memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char *));
+        (*argc)--;
+        i--;
+    }
+    return e_success;
+}
+
+/**
+ * Appends bytes to a record buffer, growing it when needed.
+ * 
+ * Parameters:
+ *   record (RecordBuffer*): The buffer.
+ *   data (const char*): The bytes.
+ *   len (size_t): Number of bytes.
+ * 
+ * Returns:
+ *   Status: e_success if the bytes were appended, e_failure if memory runs out.
+ */
+Status record_append(RecordBuffer *record, const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return e_success;
+    }
+    if (record->len + len > record->capacity)
+    {
+        size_t capacity = record->capacity ? record->capacity : 4096;
+        while (capacity < record->len + len)
+        {
+            capacity *= 2;
+        }
+        char *grown = realloc(record->data, capacity);
+        if (grown == NULL)
+        {
+            return e_failure;
+        }
+        record->data = grown;
+        record->capacity = capacity;
+    }
+
+    memcpy(record->data + record->len, data, len);
+    record->len += len;
+    return e_success;
+}
+
+/**
+ * Appends a JSON string. The text is UTF-8, only quotes, backslashes and control characters
+ * are escaped; each byte of a malformed sequence (e.g., in a file name) becomes U+FFFD, so
+ * the record is always valid JSON.
+ */
+static Status append_json(RecordBuffer *record, const char *value)
+{
+    if (record_append(record, "\"", 1) == e_failure)
+    {
+        return e_failure;
+    }
+
+    const unsigned char *text = (const unsigned char *)value;
+    while (*text != '\0')
+    {
+        // Copy the run of characters that need no escape in one go
+        size_t run = 0;
+        while (text[run] >= 0x20 && text[run] != '"' && text[run] != '\\')
+        {
+            run++;
+        }
+        if (run > 0)
+        {
+            size_t valid = text_valid_utf8((const char *)text, run);
+            if (record_append(record, (const char *)text, valid) == e_failure ||
+                (valid < run && record_append(record, "\xEF\xBF\xBD", 3) == e_failure))
+            {
+                return e_failure;
+            }
+            text += valid < run ? valid + 1 : run;
+            continue;
+        }
+        if (*text == '\0')
+        {
+            break;
+        }
+
+        char escape[8];
+        int len;
+        if (*text == '"' || *text == '\\')
+        {
+            len = sprintf(escape, "\\%c", *text);
+        }
+        else
+        {
+            len = sprintf(escape, "\\u%04x", *text);
+        }
+        if (record_append(record, escape, len) == e_failure)
+        {
+            return e_failure;
+        }
+        text++;
+    }
+
+    return record_append(record, "\"", 1);
+}
+
+/**
+ * Appends a CSV field, quoted when it holds a comma, a quote or a line break.
+ */
+static Status append_csv(RecordBuffer *record, const char *value)
+{
+    if (strpbrk(value, ",\"\r\n") == NULL)
+    {
+        return record_append(record, value, strlen(value));
+    }
+
+    if (record_append(record, "\"", 1) == e_failure)
+    {
+        return e_failure;
+    }
+    for (const char *quote; (quote = strchr(value, '"')) != NULL; value = quote + 1)
+    {
+        // Double every quote
+        if (record_append(record, value, quote - value + 1) == e_failure || record_append(record, "\"", 1) == e_failure)
+        {
+            return e_failure;
+        }
+    }
+    if (record_append(record, value, strlen(value)) == e_failure)
+    {
+        return e_failure;
+    }
+    return record_append(record, "\"", 1);
+}
+
+/**
+ * Appends a TSV field with tabs, line breaks and backslashes escaped.
+ */
+static Status append_tsv(RecordBuffer *record, const char *value)
+{
+    while (*value != '\0')
+    {
+        size_t run = strcspn(value, "\t\r\n\\");
+        if (record_append(record, value, run) == e_failure)
+        {
+            return e_failure;
+        }
+        value += run;
+        if (*value == '\0')
+        {
+            break;
+        }
+
+        char escape[2] = { '\\', *value == '\t' ? 't' : *value == '\r' ? 'r' : *value == '\n' ? 'n' : '\\' };
+        if (record_append(record, escape, 2) == e_failure)
+        {
+            return e_failure;
+        }
+        value++;
+    }
+    return e_success;
+}
+
+/**
+ * Appends one field to a record, escaped for the format. The first field of a JSON record
+ * opens the object. A NULL value is written as null in JSON and as an empty field otherwise.
+ * 
+ * Parameters:
+ *   record (RecordBuffer*): The buffer.
+ *   format (OutputFormat): The record format (not format_text).
+ *   name (const char*): Name of the field, used as the JSON key.
+ *   value (const char*): Value of the field, UTF-8 text, or NULL.
+ *   first (int): 1 for the first field of the record.
+ * 
+ * Returns:
+ *   Status: e_success if the field was appended, e_failure if memory runs out.
+ */
+Status record_field(RecordBuffer *record, OutputFormat format, const char *name, const char *value, int first)
+{
+    if (format == format_ndjson)
+    {
+        if (record_append(record, first ? "{" : ",", 1) == e_failure ||
+            append_json(record, name) == e_failure || record_append(record, ":", 1) == e_failure)
+        {
+            return e_failure;
+        }
+        return value != NULL ? append_json(record, value) : record_append(record, "null", 4);
+    }
+
+    if (!first && record_append(record, format == format_csv ? "," : "\t", 1) == e_failure)
+    {
+        return e_failure;
+    }
+    if (value == NULL)
+    {
+        return e_success;
+    }
+    return format == format_csv ? append_csv(record, value) : append_tsv(record, value);
+}
+
+/**
+ * Ends a record (closes the JSON object) and appends the line break.
+ * 
+ * Parameters:
+ *   record (RecordBuffer*): The buffer.
+ *   format (OutputFormat): The record format (not format_text).
+ * 
+ * Returns:
+ *   Status: e_success if the record was ended, e_failure if memory runs out.
+ */
+Status record_end(RecordBuffer *record, OutputFormat format)
+{
+    if (format == format_ndjson)
+    {
+        return record_append(record, "}\n", 2);
+    }
+    return format == format_csv ? record_append(record, "\r\n", 2) : record_append(record, "\n", 1);
+}
+
+/**
+ * Releases the memory of a record buffer.
+ * 
+ * Parameters:
+ *   record (RecordBuffer*): The buffer.
+ */
+void record_free(RecordBuffer *record)
+{
+    free(record->data);
+    record->data = NULL;
+    record->len = record->capacity = 0;
+}
+
+/**
+ * Prepares a writer. Pending stdio output is flushed first, so the order of the output is kept.
+ * 
+ * Parameters:
+ *   writer (OutputWriter*): The writer.
+ *   fd (int): Descriptor the bytes are written to.
+ */
+void writer_init(OutputWriter *writer, int fd)
+{
+    fflush(stdout);
+    writer->fd = fd;
+    writer->buffer.data = NULL;
+    writer->buffer.len = writer->buffer.capacity = 0;
+    pthread_mutex_init(&writer->lock, NULL);
+}
+
+/**
+ * Writes the pending bytes, the lock must be held.
+ */
+static Status flush_locked(OutputWriter *writer)
+{
+    size_t done = 0;
+    while (done < writer->buffer.len)
+    {
+        ssize_t count = write(writer->fd, writer->buffer.data + done, writer->buffer.len - done);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            writer->buffer.len = 0;
+            return e_failure;
+        }
+        done += count;
+    }
+    writer->buffer.len = 0;
+    return e_success;
+}
+
+/**
+ * Appends bytes to the writer. They are written in one large write once WRITER_FLUSH_SIZE bytes are pending.
+ * 
+ * Parameters:
+ *   writer (OutputWriter*): The writer.
+ *   data (const char*): The bytes.
+ *   len (size_t): Number of bytes.
+ * 
+ * Returns:
+ *   Status: e_success if the bytes were taken, e_failure if an error occurs.
+ */
+Status writer_write(OutputWriter *writer, const char *data, size_t len)
+{
+    pthread_mutex_lock(&writer->lock);
+    Status status = record_append(&writer->buffer, data, len);
+    if (status == e_success && writer->buffer.len >= WRITER_FLUSH_SIZE)
+    {
+        status = flush_locked(writer);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return status;
+}
+
+/**
+ * Writes all pending bytes.
+ * 
+ * Parameters:
+ *   writer (OutputWriter*): The writer.
+ * 
+ * Returns:
+ *   Status: e_success if everything was written, e_failure if an error occurs.
+ */
+Status writer_flush(OutputWriter *writer)
+{
+    pthread_mutex_lock(&writer->lock);
+    Status status = flush_locked(writer);
+    pthread_mutex_unlock(&writer->lock);
+    return status;
+}
+
+/**
+ * Writes all pending bytes and releases the writer.
+ * 
+ * Parameters:
+ *   writer (OutputWriter*): The writer.
+ * 
+ * Returns:
+ *   Status: e_success if everything was written, e_failure if an error occurs.
+ */
+Status writer_close(OutputWriter *writer)
+{
+    Status status = writer_flush(writer);
+    record_free(&writer->buffer);
+    pthread_mutex_destroy(&writer->lock);
+    return status;
+}
@@ -0,0 +1,139 @@
+#ifndef MP3_FORMAT_H
+#define MP3_FORMAT_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "types.h"
+
+// Buffered output is written once this many bytes are pending
+#define WRITER_FLUSH_SIZE (1 << 20)
+
+/**
+ * Enum to represent the layout of the printed details.
+ */
+typedef enum
+{
+    format_text,      // Labelled lines for people (the default)
+    format_ndjson,    // One JSON object per file
+    format_csv,       // Comma separated values with a header line (RFC 4180 quoting)
+    format_tsv        // Tab separated values with a header line (backslash escapes)
+} OutputFormat;
+
+// Structure to store a growing byte buffer that is reused from record to record
+typedef struct RecordBuffer
+{
+    char *data;            // The bytes, NULL before the first append
+    size_t len;            // Bytes in use
+    size_t capacity;       // Allocated bytes
+} RecordBuffer;
+
+// Structure to store an output descriptor with a large buffer in front of it.
+// Any thread may write to it, each write is appended as a whole.
+typedef struct OutputWriter
+{
+    int fd;                // Descriptor the bytes are written to
+    RecordBuffer buffer;   // Pending bytes
+    pthread_mutex_t lock;  // Protects buffer
+} OutputWriter;
+
+// Function Prototypes
+
+/**
+ * Finds a --format=text|ndjson|csv|tsv argument and removes it from the argument list.
+ * 
+ * @param argc (int*): Number of command-line arguments, lowered when the option is removed.
+ * @param argv (char*[]): Command-line arguments.
+ * @param format (OutputFormat*): Set to the format given, format_text when there is none.
+ * 
+ * @returns Status: e_success if the format is known or not given, e_failure otherwise.
+ */
+Status parse_format_option(int *argc, char *argv[], OutputFormat *format);
+
+
+/**
+ * Appends bytes to a record buffer, growing it when needed.
+ * 
+ * @param record (RecordBuffer*): The buffer.
+ * @param data (const char*): The bytes.
+ * @param len (size_t): Number of bytes.
+ * 
+ * @returns Status: e_success if the bytes were appended, e_failure if memory runs out.
+ */
+Status record_append(RecordBuffer *record, const char *data, size_t len);
+
+
+/**
+ * Appends one field to a record, escaped for the format. The first field of a JSON record
+ * opens the object. A NULL value is written as null in JSON and as an empty field otherwise.
+ * 
+ * @param record (RecordBuffer*): The buffer.
+ * @param format (OutputFormat): The record format (not format_text).
+ * @param name (const char*): Name of the field, used as the JSON key.
+ * @param value (const char*): Value of the field, UTF-8 text, or NULL.
+ * @param first (int): 1 for the first field of the record.
+ * 
+ * @returns Status: e_success if the field was appended, e_failure if memory runs out.
+ */
+Status record_field(RecordBuffer *record, OutputFormat format, const char *name, const char *value, int first);
+
+
+/**
+ * Ends a record (closes the JSON object) and appends the line break.
+ * 
+ * @param record (RecordBuffer*): The buffer.
+ * @param format (OutputFormat): The record format (not format_text).
+ * 
+ * @returns Status: e_success if the record was ended, e_failure if memory runs out.
+ */
+Status record_end(RecordBuffer *record, OutputFormat format);
+
+
+/**
+ * Releases the memory of a record buffer.
+ * 
+ * @param record (RecordBuffer*): The buffer.
+ */
+void record_free(RecordBuffer *record);
+
+
+/**
+ * Prepares a writer. Pending stdio output is flushed first, so the order of the output is kept.
+ * 
+ * @param writer (OutputWriter*): The writer.
+ * @param fd (int): Descriptor the bytes are written to.
+ */
+void writer_init(OutputWriter *writer, int fd);
+
+
+/**
+ * Appends bytes to the writer. They are written in one large write once WRITER_FLUSH_SIZE bytes are pending.
+ * 
+ * @param writer (OutputWriter*): The writer.
+ * @param data (const char*): The bytes.
+ * @param len (size_t): Number of bytes.
+ * 
+ * @returns Status: e_success if the bytes were taken, e_failure if an error occurs.
+ */
+Status writer_write(OutputWriter *writer, const char *data, size_t len);
+
+
+/**
+ * Writes all pending bytes.
+ * 
+ * @param writer (OutputWriter*): The writer.
+ * 
+ * @returns Status: e_success if everything was written, e_failure if an error occurs.
+ */
+Status writer_flush(OutputWriter *writer);
+
+
+/**
+ * Writes all pending bytes and releases the writer.
+ * 
+ * @param writer (OutputWriter*): The writer.
+ * 
+ * @returns Status: e_success if everything was written, e_failure if an error occurs.
+ */
+Status writer_close(OutputWriter *writer);
+
+#endif
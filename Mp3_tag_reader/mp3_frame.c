@@ -0,0 +1,725 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "mp3_frame.h"
+#include "mp3_unsync.h"
+
+// ID3v2.2 frame identifiers with their ID3v2.3 names, sorted by the ID3v2.2 name
+static const struct
+{
+    char v22[4];   // ID3v2.2 identifier (e.g., "TT2")
+    char v23[5];   // ID3v2.3 identifier (e.g., "TIT2")
+} v22_frames[] =
+{
+    { "BUF", "RBUF" }, { "CNT", "PCNT" }, { "COM", "COMM" }, { "CRA", "AENC" }, { "ETC", "ETCO" },
+    { "EQU", "EQUA" }, { "GEO", "GEOB" }, { "IPL", "IPLS" }, { "LNK", "LINK" }, { "MCI", "MCDI" },
+    { "MLL", "MLLT" }, { "PIC", "APIC" }, { "POP", "POPM" }, { "REV", "RVRB" }, { "RVA", "RVAD" },
+    { "SLT", "SYLT" }, { "STC", "SYTC" }, { "TAL", "TALB" }, { "TBP", "TBPM" }, { "TCM", "TCOM" },
+    { "TCO", "TCON" }, { "TCR", "TCOP" }, { "TDA", "TDAT" }, { "TDY", "TDLY" }, { "TEN", "TENC" },
+    { "TFT", "TFLT" }, { "TIM", "TIME" }, { "TKE", "TKEY" }, { "TLA", "TLAN" }, { "TLE", "TLEN" },
+    { "TMT", "TMED" }, { "TOA", "TOPE" }, { "TOF", "TOFN" }, { "TOL", "TOLY" }, { "TOR", "TORY" },
+    { "TOT", "TOAL" }, { "TP1", "TPE1" }, { "TP2", "TPE2" }, { "TP3", "TPE3" }, { "TP4", "TPE4" },
+    { "TPA", "TPOS" }, { "TPB", "TPUB" }, { "TRC", "TSRC" }, { "TRD", "TRDA" }, { "TRK", "TRCK" },
+    { "TSI", "TSIZ" }, { "TSS", "TSSE" }, { "TT1", "TIT1" }, { "TT2", "TIT2" }, { "TT3", "TIT3" },
+    { "TXT", "TEXT" }, { "TXX", "TXXX" }, { "TYE", "TYER" }, { "UFI", "UFID" }, { "ULT", "USLT" },
+    { "WAF", "WOAF" }, { "WAR", "WOAR" }, { "WAS", "WOAS" }, { "WCM", "WCOM" }, { "WCP", "WCOP" },
+    { "WPB", "WPUB" }, { "WXX", "WXXX" },
+};
+
+/**
+ * Tells if the first n bytes are a valid frame identifier (capital letters and digits only).
+ */
+static inline int valid_frame_id(const unsigned char *id, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (!((id[i] >= 'A' && id[i] <= 'Z') || (id[i] >= '0' && id[i] <= '9')))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Decodes an ID3v2.2 frame header: 3 byte identifier, 3 byte big-endian size and no flags.
+ * The identifier is given its ID3v2.3 name, unknown identifiers keep their 3 characters.
+ */
+static Status read_header_v22(const unsigned char *header, uint room, FrameEntry *entry)
+{
+    uint size = (uint)header[3] << 16 | (uint)header[4] << 8 | header[5];
+    if (!valid_frame_id(header, 3) || size > room)
+    {
+        return e_failure;
+    }
+
+    // Binary search of the sorted name table
+    int low = 0, high = sizeof(v22_frames) / sizeof(v22_frames[0]) - 1;
+    memcpy(entry->id, header, 3);
+    entry->id[3] = '\0';
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        int cmp = memcmp(header, v22_frames[mid].v22, 3);
+        if (cmp == 0)
+        {
+            memcpy(entry->id, v22_frames[mid].v23, 5);
+            break;
+        }
+        if (cmp < 0)
+        {
+            high = mid - 1;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    entry->flags = 0;
+    entry->data = FRAME_HEADER_SIZE_V22;
+    entry->size = size;
+    return e_success;
+}
+
+/**
+ * Decodes an ID3v2.3 frame header: 4 byte identifier, 4 byte big-endian size and 2 flag bytes.
+ * Compressed, encrypted and grouped frames carry extra bytes before their data.
+ */
+static Status read_header_v23(const unsigned char *header, uint room, FrameEntry *entry)
+{
+    uint size = be32_to_int(header + 4);
+    if (!valid_frame_id(header, 4) || size > room)
+    {
+        return e_failure;
+    }
+
+    memcpy(entry->id, header, 4);
+    entry->id[4] = '\0';
+    entry->flags = (unsigned short)(header[8] << 8 | header[9]);
+
+    uint extra = 0;
+    if (entry->flags & 0x00E0)
+    {
+        extra = (entry->flags & 0x0080 ? 4 : 0) + (entry->flags & 0x0040 ? 1 : 0) + (entry->flags & 0x0020 ? 1 : 0);
+        if (extra > size)
+        {
+            return e_failure;
+        }
+    }
+    entry->data = FRAME_HEADER_SIZE + extra;
+    entry->size = size - extra;
+    return e_success;
+}
+
+/**
+ * Decodes an ID3v2.4 frame header: 4 byte identifier, 4 byte syncsafe size and 2 flag bytes.
+ * Grouped and encrypted frames and frames with a data length indicator carry extra bytes
+ * before their data. TDRC, the recording time that replaced TYER, is indexed as TYER.
+ */
+static Status read_header_v24(const unsigned char *header, uint room, FrameEntry *entry)
+{
+    uint size = syncsafe_to_int(header + 4);
+    if (!valid_frame_id(header, 4) || size > room)
+    {
+        return e_failure;
+    }
+
+    memcpy(entry->id, memcmp(header, "TDRC", 4) == 0 ? "TYER" : (const char *)header, 4);
+    entry->id[4] = '\0';
+    entry->flags = (unsigned short)(header[8] << 8 | header[9]);
+
+    uint extra = 0;
+    if (entry->flags & 0x0045)
+    {
+        extra = (entry->flags & 0x0040 ? 1 : 0) + (entry->flags & 0x0004 ? 1 : 0) + (entry->flags & 0x0001 ? 4 : 0);
+        if (extra > size)
+        {
+            return e_failure;
+        }
+    }
+    entry->data = FRAME_HEADER_SIZE + extra;
+    entry->size = size - extra;
+    return e_success;
+}
+
+/**
+ * Writes an ID3v2.2 frame header, giving the ID3v2.3 identifier its ID3v2.2 name.
+ */
+static uint write_header_v22(unsigned char *dest, const char *id, uint size, const unsigned char *old_header)
+{
+    // ID3v2.2 frame headers have no flags to keep
+    (void)old_header;
+    memcpy(dest, id, 3);
+    for (uint i = 0; i < sizeof(v22_frames) / sizeof(v22_frames[0]); i++)
+    {
+        if (strncmp(id, v22_frames[i].v23, 4) == 0)
+        {
+            memcpy(dest, v22_frames[i].v22, 3);
+            break;
+        }
+    }
+    dest[3] = size >> 16;
+    dest[4] = size >> 8;
+    dest[5] = size;
+    return FRAME_HEADER_SIZE_V22;
+}
+
+/**
+ * Writes an ID3v2.3 frame header. The status flags of the old frame are kept, the format
+ * flags are cleared since the new data is written plain.
+ */
+static uint write_header_v23(unsigned char *dest, const char *id, uint size, const unsigned char *old_header)
+{
+    memcpy(dest, id, 4);
+    int_to_be32(dest + 4, size);
+    dest[8] = old_header != NULL ? old_header[8] : 0;
+    dest[9] = 0;
+    return FRAME_HEADER_SIZE;
+}
+
+/**
+ * Writes an ID3v2.4 frame header with a syncsafe size, TYER is written as TDRC.
+ * The status flags of the old frame are kept, the format flags are cleared.
+ */
+static uint write_header_v24(unsigned char *dest, const char *id, uint size, const unsigned char *old_header)
+{
+    memcpy(dest, strncmp(id, "TYER", 4) == 0 ? "TDRC" : id, 4);
+    int_to_syncsafe(dest + 4, size);
+    dest[8] = old_header != NULL ? old_header[8] : 0;
+    dest[9] = 0;
+    return FRAME_HEADER_SIZE;
+}
+
+/**
+ * Gives the size of an ID3v2.3 extended header, whose size field doesn't count itself.
+ */
+static uint extended_size_v23(const unsigned char *ext)
+{
+    return 4 + be32_to_int(ext);
+}
+
+/**
+ * Gives the size of an ID3v2.4 extended header, whose syncsafe size field counts itself.
+ */
+static uint extended_size_v24(const unsigned char *ext)
+{
+    return syncsafe_to_int(ext);
+}
+
+/**
+ * Undoes the unsynchronisation of a whole ID3v2.2 or v2.3 frame region, extended header included.
+ */
+static uint resync_whole(const unsigned char *header, unsigned char *tag, uint tag_size)
+{
+    return header[5] & ID3_UNSYNC_FLAG ? unsync_decode(tag, tag_size) : tag_size;
+}
+
+/**
+ * Copies an ID3v2.2 or v2.3 frame region, unsynchronising all of it when the header says so.
+ */
+static uint unsync_whole(const unsigned char *header, unsigned char *dest, const unsigned char *tag, uint size)
+{
+    if (header[5] & ID3_UNSYNC_FLAG)
+    {
+        return unsync_encode(dest, tag, size);
+    }
+    memcpy(dest, tag, size);
+    return size;
+}
+
+/**
+ * Gives the size of the extended header of an ID3v2.4 frame region, clamped to the region.
+ */
+static uint extended_start_v24(const unsigned char *header, const unsigned char *tag, uint tag_size)
+{
+    if (!(header[5] & ID3_EXTENDED_FLAG) || tag_size < 4)
+    {
+        return 0;
+    }
+    uint start = extended_size_v24(tag);
+    return start < tag_size ? start : tag_size;
+}
+
+/**
+ * Undoes the unsynchronisation of ID3v2.4 frames in place. Frame headers are never
+ * unsynchronised, only the data after them: each flagged frame is decoded, given its new
+ * size and its flag is cleared, and the frames after it are moved down.
+ */
+static uint resync_v24(const unsigned char *header, unsigned char *tag, uint tag_size)
+{
+    int all = header[5] & ID3_UNSYNC_FLAG;
+    uint in = extended_start_v24(header, tag, tag_size);
+    uint out = in;
+
+    while (in + FRAME_HEADER_SIZE <= tag_size && tag[in] != 0)
+    {
+        uint size = syncsafe_to_int(tag + in + 4);
+        if (size > tag_size - in - FRAME_HEADER_SIZE)
+        {
+            break;
+        }
+        if (out != in)
+        {
+            memmove(tag + out, tag + in, FRAME_HEADER_SIZE + size);
+        }
+        in += FRAME_HEADER_SIZE + size;
+        if (all || (tag[out + 9] & FRAME_UNSYNC_FLAG))
+        {
+            size = unsync_decode(tag + out + FRAME_HEADER_SIZE, size);
+            int_to_syncsafe(tag + out + 4, size);
+            tag[out + 9] &= ~FRAME_UNSYNC_FLAG;
+        }
+        out += FRAME_HEADER_SIZE + size;
+    }
+
+    // The padding follows the last frame
+    if (out != in)
+    {
+        memmove(tag + out, tag + in, tag_size - in);
+    }
+    return tag_size - (in - out);
+}
+
+/**
+ * Copies ID3v2.4 frames, unsynchronising the data of each one when the header says so.
+ * Every frame written that way gets its own flag set as well.
+ */
+static uint unsync_v24(const unsigned char *header, unsigned char *dest, const unsigned char *tag, uint size)
+{
+    if (!(header[5] & ID3_UNSYNC_FLAG))
+    {
+        memcpy(dest, tag, size);
+        return size;
+    }
+
+    uint in = extended_start_v24(header, tag, size);
+    uint out = in;
+    memcpy(dest, tag, in);
+    while (in + FRAME_HEADER_SIZE <= size && tag[in] != 0)
+    {
+        uint length = syncsafe_to_int(tag + in + 4);
+        if (length > size - in - FRAME_HEADER_SIZE)
+        {
+            break;
+        }
+        memcpy(dest + out, tag + in, FRAME_HEADER_SIZE);
+        length = unsync_encode(dest + out + FRAME_HEADER_SIZE, tag + in + FRAME_HEADER_SIZE, length);
+        int_to_syncsafe(dest + out + 4, length);
+        dest[out + 9] |= FRAME_UNSYNC_FLAG;
+        in += FRAME_HEADER_SIZE + syncsafe_to_int(tag + in + 4);
+        out += FRAME_HEADER_SIZE + length;
+    }
+    memcpy(dest + out, tag + in, size - in);
+    return out + size - in;
+}
+
+/**
+ * Walks the frames of a tag with the header decoder of one version. Each version has its own
+ * copy of the walk, so the frame loop never branches on the version.
+ * 
+ * Parameters:
+ *   index (FrameIndex*): The table to be filled.
+ *   tag (const unsigned char*): The frame region of the tag.
+ *   tag_size (uint): Size of the frame region.
+ *   start (uint): Offset of the first frame.
+ *   header_size (uint): Size of a frame header.
+ *   read_header (function): Decoder of one frame header.
+ * 
+ * Returns:
+ *   Status: e_success if the table is built, e_failure if the tag is malformed.
+ */
+static inline Status walk_frames(FrameIndex *index, const unsigned char *tag, uint tag_size, uint start, uint header_size,
+                                 Status (*read_header)(const unsigned char *, uint, FrameEntry *))
+{
+    uint pos = start;
+    index->count = 0;
+    index->start = start;
+
+    while (pos + header_size <= tag_size && tag[pos] != 0)
+    {
+        // Grow the table when it is full
+        if (index->count == index->capacity)
+        {
+            uint capacity = index->capacity ? index->capacity * 2 : 16;
+            FrameEntry *frames = realloc(index->frames, capacity * sizeof(FrameEntry));
+            if (frames == NULL)
+            {
+                return e_failure;
+            }
+            index->frames = frames;
+            index->capacity = capacity;
+        }
+
+        FrameEntry *entry = &index->frames[index->count];
+        if (read_header(tag + pos, tag_size - pos - header_size, entry) == e_failure)
+        {
+            return e_failure;
+        }
+        entry->offset = pos;
+        pos += entry->data + entry->size;
+        entry->data += entry->offset;
+        index->count++;
+    }
+
+    index->used = pos;
+    index->padding = tag_size - pos;
+    return e_success;
+}
+
+/**
+ * Walks the frames of an ID3v2.2 tag.
+ */
+static Status index_frames_v22(FrameIndex *index, const unsigned char *tag, uint tag_size, uint start)
+{
+    return walk_frames(index, tag, tag_size, start, FRAME_HEADER_SIZE_V22, read_header_v22);
+}
+
+/**
+ * Walks the frames of an ID3v2.3 tag.
+ */
+static Status index_frames_v23(FrameIndex *index, const unsigned char *tag, uint tag_size, uint start)
+{
+    return walk_frames(index, tag, tag_size, start, FRAME_HEADER_SIZE, read_header_v23);
+}
+
+/**
+ * Walks the frames of an ID3v2.4 tag.
+ */
+static Status index_frames_v24(FrameIndex *index, const unsigned char *tag, uint tag_size, uint start)
+{
+    return walk_frames(index, tag, tag_size, start, FRAME_HEADER_SIZE, read_header_v24);
+}
+
+// Frame parsers by major version, starting with ID3v2.2
+static const FrameParser frame_parsers[] =
+{
+    { 2, FRAME_HEADER_SIZE_V22, index_frames_v22, read_header_v22, write_header_v22, NULL, resync_whole, unsync_whole },
+    { 3, FRAME_HEADER_SIZE, index_frames_v23, read_header_v23, write_header_v23, extended_size_v23, resync_whole, unsync_whole },
+    { 4, FRAME_HEADER_SIZE, index_frames_v24, read_header_v24, write_header_v24, extended_size_v24, resync_v24, unsync_v24 },
+};
+
+/**
+ * Selects the frame parser of a tag from the major version in its header.
+ * Compressed ID3v2.2 tags (flag 0x40) have no defined compression, so they aren't supported.
+ * 
+ * Parameters:
+ *   header (const unsigned char*): The 10 byte tag header.
+ * 
+ * Returns:
+ *   const FrameParser*: The parser of ID3v2.2, v2.3 or v2.4, or NULL if the version isn't supported.
+ */
+const FrameParser *get_frame_parser(const unsigned char *header)
+{
+    if (header[3] < 2 || header[3] > 4 || header[4] == 0xFF || (header[3] == 2 && (header[5] & 0x40)))
+    {
+        return NULL;
+    }
+    return &frame_parsers[header[3] - 2];
+}
+
+/**
+ * Gives the offset of the first frame: the size of the extended header, if the tag has one.
+ * 
+ * Parameters:
+ *   parser (const FrameParser*): The parser of the tag.
+ *   header (const unsigned char*): The 10 byte tag header.
+ *   tag (const unsigned char*): The start of the frame region.
+ *   length (uint): Number of bytes of the frame region in memory.
+ *   start (uint*): Set to the offset of the first frame.
+ * 
+ * Returns:
+ *   Status: e_success if the offset is known, e_failure if the extended header is malformed or not in memory.
+ */
+Status frame_region_start(const FrameParser *parser, const unsigned char *header, const unsigned char *tag, uint length, uint *start)
+{
+    *start = 0;
+    if (parser->extended_size == NULL || !(header[5] & ID3_EXTENDED_FLAG))
+    {
+        return e_success;
+    }
+    if (length < 4)
+    {
+        return e_failure;
+    }
+    *start = parser->extended_size(tag);
+    return *start >= 4 && *start <= length ? e_success : e_failure;
+}
+
+/**
+ * Walks all frames of a tag once and records their identifier, offset, size and flags.
+ * The parser of the tag version is selected once; the walk stops at the first zero byte
+ * (start of the padding) or at the end of the tag.
+ * 
+ * Parameters:
+ *   index (FrameIndex*): The table to be filled (zeroed before its first use).
+ *   header (const unsigned char*): The 10 byte tag header.
+ *   tag (const unsigned char*): The frame region of the tag.
+ *   tag_size (uint): Size of the frame region.
+ * 
+ * Returns:
+ *   Status: e_success if the table is built, e_failure if the tag is malformed or its version isn't supported.
+ */
+Status build_frame_index(FrameIndex *index, const unsigned char *header, const unsigned char *tag, uint tag_size)
+{
+    const FrameParser *parser = get_frame_parser(header);
+    uint start;
+    index->count = 0;
+    if (parser == NULL || frame_region_start(parser, header, tag, tag_size, &start) == e_failure)
+    {
+        return e_failure;
+    }
+    index->parser = parser;
+    return parser->index_frames(index, tag, tag_size, start);
+}
+
+/**
+ * Undoes the unsynchronisation of a tag in place with the parser of its version,
+ * then clears the unsynchronisation flag of the header.
+ * 
+ * Parameters:
+ *   header (unsigned char*): The 10 byte tag header.
+ *   tag (unsigned char*): The frame region of the tag.
+ *   tag_size (uint): Size of the frame region.
+ * 
+ * Returns:
+ *   uint: Size of the frame region once decoded.
+ */
+uint resync_tag(unsigned char *header, unsigned char *tag, uint tag_size)
+{
+    const FrameParser *parser = get_frame_parser(header);
+    if (parser == NULL || tag == NULL)
+    {
+        return tag_size;
+    }
+    tag_size = parser->resync(header, tag, tag_size);
+    header[5] &= ~ID3_UNSYNC_FLAG;
+    return tag_size;
+}
+
+/**
+ * Tells whether resync_tag() would change a tag, walking the ID3v2.4 frames the way
+ * resync_v24() does.
+ * 
+ * Parameters:
+ *   header (const unsigned char*): The 10 byte tag header.
+ *   tag (const unsigned char*): The frame region of the tag.
+ *   tag_size (uint): Size of the frame region.
+ * 
+ * Returns:
+ *   int: 1 if the tag is unsynchronised, 0 otherwise.
+ */
+int tag_is_unsynced(const unsigned char *header, const unsigned char *tag, uint tag_size)
+{
+    if (header[5] & ID3_UNSYNC_FLAG)
+    {
+        return 1;
+    }
+    if (header[3] != 4)
+    {
+        return 0;
+    }
+
+    uint pos = extended_start_v24(header, tag, tag_size);
+    while (pos + FRAME_HEADER_SIZE <= tag_size && tag[pos] != 0)
+    {
+        uint size = syncsafe_to_int(tag + pos + 4);
+        if (size > tag_size - pos - FRAME_HEADER_SIZE)
+        {
+            break;
+        }
+        if (tag[pos + 9] & FRAME_UNSYNC_FLAG)
+        {
+            return 1;
+        }
+        pos += FRAME_HEADER_SIZE + size;
+    }
+    return 0;
+}
+
+/**
+ * Copies the frames of a tag, unsynchronised by the parser of its version when the
+ * tag header has its unsynchronisation flag set.
+ * 
+ * Parameters:
+ *   header (const unsigned char*): The 10 byte tag header.
+ *   dest (unsigned char*): Where the frames are written, 2 * size bytes at most.
+ *   tag (const unsigned char*): The frames, without padding.
+ *   size (uint): Size of the frames.
+ * 
+ * Returns:
+ *   uint: Number of bytes written.
+ */
+uint unsync_tag(const unsigned char *header, unsigned char *dest, const unsigned char *tag, uint size)
+{
+    const FrameParser *parser = get_frame_parser(header);
+    if (parser == NULL)
+    {
+        memcpy(dest, tag, size);
+        return size;
+    }
+    return parser->unsync(header, dest, tag, size);
+}
+
+/**
+ * Looks up a frame in the table.
+ * 
+ * Parameters:
+ *   index (const FrameIndex*): The frame table.
+ *   id (const char*): Frame identifier (e.g., "TIT2").
+ * 
+ * Returns:
+ *   const FrameEntry*: The first frame with that identifier, or NULL if there is none.
+ */
+const FrameEntry *find_frame(const FrameIndex *index, const char *id)
+{
+    for (uint i = 0; i < index->count; i++)
+    {
+        if (strncmp(index->frames[i].id, id, 4) == 0)
+        {
+            return &index->frames[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Releases the memory of the frame table.
+ * 
+ * Parameters:
+ *   index (FrameIndex*): The frame table.
+ */
+void free_frame_index(FrameIndex *index)
+{
+    free(index->frames);
+    index->frames = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+/**
+ * Tells if a frame holds binary data (APIC, GEOB or PRIV) whose payload can be skipped.
+ * 
+ * Parameters:
+ *   id (const char*): Frame identifier (4 characters).
+ * 
+ * Returns:
+ *   int: 1 for a binary frame, 0 otherwise.
+ */
+int is_binary_frame(const char *id)
+{
+    return strncmp(id, "APIC", 4) == 0 || strncmp(id, "GEOB", 4) == 0 || strncmp(id, "PRIV", 4) == 0;
+}
+
+/**
+ * Writes a stub for a binary frame: its header with FRAME_STUB_FLAG set and the stub size,
+ * the real payload size and the first bytes of the payload. The format flags are cleared, so
+ * the stub data starts right after its header. dest may overlap the frame.
+ * 
+ * Parameters:
+ *   parser (const FrameParser*): The parser of the tag (ID3v2.3 or v2.4).
+ *   dest (unsigned char*): Where the stub is written, 14 + FRAME_STUB_PREFIX bytes at most.
+ *   entry (const FrameEntry*): The frame, its offset and data relative to tag.
+ *   tag (const unsigned char*): Holds the frame header and at least FRAME_STUB_PREFIX bytes of its data (all of it if smaller).
+ * 
+ * Returns:
+ *   uint: Number of bytes written.
+ */
+uint make_stub_frame(const FrameParser *parser, unsigned char *dest, const FrameEntry *entry, const unsigned char *tag)
+{
+    unsigned char stub[FRAME_HEADER_SIZE + 4 + FRAME_STUB_PREFIX];
+    uint prefix_len = entry->size < FRAME_STUB_PREFIX ? entry->size : FRAME_STUB_PREFIX;
+
+    parser->write_header(stub, entry->id, 4 + prefix_len, tag + entry->offset);
+    stub[9] |= FRAME_STUB_FLAG;
+    int_to_be32(stub + FRAME_HEADER_SIZE, entry->size);
+    memcpy(stub + FRAME_HEADER_SIZE + 4, tag + entry->data, prefix_len);
+
+    memcpy(dest, stub, FRAME_HEADER_SIZE + 4 + prefix_len);
+    return FRAME_HEADER_SIZE + 4 + prefix_len;
+}
+
+/**
+ * Gives the payload of a frame, or the kept prefix of a stub.
+ * 
+ * Parameters:
+ *   entry (const FrameEntry*): The frame.
+ *   tag (const unsigned char*): The tag buffer the frame table was built from.
+ *   data (const unsigned char**): Set to the first payload byte in memory.
+ *   length (uint*): Set to the number of payload bytes in memory.
+ * 
+ * Returns:
+ *   uint: The real payload size of the frame.
+ */
+uint frame_payload(const FrameEntry *entry, const unsigned char *tag, const unsigned char **data, uint *length)
+{
+    const unsigned char *payload = tag + entry->data;
+    if ((entry->flags & FRAME_STUB_FLAG) && is_binary_frame(entry->id) && entry->size >= 4)
+    {
+        *data = payload + 4;
+        *length = entry->size - 4;
+        return be32_to_int(payload);
+    }
+
+    *data = payload;
+    *length = entry->size;
+    return entry->size;
+}
+
+/**
+ * Decodes a 4 byte syncsafe integer, where only the low 7 bits of each byte are used.
+ * 
+ * Parameters:
+ *   ptr (const unsigned char*): Pointer to the 4 encoded bytes.
+ * 
+ * Returns:
+ *   uint: The decoded value.
+ */
+uint syncsafe_to_int(const unsigned char *ptr)
+{
+    return (uint)(ptr[0] & 0x7f) << 21 | (uint)(ptr[1] & 0x7f) << 14 | (uint)(ptr[2] & 0x7f) << 7 | (ptr[3] & 0x7f);
+}
+
+/**
+ * Encodes a value as a 4 byte syncsafe integer.
+ * 
+ * Parameters:
+ *   ptr (unsigned char*): Pointer to the 4 bytes to be written.
+ *   value (uint): The value to be encoded (less than 2^28).
+ */
+void int_to_syncsafe(unsigned char *ptr, uint value)
+{
+    ptr[0] = (value >> 21) & 0x7f;
+    ptr[1] = (value >> 14) & 0x7f;
+    ptr[2] = (value >> 7) & 0x7f;
+    ptr[3] = value & 0x7f;
+}
+
+/**
+ * Decodes a 4 byte big-endian integer.
+ * 
+ * Parameters:
+ *   ptr (const unsigned char*): Pointer to the 4 encoded bytes.
+ * 
+ * Returns:
+ *   uint: The decoded value.
+ */
+uint be32_to_int(const unsigned char *ptr)
+{
+    return (uint)ptr[0] << 24 | (uint)ptr[1] << 16 | (uint)ptr[2] << 8 | ptr[3];
+}
+
+/**
+ * Encodes a value as a 4 byte big-endian integer.
+ * 
+ * Parameters:
+ *   ptr (unsigned char*): Pointer to the 4 bytes to be written.
+ *   value (uint): The value to be encoded.
+ */
+void int_to_be32(unsigned char *ptr, uint value)
+{
+    ptr[0] = value >> 24;
+    ptr[1] = value >> 16;
+    ptr[2] = value >> 8;
+    ptr[3] = value;
+}
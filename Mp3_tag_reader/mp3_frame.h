@@ -0,0 +1,258 @@
+#ifndef MP3_FRAME_H
+#define MP3_FRAME_H
+
+#include "types.h"
+
+// Size of the ID3v2 tag header and of an ID3v2.3/v2.4 frame header
+#define ID3_HEADER_SIZE 10
+#define FRAME_HEADER_SIZE 10
+
+// Size of an ID3v2.2 frame header: 3 byte identifier and 3 byte size, no flags
+#define FRAME_HEADER_SIZE_V22 6
+
+// Most bytes a frame header can be followed by before the frame data
+// (decompressed size or data length, encryption method and group)
+#define FRAME_EXTRA_MAX 6
+
+// Tag header flags of ID3v2.3 and ID3v2.4
+#define ID3_UNSYNC_FLAG 0x80     // The tag (ID3v2.2, v2.3) or every frame (ID3v2.4) is unsynchronised
+#define ID3_EXTENDED_FLAG 0x40   // An extended header comes before the frames
+#define ID3_FOOTER_FLAG 0x10     // ID3v2.4 only: a 10 byte footer follows the padding
+
+// ID3v2.4 frame flag (second flag byte) of a frame whose data is unsynchronised
+#define FRAME_UNSYNC_FLAG 0x0002
+
+// Binary frames (pictures, objects, private data) are kept in memory as a stub when their
+// payload is skipped: the header with this flag set in a bit of the second flag byte that
+// neither ID3v2.3 nor ID3v2.4 uses, then the real payload size and the first
+// FRAME_STUB_PREFIX payload bytes. Stubs never leave the process except through the tag cache.
+#define FRAME_STUB_FLAG 0x0010
+#define FRAME_STUB_PREFIX 64
+
+// Structure to store the position of one frame inside the tag buffer
+typedef struct FrameEntry
+{
+    char id[5];            // Frame identifier with its ID3v2.3 name (e.g., "TIT2" for a v2.2 "TT2"), null terminated
+    unsigned short flags;  // The 2 frame flag bytes (0 for ID3v2.2)
+    uint offset;           // Offset of the frame header inside the tag buffer
+    uint data;             // Offset of the frame data, after the header and its extra bytes
+    uint size;             // Size of the frame data (excluding the frame header and its extra bytes)
+} FrameEntry;
+
+struct FrameIndex;
+
+// Structure to describe the frame layout of one ID3v2 version, selected once per tag
+typedef struct FrameParser
+{
+    unsigned char version;  // Major version of the tag (2, 3 or 4)
+    uint header_size;       // Size of a frame header
+
+    // Walks the frames of a tag, starting after its extended header
+    Status (*index_frames)(struct FrameIndex *index, const unsigned char *tag, uint tag_size, uint start);
+
+    // Decodes one frame header; data is set relative to the header and offset is left alone.
+    // Fails when the identifier is invalid or the frame is larger than room bytes.
+    Status (*read_header)(const unsigned char *header, uint room, FrameEntry *entry);
+
+    // Writes a frame header for an ID3v2.3 identifier, keeping the status flags of old_header (may be NULL)
+    uint (*write_header)(unsigned char *dest, const char *id, uint size, const unsigned char *old_header);
+
+    // Size of the extended header starting at ext, which must have 4 bytes
+    uint (*extended_size)(const unsigned char *ext);
+
+    // Undoes the unsynchronisation of the frame region in place, returns its new size
+    uint (*resync)(const unsigned char *header, unsigned char *tag, uint tag_size);
+
+    // Copies frames to dest, unsynchronised when the tag header says so; returns the size written
+    uint (*unsync)(const unsigned char *header, unsigned char *dest, const unsigned char *tag, uint size);
+} FrameParser;
+
+// Structure to store the table of all frames of a tag, built in one pass
+typedef struct FrameIndex
+{
+    FrameEntry *frames;    // Frames in the order they appear in the tag
+    uint count;            // Number of frames in the table
+    uint capacity;         // Allocated entries, kept when the table is rebuilt
+    uint start;            // Bytes taken by the extended header (offset of the first frame)
+    uint used;             // Bytes taken by the frames (offset of the padding)
+    uint padding;          // Padding bytes after the last frame
+    const FrameParser *parser;  // Frame layout of the tag the table was built from
+} FrameIndex;
+
+// Function Prototypes
+
+/**
+ * Selects the frame parser of a tag from its header.
+ * 
+ * @param header (const unsigned char*): The 10 byte tag header.
+ * 
+ * @returns const FrameParser*: The parser of ID3v2.2, v2.3 or v2.4, or NULL if the version isn't supported.
+ */
+const FrameParser *get_frame_parser(const unsigned char *header);
+
+
+/**
+ * Gives the offset of the first frame: the size of the extended header, if the tag has one.
+ * 
+ * @param parser (const FrameParser*): The parser of the tag.
+ * @param header (const unsigned char*): The 10 byte tag header.
+ * @param tag (const unsigned char*): The start of the frame region.
+ * @param length (uint): Number of bytes of the frame region in memory.
+ * @param start (uint*): Set to the offset of the first frame.
+ * 
+ * @returns Status: e_success if the offset is known, e_failure if the extended header is malformed or not in memory.
+ */
+Status frame_region_start(const FrameParser *parser, const unsigned char *header, const unsigned char *tag, uint length, uint *start);
+
+
+/**
+ * Walks all frames of a tag once and records their identifier, offset, size and flags.
+ * The parser of the tag version is selected once, before the walk.
+ * The table must be zeroed before its first use; its memory is reused when rebuilt.
+ * 
+ * @param index (FrameIndex*): The table to be filled.
+ * @param header (const unsigned char*): The 10 byte tag header.
+ * @param tag (const unsigned char*): The frame region of the tag (after the 10 byte header).
+ * @param tag_size (uint): Size of the frame region.
+ * 
+ * @returns Status: e_success if the table is built, e_failure if the tag is malformed or its version isn't supported.
+ */
+Status build_frame_index(FrameIndex *index, const unsigned char *header, const unsigned char *tag, uint tag_size);
+
+
+/**
+ * Undoes the unsynchronisation of a tag in place, so its frames can be indexed and read:
+ * the whole frame region for ID3v2.2 and v2.3, every flagged frame for ID3v2.4 (or every
+ * frame when the tag header says so). The unsynchronisation flag of the header is cleared.
+ * 
+ * @param header (unsigned char*): The 10 byte tag header.
+ * @param tag (unsigned char*): The frame region of the tag.
+ * @param tag_size (uint): Size of the frame region.
+ * 
+ * @returns uint: Size of the frame region once decoded (tag_size if nothing was unsynchronised).
+ */
+uint resync_tag(unsigned char *header, unsigned char *tag, uint tag_size);
+
+
+/**
+ * Tells whether resync_tag() would change a tag: the tag header has its unsynchronisation
+ * flag set, or an ID3v2.4 frame has its own.
+ * 
+ * @param header (const unsigned char*): The 10 byte tag header.
+ * @param tag (const unsigned char*): The frame region of the tag.
+ * @param tag_size (uint): Size of the frame region.
+ * 
+ * @returns int: 1 if the tag is unsynchronised, 0 otherwise.
+ */
+int tag_is_unsynced(const unsigned char *header, const unsigned char *tag, uint tag_size);
+
+
+/**
+ * Copies the frames of a tag, unsynchronising them when the tag header has its
+ * unsynchronisation flag set: the whole region for ID3v2.2 and v2.3, each frame
+ * after its header for ID3v2.4.
+ * 
+ * @param header (const unsigned char*): The 10 byte tag header.
+ * @param dest (unsigned char*): Where the frames are written, 2 * size bytes at most.
+ * @param tag (const unsigned char*): The frames (with the extended header in front, if any), without padding.
+ * @param size (uint): Size of the frames.
+ * 
+ * @returns uint: Number of bytes written.
+ */
+uint unsync_tag(const unsigned char *header, unsigned char *dest, const unsigned char *tag, uint size);
+
+
+/**
+ * Looks up a frame in the table.
+ * 
+ * @param index (const FrameIndex*): The frame table.
+ * @param id (const char*): Frame identifier (e.g., "TIT2").
+ * 
+ * @returns const FrameEntry*: The first frame with that identifier, or NULL if there is none.
+ */
+const FrameEntry *find_frame(const FrameIndex *index, const char *id);
+
+
+/**
+ * Releases the memory of the frame table.
+ * 
+ * @param index (FrameIndex*): The frame table.
+ */
+void free_frame_index(FrameIndex *index);
+
+
+/**
+ * Tells if a frame holds binary data (APIC, GEOB or PRIV) whose payload can be skipped.
+ * 
+ * @param id (const char*): Frame identifier (4 characters).
+ * 
+ * @returns int: 1 for a binary frame, 0 otherwise.
+ */
+int is_binary_frame(const char *id);
+
+
+/**
+ * Writes a stub for a binary frame: its header with FRAME_STUB_FLAG set, the real payload size
+ * and the first bytes of the payload. ID3v2.2 frames have no flags, so they are never stubbed.
+ * 
+ * @param parser (const FrameParser*): The parser of the tag (ID3v2.3 or v2.4).
+ * @param dest (unsigned char*): Where the stub is written, 14 + FRAME_STUB_PREFIX bytes at most.
+ * @param entry (const FrameEntry*): The frame, its offset and data relative to tag.
+ * @param tag (const unsigned char*): Holds the frame header and at least FRAME_STUB_PREFIX bytes of its data (all of it if smaller).
+ * 
+ * @returns uint: Number of bytes written.
+ */
+uint make_stub_frame(const FrameParser *parser, unsigned char *dest, const FrameEntry *entry, const unsigned char *tag);
+
+
+/**
+ * Gives the payload of a frame, or the kept prefix of a stub.
+ * 
+ * @param entry (const FrameEntry*): The frame.
+ * @param tag (const unsigned char*): The tag buffer the frame table was built from.
+ * @param data (const unsigned char**): Set to the first payload byte in memory.
+ * @param length (uint*): Set to the number of payload bytes in memory.
+ * 
+ * @returns uint: The real payload size of the frame.
+ */
+uint frame_payload(const FrameEntry *entry, const unsigned char *tag, const unsigned char **data, uint *length);
+
+
+/**
+ * Decodes a 4 byte syncsafe integer (7 bits per byte) as used by the ID3 tag header.
+ * 
+ * @param ptr (const unsigned char*): Pointer to the 4 encoded bytes.
+ * 
+ * @returns uint: The decoded value.
+ */
+uint syncsafe_to_int(const unsigned char *ptr);
+
+
+/**
+ * Encodes a value as a 4 byte syncsafe integer (7 bits per byte).
+ * 
+ * @param ptr (unsigned char*): Pointer to the 4 bytes to be written.
+ * @param value (uint): The value to be encoded (less than 2^28).
+ */
+void int_to_syncsafe(unsigned char *ptr, uint value);
+
+
+/**
+ * Decodes a 4 byte big-endian integer as used by ID3v2.3 frame sizes (ID3v2.4 frame sizes are syncsafe).
+ * 
+ * @param ptr (const unsigned char*): Pointer to the 4 encoded bytes.
+ * 
+ * @returns uint: The decoded value.
+ */
+uint be32_to_int(const unsigned char *ptr);
+
+
+/**
+ * Encodes a value as a 4 byte big-endian integer.
+ * 
+ * @param ptr (unsigned char*): Pointer to the 4 bytes to be written.
+ * @param value (uint): The value to be encoded.
+ */
+void int_to_be32(unsigned char *ptr, uint value);
+
+#endif
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "mp3_lib.h"
+#include "mp3_view.h"
+#include "mp3_edit.h"
+#include "mp3_cache.h"
+#include "mp3_arena.h"
+#include "mp3_tail.h"
+
+// The public tail tag bits are the ones the tail tag reader sets
+_Static_assert(MP3_TAIL_ID3V1 == TAIL_ID3V1 && MP3_TAIL_ID3V11 == TAIL_ID3V11 &&
+               MP3_TAIL_LYRICS3 == TAIL_LYRICS3 && MP3_TAIL_LYRICS3V2 == TAIL_LYRICS3V2 &&
+               MP3_TAIL_APE == TAIL_APE && MP3_TAIL_APEV2 == TAIL_APEV2, "tail tag bits differ");
+
+// Structure to store the state kept by a context from file to file
+struct Mp3Context
+{
+    Arena arena;           // Holds the tag and the texts of the file read last
+    TagCache cache;        // Cache of parsed tags, used once has_cache is set
+    int has_cache;         // 1 if a cache file was opened
+    Mp3ViewInfo view;      // The file read last and its frame table
+    int loaded;            // 1 if view holds a successfully read file
+    Mp3EditInfo edit;      // Edit state, its arena is reused for every edit
+};
+
+// Description of each error code
+static const char *error_messages[] =
+{
+    [mp3_ok] = "no error",
+    [mp3_err_open] = "cannot open the file",
+    [mp3_err_no_tag] = "no ID3v2, ID3v1, Lyrics3 or APE tag",
+    [mp3_err_version] = "unsupported ID3v2 version",
+    [mp3_err_read] = "cannot read the tag",
+    [mp3_err_build] = "cannot build the changed frames",
+    [mp3_err_write] = "cannot write the changed tag",
+    [mp3_err_args] = "invalid argument",
+};
+
+/**
+ * Creates a context with an empty arena, no cache and an edit state that prints nothing.
+ * 
+ * Returns:
+ *   Mp3Context*: The context, or NULL if memory runs out.
+ */
+Mp3Context *mp3_context_new(void)
+{
+    Mp3Context *ctx = calloc(1, sizeof(Mp3Context));
+    if (ctx == NULL)
+    {
+        return NULL;
+    }
+
+    arena_init(&ctx->arena, arena_limit());
+    ctx->view.arena = &ctx->arena;
+    ctx->view.format = format_text;
+    init_edit(&ctx->edit);
+    ctx->edit.out = NULL;
+    return ctx;
+}
+
+/**
+ * Releases the frame table and the texts of the file read last. The arena keeps its first
+ * block, so the next file usually needs no allocation.
+ * 
+ * Parameters:
+ *   ctx (Mp3Context*): The context.
+ */
+void mp3_context_reset(Mp3Context *ctx)
+{
+    view_release(&ctx->view);
+    ctx->loaded = 0;
+    arena_reset(&ctx->arena);
+}
+
+/**
+ * Releases a context, its memory and its cache.
+ * 
+ * Parameters:
+ *   ctx (Mp3Context*): The context, may be NULL.
+ */
+void mp3_context_free(Mp3Context *ctx)
+{
+    if (ctx == NULL)
+    {
+        return;
+    }
+
+    mp3_context_reset(ctx);
+    arena_free(&ctx->arena);
+    free_edit(&ctx->edit);
+    if (ctx->has_cache)
+    {
+        cache_close(&ctx->cache);
+    }
+    free(ctx);
+}
+
+/**
+ * Opens a cache file for the files read by the context, replacing the previous one.
+ * 
+ * Parameters:
+ *   ctx (Mp3Context*): The context.
+ *   file_name (const char*): The cache file.
+ * 
+ * Returns:
+ *   Mp3Error: mp3_ok, or mp3_err_open if the cache file can't be used.
+ */
+Mp3Error mp3_context_set_cache(Mp3Context *ctx, const char *file_name)
+{
+    if (ctx->has_cache)
+    {
+        cache_close(&ctx->cache);
+        ctx->has_cache = 0;
+        ctx->view.cache = NULL;
+    }
+    if (cache_open(&ctx->cache, file_name) == e_failure)
+    {
+        return mp3_err_open;
+    }
+    ctx->has_cache = 1;
+    ctx->view.cache = &ctx->cache;
+    return mp3_ok;
+}
+
+/**
+ * Reads the tags of a file with the view core and fills in the fields, completed from the
+ * tail tags. The texts stay in the arena of the context until its next call.
+ * 
+ * Parameters:
+ *   ctx (Mp3Context*): The context.
+ *   path (const char*): The MP3 file.
+ *   tags (Mp3Tags*): Filled with the fields.
+ * 
+ * Returns:
+ *   Mp3Error: mp3_ok, or the reason the file can't be read (mp3_err_read if a text doesn't
+ *             fit in the arena).
+ */
+Mp3Error mp3_read(Mp3Context *ctx, const char *path, Mp3Tags *tags)
+{
+    mp3_context_reset(ctx);
+    memset(tags, 0, sizeof(*tags));
+
+    Mp3ViewInfo *mp3View = &ctx->view;
+    mp3View->file_name = (char *)path;
+    Mp3Error error = view_load(mp3View);
+    if (error != mp3_ok)
+    {
+        view_release(mp3View);
+        return error;
+    }
+
+    // The fields of Mp3Tags are in record order
+    const char *fields[VIEW_FIELDS];
+    error = decode_fields(mp3View, fields);
+    if (error != mp3_ok)
+    {
+        view_release(mp3View);
+        return error;
+    }
+    ctx->loaded = 1;
+
+    tags->version = strncmp((char *)mp3View->header, "ID3", 3) == 0 ? mp3View->header[3] : 0;
+    tags->title = fields[0];
+    tags->artist = fields[1];
+    tags->album = fields[2];
+    tags->year = fields[3];
+    tags->genre = fields[4];
+    tags->comment = fields[5];
+    for (uint i = 0; i < mp3View->index.count; i++)
+    {
+        tags->pictures += strncmp(mp3View->index.frames[i].id, "APIC", 4) == 0;
+    }
+    tags->tail_tags = mp3View->tail_tags.found;
+    return mp3_ok;
+}
+
+/**
+ * Calls a function for every frame of the tag read last. Text frames, comments and lyrics
+ * come with their text decoded to UTF-8.
+ * 
+ * Parameters:
+ *   ctx (Mp3Context*): The context.
+ *   fn (Mp3FrameFn): The callback.
+ *   arg (void*): Argument passed to the callback.
+ * 
+ * Returns:
+ *   Mp3Error: mp3_ok, mp3_err_args if no file was read successfully, or mp3_err_read if a
+ *             text doesn't fit in the arena (no further frame is passed to the callback).
+ */
+Mp3Error mp3_for_each_frame(Mp3Context *ctx, Mp3FrameFn fn, void *arg)
+{
+    if (!ctx->loaded || fn == NULL)
+    {
+        return mp3_err_args;
+    }
+
+    Mp3ViewInfo *mp3View = &ctx->view;
+    mp3View->text_error = mp3_ok;
+    for (uint i = 0; i < mp3View->index.count; i++)
+    {
+        const FrameEntry *entry = &mp3View->index.frames[i];
+        char id[5];
+        memcpy(id, entry->id, 4);
+        id[4] = '\0';
+
+        Mp3Frame frame;
+        frame.id = id;
+        frame.size = entry->size;
+        frame.text = NULL;
+        if (id[0] == 'T' || strcmp(id, "COMM") == 0 || strcmp(id, "USLT") == 0)
+        {
+            frame.text = get_frame_text(mp3View, id);
+            if (mp3View->text_error != mp3_ok)
+            {
+                return mp3View->text_error;
+            }
+        }
+        fn(&frame, arg);
+    }
+    return mp3_ok;
+}
+
+/**
+ * Changes fields of a file with the edit core, which prints nothing for the library.
+ * The changes are checked the way a batch manifest is: each field is known and given once.
+ * 
+ * Parameters:
+ *   ctx (Mp3Context*): The context.
+ *   path (const char*): The MP3 file.
+ *   edits (const Mp3FieldEdit*): The changes.
+ *   count (uint): Number of changes.
+ *   in_place (int*): Set to 1 if the tag was patched in place, 0 if the file was rewritten (may be NULL).
+ * 
+ * Returns:
+ *   Mp3Error: mp3_ok or the reason the edit failed.
+ */
+Mp3Error mp3_edit(Mp3Context *ctx, const char *path, const Mp3FieldEdit *edits, uint count, int *in_place)
+{
+    mp3_context_reset(ctx);
+
+    Mp3EditInfo *mp3Edit = &ctx->edit;
+    if (count == 0 || count > MAX_EDITS)
+    {
+        return mp3_err_args;
+    }
+    mp3Edit->edit_count = 0;
+    for (uint i = 0; i < count; i++)
+    {
+        char *option = edits[i].field[0] == '-' ? (char *)edits[i].field : get_frame_option(edits[i].field);
+        if (option == NULL || get_frame_id(option) == NULL || edits[i].text == NULL)
+        {
+            return mp3_err_args;
+        }
+        for (int j = 0; j < mp3Edit->edit_count; j++)
+        {
+            if (strcmp(mp3Edit->edits[j].frame, option) == 0)
+            {
+                return mp3_err_args;
+            }
+        }
+
+        FrameEdit *edit = &mp3Edit->edits[mp3Edit->edit_count++];
+        edit->frame = option;
+        edit->modify_data = (char *)edits[i].text;
+        edit->data_length = strlen(edit->modify_data) + 1;
+    }
+
+    mp3Edit->src_fname = (char *)path;
+    Status status = edit_info(mp3Edit);
+    if (in_place != NULL)
+    {
+        *in_place = status == e_success && mp3Edit->in_place;
+    }
+    return status == e_success ? mp3_ok : mp3Edit->error;
+}
+
+/**
+ * Describes an error code.
+ * 
+ * Parameters:
+ *   error (Mp3Error): The error code.
+ * 
+ * Returns:
+ *   const char*: A short description.
+ */
+const char *mp3_strerror(Mp3Error error)
+{
+    if (error < 0 || error >= sizeof(error_messages) / sizeof(error_messages[0]))
+    {
+        return "unknown error";
+    }
+    return error_messages[error];
+}
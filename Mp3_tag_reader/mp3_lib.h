@@ -0,0 +1,157 @@
+#ifndef MP3_LIB_H
+#define MP3_LIB_H
+
+// Public interface of libmp3tag, the library the command-line tool is built on.
+// Nothing is printed: results come back in structures or through callbacks and
+// every call returns an error code. A context is used by one thread at a time;
+// separate contexts may be used from separate threads.
+
+// Functions exported by the shared library, which is built with -fvisibility=hidden
+#define MP3_API __attribute__((visibility("default")))
+
+/**
+ * Enum to represent the error codes returned by the library (and by the view and edit cores).
+ */
+typedef enum
+{
+    mp3_ok,             // No error
+    mp3_err_open,       // The file could not be opened
+    mp3_err_no_tag,     // The file has neither an ID3v2 tag nor ID3v1, Lyrics3 or APE tags
+    mp3_err_version,    // The ID3v2 tag is not version 2.2, 2.3 or 2.4
+    mp3_err_read,       // The tag could not be read: truncated, malformed or over the memory limit
+    mp3_err_build,      // The changed frames could not be built
+    mp3_err_write,      // The changed tag could not be written back
+    mp3_err_args        // Invalid argument (e.g., unknown field, field given twice, no tag read yet)
+} Mp3Error;
+
+// Tags found at the end of a file, the bits of Mp3Tags.tail_tags
+#define MP3_TAIL_ID3V1 0x01      // ID3v1
+#define MP3_TAIL_ID3V11 0x02     // ID3v1.1, with a track number
+#define MP3_TAIL_LYRICS3 0x04    // Lyrics3 block
+#define MP3_TAIL_LYRICS3V2 0x08  // The Lyrics3 block is version 2
+#define MP3_TAIL_APE 0x10        // APE tag
+#define MP3_TAIL_APEV2 0x20      // The APE tag is version 2
+
+// Reusable parser state: memory, frame table and tag cache kept from file to file
+typedef struct Mp3Context Mp3Context;
+
+// Structure to store the fields of one file, valid until the next call on the context
+typedef struct Mp3Tags
+{
+    int version;           // ID3v2 major version (2, 3 or 4), 0 if the file only has tail tags
+    const char *title;     // UTF-8 text of each field, NULL if the file doesn't have it
+    const char *artist;
+    const char *album;
+    const char *year;
+    const char *genre;
+    const char *comment;
+    unsigned int pictures;   // Number of embedded pictures (APIC frames)
+    unsigned int tail_tags;  // MP3_TAIL_* bits of the tags found at the end of the file
+} Mp3Tags;
+
+// Structure to describe one frame of the tag read last
+typedef struct Mp3Frame
+{
+    const char *id;        // Frame identifier with its ID3v2.3 name (e.g., "TIT2")
+    unsigned int size;     // Size of the frame data
+    const char *text;      // UTF-8 text of a text frame or comment, NULL for other frames
+} Mp3Frame;
+
+// Callback called for every frame by mp3_for_each_frame()
+typedef void (*Mp3FrameFn)(const Mp3Frame *frame, void *arg);
+
+// Structure to store one field change of mp3_edit()
+typedef struct Mp3FieldEdit
+{
+    const char *field;     // Frame identifier (e.g., "TIT2") or command-line option (e.g., "-t")
+    const char *text;      // New UTF-8 text of the field
+} Mp3FieldEdit;
+
+// Function Prototypes
+
+/**
+ * Creates a context. The memory limit of one file is taken from MP3_ARENA_LIMIT.
+ * 
+ * @returns Mp3Context*: The context, or NULL if memory runs out.
+ */
+MP3_API Mp3Context *mp3_context_new(void);
+
+
+/**
+ * Releases the memory of the last file (texts, frame table); the context can be used again.
+ * Every read and edit starts with a reset, so calling it is only needed to give memory back early.
+ * 
+ * @param ctx (Mp3Context*): The context.
+ */
+MP3_API void mp3_context_reset(Mp3Context *ctx);
+
+
+/**
+ * Releases a context and closes its tag cache.
+ * 
+ * @param ctx (Mp3Context*): The context, may be NULL.
+ */
+MP3_API void mp3_context_free(Mp3Context *ctx);
+
+
+/**
+ * Keeps the parsed tags of the files read in a cache file, so unchanged files are answered without
+ * being opened. A cache file must not be shared by two contexts at the same time.
+ * 
+ * @param ctx (Mp3Context*): The context.
+ * @param file_name (const char*): The cache file, created if it doesn't exist.
+ * 
+ * @returns Mp3Error: mp3_ok, or mp3_err_open if the cache file can't be used.
+ */
+MP3_API Mp3Error mp3_context_set_cache(Mp3Context *ctx, const char *file_name);
+
+
+/**
+ * Reads the tags of a file: the ID3v2 tag, completed from the ID3v1, Lyrics3 and APE tags at its end.
+ * 
+ * @param ctx (Mp3Context*): The context.
+ * @param path (const char*): The MP3 file.
+ * @param tags (Mp3Tags*): Filled with the fields, valid until the next call on the context.
+ * 
+ * @returns Mp3Error: mp3_ok, mp3_err_open, mp3_err_no_tag, mp3_err_version or mp3_err_read.
+ */
+MP3_API Mp3Error mp3_read(Mp3Context *ctx, const char *path, Mp3Tags *tags);
+
+
+/**
+ * Calls a function for every frame of the ID3v2 tag read last by mp3_read(), in tag order.
+ * 
+ * @param ctx (Mp3Context*): The context.
+ * @param fn (Mp3FrameFn): The callback; the frame and its text are valid until the next call on the context.
+ * @param arg (void*): Argument passed to the callback.
+ * 
+ * @returns Mp3Error: mp3_ok, mp3_err_args if no file was read successfully, or mp3_err_read if a text
+ *                   doesn't fit in the arena (no further frame is passed to fn).
+ */
+MP3_API Mp3Error mp3_for_each_frame(Mp3Context *ctx, Mp3FrameFn fn, void *arg);
+
+
+/**
+ * Changes fields of a file in one pass, patching the tag in place when the new frames fit.
+ * 
+ * @param ctx (Mp3Context*): The context.
+ * @param path (const char*): The MP3 file, which needs an ID3v2 tag.
+ * @param edits (const Mp3FieldEdit*): The changes; title, artist, album, year, genre and comment can be changed.
+ * @param count (unsigned int): Number of changes.
+ * @param in_place (int*): Set to 1 if the tag was patched in place, 0 if the file was rewritten (may be NULL).
+ * 
+ * @returns Mp3Error: mp3_ok or the reason the edit failed.
+ */
+MP3_API Mp3Error mp3_edit(Mp3Context *ctx, const char *path, const Mp3FieldEdit *edits, unsigned int count, int *in_place);
+
+
+/**
+ * Describes an error code.
+ * 
+ * @param error (Mp3Error): The error code.
+ * 
+ * @returns const char*: A short description (e.g., "cannot open the file").
+ */
+MP3_API const char *mp3_strerror(Mp3Error error);
+
+#endif
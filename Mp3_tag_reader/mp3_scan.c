@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "mp3_view.h"
+#include "mp3_scan.h"
+#include "mp3_stats.h"
+
+/**
+ * Validates the arguments of the recursive scan.
+ * 
+ * Parameters:
+ *   argc (int): Number of command-line arguments.
+ *   argv (char*[]): Command-line arguments, the directory at index 2, the optional thread count at index 3
+ *                   and the optional io_uring queue depth at index 4.
+ *   scan (ScanInfo*): A pointer to the structure where the scan information will be stored.
+ * 
+ * Returns:
+ *   Status: e_success if validation passes, e_failure if there's an error.
+ */
+Status read_and_validation_scan(int argc, char *argv[], ScanInfo *scan)
+{
+    struct stat st;
+
+    // Check if the path is a directory
+    if (stat(argv[2], &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : %s IS NOT A DIRECTORY\n", argv[2]);
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+    scan->dir_name = argv[2];
+    scan->cache = NULL;
+    scan->format = format_text;
+
+    // Use one worker per online CPU unless a thread count is passed
+    scan->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 3)
+    {
+        scan->threads = atoi(argv[3]);
+    }
+    if (scan->threads < 1)
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : INVALID THREAD COUNT\n");
+        printf("USAGE :\nTo scan please pass like: ./a.out -r directory [threads] [queue_depth]\n");
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+
+    // Read the tags through io_uring only when a queue depth is passed
+    scan->queue_depth = 0;
+    if (argc > 4)
+    {
+        scan->queue_depth = atoi(argv[4]);
+    }
+    if (scan->queue_depth < 0 || scan->queue_depth > 4096)
+    {
+        printf("-------------------------------------------------------------------------------\n\n");
+        printf("ERROR: ./a.out : INVALID QUEUE DEPTH (0 to 4096)\n");
+        printf("USAGE :\nTo scan please pass like: ./a.out -r directory [threads] [queue_depth]\n");
+        printf("-------------------------------------------------------------------------------\n");
+        return e_failure;
+    }
+
+    return e_success;
+}
+
+/**
+ * Compares two paths for qsort().
+ */
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Recursively adds the MP3 files below a directory to the file list.
+ * The directory entry type is used when the file system reports it, so regular
+ * directories are walked without a stat() per file.
+ * 
+ * Parameters:
+ *   scan (ScanInfo*): A pointer to the structure containing the scan information.
+ *   dir_name (const char*): The directory to be walked.
+ * 
+ * Returns:
+ *   Status: e_success if the directory was walked, e_failure if an error occurs.
+ */
+Status collect_files(ScanInfo *scan, const char *dir_name)
+{
+    DIR *dir = opendir(dir_name);
+    if (dir == NULL)
+    {
+        return e_failure;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        char *path = malloc(strlen(dir_name) + strlen(entry->d_name) + 2);
+        if (path == NULL)
+        {
+            closedir(dir);
+            return e_failure;
+        }
+        sprintf(path, "%s/%s", dir_name, entry->d_name);
+
+        // Find the entry type when the file system doesn't report it
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if (lstat(path, &st) == 0)
+            {
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+        }
+
+        char *extn = strrchr(entry->d_name, '.');
+        if (type == DT_DIR)
+        {
+            // Unreadable sub directories are skipped
+            collect_files(scan, path);
+            free(path);
+        }
+        else if (type == DT_REG && extn != NULL && strcasecmp(extn, ".mp3") == 0)
+        {
+            // Grow the file list when it is full
+            if (scan->count == scan->capacity)
+            {
+                uint capacity = scan->capacity ? scan->capacity * 2 : 256;
+                char **files = realloc(scan->files, capacity * sizeof(char *));
+                if (files == NULL)
+                {
+                    free(path);
+                    closedir(dir);
+                    return e_failure;
+                }
+                scan->files = files;
+                scan->capacity = capacity;
+            }
+            scan->files[scan->count++] = path;
+        }
+        else
+        {
+            free(path);
+        }
+    }
+
+    closedir(dir);
+    return e_success;
+}
+
+/**
+ * Views one file into its own memory buffer and stores the result.
+ * Records are built in the reusable buffer of the calling thread and copied out once.
+ * 
+ * Parameters:
+ *   scan (ScanInfo*): A pointer to the structure containing the scan information.
+ *   arena (Arena*): Arena of the calling thread, reset once the file is done.
+ *   record (RecordBuffer*): Record buffer of the calling thread.
+ *   i (uint): Index of the file in the file list.
+ */
+static void scan_file(ScanInfo *scan, Arena *arena, RecordBuffer *record, uint i)
+{
+    char *result = NULL;
+    size_t result_len = 0;
+    Mp3ViewInfo mp3View;
+    mp3View.file_name = scan->files[i];
+    mp3View.cache = scan->cache;
+    mp3View.arena = arena;
+    mp3View.format = scan->format;
+    mp3View.record = record;
+    record->len = 0;
+    mp3View.out = scan->format == format_text ? open_memstream(&result, &result_len) : stderr;
+
+    FileStats stats;
+    stats_begin(&stats);
+
+    // Wait for the reader thread to bring in the tag
+    TagRequest *req = NULL;
+    if (scan->use_aio)
+    {
+        uint slot = i % (2 * SCAN_WINDOW);
+        pthread_mutex_lock(&scan->lock);
+        while (scan->slot_ready[slot] != i + 1)
+        {
+            pthread_cond_wait(&scan->ready, &scan->lock);
+        }
+        pthread_mutex_unlock(&scan->lock);
+        req = &scan->slots[slot];
+        stats_merge(&req->stats);
+    }
+
+    Status status = e_failure;
+    if (mp3View.out != NULL)
+    {
+        if (scan->format == format_text)
+        {
+            fprintf(mp3View.out, "FILE     :   %s\n", scan->files[i]);
+        }
+        if (req != NULL && req->too_large)
+        {
+            // A tag too large to be read whole is walked by load_tag(), which skips its binary payloads
+            free(req->tail);
+            req->tail = NULL;
+            status = view_info(&mp3View);
+        }
+        else if (req != NULL)
+        {
+            // Remember tags read from the file for the next run, decoded once
+            struct stat st;
+            if (req->status == e_success)
+            {
+                req->tag_size = resync_tag(req->header, req->tag, req->tag_size);
+            }
+            int tail_only = req->status == e_failure && req->tail != NULL && strncmp((char *)req->header, "ID3", 3) != 0;
+            if (scan->cache != NULL && !req->from_cache && (req->status == e_success || tail_only) && stat(scan->files[i], &st) == 0)
+            {
+                cache_store(scan->cache, &st, req->header, tail_only ? NULL : req->tag, req->tag_size, req->tail, req->tail_size);
+            }
+            memcpy(mp3View.header, req->header, sizeof(mp3View.header));
+            mp3View.tag = req->tag;
+            mp3View.tag_size = req->tag_size;
+            mp3View.tail = req->tail;
+            mp3View.tail_size = req->tail_size;
+            req->tag = NULL;
+            req->tail = NULL;
+            status = view_loaded(&mp3View);
+        }
+        else
+        {
+            status = view_info(&mp3View);
+        }
+        // The statistics of the file go with its details, or to stderr next to the records
+        stats_end(&stats, scan->format == format_text ? mp3View.out : stderr, scan->files[i]);
+        if (scan->format == format_text)
+        {
+            fprintf(mp3View.out, "-----------------------------------------------------------------------------------------------------\n");
+            fclose(mp3View.out);
+        }
+        else if ((result = malloc(record->len + 1)) != NULL)
+        {
+            memcpy(result, record->data, record->len);
+            result_len = record->len;
+        }
+    }
+    else
+    {
+        stats_end(&stats, stderr, scan->files[i]);
+    }
+    arena_reset(arena);
+
+    pthread_mutex_lock(&scan->lock);
+    scan->results[i] = result != NULL ? result : strdup("");
+    scan->result_len[i] = result != NULL ? result_len : 0;
+    if (status == e_failure)
+    {
+        scan->failed++;
+    }
+    pthread_cond_broadcast(&scan->ready);
+    pthread_mutex_unlock(&scan->lock);
+}
+
+/**
+ * Called by the io_uring reader for every finished tag: stores it in its slot and marks it as ready.
+ * 
+ * Parameters:
+ *   req (TagRequest*): The finished request.
+ *   arg (void*): A pointer to the ScanInfo structure.
+ */
+static void tag_done(TagRequest *req, void *arg)
+{
+    ScanInfo *scan = arg;
+    uint slot = req->id % (2 * SCAN_WINDOW);
+
+    pthread_mutex_lock(&scan->lock);
+    scan->slots[slot] = *req;
+    scan->slot_ready[slot] = req->id + 1;
+    pthread_cond_broadcast(&scan->ready);
+    pthread_mutex_unlock(&scan->lock);
+}
+
+/**
+ * Reader thread: reads the tags of the files through io_uring, one window of files at a time.
+ * A window is only started once the window two steps back is printed, so its slots are free.
+ * Files whose tag is in the cache are handed over without being opened.
+ * 
+ * Parameters:
+ *   arg (void*): A pointer to the ScanInfo structure.
+ * 
+ * Returns:
+ *   void*: Always NULL.
+ */
+static void *scan_reader(void *arg)
+{
+    ScanInfo *scan = arg;
+    TagRequest *reqs = calloc(SCAN_WINDOW, sizeof(TagRequest));
+
+    for (uint base = 0; base < scan->count; base += SCAN_WINDOW)
+    {
+        pthread_mutex_lock(&scan->lock);
+        while (scan->printed + SCAN_WINDOW < base)
+        {
+            pthread_cond_wait(&scan->space, &scan->lock);
+        }
+        pthread_mutex_unlock(&scan->lock);
+
+        uint n = scan->count - base < SCAN_WINDOW ? scan->count - base : SCAN_WINDOW;
+        uint misses = 0;
+        for (uint k = 0; k < n; k++)
+        {
+            TagRequest req;
+            memset(&req, 0, sizeof(req));
+            req.path = scan->files[base + k];
+            req.id = base + k;
+
+            struct stat st;
+            if (scan->cache != NULL && stat(req.path, &st) == 0 &&
+                cache_lookup(scan->cache, &st, req.header, &req.tag, &req.tag_size, &req.tail, &req.tail_size) == e_success)
+            {
+                req.status = e_success;
+                req.from_cache = 1;
+                tag_done(&req, scan);
+            }
+            else if (reqs != NULL)
+            {
+                reqs[misses++] = req;
+            }
+            else
+            {
+                blocking_read_tags(&req, 1, tag_done, scan);
+            }
+        }
+
+        if (misses > 0 && aio_read_tags(&scan->aio, reqs, misses, tag_done, scan) == e_failure)
+        {
+            // The ring failed, read the files it didn't finish with blocking reads
+            for (uint k = 0; k < misses; k++)
+            {
+                pthread_mutex_lock(&scan->lock);
+                int ready = scan->slot_ready[reqs[k].id % (2 * SCAN_WINDOW)] == reqs[k].id + 1;
+                pthread_mutex_unlock(&scan->lock);
+                if (!ready)
+                {
+                    blocking_read_tags(&reqs[k], 1, tag_done, scan);
+                }
+            }
+        }
+    }
+
+    free(reqs);
+    return NULL;
+}
+
+/**
+ * Worker thread: keeps taking the next file until all files are handed out.
+ * The tags and frame texts of its files come from one arena that is reused for every file.
+ * 
+ * Parameters:
+ *   arg (void*): A pointer to the ScanInfo structure.
+ * 
+ * Returns:
+ *   void*: Always NULL.
+ */
+static void *scan_worker(void *arg)
+{
+    ScanInfo *scan = arg;
+    Arena arena;
+    arena_init(&arena, arena_limit());
+    RecordBuffer record = { NULL, 0, 0 };
+
+    while (1)
+    {
+        // Take the next file, but don't run too far ahead of the printer
+        pthread_mutex_lock(&scan->lock);
+        while (scan->next < scan->count && scan->next >= scan->printed + SCAN_WINDOW)
+        {
+            pthread_cond_wait(&scan->space, &scan->lock);
+        }
+        uint i = scan->next++;
+        pthread_mutex_unlock(&scan->lock);
+        if (i >= scan->count)
+        {
+            break;
+        }
+
+        scan_file(scan, &arena, &record, i);
+    }
+
+    arena_free(&arena);
+    record_free(&record);
+    return NULL;
+}
+
+/**
+ * Finds every MP3 file below the directory and views them on the worker threads.
+ * The main thread prints each result as soon as it and all files before it are done,
+ * so the output is always in sorted path order.
+ * 
+ * Parameters:
+ *   scan (ScanInfo*): A pointer to the structure containing the scan information.
+ * 
+ * Returns:
+ *   Status: e_success if every file was viewed, e_failure if any file failed.
+ */
+Status scan_info(ScanInfo *scan)
+{
+    scan->files = NULL;
+    scan->count = scan->capacity = 0;
+    if (collect_files(scan, scan->dir_name) == e_failure)
+    {
+        printf("Error in reading directory %s\n", scan->dir_name);
+        return e_failure;
+    }
+    qsort(scan->files, scan->count, sizeof(char *), compare_paths);
+
+    scan->results = calloc(scan->count + 1, sizeof(char *));
+    scan->result_len = calloc(scan->count + 1, sizeof(size_t));
+    if (scan->results == NULL || scan->result_len == NULL)
+    {
+        return e_failure;
+    }
+    scan->next = scan->printed = scan->failed = 0;
+    pthread_mutex_init(&scan->lock, NULL);
+    pthread_cond_init(&scan->ready, NULL);
+    pthread_cond_init(&scan->space, NULL);
+
+    // Start the io_uring reader thread when a queue depth is passed
+    pthread_t reader;
+    scan->use_aio = 0;
+    if (scan->queue_depth > 0 && scan->count > 0)
+    {
+        if (aio_init(&scan->aio, scan->queue_depth) == e_failure)
+        {
+            printf("io_uring is not available, using blocking reads\n");
+        }
+        else
+        {
+            scan->slots = calloc(2 * SCAN_WINDOW, sizeof(TagRequest));
+            scan->slot_ready = calloc(2 * SCAN_WINDOW, sizeof(uint));
+            if (scan->slots != NULL && scan->slot_ready != NULL && pthread_create(&reader, NULL, scan_reader, scan) == 0)
+            {
+                scan->use_aio = 1;
+            }
+            else
+            {
+                free(scan->slots);
+                free(scan->slot_ready);
+                aio_close(&scan->aio);
+            }
+        }
+    }
+
+    // Start the workers, never more than there are files
+    int threads = scan->threads < (int)scan->count ? scan->threads : (int)scan->count;
+    pthread_t *workers = malloc((threads + 1) * sizeof(pthread_t));
+    int started = 0;
+    while (workers != NULL && started < threads && pthread_create(&workers[started], NULL, scan_worker, scan) == 0)
+    {
+        started++;
+    }
+
+    // Without any worker the files are viewed on this thread
+    Arena arena;
+    arena_init(&arena, arena_limit());
+    RecordBuffer record = { NULL, 0, 0 };
+
+    // The results go out in large writes, CSV and TSV start with a header line
+    writer_init(&scan->writer, STDOUT_FILENO);
+    format_header(&record, scan->format);
+    writer_write(&scan->writer, record.data, record.len);
+
+    // Print the results in order as they become ready
+    for (uint i = 0; i < scan->count; i++)
+    {
+        if (started == 0)
+        {
+            scan_file(scan, &arena, &record, i);
+        }
+
+        pthread_mutex_lock(&scan->lock);
+        while (scan->results[i] == NULL)
+        {
+            pthread_cond_wait(&scan->ready, &scan->lock);
+        }
+        pthread_mutex_unlock(&scan->lock);
+
+        writer_write(&scan->writer, scan->results[i], scan->result_len[i]);
+        free(scan->results[i]);
+        free(scan->files[i]);
+
+        pthread_mutex_lock(&scan->lock);
+        scan->printed = i + 1;
+        pthread_cond_broadcast(&scan->space);
+        pthread_mutex_unlock(&scan->lock);
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    arena_free(&arena);
+    record_free(&record);
+    writer_close(&scan->writer);
+    if (scan->use_aio)
+    {
+        pthread_join(reader, NULL);
+        aio_close(&scan->aio);
+        free(scan->slots);
+        free(scan->slot_ready);
+    }
+
+    // The summary never mixes with the records
+    fprintf(scan->format == format_text ? stdout : stderr, "FILES    :   %u scanned, %u failed\n", scan->count, scan->failed);
+
+    free(scan->files);
+    free(scan->results);
+    free(scan->result_len);
+    pthread_mutex_destroy(&scan->lock);
+    pthread_cond_destroy(&scan->ready);
+    pthread_cond_destroy(&scan->space);
+
+    return scan->failed == 0 ? e_success : e_failure;
+}
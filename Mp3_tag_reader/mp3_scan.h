@@ -0,0 +1,79 @@
+#ifndef MP3_SCAN_H
+#define MP3_SCAN_H
+
+#include <pthread.h>
+#include "types.h"
+#include "mp3_aio.h"
+#include "mp3_cache.h"
+#include "mp3_format.h"
+
+// Number of files the workers may run ahead of the file being printed
+#define SCAN_WINDOW 1024
+
+// Structure to store the state of a recursive directory scan
+typedef struct ScanInfo
+{
+    char *dir_name;        // Root directory of the scan
+    int threads;           // Number of worker threads
+    int queue_depth;       // io_uring requests in flight, 0 for blocking reads on the workers
+    TagCache *cache;       // Cache of parsed tags, NULL if not used
+    OutputFormat format;   // Labelled lines or one record per file
+    OutputWriter writer;   // Buffered stdout the results are written to in order
+
+    char **files;          // Paths of all MP3 files found, in sorted order
+    uint count;            // Number of files found
+    uint capacity;         // Allocated entries in files
+
+    char **results;        // Printed details of each file, NULL until parsed
+    size_t *result_len;    // Length of each result
+    uint next;             // Next file to be handed to a worker
+    uint printed;          // Number of files already printed
+    uint failed;           // Number of files that could not be viewed
+
+    pthread_mutex_t lock;  // Protects next, printed, failed and results
+    pthread_cond_t ready;  // Signalled when a result is stored
+    pthread_cond_t space;  // Signalled when a result is printed
+
+    AioReader aio;         // io_uring reader used when queue_depth is set
+    int use_aio;           // 1 if the tags are read by the io_uring reader thread
+    TagRequest *slots;     // Tags read by the reader, 2 * SCAN_WINDOW slots used in turn
+    uint *slot_ready;      // Index + 1 of the file whose tag is ready in each slot
+} ScanInfo;
+
+// Function Prototypes
+
+/**
+ * Validates the arguments of the recursive scan.
+ * 
+ * @param argc (int): Number of command-line arguments.
+ * @param argv (char*[]): Command-line arguments, the directory at index 2, the optional thread count at index 3
+ *                      and the optional io_uring queue depth at index 4.
+ * @param scan (ScanInfo*): Structure to store the scan information.
+ * 
+ * @returns Status: e_success if validation is successful, e_failure if there's an error.
+ */
+Status read_and_validation_scan(int argc, char *argv[], ScanInfo *scan);
+
+
+/**
+ * Finds every MP3 file below the directory and views them on the worker threads.
+ * The details are printed in sorted path order while the workers keep parsing.
+ * 
+ * @param scan (ScanInfo*): Structure containing the scan information.
+ * 
+ * @returns Status: e_success if every file was viewed, e_failure if any file failed.
+ */
+Status scan_info(ScanInfo *scan);
+
+
+/**
+ * Recursively adds the MP3 files below a directory to the file list.
+ * 
+ * @param scan (ScanInfo*): Structure containing the scan information.
+ * @param dir_name (const char*): The directory to be walked.
+ * 
+ * @returns Status: e_success if the directory was walked, e_failure if an error occurs.
+ */
+Status collect_files(ScanInfo *scan, const char *dir_name);
+
+#endif
@@ -0,0 +1,472 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "types.h"
+#include "mp3_stats.h"
+
+// Names of the phases and counters as printed
+static const char *phase_names[phase_count] = { "open", "header", "parse", "output", "write", "copy" };
+static const char *counter_names[count_total] = { "opens", "reads", "rd_bytes", "writes", "wr_bytes", "seeks" };
+
+// Set once --stats is given, before any thread is started
+static int stats_enabled;
+
+// Statistics the calling thread counts into, NULL when not counting
+static __thread FileStats *stats_current;
+
+// Sum of every ended file
+static FileStats stats_totals;
+static unsigned long stats_files;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Stream the totals are printed to at exit
+static FILE *stats_exit_out;
+
+/**
+ * Returns the current monotonic time in nanoseconds.
+ */
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Finds a --stats argument and removes it from the argument list. Statistics are
+ * collected from then on.
+ * 
+ * Parameters:
+ *   argc (int*): Number of command-line arguments, lowered when the option is removed.
+ *   argv (char*[]): Command-line arguments.
+ * 
+ * Returns:
+ *   int: 1 if --stats was given, 0 otherwise.
+ */
+int parse_stats_option(int *argc, char *argv[])
+{
+    for (int i = 1; i < *argc; i++)
+    {
+        if (strcmp(argv[i], "--stats") == 0)
+        {
+            // Drop the option so the other arguments keep their positions
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char *));
+            (*argc)--;
+            stats_enabled = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Clears the statistics of a file and makes them the ones the calling thread counts into.
+ * Does nothing unless --stats was given.
+ * 
+ * Parameters:
+ *   stats (FileStats*): Statistics of the file.
+ */
+void stats_begin(FileStats *stats)
+{
+    if (stats_enabled)
+    {
+        memset(stats, 0, sizeof(*stats));
+        stats_current = stats;
+    }
+}
+
+/**
+ * Stops counting into the statistics of a file, prints them as one line
+ * and adds them to the totals.
+ * 
+ * Parameters:
+ *   stats (FileStats*): Statistics of the file, as passed to stats_begin().
+ *   out (FILE*): Stream the line is printed to.
+ *   name (const char*): Name of the file.
+ */
+void stats_end(FileStats *stats, FILE *out, const char *name)
+{
+    if (!stats_enabled)
+    {
+        return;
+    }
+    stats_current = NULL;
+
+    fprintf(out, "STATS    :   %s", name);
+    for (int i = 0; i < phase_count; i++)
+    {
+        fprintf(out, " %s=%lluus", phase_names[i], stats->nanosec[i] / 1000);
+    }
+    for (int i = 0; i < count_total; i++)
+    {
+        fprintf(out, " %s=%llu", counter_names[i], stats->counters[i]);
+    }
+    fprintf(out, "\n");
+
+    pthread_mutex_lock(&stats_lock);
+    for (int i = 0; i < phase_count; i++)
+    {
+        stats_totals.nanosec[i] += stats->nanosec[i];
+    }
+    for (int i = 0; i < count_total; i++)
+    {
+        stats_totals.counters[i] += stats->counters[i];
+    }
+    stats_files++;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * Makes other statistics the ones the calling thread counts into, without clearing them
+ * (e.g., a reader thread counting for the file it reads).
+ * 
+ * Parameters:
+ *   stats (FileStats*): The statistics, NULL to stop counting.
+ * 
+ * Returns:
+ *   FileStats*: The statistics counted into before.
+ */
+FileStats *stats_attach(FileStats *stats)
+{
+    FileStats *previous = stats_current;
+    if (stats_enabled)
+    {
+        stats_current = stats;
+    }
+    return previous;
+}
+
+/**
+ * Adds the statistics collected elsewhere for the current file of the calling thread.
+ * 
+ * Parameters:
+ *   stats (const FileStats*): The statistics to be added.
+ */
+void stats_merge(const FileStats *stats)
+{
+    if (stats_current == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < phase_count; i++)
+    {
+        stats_current->nanosec[i] += stats->nanosec[i];
+    }
+    for (int i = 0; i < count_total; i++)
+    {
+        stats_current->counters[i] += stats->counters[i];
+    }
+}
+
+/**
+ * Starts timing a phase of the current file. The clock is only read while counting,
+ * so the timers cost a thread local load and a branch otherwise.
+ * 
+ * Returns:
+ *   unsigned long long: Start time to be passed to stats_stop(), 0 when not counting.
+ */
+unsigned long long stats_start(void)
+{
+    return stats_current != NULL ? now_ns() : 0;
+}
+
+/**
+ * Adds the time since stats_start() to a phase of the current file.
+ * 
+ * Parameters:
+ *   phase (StatPhase): The phase.
+ *   start (unsigned long long): Value returned by stats_start().
+ */
+void stats_stop(StatPhase phase, unsigned long long start)
+{
+    if (stats_current != NULL && start != 0)
+    {
+        stats_current->nanosec[phase] += now_ns() - start;
+    }
+}
+
+/**
+ * Adds to a counter of the current file of the calling thread.
+ * 
+ * Parameters:
+ *   counter (StatCounter): The counter.
+ *   value (unsigned long long): The amount.
+ */
+void stats_count(StatCounter counter, unsigned long long value)
+{
+    if (stats_current != NULL)
+    {
+        stats_current->counters[counter] += value;
+    }
+}
+
+/**
+ * Adds to a counter of the given statistics, used where the file isn't the
+ * current one of the thread (e.g., io_uring completions).
+ * 
+ * Parameters:
+ *   stats (FileStats*): The statistics.
+ *   counter (StatCounter): The counter.
+ *   value (unsigned long long): The amount.
+ */
+void stats_count_to(FileStats *stats, StatCounter counter, unsigned long long value)
+{
+    if (stats_enabled)
+    {
+        stats->counters[counter] += value;
+    }
+}
+
+/**
+ * Counts one call and the bytes it moved for the current file.
+ * 
+ * Parameters:
+ *   calls (StatCounter): Counter of the calls.
+ *   bytes (StatCounter): Counter of the bytes.
+ *   moved (ssize_t): Bytes moved by the call, negative on error.
+ */
+static void count_io(StatCounter calls, StatCounter bytes, ssize_t moved)
+{
+    if (stats_current != NULL)
+    {
+        stats_current->counters[calls]++;
+        stats_current->counters[bytes] += moved > 0 ? moved : 0;
+    }
+}
+
+/**
+ * open() that counts the open for the current file.
+ * 
+ * Parameters:
+ *   path (const char*): The file.
+ *   flags (int): Open flags.
+ *   mode (mode_t): Permissions of a created file.
+ * 
+ * Returns:
+ *   int: The descriptor, or -1 on error.
+ */
+int stats_open(const char *path, int flags, mode_t mode)
+{
+    stats_count(count_opens, 1);
+    return open(path, flags, mode);
+}
+
+/**
+ * pread() that counts the read and its bytes for the current file.
+ * 
+ * Parameters:
+ *   fd (int): The descriptor.
+ *   buffer (void*): Where the bytes are stored.
+ *   count (size_t): Number of bytes wanted.
+ *   offset (off_t): File offset.
+ * 
+ * Returns:
+ *   ssize_t: Bytes read, or -1 on error.
+ */
+ssize_t stats_pread(int fd, void *buffer, size_t count, off_t offset)
+{
+    ssize_t got = pread(fd, buffer, count, offset);
+    count_io(count_reads, count_bytes_read, got);
+    return got;
+}
+
+/**
+ * pwrite() that counts the write and its bytes for the current file.
+ * 
+ * Parameters:
+ *   fd (int): The descriptor.
+ *   buffer (const void*): The bytes.
+ *   count (size_t): Number of bytes.
+ *   offset (off_t): File offset.
+ * 
+ * Returns:
+ *   ssize_t: Bytes written, or -1 on error.
+ */
+ssize_t stats_pwrite(int fd, const void *buffer, size_t count, off_t offset)
+{
+    ssize_t done = pwrite(fd, buffer, count, offset);
+    count_io(count_writes, count_bytes_written, done);
+    return done;
+}
+
+/**
+ * read() that counts the read and its bytes for the current file.
+ * 
+ * Parameters:
+ *   fd (int): The descriptor.
+ *   buffer (void*): Where the bytes are stored.
+ *   count (size_t): Number of bytes wanted.
+ * 
+ * Returns:
+ *   ssize_t: Bytes read, or -1 on error.
+ */
+ssize_t stats_read(int fd, void *buffer, size_t count)
+{
+    ssize_t got = read(fd, buffer, count);
+    count_io(count_reads, count_bytes_read, got);
+    return got;
+}
+
+/**
+ * write() that counts the write and its bytes for the current file.
+ * 
+ * Parameters:
+ *   fd (int): The descriptor.
+ *   buffer (const void*): The bytes.
+ *   count (size_t): Number of bytes.
+ * 
+ * Returns:
+ *   ssize_t: Bytes written, or -1 on error.
+ */
+ssize_t stats_write(int fd, const void *buffer, size_t count)
+{
+    ssize_t done = write(fd, buffer, count);
+    count_io(count_writes, count_bytes_written, done);
+    return done;
+}
+
+/**
+ * lseek() that counts the seek for the current file.
+ * 
+ * Parameters:
+ *   fd (int): The descriptor.
+ *   offset (off_t): The offset.
+ *   whence (int): SEEK_SET, SEEK_CUR or SEEK_END.
+ * 
+ * Returns:
+ *   off_t: The new offset, or -1 on error.
+ */
+off_t stats_lseek(int fd, off_t offset, int whence)
+{
+    stats_count(count_seeks, 1);
+    return lseek(fd, offset, whence);
+}
+
+/**
+ * fopen() that counts the open for the current file.
+ * 
+ * Parameters:
+ *   path (const char*): The file.
+ *   mode (const char*): The fopen() mode.
+ * 
+ * Returns:
+ *   FILE*: The stream, or NULL on error.
+ */
+FILE *stats_fopen(const char *path, const char *mode)
+{
+    stats_count(count_opens, 1);
+    return fopen(path, mode);
+}
+
+/**
+ * fread() that counts the read and its bytes for the current file.
+ * 
+ * Parameters:
+ *   ptr (void*): Where the items are stored.
+ *   size (size_t): Size of one item.
+ *   nmemb (size_t): Number of items.
+ *   fptr (FILE*): The stream.
+ * 
+ * Returns:
+ *   size_t: Number of items read.
+ */
+size_t stats_fread(void *ptr, size_t size, size_t nmemb, FILE *fptr)
+{
+    size_t got = fread(ptr, size, nmemb, fptr);
+    count_io(count_reads, count_bytes_read, got * size);
+    return got;
+}
+
+/**
+ * fwrite() that counts the write and its bytes for the current file.
+ * 
+ * Parameters:
+ *   ptr (const void*): The items.
+ *   size (size_t): Size of one item.
+ *   nmemb (size_t): Number of items.
+ *   fptr (FILE*): The stream.
+ * 
+ * Returns:
+ *   size_t: Number of items written.
+ */
+size_t stats_fwrite(const void *ptr, size_t size, size_t nmemb, FILE *fptr)
+{
+    size_t done = fwrite(ptr, size, nmemb, fptr);
+    count_io(count_writes, count_bytes_written, done * size);
+    return done;
+}
+
+/**
+ * fseeko() that counts the seek for the current file.
+ * 
+ * Parameters:
+ *   fptr (FILE*): The stream.
+ *   offset (off_t): The offset.
+ *   whence (int): SEEK_SET, SEEK_CUR or SEEK_END.
+ * 
+ * Returns:
+ *   int: 0 on success, -1 on error.
+ */
+int stats_fseek(FILE *fptr, off_t offset, int whence)
+{
+    stats_count(count_seeks, 1);
+    return fseeko(fptr, offset, whence);
+}
+
+/**
+ * Prints the totals and averages of every file ended so far, when --stats was given.
+ * 
+ * Parameters:
+ *   out (FILE*): Stream the totals are printed to.
+ */
+void stats_print_total(FILE *out)
+{
+    if (!stats_enabled)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    unsigned long files = stats_files ? stats_files : 1;
+    fprintf(out, "----------------------------------------[[ STATS ]]----------------------------------------\n");
+    fprintf(out, "FILES    :   %lu\n", stats_files);
+    for (int i = 0; i < phase_count; i++)
+    {
+        fprintf(out, "%-9s:   %10.3f ms total, %10.1f us per file\n", phase_names[i],
+                stats_totals.nanosec[i] / 1e6, stats_totals.nanosec[i] / 1e3 / files);
+    }
+    for (int i = 0; i < count_total; i++)
+    {
+        fprintf(out, "%-9s:   %10llu total, %10.1f per file\n", counter_names[i],
+                stats_totals.counters[i], (double)stats_totals.counters[i] / files);
+    }
+    fprintf(out, "--------------------------------------------------------------------------------------------\n");
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * Prints the totals to the stream chosen with stats_print_at_exit().
+ */
+static void print_total_at_exit(void)
+{
+    stats_print_total(stats_exit_out);
+}
+
+/**
+ * Prints the totals with stats_print_total() when the program exits, on success or failure.
+ * 
+ * Parameters:
+ *   out (FILE*): Stream the totals are printed to.
+ */
+void stats_print_at_exit(FILE *out)
+{
+    if (stats_enabled && stats_exit_out == NULL)
+    {
+        stats_exit_out = out;
+        atexit(print_total_at_exit);
+    }
+}
@@ -0,0 +1,271 @@
+#ifndef MP3_STATS_H
+#define MP3_STATS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "types.h"
+
+/**
+ * Enum to represent the phases the time of one file is split into.
+ */
+typedef enum
+{
+    phase_open,       // Opening the files
+    phase_header,     // Reading and checking the ID3 header
+    phase_parse,      // Reading the tag and indexing or building its frames
+    phase_output,     // Printing the details or the record
+    phase_write,      // Writing the changed frames
+    phase_copy,       // Moving the payload with the copy engine
+    phase_count       // Number of phases
+} StatPhase;
+
+/**
+ * Enum to represent the I/O counters of one file.
+ */
+typedef enum
+{
+    count_opens,          // Files opened
+    count_reads,          // Read calls
+    count_bytes_read,     // Bytes read
+    count_writes,         // Write calls
+    count_bytes_written,  // Bytes written
+    count_seeks,          // Seeks
+    count_total           // Number of counters
+} StatCounter;
+
+// Structure to store the phase timers and I/O counters of one file
+typedef struct FileStats
+{
+    unsigned long long nanosec[phase_count];   // Time spent in each phase
+    unsigned long long counters[count_total];  // I/O counters
+} FileStats;
+
+// Function Prototypes
+
+/**
+ * Finds a --stats argument and removes it from the argument list. Statistics are
+ * collected from then on.
+ * 
+ * @param argc (int*): Number of command-line arguments, lowered when the option is removed.
+ * @param argv (char*[]): Command-line arguments.
+ * 
+ * @returns int: 1 if --stats was given, 0 otherwise.
+ */
+int parse_stats_option(int *argc, char *argv[]);
+
+
+/**
+ * Clears the statistics of a file and makes them the ones the calling thread counts into.
+ * Does nothing unless --stats was given.
+ * 
+ * @param stats (FileStats*): Statistics of the file.
+ */
+void stats_begin(FileStats *stats);
+
+
+/**
+ * Stops counting into the statistics of a file, prints them as one line
+ * and adds them to the totals.
+ * 
+ * @param stats (FileStats*): Statistics of the file, as passed to stats_begin().
+ * @param out (FILE*): Stream the line is printed to.
+ * @param name (const char*): Name of the file.
+ */
+void stats_end(FileStats *stats, FILE *out, const char *name);
+
+
+/**
+ * Makes other statistics the ones the calling thread counts into, without clearing them
+ * (e.g., a reader thread counting for the file it reads).
+ * 
+ * @param stats (FileStats*): The statistics, NULL to stop counting.
+ * 
+ * @returns FileStats*: The statistics counted into before.
+ */
+FileStats *stats_attach(FileStats *stats);
+
+
+/**
+ * Adds the statistics collected elsewhere for the current file of the calling thread.
+ * 
+ * @param stats (const FileStats*): The statistics to be added.
+ */
+void stats_merge(const FileStats *stats);
+
+
+/**
+ * Starts timing a phase of the current file.
+ * 
+ * @returns unsigned long long: Start time to be passed to stats_stop(), 0 when not counting.
+ */
+unsigned long long stats_start(void);
+
+
+/**
+ * Adds the time since stats_start() to a phase of the current file.
+ * 
+ * @param phase (StatPhase): The phase.
+ * @param start (unsigned long long): Value returned by stats_start().
+ */
+void stats_stop(StatPhase phase, unsigned long long start);
+
+
+/**
+ * Adds to a counter of the current file of the calling thread.
+ * 
+ * @param counter (StatCounter): The counter.
+ * @param value (unsigned long long): The amount.
+ */
+void stats_count(StatCounter counter, unsigned long long value);
+
+
+/**
+ * Adds to a counter of the given statistics, used where the file isn't the
+ * current one of the thread (e.g., io_uring completions).
+ * 
+ * @param stats (FileStats*): The statistics.
+ * @param counter (StatCounter): The counter.
+ * @param value (unsigned long long): The amount.
+ */
+void stats_count_to(FileStats *stats, StatCounter counter, unsigned long long value);
+
+
+/**
+ * open() that counts the open for the current file.
+ * 
+ * @param path (const char*): The file.
+ * @param flags (int): Open flags.
+ * @param mode (mode_t): Permissions of a created file.
+ * 
+ * @returns int: The descriptor, or -1 on error.
+ */
+int stats_open(const char *path, int flags, mode_t mode);
+
+
+/**
+ * pread() that counts the read and its bytes for the current file.
+ * 
+ * @param fd (int): The descriptor.
+ * @param buffer (void*): Where the bytes are stored.
+ * @param count (size_t): Number of bytes wanted.
+ * @param offset (off_t): File offset.
+ * 
+ * @returns ssize_t: Bytes read, or -1 on error.
+ */
+ssize_t stats_pread(int fd, void *buffer, size_t count, off_t offset);
+
+
+/**
+ * pwrite() that counts the write and its bytes for the current file.
+ * 
+ * @param fd (int): The descriptor.
+ * @param buffer (const void*): The bytes.
+ * @param count (size_t): Number of bytes.
+ * @param offset (off_t): File offset.
+ * 
+ * @returns ssize_t: Bytes written, or -1 on error.
+ */
+ssize_t stats_pwrite(int fd, const void *buffer, size_t count, off_t offset);
+
+
+/**
+ * read() that counts the read and its bytes for the current file.
+ * 
+ * @param fd (int): The descriptor.
+ * @param buffer (void*): Where the bytes are stored.
+ * @param count (size_t): Number of bytes wanted.
+ * 
+ * @returns ssize_t: Bytes read, or -1 on error.
+ */
+ssize_t stats_read(int fd, void *buffer, size_t count);
+
+
+/**
+ * write() that counts the write and its bytes for the current file.
+ * 
+ * @param fd (int): The descriptor.
+ * @param buffer (const void*): The bytes.
+ * @param count (size_t): Number of bytes.
+ * 
+ * @returns ssize_t: Bytes written, or -1 on error.
+ */
+ssize_t stats_write(int fd, const void *buffer, size_t count);
+
+
+/**
+ * lseek() that counts the seek for the current file.
+ * 
+ * @param fd (int): The descriptor.
+ * @param offset (off_t): The offset.
+ * @param whence (int): SEEK_SET, SEEK_CUR or SEEK_END.
+ * 
+ * @returns off_t: The new offset, or -1 on error.
+ */
+off_t stats_lseek(int fd, off_t offset, int whence);
+
+
+/**
+ * fopen() that counts the open for the current file.
+ * 
+ * @param path (const char*): The file.
+ * @param mode (const char*): The fopen() mode.
+ * 
+ * @returns FILE*: The stream, or NULL on error.
+ */
+FILE *stats_fopen(const char *path, const char *mode);
+
+
+/**
+ * fread() that counts the read and its bytes for the current file.
+ * 
+ * @param ptr (void*): Where the items are stored.
+ * @param size (size_t): Size of one item.
+ * @param nmemb (size_t): Number of items.
+ * @param fptr (FILE*): The stream.
+ * 
+ * @returns size_t: Number of items read.
+ */
+size_t stats_fread(void *ptr, size_t size, size_t nmemb, FILE *fptr);
+
+
+/**
+ * fwrite() that counts the write and its bytes for the current file.
+ * 
+ * @param ptr (const void*): The items.
+ * @param size (size_t): Size of one item.
+ * @param nmemb (size_t): Number of items.
+ * @param fptr (FILE*): The stream.
+ * 
+ * @returns size_t: Number of items written.
+ */
+size_t stats_fwrite(const void *ptr, size_t size, size_t nmemb, FILE *fptr);
+
+
+/**
+ * fseeko() that counts the seek for the current file.
+ * 
+ * @param fptr (FILE*): The stream.
+ * @param offset (off_t): The offset.
+ * @param whence (int): SEEK_SET, SEEK_CUR or SEEK_END.
+ * 
+ * @returns int: 0 on success, -1 on error.
+ */
+int stats_fseek(FILE *fptr, off_t offset, int whence);
+
+
+/**
+ * Prints the totals and averages of every file ended so far, when --stats was given.
+ * 
+ * @param out (FILE*): Stream the totals are printed to.
+ */
+void stats_print_total(FILE *out);
+
+
+/**
+ * Prints the totals with stats_print_total() when the program exits, on success or failure.
+ * 
+ * @param out (FILE*): Stream the totals are printed to.
+ */
+void stats_print_at_exit(FILE *out);
+
+#endif
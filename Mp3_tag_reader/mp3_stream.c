@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "types.h"
+#include "mp3_frame.h"
+#include "mp3_edit.h"
+#include "mp3_view.h"
+#include "mp3_copy.h"
+#include "mp3_stats.h"
+#include "mp3_stream.h"
+
+// Size of the zero block used to write padding
+#define STREAM_ZEROS 4096
+
+/**
+ * Validates the arguments of the streaming mode.
+ * 
+ * Parameters:
+ *   argc (int): Number of command-line arguments.
+ *   argv (char*[]): Command-line arguments, option and text pairs from index 2 on (none to only view).
+ *   stream (StreamInfo*): A pointer to the structure where the stream information will be stored.
+ * 
+ * Returns:
+ *   Status: e_success if validation passes, e_failure if there's an error.
+ */
+Status read_and_validation_stream(int argc, char *argv[], StreamInfo *stream)
+{
+    // The details go to stderr so they never mix with the forwarded data
+    stream->fd_in = STDIN_FILENO;
+    stream->fd_out = STDOUT_FILENO;
+    stream->out = stderr;
+    init_edit(&stream->edit);
+    stream->edit.out = stderr;
+    stream->edit.edit_count = 0;
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        int duplicate = 0;
+        for (int j = 0; j < stream->edit.edit_count; j++)
+        {
+            duplicate |= strcmp(stream->edit.edits[j].frame, argv[i]) == 0;
+        }
+        if (i + 1 >= argc || get_frame_id(argv[i]) == NULL || duplicate || stream->edit.edit_count == MAX_EDITS)
+        {
+            fprintf(stderr, "-------------------------------------------------------------------------------\n\n");
+            fprintf(stderr, "ERROR: ./a.out : INVALID ARGUMENTS\n");
+            fprintf(stderr, "USAGE :\nTo stream please pass like: ./a.out -s [-t/-a/-A/-m/-y/-c changing_text ...] < in.mp3 > out.mp3\n");
+            fprintf(stderr, "-------------------------------------------------------------------------------\n");
+            return e_failure;
+        }
+
+        // Store the frame type and data to be modified
+        FrameEdit *edit = &stream->edit.edits[stream->edit.edit_count++];
+        edit->frame = argv[i];
+        edit->modify_data = argv[i + 1];
+        edit->data_length = strlen(edit->modify_data) + 1;
+    }
+
+    return e_success;
+}
+
+/**
+ * Reads exactly size bytes unless the input ends first.
+ * 
+ * Parameters:
+ *   fd (int): The input descriptor.
+ *   buffer (unsigned char*): Where the bytes are stored.
+ *   size (uint): Number of bytes wanted.
+ * 
+ * Returns:
+ *   uint: Number of bytes read, less than size only at end of input or on error.
+ */
+static uint read_full(int fd, unsigned char *buffer, uint size)
+{
+    uint done = 0;
+    while (done < size)
+    {
+        ssize_t count = stats_read(fd, buffer + done, size - done);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            break;
+        }
+        done += count;
+    }
+    return done;
+}
+
+/**
+ * Writes all size bytes.
+ * 
+ * Parameters:
+ *   fd (int): The output descriptor.
+ *   buffer (const unsigned char*): The bytes to be written.
+ *   size (uint): Number of bytes.
+ * 
+ * Returns:
+ *   Status: e_success if every byte was written, e_failure if an error occurs.
+ */
+static Status write_full(int fd, const unsigned char *buffer, uint size)
+{
+    while (size > 0)
+    {
+        ssize_t count = stats_write(fd, buffer, size);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return e_failure;
+        }
+        buffer += count;
+        size -= count;
+    }
+    return e_success;
+}
+
+/**
+ * Writes size zero bytes of padding.
+ * 
+ * Parameters:
+ *   fd (int): The output descriptor.
+ *   size (uint): Number of bytes.
+ * 
+ * Returns:
+ *   Status: e_success if the padding was written, e_failure if an error occurs.
+ */
+static Status write_padding(int fd, uint size)
+{
+    static const unsigned char zeros[STREAM_ZEROS];
+    while (size > 0)
+    {
+        uint count = size < STREAM_ZEROS ? size : STREAM_ZEROS;
+        if (write_full(fd, zeros, count) == e_failure)
+        {
+            return e_failure;
+        }
+        size -= count;
+    }
+    return e_success;
+}
+
+/**
+ * Writes the tag with the new frames, unsynchronised if the tag was. The tag keeps its size when the frames fit, so the
+ * audio data stays at the same offset; otherwise (or when compacting a tag with more padding than the policy reserves)
+ * it is written with the padding the policy reserves.
+ * The ID3v2.4 footer, read from the input before, is written with the size of the new tag.
+ * 
+ * Parameters:
+ *   stream (StreamInfo*): A pointer to the structure containing the stream information.
+ * 
+ * Returns:
+ *   Status: e_success if the tag was written, e_failure if an error occurs.
+ */
+static Status write_tag(StreamInfo *stream)
+{
+    Mp3EditInfo *mp3Edit = &stream->edit;
+    uint padding = mp3Edit->tag_size - mp3Edit->encoded_size;
+    if (mp3Edit->encoded_size > mp3Edit->tag_size ||
+        (mp3Edit->padding_policy.compact && padding > padding_reserve(mp3Edit)))
+    {
+        padding = mp3Edit->padding_reserved = padding_reserve(mp3Edit);
+        int_to_syncsafe(stream->header + 6, mp3Edit->encoded_size + padding);
+    }
+
+    if (write_full(stream->fd_out, stream->header, ID3_HEADER_SIZE) == e_failure ||
+        write_full(stream->fd_out, mp3Edit->encoded, mp3Edit->encoded_size) == e_failure ||
+        write_padding(stream->fd_out, padding) == e_failure)
+    {
+        return e_failure;
+    }
+
+    if (stream->footer_size > 0)
+    {
+        unsigned char footer[ID3_HEADER_SIZE];
+        memcpy(footer, stream->footer, ID3_HEADER_SIZE);
+        memcpy(footer + 6, stream->header + 6, 4);
+        return write_full(stream->fd_out, footer, ID3_HEADER_SIZE);
+    }
+    return e_success;
+}
+
+/**
+ * Forwards the input unchanged after an error: the tag header, the frame region and the
+ * footer bytes as they were read, then the rest of the input.
+ * 
+ * Parameters:
+ *   stream (StreamInfo*): A pointer to the structure containing the stream information.
+ *   raw (const unsigned char*): The frame region as it was read.
+ *   size (uint): Number of bytes of the frame region read.
+ */
+static void forward_unchanged(StreamInfo *stream, const unsigned char *raw, uint size)
+{
+    write_full(stream->fd_out, stream->header, ID3_HEADER_SIZE);
+    write_full(stream->fd_out, raw, size);
+    write_full(stream->fd_out, stream->footer, stream->footer_size);
+    copy_stream_data(stream->fd_out, stream->fd_in, NULL);
+}
+
+/**
+ * Prints the details of the tag that is forwarded.
+ * 
+ * Parameters:
+ *   stream (StreamInfo*): A pointer to the structure containing the stream information.
+ *   frames (unsigned char*): The frame region that is forwarded.
+ *   size (uint): Size of the frame region.
+ */
+static void print_stream(StreamInfo *stream, unsigned char *frames, uint size)
+{
+    Mp3ViewInfo mp3View;
+    mp3View.out = stream->out;
+    mp3View.arena = &stream->edit.arena;
+    mp3View.tag = frames;
+    mp3View.tag_size = size;
+    memcpy(mp3View.header, stream->header, sizeof(mp3View.header));
+    memset(&mp3View.index, 0, sizeof(mp3View.index));
+
+    // The end of the input is never seen before the tag is forwarded, so there are no tail tags
+    mp3View.tail = NULL;
+    mp3View.tail_size = 0;
+    parse_tail_tags(&mp3View.tail_tags, NULL, 0, NULL);
+
+    if (build_frame_index(&mp3View.index, stream->header, frames, size) == e_success && print_info(&mp3View) == e_failure)
+    {
+        fprintf(stream->out, "%s\n", view_message(mp3_err_read));
+    }
+    free_frame_index(&mp3View.index);
+}
+
+/**
+ * Reads one MP3 file from the input, applies the frame changes, prints the resulting details
+ * and forwards the tag and the untouched audio data to the output. The header size comes
+ * before the frames, so the tag itself is held in memory, decoded where it was read (an
+ * unsynchronised tag is decoded from a copy); the audio data is moved in fixed size chunks (or
+ * spliced between pipes). Every byte is read once and neither descriptor is seeked.
+ * Input without an ID3v2.2, v2.3 or v2.4 tag, with a malformed or cut short tag, or whose tag
+ * can't be rebuilt, is forwarded unchanged and reported as a failure.
+ * 
+ * Parameters:
+ *   stream (StreamInfo*): A pointer to the structure containing the stream information.
+ * 
+ * Returns:
+ *   Status: e_success if the file was forwarded with its changes, e_failure if an error occurs.
+ */
+Status stream_info(StreamInfo *stream)
+{
+    Mp3EditInfo *mp3Edit = &stream->edit;
+    unsigned long long start = stats_start();
+    uint have = read_full(stream->fd_in, stream->header, ID3_HEADER_SIZE);
+    stats_stop(phase_header, start);
+
+    Status status = e_failure;
+    if (have < ID3_HEADER_SIZE || strncmp((char *)stream->header, "ID3", 3) != 0)
+    {
+        fprintf(stream->out, "Invalid Mp3 ID format, forwarding the input unchanged\n");
+    }
+    else if (get_frame_parser(stream->header) == NULL)
+    {
+        fprintf(stream->out, "Invalid ID3 version, forwarding the input unchanged\n");
+    }
+    else
+    {
+        status = e_success;
+    }
+    if (status == e_failure)
+    {
+        write_full(stream->fd_out, stream->header, have);
+        copy_stream_data(stream->fd_out, stream->fd_in, NULL);
+        return e_failure;
+    }
+
+    // Read the frame region (and the footer) once, undo its unsynchronisation and index it. The
+    // frames are decoded where they were read unless decoding changes them, in which case they
+    // are decoded from a copy, so the tag can still be forwarded as it was read
+    start = stats_start();
+    unsigned char header[ID3_HEADER_SIZE];
+    memcpy(header, stream->header, ID3_HEADER_SIZE);
+    memcpy(mp3Edit->header, stream->header, ID3_HEADER_SIZE);
+    mp3Edit->tag_size = syncsafe_to_int(stream->header + 6);
+    unsigned char *raw = arena_alloc(&mp3Edit->arena, mp3Edit->tag_size + 1);
+    uint got = raw != NULL ? read_full(stream->fd_in, raw, mp3Edit->tag_size) : 0;
+    stream->footer_size = 0;
+    if (got == mp3Edit->tag_size && stream->header[3] == 4 && (stream->header[5] & ID3_FOOTER_FLAG))
+    {
+        stream->footer_size = read_full(stream->fd_in, stream->footer, ID3_HEADER_SIZE);
+    }
+    status = e_failure;
+    if (got == mp3Edit->tag_size && stream->footer_size % ID3_HEADER_SIZE == 0)
+    {
+        mp3Edit->tag = raw;
+        if (tag_is_unsynced(header, raw, mp3Edit->tag_size))
+        {
+            mp3Edit->tag = arena_alloc(&mp3Edit->arena, mp3Edit->tag_size + 1);
+            if (mp3Edit->tag != NULL)
+            {
+                memcpy(mp3Edit->tag, raw, mp3Edit->tag_size);
+            }
+        }
+        if (mp3Edit->tag != NULL)
+        {
+            mp3Edit->synced_size = resync_tag(header, mp3Edit->tag, mp3Edit->tag_size);
+            status = build_frame_index(&mp3Edit->index, header, mp3Edit->tag, mp3Edit->synced_size);
+        }
+    }
+    if (status == e_failure)
+    {
+        // A malformed or cut short tag goes out as it came in, with the rest of the input
+        fprintf(stream->out, "Error in reading ID3 tag, forwarding the input unchanged\n");
+        forward_unchanged(stream, raw, got);
+        return e_failure;
+    }
+    mp3Edit->padding = mp3Edit->index.padding;
+    stats_stop(phase_parse, start);
+
+    if (mp3Edit->edit_count == 0 && !mp3Edit->padding_policy.compact)
+    {
+        // Only viewing, forward the tag as it was read
+        start = stats_start();
+        print_stream(stream, mp3Edit->tag, mp3Edit->synced_size);
+        stats_stop(phase_output, start);
+        start = stats_start();
+        if (write_full(stream->fd_out, stream->header, ID3_HEADER_SIZE) == e_failure ||
+            write_full(stream->fd_out, raw, mp3Edit->tag_size) == e_failure ||
+            write_full(stream->fd_out, stream->footer, stream->footer_size) == e_failure)
+        {
+            fprintf(stream->out, "Error in writing ID3 tag\n");
+            return e_failure;
+        }
+        stats_stop(phase_write, start);
+    }
+    else
+    {
+        start = stats_start();
+        status = build_frames(mp3Edit);
+        stats_stop(phase_parse, start);
+        if (status == e_failure)
+        {
+            fprintf(stream->out, "Error in building frames, forwarding the input unchanged\n");
+            forward_unchanged(stream, raw, mp3Edit->tag_size);
+            return e_failure;
+        }
+        start = stats_start();
+        print_stream(stream, mp3Edit->frames, mp3Edit->frames_size);
+        stats_stop(phase_output, start);
+        start = stats_start();
+        status = write_tag(stream);
+        stats_stop(phase_write, start);
+        if (status == e_failure)
+        {
+            // What still goes out is the input as it was read
+            fprintf(stream->out, "Error in writing ID3 tag, forwarding the input unchanged\n");
+            forward_unchanged(stream, raw, mp3Edit->tag_size);
+            return e_failure;
+        }
+        fprintf(stream->out, "PADDING   : %u bytes consumed, %u reserved\n", mp3Edit->padding_consumed, mp3Edit->padding_reserved);
+    }
+
+    // Forward the audio data untouched
+    CopyMethod method;
+    if (copy_stream_data(stream->fd_out, stream->fd_in, &method) == e_failure)
+    {
+        fprintf(stream->out, "Error in forwarding audio data\n");
+        return e_failure;
+    }
+    fprintf(stream->out, "COPY PATH : %s\n", copy_method_name(method));
+
+    return e_success;
+}
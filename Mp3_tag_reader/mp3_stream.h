@@ -0,0 +1,46 @@
+#ifndef MP3_STREAM_H
+#define MP3_STREAM_H
+
+#include <stdio.h>
+#include "types.h"
+#include "mp3_edit.h"
+
+// Structure to store the state of a streamed view or edit
+typedef struct StreamInfo
+{
+    int fd_in;             // Descriptor the MP3 data is read from (e.g., stdin), never seeked
+    int fd_out;            // Descriptor the MP3 data is forwarded to (e.g., stdout)
+    FILE *out;             // Stream the details are printed to (e.g., stderr)
+
+    unsigned char header[10];  // ID3 tag header as read from the input
+    unsigned char footer[10];  // ID3v2.4 footer as read from the input
+    uint footer_size;      // Number of footer bytes read
+    Mp3EditInfo edit;      // Frame changes with the tag, frame table and new frames
+} StreamInfo;
+
+// Function Prototypes
+
+/**
+ * Validates the arguments of the streaming mode.
+ * 
+ * @param argc (int): Number of command-line arguments.
+ * @param argv (char*[]): Command-line arguments, option and text pairs from index 2 on (none to only view).
+ * @param stream (StreamInfo*): Structure to store the stream information.
+ * 
+ * @returns Status: e_success if validation is successful, e_failure if there's an error.
+ */
+Status read_and_validation_stream(int argc, char *argv[], StreamInfo *stream);
+
+
+/**
+ * Reads one MP3 file from the input, applies the frame changes, prints the resulting details
+ * and forwards the tag and the untouched audio data to the output. Every byte is read once
+ * and neither descriptor is seeked.
+ * 
+ * @param stream (StreamInfo*): Structure containing the stream information.
+ * 
+ * @returns Status: e_success if the file was forwarded with its changes, e_failure if an error occurs.
+ */
+Status stream_info(StreamInfo *stream);
+
+#endif
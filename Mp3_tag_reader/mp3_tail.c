@@ -0,0 +1,383 @@
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "types.h"
+#include "mp3_text.h"
+#include "mp3_stats.h"
+#include "mp3_tail.h"
+
+// Size of an ID3v1 tag
+#define ID3V1_SIZE 128
+
+// Size of the footer (and the optional header) of an APE tag
+#define APE_FOOTER_SIZE 32
+
+// Flag of the APE footer telling that the tag also starts with a header
+#define APE_HAS_HEADER 0x80000000u
+
+// Size of the end of a Lyrics3v2 block: 6 digit size and "LYRICS200"
+#define LYRICS3_END_SIZE 15
+
+// Largest Lyrics3v1 block, without its "LYRICSBEGIN" and "LYRICSEND" markers
+#define LYRICS3V1_MAX 5100
+
+// Precedence of the tags, a field is taken from the tag of the highest rank that has it
+enum
+{
+    rank_id3v1 = 1,
+    rank_lyrics3,
+    rank_ape
+};
+
+// ID3v2 frame holding each field
+static const char *const field_frames[tail_fields] = { "TIT2", "TPE1", "TALB", "TYER", "TCON", "COMM" };
+
+// Genres named by the ID3v1 genre byte, with the Winamp extensions
+static const char *const id3v1_genres[] =
+{
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+    "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap",
+    "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks",
+    "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+    "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "AlternRock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock",
+    "Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+    "Native American", "Cabaret", "New Wave", "Psychadelic", "Rave", "Showtunes", "Trailer", "Lo-Fi",
+    "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock",
+    "Folk", "Folk-Rock", "National Folk", "Swing", "Fast Fusion", "Bebob", "Latin", "Revival",
+    "Celtic", "Bluegrass", "Avantgarde", "Gothic Rock", "Progressive Rock", "Psychedelic Rock", "Symphonic Rock", "Slow Rock",
+    "Big Band", "Chorus", "Easy Listening", "Acoustic", "Humour", "Speech", "Chanson", "Opera",
+    "Chamber Music", "Sonata", "Symphony", "Booty Bass", "Primus", "Porn Groove", "Satire", "Slow Jam",
+    "Club", "Tango", "Samba", "Folklore", "Ballad", "Power Ballad", "Rhythmic Soul", "Freestyle",
+    "Duet", "Punk Rock", "Drum Solo", "A capella", "Euro-House", "Dance Hall", "Goa", "Drum & Bass",
+    "Club-House", "Hardcore", "Terror", "Indie", "BritPop", "Negerpunk", "Polsk Punk", "Beat",
+    "Christian Gangsta Rap", "Heavy Metal", "Black Metal", "Crossover", "Contemporary Christian", "Christian Rock", "Merengue", "Salsa",
+    "Thrash Metal", "Anime", "JPop", "Synthpop",
+};
+
+/**
+ * Reads a 32 bit little-endian number.
+ */
+static uint read_le32(const unsigned char *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint)data[3] << 24;
+}
+
+/**
+ * Reads a number written as count decimal digits, as Lyrics3 does. Returns 0 if a byte isn't a digit.
+ */
+static int read_digits(const unsigned char *data, uint count, uint *value)
+{
+    *value = 0;
+    for (uint i = 0; i < count; i++)
+    {
+        if (data[i] < '0' || data[i] > '9')
+        {
+            return 0;
+        }
+        *value = *value * 10 + (data[i] - '0');
+    }
+    return 1;
+}
+
+/**
+ * Sets a field from encoded text, unless a tag of the same or a higher rank already set it.
+ * Trailing spaces (ID3v1 pads with them) are dropped and empty text never hides another tag.
+ */
+static void set_field(TailTags *tail, TailField field, int rank, const unsigned char *data, uint length,
+                      unsigned char encoding, Arena *arena)
+{
+    if (tail == NULL || tail->rank[field] >= rank)
+    {
+        return;
+    }
+    char *text = arena_alloc(arena, TEXT_UTF8_MAX(length));
+    if (text == NULL)
+    {
+        return;
+    }
+    uint n = text_to_utf8(text, data, length, encoding);
+    while (n > 0 && text[n - 1] == ' ')
+    {
+        n--;
+    }
+    text[n] = '\0';
+    if (n > 0)
+    {
+        tail->fields[field] = text;
+        tail->rank[field] = rank;
+    }
+}
+
+/**
+ * Reads the fields of a 128 byte ID3v1 tag. A zero byte before the last comment byte makes it
+ * ID3v1.1, with the track number in that last byte.
+ */
+static uint parse_id3v1(TailTags *tail, const unsigned char *tag, Arena *arena)
+{
+    int v11 = tag[125] == 0 && tag[126] != 0;
+    set_field(tail, tail_title, rank_id3v1, tag + 3, 30, TEXT_LATIN1, arena);
+    set_field(tail, tail_artist, rank_id3v1, tag + 33, 30, TEXT_LATIN1, arena);
+    set_field(tail, tail_album, rank_id3v1, tag + 63, 30, TEXT_LATIN1, arena);
+    set_field(tail, tail_year, rank_id3v1, tag + 93, 4, TEXT_LATIN1, arena);
+    set_field(tail, tail_comment, rank_id3v1, tag + 97, v11 ? 28 : 30, TEXT_LATIN1, arena);
+    if (tag[127] < sizeof(id3v1_genres) / sizeof(id3v1_genres[0]))
+    {
+        const char *genre = id3v1_genres[tag[127]];
+        set_field(tail, tail_genre, rank_id3v1, (const unsigned char *)genre, strlen(genre), TEXT_LATIN1, arena);
+    }
+    return TAIL_ID3V1 | (v11 ? TAIL_ID3V11 : 0);
+}
+
+/**
+ * Reads the fields of a Lyrics3v2 block, from after "LYRICSBEGIN" to before its size.
+ * Every field is a 3 letter name, a 5 digit size and the text.
+ */
+static void parse_lyrics3v2(TailTags *tail, const unsigned char *data, uint length, Arena *arena)
+{
+    uint pos = 0;
+    uint size;
+    while (pos + 8 <= length && read_digits(data + pos + 3, 5, &size) && size <= length - pos - 8)
+    {
+        const unsigned char *name = data + pos;
+        const unsigned char *text = data + pos + 8;
+        if (memcmp(name, "ETT", 3) == 0)
+        {
+            set_field(tail, tail_title, rank_lyrics3, text, size, TEXT_LATIN1, arena);
+        }
+        else if (memcmp(name, "EAR", 3) == 0)
+        {
+            set_field(tail, tail_artist, rank_lyrics3, text, size, TEXT_LATIN1, arena);
+        }
+        else if (memcmp(name, "EAL", 3) == 0)
+        {
+            set_field(tail, tail_album, rank_lyrics3, text, size, TEXT_LATIN1, arena);
+        }
+        else if (memcmp(name, "INF", 3) == 0)
+        {
+            set_field(tail, tail_comment, rank_lyrics3, text, size, TEXT_LATIN1, arena);
+        }
+        pos += 8 + size;
+    }
+}
+
+/**
+ * Reads the text items of an APE tag. Every item is a 4 byte value size, 4 byte flags,
+ * a null terminated key and the value; keys are compared without case.
+ */
+static void parse_ape(TailTags *tail, const unsigned char *items, uint length, uint count, int v2, Arena *arena)
+{
+    static const struct
+    {
+        const char *key;
+        TailField field;
+    } ape_keys[] =
+    {
+        { "Title", tail_title },
+        { "Artist", tail_artist },
+        { "Album", tail_album },
+        { "Year", tail_year },
+        { "Genre", tail_genre },
+        { "Comment", tail_comment },
+    };
+
+    uint pos = 0;
+    for (uint i = 0; i < count && pos + 8 < length; i++)
+    {
+        uint size = read_le32(items + pos);
+        uint flags = read_le32(items + pos + 4);
+        const unsigned char *key = items + pos + 8;
+        const unsigned char *end = memchr(key, 0, length - pos - 8);
+        if (end == NULL || size > length - (uint)(end + 1 - items))
+        {
+            break;
+        }
+        const unsigned char *value = end + 1;
+        pos = value + size - items;
+
+        // Only UTF-8 text items, not binary data or links
+        if ((flags >> 1 & 3) != 0)
+        {
+            continue;
+        }
+        for (uint k = 0; k < sizeof(ape_keys) / sizeof(ape_keys[0]); k++)
+        {
+            if (strcasecmp((const char *)key, ape_keys[k].key) == 0)
+            {
+                set_field(tail, ape_keys[k].field, rank_ape, value, size, v2 ? TEXT_UTF8 : TEXT_LATIN1, arena);
+            }
+        }
+    }
+}
+
+/**
+ * Walks the tail tags from the end of the block, reading their fields when tail is set.
+ * Returns the bytes taken by the tags and sets *found to the TAIL_* bits of the tags.
+ */
+static uint walk_tail_tags(TailTags *tail, const unsigned char *block, uint length, uint *found, Arena *arena)
+{
+    uint end = length;
+    *found = 0;
+    if (end >= ID3V1_SIZE && memcmp(block + end - ID3V1_SIZE, "TAG", 3) == 0)
+    {
+        *found |= parse_id3v1(tail, block + end - ID3V1_SIZE, arena);
+        end -= ID3V1_SIZE;
+    }
+
+    // Lyrics3 blocks sit right in front of the ID3v1 tag, an APE tag in front of either
+    for (int more = 1; more; )
+    {
+        more = 0;
+        uint size;
+        if ((*found & TAIL_ID3V1) && end >= LYRICS3_END_SIZE && memcmp(block + end - 9, "LYRICS200", 9) == 0 &&
+            read_digits(block + end - LYRICS3_END_SIZE, 6, &size) && size >= 11 && size <= end - LYRICS3_END_SIZE &&
+            memcmp(block + end - LYRICS3_END_SIZE - size, "LYRICSBEGIN", 11) == 0)
+        {
+            parse_lyrics3v2(tail, block + end - LYRICS3_END_SIZE - size + 11, size - 11, arena);
+            end -= LYRICS3_END_SIZE + size;
+            *found |= TAIL_LYRICS3 | TAIL_LYRICS3V2;
+            more = 1;
+        }
+        else if ((*found & TAIL_ID3V1) && !(*found & TAIL_LYRICS3) && end >= 20 && memcmp(block + end - 9, "LYRICSEND", 9) == 0)
+        {
+            // Lyrics3v1 has no size and no fields, its start is searched for
+            uint limit = end - 20 > LYRICS3V1_MAX ? end - 20 - LYRICS3V1_MAX : 0;
+            for (uint i = end - 20 + 1; i-- > limit; )
+            {
+                if (memcmp(block + i, "LYRICSBEGIN", 11) == 0)
+                {
+                    end = i;
+                    *found |= TAIL_LYRICS3;
+                    more = 1;
+                    break;
+                }
+            }
+        }
+        else if (!(*found & TAIL_APE) && end >= APE_FOOTER_SIZE && memcmp(block + end - APE_FOOTER_SIZE, "APETAGEX", 8) == 0)
+        {
+            // The size counts the items and the footer, a tag larger than the block is not seen
+            const unsigned char *footer = block + end - APE_FOOTER_SIZE;
+            uint version = read_le32(footer + 8);
+            size = read_le32(footer + 12);
+            uint count = read_le32(footer + 16);
+            uint header = read_le32(footer + 20) & APE_HAS_HEADER ? APE_FOOTER_SIZE : 0;
+            if (size >= APE_FOOTER_SIZE && size <= end && header <= end - size)
+            {
+                parse_ape(tail, footer - (size - APE_FOOTER_SIZE), size - APE_FOOTER_SIZE, count, version >= 2000, arena);
+                end -= size + header;
+                *found |= TAIL_APE | (version >= 2000 ? TAIL_APEV2 : 0);
+                more = 1;
+            }
+        }
+    }
+
+    return length - end;
+}
+
+/**
+ * Finds the ID3v1, Lyrics3 and APE tags at the end of a block that ends where the file ends.
+ * 
+ * Parameters:
+ *   block (const unsigned char*): The last bytes of the file.
+ *   length (uint): Number of bytes.
+ * 
+ * Returns:
+ *   uint: Number of bytes at the end of the block taken by the tags, 0 if there are none.
+ */
+uint find_tail_tags(const unsigned char *block, uint length)
+{
+    uint found;
+    return walk_tail_tags(NULL, block, length, &found, NULL);
+}
+
+/**
+ * Reads the fields of the tail tags, merged by the precedence APE, Lyrics3, ID3v1.
+ * 
+ * Parameters:
+ *   tail (TailTags*): Filled with the fields, cleared when there are no tags.
+ *   tags (const unsigned char*): The tail tags, from the first tag to the end of the file.
+ *   size (uint): Size of the tail tags.
+ *   arena (Arena*): Arena the texts are taken from.
+ */
+void parse_tail_tags(TailTags *tail, const unsigned char *tags, uint size, Arena *arena)
+{
+    memset(tail, 0, sizeof(*tail));
+    if (tags != NULL && size > 0)
+    {
+        walk_tail_tags(tail, tags, size, &tail->found, arena);
+    }
+}
+
+/**
+ * Reads the last TAIL_PROBE_SIZE bytes of a file with one pread() and finds the tail tags in them.
+ * 
+ * Parameters:
+ *   fd (int): The open file.
+ *   file_size (unsigned long long): Size of the file in bytes.
+ *   block (unsigned char*): Buffer of TAIL_PROBE_SIZE bytes the read goes to.
+ *   tags (unsigned char**): Set to the first byte of the tail tags in block.
+ * 
+ * Returns:
+ *   uint: Size of the tail tags, 0 if there are none or the read fails.
+ */
+uint read_tail_tags(int fd, unsigned long long file_size, unsigned char *block, unsigned char **tags)
+{
+    uint count = file_size < TAIL_PROBE_SIZE ? file_size : TAIL_PROBE_SIZE;
+    *tags = block;
+    if (count == 0 || stats_pread(fd, block, count, file_size - count) != count)
+    {
+        return 0;
+    }
+    uint size = find_tail_tags(block, count);
+    *tags = block + count - size;
+    return size;
+}
+
+/**
+ * Gives the tail tag text of the field an ID3v2 frame holds.
+ * 
+ * Parameters:
+ *   tail (const TailTags*): The parsed tail tags.
+ *   id (const char*): The frame identifier (e.g., TIT2 for title).
+ * 
+ * Returns:
+ *   const char*: The text, or NULL if no tail tag has the field.
+ */
+const char *tail_field(const TailTags *tail, const char *id)
+{
+    for (int i = 0; tail->found != 0 && i < tail_fields; i++)
+    {
+        if (strncmp(id, field_frames[i], 4) == 0)
+        {
+            return tail->fields[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Writes the names of the tail tags found, in file order, separated by commas.
+ * 
+ * Parameters:
+ *   tail (const TailTags*): The parsed tail tags.
+ *   dest (char*): Where the null terminated names are written, 64 bytes.
+ */
+void tail_tag_names(const TailTags *tail, char *dest)
+{
+    dest[0] = '\0';
+    if (tail->found & TAIL_APE)
+    {
+        strcat(dest, tail->found & TAIL_APEV2 ? "APEv2" : "APEv1");
+    }
+    if (tail->found & TAIL_LYRICS3)
+    {
+        strcat(dest, dest[0] ? ", " : "");
+        strcat(dest, tail->found & TAIL_LYRICS3V2 ? "Lyrics3v2" : "Lyrics3v1");
+    }
+    if (tail->found & TAIL_ID3V1)
+    {
+        strcat(dest, dest[0] ? ", " : "");
+        strcat(dest, tail->found & TAIL_ID3V11 ? "ID3v1.1" : "ID3v1");
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef MP3_TAIL_H
+#define MP3_TAIL_H
+
+#include "types.h"
+#include "mp3_arena.h"
+
+// Bytes read from the end of every file, tail tags are only seen if they fit in them
+#define TAIL_PROBE_SIZE (16 * 1024)
+
+// Tags found at the end of a file
+#define TAIL_ID3V1 0x01       // ID3v1, 128 bytes starting with "TAG"
+#define TAIL_ID3V11 0x02      // ID3v1.1, an ID3v1 tag with a track number in its comment
+#define TAIL_LYRICS3 0x04     // Lyrics3 (v1 or v2) block in front of the ID3v1 tag
+#define TAIL_LYRICS3V2 0x08   // The Lyrics3 block is version 2, with fields and a size
+#define TAIL_APE 0x10         // APEv1 or APEv2 tag, found by its 32 byte footer
+#define TAIL_APEV2 0x20       // The APE tag is version 2, with UTF-8 text
+
+// Fields read from the tail tags, in the order of the record columns
+typedef enum
+{
+    tail_title,
+    tail_artist,
+    tail_album,
+    tail_year,
+    tail_genre,
+    tail_comment,
+    tail_fields
+} TailField;
+
+// Structure to store the fields of all tail tags of a file, merged by precedence
+typedef struct TailTags
+{
+    uint found;                        // TAIL_* bits of the tags found
+    const char *fields[tail_fields];   // UTF-8 text of each field, NULL if no tag has it
+    unsigned char rank[tail_fields];   // Precedence of the tag each field was taken from
+} TailTags;
+
+// Function Prototypes
+
+/**
+ * Finds the ID3v1, Lyrics3 and APE tags at the end of a block that ends where the file ends.
+ * The tags are walked from the end: ID3v1 first, then Lyrics3 and APE blocks in either order.
+ * 
+ * @param block (const unsigned char*): The last bytes of the file.
+ * @param length (uint): Number of bytes.
+ * 
+ * @returns uint: Number of bytes at the end of the block taken by the tags, 0 if there are none.
+ */
+uint find_tail_tags(const unsigned char *block, uint length);
+
+
+/**
+ * Reads the fields of the tail tags found by find_tail_tags(). When several tags have
+ * the same field, APE wins over Lyrics3 and Lyrics3 over ID3v1 (whose fields are cut at
+ * 30 characters). Text is decoded to UTF-8 into the arena.
+ * 
+ * @param tail (TailTags*): Filled with the fields, cleared when there are no tags.
+ * @param tags (const unsigned char*): The tail tags, from the first tag to the end of the file.
+ * @param size (uint): Size of the tail tags.
+ * @param arena (Arena*): Arena the texts are taken from.
+ */
+void parse_tail_tags(TailTags *tail, const unsigned char *tags, uint size, Arena *arena);
+
+
+/**
+ * Reads the last TAIL_PROBE_SIZE bytes of a file with a single positioned read and finds
+ * the tail tags in them. The file offset is left untouched.
+ * 
+ * @param fd (int): The open file.
+ * @param file_size (unsigned long long): Size of the file in bytes.
+ * @param block (unsigned char*): Buffer of TAIL_PROBE_SIZE bytes the read goes to.
+ * @param tags (unsigned char**): Set to the first byte of the tail tags in block.
+ * 
+ * @returns uint: Size of the tail tags, 0 if there are none or the read fails.
+ */
+uint read_tail_tags(int fd, unsigned long long file_size, unsigned char *block, unsigned char **tags);
+
+
+/**
+ * Gives the tail tag text of the field an ID3v2 frame holds (TIT2, TPE1, TALB, TYER, TCON or COMM).
+ * 
+ * @param tail (const TailTags*): The parsed tail tags.
+ * @param id (const char*): The frame identifier.
+ * 
+ * @returns const char*: The text, or NULL if no tail tag has the field.
+ */
+const char *tail_field(const TailTags *tail, const char *id);
+
+
+/**
+ * Writes the names of the tail tags found, separated by commas (e.g., "APEv2, ID3v1.1").
+ * 
+ * @param tail (const TailTags*): The parsed tail tags.
+ * @param dest (char*): Where the null terminated names are written, 64 bytes.
+ */
+void tail_tag_names(const TailTags *tail, char *dest);
+
+#endif
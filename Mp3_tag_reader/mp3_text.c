@@ -0,0 +1,358 @@
+#include <string.h>
+#include <stdint.h>
+#include "types.h"
+#include "mp3_text.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Appends a code point as UTF-8.
+ */
+static inline uint put_utf8(char *dest, uint out, uint32_t c)
+{
+    if (c < 0x80)
+    {
+        dest[out++] = c;
+    }
+    else if (c < 0x800)
+    {
+        dest[out++] = 0xC0 | (c >> 6);
+        dest[out++] = 0x80 | (c & 0x3F);
+    }
+    else if (c < 0x10000)
+    {
+        dest[out++] = 0xE0 | (c >> 12);
+        dest[out++] = 0x80 | ((c >> 6) & 0x3F);
+        dest[out++] = 0x80 | (c & 0x3F);
+    }
+    else
+    {
+        dest[out++] = 0xF0 | (c >> 18);
+        dest[out++] = 0x80 | ((c >> 12) & 0x3F);
+        dest[out++] = 0x80 | ((c >> 6) & 0x3F);
+        dest[out++] = 0x80 | (c & 0x3F);
+    }
+    return out;
+}
+
+/**
+ * Reads the code point at *pos of a UTF-8 text and moves past it.
+ * Malformed sequences (overlong forms and surrogates included) give U+FFFD and are
+ * skipped one byte at a time.
+ */
+static uint32_t next_utf8(const unsigned char *text, uint length, uint *pos)
+{
+    static const uint32_t smallest[] = { 0, 0x80, 0x800, 0x10000 };
+    unsigned char c = text[(*pos)++];
+    if (c < 0x80)
+    {
+        return c;
+    }
+
+    uint extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    if (extra == 0 || c > 0xF4 || *pos + extra > length)
+    {
+        return 0xFFFD;
+    }
+    uint32_t code = c & (0x3F >> extra);
+    for (uint i = 0; i < extra; i++)
+    {
+        if ((text[*pos + i] & 0xC0) != 0x80)
+        {
+            return 0xFFFD;
+        }
+        code = code << 6 | (text[*pos + i] & 0x3F);
+    }
+    if (code < smallest[extra] || code > 0x10FFFF || (code >= 0xD800 && code < 0xE000))
+    {
+        return 0xFFFD;
+    }
+    *pos += extra;
+    return code;
+}
+
+/**
+ * Decodes ISO-8859-1, whose characters are the first 256 code points.
+ */
+static uint decode_latin1(char *dest, const unsigned char *data, uint length)
+{
+    uint in = 0, out = 0;
+    while (in < length)
+    {
+#ifdef __SSE2__
+        // Copy 16 ASCII characters at once, up to the first other byte
+        if (in + 16 <= length)
+        {
+            __m128i block = _mm_loadu_si128((const __m128i *)(data + in));
+            uint stop = (uint)(_mm_movemask_epi8(block) | _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128())));
+            _mm_storeu_si128((__m128i *)(dest + out), block);
+            uint n = stop == 0 ? 16 : __builtin_ctz(stop);
+            in += n;
+            out += n;
+            if (n == 16)
+            {
+                continue;
+            }
+        }
+#endif
+        if (data[in] == 0)
+        {
+            break;
+        }
+        out = put_utf8(dest, out, data[in++]);
+    }
+    return out;
+}
+
+/**
+ * Decodes UTF-16 of the given byte order, pairing surrogates.
+ */
+static uint decode_utf16(char *dest, const unsigned char *data, uint length, int big_endian)
+{
+    uint in = 0, out = 0;
+    length &= ~1u;
+    while (in < length)
+    {
+#ifdef __SSE2__
+        // Narrow 8 ASCII code units at once, up to the first other unit
+        if (in + 16 <= length)
+        {
+            __m128i units = _mm_loadu_si128((const __m128i *)(data + in));
+            if (big_endian)
+            {
+                units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+            }
+            __m128i zero = _mm_setzero_si128();
+            __m128i ascii = _mm_andnot_si128(_mm_cmpeq_epi16(units, zero),
+                                             _mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16((short)0xFF80)), zero));
+            uint ok = (uint)_mm_movemask_epi8(ascii);
+            _mm_storel_epi64((__m128i *)(dest + out), _mm_packus_epi16(units, units));
+            uint n = ok == 0xFFFF ? 8 : __builtin_ctz(~ok) / 2;
+            in += 2 * n;
+            out += n;
+            if (n == 8)
+            {
+                continue;
+            }
+        }
+#endif
+        uint32_t unit = big_endian ? data[in] << 8 | data[in + 1] : data[in + 1] << 8 | data[in];
+        if (unit == 0)
+        {
+            break;
+        }
+        in += 2;
+        if (unit >= 0xD800 && unit < 0xE000)
+        {
+            // A high surrogate followed by a low one makes a character above U+FFFF
+            uint32_t low = in < length ? (big_endian ? data[in] << 8 | data[in + 1] : data[in + 1] << 8 | data[in]) : 0;
+            if (unit < 0xDC00 && low >= 0xDC00 && low < 0xE000)
+            {
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                in += 2;
+            }
+            else
+            {
+                unit = 0xFFFD;
+            }
+        }
+        out = put_utf8(dest, out, unit);
+    }
+    return out;
+}
+
+/**
+ * Gives the number of bytes taken by the first string of a text field and its terminator.
+ * 
+ * Parameters:
+ *   data (const unsigned char*): The text.
+ *   length (uint): Bytes available.
+ *   encoding (unsigned char): ID3 text encoding.
+ * 
+ * Returns:
+ *   uint: Bytes up to and including the terminator, length when there is none.
+ */
+uint text_span(const unsigned char *data, uint length, unsigned char encoding)
+{
+    if (encoding == TEXT_UTF16 || encoding == TEXT_UTF16BE)
+    {
+        for (uint i = 0; i + 1 < length; i += 2)
+        {
+            if (data[i] == 0 && data[i + 1] == 0)
+            {
+                return i + 2;
+            }
+        }
+        return length;
+    }
+
+    const unsigned char *end = memchr(data, 0, length);
+    return end != NULL ? (uint)(end - data) + 1 : length;
+}
+
+/**
+ * Decodes the first string of a text field to UTF-8.
+ * 
+ * Parameters:
+ *   dest (char*): Where the null terminated text is written, TEXT_UTF8_MAX(length) bytes.
+ *   data (const unsigned char*): The encoded text.
+ *   length (uint): Bytes available.
+ *   encoding (unsigned char): ID3 text encoding.
+ * 
+ * Returns:
+ *   uint: Length of the decoded text, without the terminator.
+ */
+uint text_to_utf8(char *dest, const unsigned char *data, uint length, unsigned char encoding)
+{
+    uint out;
+    if (encoding == TEXT_UTF16 || encoding == TEXT_UTF16BE)
+    {
+        // The byte order mark decides, UTF-16 without one is taken as little-endian
+        int big_endian = encoding == TEXT_UTF16BE;
+        if (length >= 2 && ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF)))
+        {
+            big_endian = data[0] == 0xFE;
+            data += 2;
+            length -= 2;
+        }
+        out = decode_utf16(dest, data, length, big_endian);
+    }
+    else if (encoding == TEXT_UTF8)
+    {
+        if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        {
+            data += 3;
+            length -= 3;
+        }
+        const unsigned char *end = memchr(data, 0, length);
+        out = end != NULL ? (uint)(end - data) : length;
+        memcpy(dest, data, out);
+    }
+    else
+    {
+        out = decode_latin1(dest, data, length);
+    }
+
+    dest[out] = '\0';
+    return out;
+}
+
+/**
+ * Encodes UTF-8 text for a text field, without a terminator.
+ * 
+ * Parameters:
+ *   dest (unsigned char*): Where the encoded text is written, TEXT_ENCODED_MAX(length) bytes.
+ *   text (const char*): The UTF-8 text.
+ *   length (uint): Length of the text.
+ *   encoding (unsigned char): ID3 text encoding.
+ * 
+ * Returns:
+ *   uint: Number of bytes written.
+ */
+uint text_from_utf8(unsigned char *dest, const char *text, uint length, unsigned char encoding)
+{
+    const unsigned char *src = (const unsigned char *)text;
+    uint in = 0, out = 0;
+    if (encoding == TEXT_UTF8)
+    {
+        memcpy(dest, text, length);
+        return length;
+    }
+
+    if (encoding == TEXT_UTF16)
+    {
+        dest[out++] = 0xFF;
+        dest[out++] = 0xFE;
+    }
+    while (in < length)
+    {
+        uint32_t c = next_utf8(src, length, &in);
+        if (encoding != TEXT_UTF16 && encoding != TEXT_UTF16BE)
+        {
+            dest[out++] = c < 0x100 ? c : '?';
+            continue;
+        }
+
+        // Characters above U+FFFF take a surrogate pair
+        uint32_t units[2] = { c, 0 };
+        int count = 1;
+        if (c >= 0x10000)
+        {
+            units[0] = 0xD800 + ((c - 0x10000) >> 10);
+            units[1] = 0xDC00 + ((c - 0x10000) & 0x3FF);
+            count = 2;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            dest[out++] = encoding == TEXT_UTF16 ? units[i] & 0xFF : units[i] >> 8;
+            dest[out++] = encoding == TEXT_UTF16 ? units[i] >> 8 : units[i] & 0xFF;
+        }
+    }
+    return out;
+}
+
+/**
+ * Encodes one code point as UTF-8, without a terminator.
+ * 
+ * Parameters:
+ *   dest (char*): Where the character is written, 4 bytes at most.
+ *   code (uint): The code point, up to 0x10FFFF.
+ * 
+ * Returns:
+ *   uint: Number of bytes written.
+ */
+uint text_put_utf8(char *dest, uint code)
+{
+    return put_utf8(dest, 0, code);
+}
+
+/**
+ * Tells if a UTF-8 text holds ASCII characters only.
+ * 
+ * Parameters:
+ *   text (const char*): The text.
+ *   length (uint): Length of the text.
+ * 
+ * Returns:
+ *   int: 1 for ASCII text, 0 otherwise.
+ */
+int text_is_ascii(const char *text, uint length)
+{
+    for (uint i = 0; i < length; i++)
+    {
+        if ((unsigned char)text[i] >= 0x80)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Gives the length of the part of a text that is well-formed UTF-8, up to the first
+ * malformed sequence (or a sequence cut short by the end of the text).
+ * 
+ * Parameters:
+ *   text (const char*): The text.
+ *   length (uint): Length of the text.
+ * 
+ * Returns:
+ *   uint: Number of bytes of valid UTF-8 at the start of the text, length if all of it is.
+ */
+uint text_valid_utf8(const char *text, uint length)
+{
+    const unsigned char *src = (const unsigned char *)text;
+    uint pos = 0;
+    while (pos < length)
+    {
+        // U+FFFD also stands for a malformed sequence, which is skipped one byte at a time
+        uint start = pos;
+        if (next_utf8(src, length, &pos) == 0xFFFD && pos == start + 1)
+        {
+            return start;
+        }
+    }
+    return length;
+}
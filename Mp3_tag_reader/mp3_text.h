@@ -0,0 +1,94 @@
+#ifndef MP3_TEXT_H
+#define MP3_TEXT_H
+
+#include "types.h"
+
+// Text encodings named by the first byte of an ID3 text frame
+#define TEXT_LATIN1 0     // ISO-8859-1
+#define TEXT_UTF16 1      // UTF-16 with a byte order mark (little-endian without one)
+#define TEXT_UTF16BE 2    // UTF-16 big-endian without a byte order mark (ID3v2.4)
+#define TEXT_UTF8 3       // UTF-8 (ID3v2.4)
+
+// Bytes needed to decode length bytes of any encoding to UTF-8, with the null terminator
+#define TEXT_UTF8_MAX(length) (2 * (length) + 1)
+
+// Bytes needed to encode length bytes of UTF-8 in any encoding, with a byte order mark
+#define TEXT_ENCODED_MAX(length) (2 * (length) + 2)
+
+// Function Prototypes
+
+/**
+ * Gives the number of bytes taken by the first string of a text field and its terminator
+ * (one zero byte, two for UTF-16 encodings), or all bytes when it isn't terminated.
+ * 
+ * @param data (const unsigned char*): The text.
+ * @param length (uint): Bytes available.
+ * @param encoding (unsigned char): ID3 text encoding.
+ * 
+ * @returns uint: Bytes up to and including the terminator.
+ */
+uint text_span(const unsigned char *data, uint length, unsigned char encoding);
+
+
+/**
+ * Decodes the first string of a text field to UTF-8, up to its terminator or the end of the data.
+ * A byte order mark is dropped, unpaired UTF-16 surrogates become U+FFFD and UTF-8 is copied as is.
+ * Runs of ASCII characters are converted 16 bytes at a time where SSE2 is available.
+ * 
+ * @param dest (char*): Where the null terminated UTF-8 text is written, TEXT_UTF8_MAX(length) bytes.
+ * @param data (const unsigned char*): The encoded text.
+ * @param length (uint): Bytes available.
+ * @param encoding (unsigned char): ID3 text encoding, unknown encodings are read as ISO-8859-1.
+ * 
+ * @returns uint: Length of the decoded text, without the terminator.
+ */
+uint text_to_utf8(char *dest, const unsigned char *data, uint length, unsigned char encoding);
+
+
+/**
+ * Encodes UTF-8 text for a text field, without a terminator. UTF-16 is written with a
+ * byte order mark, characters ISO-8859-1 can't hold become '?'.
+ * 
+ * @param dest (unsigned char*): Where the encoded text is written, TEXT_ENCODED_MAX(length) bytes.
+ * @param text (const char*): The UTF-8 text.
+ * @param length (uint): Length of the text.
+ * @param encoding (unsigned char): ID3 text encoding.
+ * 
+ * @returns uint: Number of bytes written.
+ */
+uint text_from_utf8(unsigned char *dest, const char *text, uint length, unsigned char encoding);
+
+
+/**
+ * Encodes one code point as UTF-8, without a terminator.
+ * 
+ * @param dest (char*): Where the character is written, 4 bytes at most.
+ * @param code (uint): The code point, up to 0x10FFFF.
+ * 
+ * @returns uint: Number of bytes written.
+ */
+uint text_put_utf8(char *dest, uint code);
+
+
+/**
+ * Tells if a UTF-8 text holds ASCII characters only, so ISO-8859-1 can carry it unchanged.
+ * 
+ * @param text (const char*): The text.
+ * @param length (uint): Length of the text.
+ * 
+ * @returns int: 1 for ASCII text, 0 otherwise.
+ */
+int text_is_ascii(const char *text, uint length);
+
+
+/**
+ * Gives the length of the well-formed UTF-8 at the start of a text.
+ * 
+ * @param text (const char*): The text.
+ * @param length (uint): Length of the text.
+ * 
+ * @returns uint: Number of bytes of valid UTF-8 before the first malformed sequence, length if there is none.
+ */
+uint text_valid_utf8(const char *text, uint length);
+
+#endif
@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "types.h"
+#include "mp3_unsync.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UNSYNC_X86 1
+#endif
+
+/**
+ * Tells if the byte at i of a plain buffer needs a 0x00 after it once unsynchronised.
+ */
+static inline int needs_zero(const unsigned char *data, uint i, uint length)
+{
+    return data[i] == 0xFF && (i + 1 == length || data[i + 1] == 0x00 || data[i + 1] >= 0xE0);
+}
+
+/**
+ * Decodes the bytes [*in, end) one at a time, writing them at *out.
+ * A 0x00 right after a 0xFF is dropped, even when it lies past end.
+ */
+static inline void decode_bytes(unsigned char *data, uint *in, uint *out, uint end, uint length)
+{
+    while (*in < end)
+    {
+        unsigned char c = data[(*in)++];
+        data[(*out)++] = c;
+        if (c == 0xFF && *in < length && data[*in] == 0x00)
+        {
+            (*in)++;
+        }
+    }
+}
+
+/**
+ * Encodes the bytes [*in, end) one at a time, writing them at dest + *out.
+ */
+static inline void encode_bytes(unsigned char *dest, const unsigned char *src, uint *in, uint *out, uint end, uint length)
+{
+    while (*in < end)
+    {
+        dest[(*out)++] = src[*in];
+        if (needs_zero(src, *in, length))
+        {
+            dest[(*out)++] = 0x00;
+        }
+        (*in)++;
+    }
+}
+
+/**
+ * Removes the 0x00 after every 0xFF, one byte at a time.
+ */
+static uint decode_scalar(unsigned char *data, uint length)
+{
+    uint in = 0, out = 0;
+    decode_bytes(data, &in, &out, length, length);
+    return out;
+}
+
+/**
+ * Counts the 0x00 bytes encoding inserts, one byte at a time.
+ */
+static uint inserted_scalar(const unsigned char *data, uint length)
+{
+    uint count = 0;
+    for (uint i = 0; i < length; i++)
+    {
+        count += needs_zero(data, i, length);
+    }
+    return count;
+}
+
+/**
+ * Inserts the 0x00 bytes of unsynchronisation, one byte at a time.
+ */
+static uint encode_scalar(unsigned char *dest, const unsigned char *src, uint length)
+{
+    uint in = 0, out = 0;
+    encode_bytes(dest, src, &in, &out, length, length);
+    return out;
+}
+
+#ifdef UNSYNC_X86
+
+/**
+ * Removes the 0x00 after every 0xFF 16 bytes at a time. Blocks without 0xFF are moved down
+ * with one load and store, a block with one is handled byte by byte up to its first 0xFF.
+ */
+__attribute__((target("sse2")))
+static uint decode_sse2(unsigned char *data, uint length)
+{
+    const __m128i ff = _mm_set1_epi8((char)0xFF);
+    uint in = 0, out = 0;
+    while (in + 16 <= length)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + in));
+        uint mask = (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(block, ff));
+        if (mask == 0)
+        {
+            // The store never reaches past the bytes already loaded
+            _mm_storeu_si128((__m128i *)(data + out), block);
+            in += 16;
+            out += 16;
+            continue;
+        }
+        decode_bytes(data, &in, &out, in + __builtin_ctz(mask) + 1, length);
+    }
+    decode_bytes(data, &in, &out, length, length);
+    return out;
+}
+
+/**
+ * Gives the mask of the bytes of a 16 byte block that need a 0x00 after them, from the
+ * block and the same block shifted by one byte.
+ */
+__attribute__((target("sse2")))
+static inline uint zero_mask_sse2(const unsigned char *data)
+{
+    __m128i block = _mm_loadu_si128((const __m128i *)data);
+    __m128i next = _mm_loadu_si128((const __m128i *)(data + 1));
+    __m128i is_ff = _mm_cmpeq_epi8(block, _mm_set1_epi8((char)0xFF));
+    __m128i is_sync = _mm_cmpeq_epi8(_mm_max_epu8(next, _mm_set1_epi8((char)0xE0)), next);
+    __m128i is_zero = _mm_cmpeq_epi8(next, _mm_setzero_si128());
+    return (uint)_mm_movemask_epi8(_mm_and_si128(is_ff, _mm_or_si128(is_sync, is_zero)));
+}
+
+/**
+ * Counts the 0x00 bytes encoding inserts, 16 bytes at a time.
+ */
+__attribute__((target("sse2,popcnt")))
+static uint inserted_sse2(const unsigned char *data, uint length)
+{
+    uint count = 0, i = 0;
+    for (; i + 17 <= length; i += 16)
+    {
+        count += __builtin_popcount(zero_mask_sse2(data + i));
+    }
+    for (; i < length; i++)
+    {
+        count += needs_zero(data, i, length);
+    }
+    return count;
+}
+
+/**
+ * Inserts the 0x00 bytes of unsynchronisation, copying blocks that need none 16 bytes at a time.
+ */
+__attribute__((target("sse2")))
+static uint encode_sse2(unsigned char *dest, const unsigned char *src, uint length)
+{
+    uint in = 0, out = 0;
+    while (in + 17 <= length)
+    {
+        if (zero_mask_sse2(src + in) == 0)
+        {
+            _mm_storeu_si128((__m128i *)(dest + out), _mm_loadu_si128((const __m128i *)(src + in)));
+            in += 16;
+            out += 16;
+            continue;
+        }
+        encode_bytes(dest, src, &in, &out, in + 16, length);
+    }
+    encode_bytes(dest, src, &in, &out, length, length);
+    return out;
+}
+
+/**
+ * Removes the 0x00 after every 0xFF 32 bytes at a time.
+ */
+__attribute__((target("avx2")))
+static uint decode_avx2(unsigned char *data, uint length)
+{
+    const __m256i ff = _mm256_set1_epi8((char)0xFF);
+    uint in = 0, out = 0;
+    while (in + 32 <= length)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + in));
+        uint mask = (uint)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, ff));
+        if (mask == 0)
+        {
+            _mm256_storeu_si256((__m256i *)(data + out), block);
+            in += 32;
+            out += 32;
+            continue;
+        }
+        decode_bytes(data, &in, &out, in + __builtin_ctz(mask) + 1, length);
+    }
+    decode_bytes(data, &in, &out, length, length);
+    return out;
+}
+
+/**
+ * Gives the mask of the bytes of a 32 byte block that need a 0x00 after them.
+ */
+__attribute__((target("avx2")))
+static inline uint zero_mask_avx2(const unsigned char *data)
+{
+    __m256i block = _mm256_loadu_si256((const __m256i *)data);
+    __m256i next = _mm256_loadu_si256((const __m256i *)(data + 1));
+    __m256i is_ff = _mm256_cmpeq_epi8(block, _mm256_set1_epi8((char)0xFF));
+    __m256i is_sync = _mm256_cmpeq_epi8(_mm256_max_epu8(next, _mm256_set1_epi8((char)0xE0)), next);
+    __m256i is_zero = _mm256_cmpeq_epi8(next, _mm256_setzero_si256());
+    return (uint)_mm256_movemask_epi8(_mm256_and_si256(is_ff, _mm256_or_si256(is_sync, is_zero)));
+}
+
+/**
+ * Counts the 0x00 bytes encoding inserts, 32 bytes at a time.
+ */
+__attribute__((target("avx2,popcnt")))
+static uint inserted_avx2(const unsigned char *data, uint length)
+{
+    uint count = 0, i = 0;
+    for (; i + 33 <= length; i += 32)
+    {
+        count += __builtin_popcount(zero_mask_avx2(data + i));
+    }
+    for (; i < length; i++)
+    {
+        count += needs_zero(data, i, length);
+    }
+    return count;
+}
+
+/**
+ * Inserts the 0x00 bytes of unsynchronisation, copying blocks that need none 32 bytes at a time.
+ */
+__attribute__((target("avx2")))
+static uint encode_avx2(unsigned char *dest, const unsigned char *src, uint length)
+{
+    uint in = 0, out = 0;
+    while (in + 33 <= length)
+    {
+        if (zero_mask_avx2(src + in) == 0)
+        {
+            _mm256_storeu_si256((__m256i *)(dest + out), _mm256_loadu_si256((const __m256i *)(src + in)));
+            in += 32;
+            out += 32;
+            continue;
+        }
+        encode_bytes(dest, src, &in, &out, in + 32, length);
+    }
+    encode_bytes(dest, src, &in, &out, length, length);
+    return out;
+}
+
+#endif
+
+// Engines from the narrowest to the widest
+static const UnsyncEngine unsync_engines[] =
+{
+    { "scalar", decode_scalar, inserted_scalar, encode_scalar },
+#ifdef UNSYNC_X86
+    { "sse2", decode_sse2, inserted_sse2, encode_sse2 },
+    { "avx2", decode_avx2, inserted_avx2, encode_avx2 },
+#endif
+};
+
+static const UnsyncEngine *selected_engine;
+static pthread_once_t engine_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Tells if the CPU can run an engine.
+ */
+static int engine_supported(const UnsyncEngine *engine)
+{
+#ifdef UNSYNC_X86
+    __builtin_cpu_init();
+    if (strcmp(engine->name, "sse2") == 0)
+    {
+        return __builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt");
+    }
+    if (strcmp(engine->name, "avx2") == 0)
+    {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    }
+#endif
+    return 1;
+}
+
+/**
+ * Selects the engine named in MP3_UNSYNC, or the widest one the CPU supports.
+ */
+static void select_engine(void)
+{
+    const char *name = getenv("MP3_UNSYNC");
+    int count = sizeof(unsync_engines) / sizeof(unsync_engines[0]);
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (engine_supported(&unsync_engines[i]) &&
+            (name == NULL || *name == '\0' || strcmp(name, unsync_engines[i].name) == 0))
+        {
+            selected_engine = &unsync_engines[i];
+            return;
+        }
+    }
+    selected_engine = &unsync_engines[0];
+}
+
+/**
+ * Gives the engine used for unsynchronisation, selected once on first use.
+ * 
+ * Returns:
+ *   const UnsyncEngine*: The engine.
+ */
+const UnsyncEngine *unsync_engine(void)
+{
+    pthread_once(&engine_once, select_engine);
+    return selected_engine;
+}
+
+/**
+ * Undoes the unsynchronisation of a buffer in place: every 0xFF 0x00 pair becomes 0xFF.
+ * 
+ * Parameters:
+ *   data (unsigned char*): The unsynchronised bytes.
+ *   length (uint): Number of bytes.
+ * 
+ * Returns:
+ *   uint: Number of bytes once decoded.
+ */
+uint unsync_decode(unsigned char *data, uint length)
+{
+    return unsync_engine()->decode(data, length);
+}
+
+/**
+ * Gives the length of a buffer once unsynchronised.
+ * 
+ * Parameters:
+ *   data (const unsigned char*): The plain bytes.
+ *   length (uint): Number of bytes.
+ * 
+ * Returns:
+ *   uint: Number of bytes once encoded.
+ */
+uint unsync_encoded_size(const unsigned char *data, uint length)
+{
+    return length + unsync_engine()->inserted(data, length);
+}
+
+/**
+ * Unsynchronises a buffer, inserting a 0x00 after every 0xFF followed by 0x00 or a byte of
+ * 0xE0 or more, and after a 0xFF in the last byte.
+ * 
+ * Parameters:
+ *   dest (unsigned char*): Where the encoded bytes are written, 2 * length bytes at most.
+ *   src (const unsigned char*): The plain bytes, not overlapping dest.
+ *   length (uint): Number of bytes.
+ * 
+ * Returns:
+ *   uint: Number of bytes written.
+ */
+uint unsync_encode(unsigned char *dest, const unsigned char *src, uint length)
+{
+    return unsync_engine()->encode(dest, src, length);
+}
@@ -0,0 +1,69 @@
+#ifndef MP3_UNSYNC_H
+#define MP3_UNSYNC_H
+
+#include "types.h"
+
+// Structure to describe one implementation of the unsynchronisation scheme
+typedef struct UnsyncEngine
+{
+    const char *name;      // Name used in MP3_UNSYNC and in reports (e.g., "avx2")
+
+    // Removes the 0x00 after every 0xFF in place, returns the new length
+    uint (*decode)(unsigned char *data, uint length);
+
+    // Counts the 0x00 bytes encoding has to insert
+    uint (*inserted)(const unsigned char *data, uint length);
+
+    // Inserts a 0x00 after every 0xFF that is followed by 0x00, a byte of 0xE0 or more,
+    // or nothing; returns the length written to dest
+    uint (*encode)(unsigned char *dest, const unsigned char *src, uint length);
+} UnsyncEngine;
+
+// Function Prototypes
+
+/**
+ * Gives the engine used for unsynchronisation, selected on first use: the one named in the
+ * MP3_UNSYNC environment variable (scalar, sse2 or avx2) when the CPU supports it,
+ * otherwise the widest one the CPU supports.
+ * 
+ * @returns const UnsyncEngine*: The engine.
+ */
+const UnsyncEngine *unsync_engine(void);
+
+
+/**
+ * Undoes the unsynchronisation of a buffer in place: every 0xFF 0x00 pair becomes 0xFF.
+ * 
+ * @param data (unsigned char*): The unsynchronised bytes.
+ * @param length (uint): Number of bytes.
+ * 
+ * @returns uint: Number of bytes once decoded.
+ */
+uint unsync_decode(unsigned char *data, uint length);
+
+
+/**
+ * Gives the length of a buffer once unsynchronised.
+ * 
+ * @param data (const unsigned char*): The plain bytes.
+ * @param length (uint): Number of bytes.
+ * 
+ * @returns uint: Number of bytes once encoded, length + the inserted 0x00 bytes.
+ */
+uint unsync_encoded_size(const unsigned char *data, uint length);
+
+
+/**
+ * Unsynchronises a buffer: a 0x00 is inserted after every 0xFF that would otherwise look like
+ * the start of an MPEG frame sync (followed by a byte of 0xE0 or more), after every 0xFF
+ * followed by 0x00, and after a 0xFF in the last byte.
+ * 
+ * @param dest (unsigned char*): Where the encoded bytes are written, unsync_encoded_size() bytes (2 * length at most).
+ * @param src (const unsigned char*): The plain bytes, not overlapping dest.
+ * @param length (uint): Number of bytes.
+ * 
+ * @returns uint: Number of bytes written.
+ */
+uint unsync_encode(unsigned char *dest, const unsigned char *src, uint length);
+
+#endif
@@ -1,7 +1,45 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "types.h"
 #include "mp3_view.h"
+#include "mp3_frame.h"
+#include "mp3_text.h"
+#include "mp3_stats.h"
+#include "mp3_tail.h"
+
+// Bytes of the tag read per call, binary frames reaching past them are skipped
+#define VIEW_WINDOW (64 * 1024)
+
+// Text fields of a record, in column order
+static const struct
+{
+    const char *name;      // Field name used in the header and as JSON key
+    const char *frame_id;  // ID3 frame the field is read from
+    const char *label;     // Label of the field in the text format
+    const char *missing;   // Line printed in the text format when the field is missing
+} record_fields[VIEW_FIELDS] =
+{
+    { "title", "TIT2", "TITLE    :   ", "Error in getting title name" },
+    { "artist", "TPE1", "ARTIST   :   ", "Error in getting artist name" },
+    { "album", "TALB", "ALBUM    :   ", "Error in getting album name" },
+    { "year", "TYER", "YEAR     :   ", "Error in getting year" },
+    { "genre", "TCON", "MUSIC    :   ", "Error in getting music" },
+    { "comment", "COMM", "COMMENT  :   ", "Error in getting comments" },
+};
+
+// Line reported for each reason a file can't be viewed
+static const char *view_messages[] =
+{
+    [mp3_err_open] = "Error in opening mp3View file",
+    [mp3_err_no_tag] = "Invalid Mp3 ID format",
+    [mp3_err_version] = "Invalid ID3 version",
+    [mp3_err_read] = "Error in reading ID3 tag",
+};
 
 /**
  * Validates and reads the MP3 file for viewing.
@@ -39,86 +77,453 @@ Status read_and_validation_view(char *argv[], Mp3ViewInfo *mp3View)
         return e_failure;
     }
 
-    // Store the file name in the mp3View structure
+    // Store the file name in the mp3View structure, details are printed to stdout
     mp3View->file_name = argv[2];
+    mp3View->out = stdout;
+    mp3View->cache = NULL;
+    mp3View->arena = NULL;
+    mp3View->text_error = mp3_ok;
+    mp3View->tail = NULL;
+    mp3View->tail_size = 0;
+    mp3View->format = format_text;
+    mp3View->record = NULL;
 
     return e_success;
 }
 
 /**
- * Displays the information stored in the MP3 file's ID3 tag.
- * It opens the file, validates the ID3 tag, and then reads specific information like
- * title, artist, album, year, music genre, and comments.
+ * Reports why a file can't be viewed: a line on out, or a record with the error.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ *   message (const char*): The error.
+ */
+static void view_error(Mp3ViewInfo *mp3View, const char *message)
+{
+    if (mp3View->format == format_text)
+    {
+        fprintf(mp3View->out, "%s\n", message);
+    }
+    else
+    {
+        format_record(mp3View, message);
+    }
+}
+
+/**
+ * Shows the details of the indexed tag in the selected format. A text that doesn't fit in
+ * the arena makes it an error report instead.
  * 
  * Parameters:
  *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
  * 
  * Returns:
- *   Status: e_success if all information is successfully displayed, e_failure if an error occurs.
+ *   Mp3Error: mp3_ok if the details were shown, mp3_err_read if a text doesn't fit in the arena.
  */
-Status view_info(Mp3ViewInfo *mp3View)
+static Mp3Error show_info(Mp3ViewInfo *mp3View)
+{
+    if (mp3View->format != format_text)
+    {
+        return format_record(mp3View, NULL) == e_success ? mp3_ok : mp3_err_read;
+    }
+    if (print_info(mp3View) == e_failure)
+    {
+        view_error(mp3View, view_message(mp3_err_read));
+        return mp3_err_read;
+    }
+    return mp3_ok;
+}
+
+/**
+ * Copies a plain tag that was read whole, keeping it the way load_tag() does: binary frames
+ * larger than VIEW_WINDOW, which load_tag() never reads, are replaced by stubs and only a frame
+ * header of what follows the last frame is kept. The tag may be copied onto itself.
+ * 
+ * Parameters:
+ *   header (const unsigned char*): The 10 byte tag header.
+ *   dest (unsigned char*): Where the tag is written, tag_size bytes at most.
+ *   tag (const unsigned char*): The frame region of the tag.
+ *   tag_size (uint): Size of the frame region.
+ * 
+ * Returns:
+ *   uint: Size of the copied frame region.
+ */
+static uint copy_tag(const unsigned char *header, unsigned char *dest, const unsigned char *tag, uint tag_size)
+{
+    const FrameParser *parser = get_frame_parser(header);
+    uint pos = 0;
+    if (parser == NULL || parser->header_size != FRAME_HEADER_SIZE ||
+        frame_region_start(parser, header, tag, tag_size, &pos) == e_failure)
+    {
+        memmove(dest, tag, tag_size);
+        return tag_size;
+    }
+    memmove(dest, tag, pos);
+    uint out = pos;
+
+    while (tag_size - pos >= FRAME_HEADER_SIZE && tag[pos] != 0)
+    {
+        // Stop at the padding; a malformed frame is left for the frame table to reject
+        FrameEntry entry;
+        if (parser->read_header(tag + pos, tag_size - pos - FRAME_HEADER_SIZE, &entry) == e_failure)
+        {
+            break;
+        }
+        uint next = pos + entry.data + entry.size;
+        if (is_binary_frame(entry.id) && !(entry.flags & FRAME_UNSYNC_FLAG) && entry.size > VIEW_WINDOW)
+        {
+            entry.offset = 0;
+            out += make_stub_frame(parser, dest + out, &entry, tag + pos);
+        }
+        else
+        {
+            memmove(dest + out, tag + pos, next - pos);
+            out += next - pos;
+        }
+        pos = next;
+    }
+
+    uint rest = tag_size - pos < FRAME_HEADER_SIZE ? tag_size - pos : FRAME_HEADER_SIZE;
+    memmove(dest + out, tag + pos, rest);
+    return out + rest;
+}
+
+/**
+ * Builds the frame table of a tag that is already in memory and parses the tail tags.
+ * An unsynchronised tag is decoded in place first.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure with header, tag, tag_size, tail and tail_size filled in.
+ * 
+ * Returns:
+ *   Mp3Error: mp3_ok if the tag is indexed or the file only has tail tags, the reason otherwise.
+ */
+static Mp3Error index_view(Mp3ViewInfo *mp3View)
 {
+    memset(&mp3View->index, 0, sizeof(mp3View->index));
+    parse_tail_tags(&mp3View->tail_tags, mp3View->tail, mp3View->tail_size, mp3View->arena);
+
+    // Without an ID3v2 tag all fields come from the tail tags, if there are any
+    if (strncmp((char *)mp3View->header, "ID3", 3) != 0)
+    {
+        return mp3View->tail_size > 0 ? mp3_ok : mp3_err_no_tag;
+    }
+    if (check_version(mp3View) == e_failure)
+    {
+        return mp3_err_version;
+    }
+
+    unsigned long long start = stats_start();
+    mp3View->tag_size = resync_tag(mp3View->header, mp3View->tag, mp3View->tag_size);
+    Status status = mp3View->tag != NULL ? build_frame_index(&mp3View->index, mp3View->header, mp3View->tag, mp3View->tag_size) : e_failure;
+    stats_stop(phase_parse, start);
+    return status == e_success ? mp3_ok : mp3_err_read;
+}
+
+/**
+ * Reads the tags of the file and builds the frame table, without printing anything.
+ * If the cache has the tag of the unchanged file it is used without opening the file.
+ * Otherwise it opens the file, reads the ID3v1, Lyrics3 and APE tags at its end with one
+ * positioned read, validates the ID3 tag and reads its frame region. A file with only tail
+ * tags is loaded from them. The file is closed before returning.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ * 
+ * Returns:
+ *   Mp3Error: mp3_ok if the tags are loaded, the reason otherwise.
+ */
+Mp3Error view_load(Mp3ViewInfo *mp3View)
+{
+    // Answer from the cache when the file is unchanged since it was last parsed.
+    // The tag is moved into the arena, the tail is only needed for parsing
+    struct stat st;
+    unsigned char *tag, *tail;
+    if (mp3View->cache != NULL && stat(mp3View->file_name, &st) == 0 &&
+        cache_lookup(mp3View->cache, &st, mp3View->header, &tag, &mp3View->tag_size, &tail, &mp3View->tail_size) == e_success)
+    {
+        mp3View->tag = arena_alloc(mp3View->arena, mp3View->tag_size + 1);
+        mp3View->tail = tail;
+        Mp3Error error = mp3_err_read;
+        if (mp3View->tag != NULL)
+        {
+            memcpy(mp3View->tag, tag, mp3View->tag_size);
+            error = index_view(mp3View);
+        }
+        free(tag);
+        free(tail);
+        mp3View->tail = NULL;
+        return error;
+    }
+
     // Open the MP3 file for reading
-    if (open_mp3file(mp3View) == e_failure)
+    unsigned long long start = stats_start();
+    Status status = open_mp3file(mp3View);
+    stats_stop(phase_open, start);
+    if (status == e_failure)
     {
-        printf("Error in opening mp3View file\n");
-        return e_failure;
+        return mp3_err_open;
     }
 
+    // Read the tags at the end of the file, the size tells where the last block starts.
+    // The block stays on the stack, the arena limit is left to the tag
+    start = stats_start();
+    unsigned char block[TAIL_PROBE_SIZE];
+    int have_stat = fstat(mp3View->fd, &st) == 0;
+    mp3View->tail_size = have_stat ? read_tail_tags(mp3View->fd, st.st_size, block, &mp3View->tail) : 0;
+    parse_tail_tags(&mp3View->tail_tags, mp3View->tail, mp3View->tail_size, mp3View->arena);
+    stats_stop(phase_header, start);
+
     // Check if the MP3 file has a valid ID3 tag
-    if (check_ID(mp3View) == e_failure)
+    start = stats_start();
+    status = check_ID(mp3View);
+    stats_stop(phase_header, start);
+    if (status == e_failure && mp3View->tail_size == 0)
     {
-        printf("Invalid Mp3 ID format\n");
-        return e_failure;
+        close_mp3file(mp3View);
+        return mp3_err_no_tag;
     }
 
-    // Check if the MP3 file has a valid ID3 version
-    if (check_version(mp3View) == e_failure)
+    if (status == e_failure)
     {
-        printf("Invalid ID3 version\n");
-        return e_failure;
+        // Only tail tags, all fields come from them
+        memset(mp3View->header, 0, sizeof(mp3View->header));
+    }
+    else
+    {
+        // Check if the MP3 file has a valid ID3 version
+        start = stats_start();
+        status = check_version(mp3View);
+        stats_stop(phase_header, start);
+        if (status == e_failure)
+        {
+            close_mp3file(mp3View);
+            return mp3_err_version;
+        }
+
+        // Read the frame region of the tag once, all fields are parsed from memory
+        start = stats_start();
+        status = load_tag(mp3View);
+        stats_stop(phase_parse, start);
+        if (status == e_failure)
+        {
+            close_mp3file(mp3View);
+            return mp3_err_read;
+        }
     }
 
-    // Display the MP3 file's details (title, artist, album, year, music genre, comments)
-    printf("TITLE    :   ");
-    if (read_info(mp3View, "TIT2") == e_failure)
+    // Remember the tag for the next run
+    if (mp3View->cache != NULL && have_stat)
     {
-        printf("Error in getting title name\n");
+        int has_tag = mp3View->tag != NULL;
+        cache_store(mp3View->cache, &st, has_tag ? mp3View->header : NULL, mp3View->tag, has_tag ? mp3View->tag_size : 0,
+                    mp3View->tail, mp3View->tail_size);
     }
 
-    printf("ARTIST   :   ");
-    if (read_info(mp3View, "TPE1") == e_failure)
+    // The tail block is on the stack, only its parsed fields are kept
+    mp3View->tail = NULL;
+    close(mp3View->fd);
+    return mp3_ok;
+}
+
+/**
+ * Releases the frame table of the file loaded last. The tag and the texts stay in the arena until it is reset.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ */
+void view_release(Mp3ViewInfo *mp3View)
+{
+    mp3View->tag = NULL;
+    mp3View->tail = NULL;
+    free_frame_index(&mp3View->index);
+}
+
+/**
+ * Gives the line reported when a file can't be viewed, the same in every output format.
+ * 
+ * Parameters:
+ *   error (Mp3Error): The reason returned by view_load().
+ * 
+ * Returns:
+ *   const char*: The message (e.g., "Invalid ID3 version").
+ */
+const char *view_message(Mp3Error error)
+{
+    if (error >= sizeof(view_messages) / sizeof(view_messages[0]) || view_messages[error] == NULL)
+    {
+        return view_messages[mp3_err_read];
+    }
+    return view_messages[error];
+}
+
+/**
+ * Displays the information stored in the MP3 file's ID3 tag: the tags are loaded by
+ * view_load(), then the title, artist, album, year, music genre, and comments are shown.
+ * Fields the ID3v2 tag lacks are taken from the tail tags, and a file with only tail tags
+ * is shown from them.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ * 
+ * Returns:
+ *   Status: e_success if all information is successfully displayed, e_failure if an error occurs.
+ */
+Status view_info(Mp3ViewInfo *mp3View)
+{
+    Mp3Error error = view_load(mp3View);
+    if (error == mp3_ok)
     {
-        printf("Error in getting artist name\n");
+        // Display the MP3 file's details
+        unsigned long long start = stats_start();
+        error = show_info(mp3View);
+        stats_stop(phase_output, start);
+    }
+    else
+    {
+        view_error(mp3View, view_message(error));
     }
 
-    printf("ALBUM    :   ");
-    if (read_info(mp3View, "TALB") == e_failure)
+    view_release(mp3View);
+    return error == mp3_ok ? e_success : e_failure;
+}
+
+/**
+ * Displays the information of a tag that was already read into memory by the caller
+ * (e.g., by the asynchronous reader). The tag is moved into the arena first, with its large
+ * binary frames stubbed as load_tag() keeps them, so it is shown the same as by view_info().
+ * An unsynchronised tag is decoded in place first.
+ * A file without an ID3v2 tag is shown from its tail tags, if it has any.
+ * The tag and tail buffers and the frame table are released afterwards.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure with header, tag, tag_size, tail and tail_size
+ *                           filled in. tag is NULL if the tag could not be read, tail is NULL
+ *                           if the file has no tail tags.
+ * 
+ * Returns:
+ *   Status: e_success if all information is successfully displayed, e_failure if an error occurs.
+ */
+Status view_loaded(Mp3ViewInfo *mp3View)
+{
+    // The tag is stubbed where it was read, then moved into the arena, charged like a tag read by load_tag()
+    if (mp3View->tag != NULL)
     {
-        printf("Error in getting album name\n");
+        mp3View->tag_size = copy_tag(mp3View->header, mp3View->tag, mp3View->tag, mp3View->tag_size);
+        unsigned char *tag = arena_alloc(mp3View->arena, mp3View->tag_size + 1);
+        if (tag != NULL)
+        {
+            memcpy(tag, mp3View->tag, mp3View->tag_size);
+        }
+        free(mp3View->tag);
+        mp3View->tag = tag;
     }
 
-    printf("YEAR     :   ");
-    if (read_info(mp3View, "TYER") == e_failure)
+    Mp3Error error = index_view(mp3View);
+    if (error == mp3_ok)
+    {
+        unsigned long long start = stats_start();
+        error = show_info(mp3View);
+        stats_stop(phase_output, start);
+    }
+    else
     {
-        printf("Error in getting year\n");
+        view_error(mp3View, view_message(error));
     }
 
-    printf("MUSIC    :   ");
-    if (read_info(mp3View, "TCON") == e_failure)
+    mp3View->tag = NULL;
+    free(mp3View->tail);
+    mp3View->tail = NULL;
+    free_frame_index(&mp3View->index);
+    return error == mp3_ok ? e_success : e_failure;
+}
+
+/**
+ * Displays the title, artist, album, year, music genre and comments of the indexed tag,
+ * completed from the tail tags, and names the tail tags. Nothing is printed when a text
+ * doesn't fit in the arena.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ * 
+ * Returns:
+ *   Status: e_success if the details were printed, e_failure if a text doesn't fit in the arena.
+ */
+Status print_info(Mp3ViewInfo *mp3View)
+{
+    // Every text is decoded before anything is printed, a file is shown whole or not at all
+    const char *fields[VIEW_FIELDS];
+    if (decode_fields(mp3View, fields) != mp3_ok)
+    {
+        return e_failure;
+    }
+    for (uint i = 0; i < VIEW_FIELDS; i++)
     {
-        printf("Error in getting music\n");
+        fprintf(mp3View->out, "%s", record_fields[i].label);
+        if (fields[i] == NULL)
+        {
+            fprintf(mp3View->out, "%s\n", record_fields[i].missing);
+        }
+        else
+        {
+            fprintf(mp3View->out, "%-15s\n", fields[i]);
+        }
     }
 
-    printf("COMMENT  :   ");
-    if (read_info(mp3View, "COMM") == e_failure)
+    // Binary frames are only listed, their payload may not even be in memory
+    print_binary_frames(mp3View);
+
+    // Name the tail tags, they may have filled in some of the fields above
+    if (mp3View->tail_tags.found != 0)
     {
-        printf("Error in getting comments\n");
+        char names[64];
+        tail_tag_names(&mp3View->tail_tags, names);
+        fprintf(mp3View->out, "TAIL     :   %s\n", names);
     }
 
     return e_success;
 }
 
+/**
+ * Lists the pictures, objects and private frames of the tag with their MIME type (owner for
+ * private frames) and size. Only the first bytes of each payload are looked at.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ */
+void print_binary_frames(Mp3ViewInfo *mp3View)
+{
+    for (uint i = 0; i < mp3View->index.count; i++)
+    {
+        const FrameEntry *entry = &mp3View->index.frames[i];
+        if (!is_binary_frame(entry->id))
+        {
+            continue;
+        }
+
+        const unsigned char *data;
+        uint length;
+        uint size = frame_payload(entry, mp3View->tag, &data, &length);
+
+        // Pictures and objects start with the text encoding byte, then the MIME type
+        // (a 3 character image format for ID3v2.2 pictures)
+        int is_private = strncmp(entry->id, "PRIV", 4) == 0;
+        uint skip = is_private ? 0 : 1;
+        uint limit = mp3View->index.parser->version == 2 && strncmp(entry->id, "APIC", 4) == 0 ? 3 : FRAME_STUB_PREFIX;
+        char text[FRAME_STUB_PREFIX + 1];
+        uint n = 0;
+        while (skip + n < length && n < limit && data[skip + n] != 0)
+        {
+            text[n] = data[skip + n];
+            n++;
+        }
+        text[n] = '\0';
+
+        const char *label = strncmp(entry->id, "APIC", 4) == 0 ? "PICTURE" : is_private ? "PRIVATE" : "OBJECT";
+        fprintf(mp3View->out, "%-9s:   %s, %u bytes\n", label, n > 0 ? text : "unknown", size);
+    }
+}
+
 /**
  * Opens the MP3 file in read mode.
  * 
@@ -131,8 +536,10 @@ Status view_info(Mp3ViewInfo *mp3View)
 Status open_mp3file(Mp3ViewInfo *mp3View)
 {
     // Open the file for reading
-    mp3View->fptr_file = fopen(mp3View->file_name, "r");
-    if (mp3View->fptr_file == NULL)
+    mp3View->tag = NULL;
+    memset(&mp3View->index, 0, sizeof(mp3View->index));
+    mp3View->fd = stats_open(mp3View->file_name, O_RDONLY, 0);
+    if (mp3View->fd < 0)
     {
         return e_failure;
     }
@@ -141,7 +548,7 @@ Status open_mp3file(Mp3ViewInfo *mp3View)
 
 /**
  * Checks if the MP3 file has a valid ID3 tag.
- * This function reads the first 3 bytes of the file and checks if they match the "ID3" signature.
+ * This function reads the 10 byte tag header and checks if it starts with the "ID3" signature.
  * 
  * Parameters:
  *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
@@ -151,53 +558,268 @@ Status open_mp3file(Mp3ViewInfo *mp3View)
  */
 Status check_ID(Mp3ViewInfo *mp3View)
 {
-    char buffer[3];
-
-    // Read the first 3 bytes of the file to check for "ID3" signature
-    fread(buffer, 3, 1, mp3View->fptr_file);
+    // Read the whole tag header, the version and size are taken from it later
+    if (stats_pread(mp3View->fd, mp3View->header, ID3_HEADER_SIZE, 0) != ID3_HEADER_SIZE)
+    {
+        return e_failure;
+    }
 
     // If the first 3 bytes aren't "ID3", return failure
-    if (strcmp(buffer, "ID3") != 0)
+    if (strncmp((char *)mp3View->header, "ID3", 3) != 0)
     {
         return e_failure;
     }
 
     // Store the ID3 tag information
-    strcpy(mp3View->mp3Id, buffer);
+    memcpy(mp3View->mp3Id, mp3View->header, 3);
+    mp3View->mp3Id[3] = '\0';
 
     return e_success;
 }
 
 /**
- * Checks if the MP3 file uses a valid ID3 version.
- * This function reads the version bytes from the MP3 file and checks if it matches version 3.
+ * Checks if the MP3 file uses a supported ID3 version.
+ * This function takes the major version byte from the tag header and checks that a frame
+ * parser exists for it (ID3v2.2, v2.3 or v2.4).
  * 
  * Parameters:
  *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
  * 
  * Returns:
- *   Status: e_success if the version is 3, e_failure if the version is different.
+ *   Status: e_success if the version is supported, e_failure if it is not.
  */
 Status check_version(Mp3ViewInfo *mp3View)
 {
-    // Read the version bytes (2 bytes)
-    fread(&mp3View->version, 2, 1, mp3View->fptr_file);
+    // The major version is a single byte, the revision byte after it is never 0xFF
+    mp3View->version = mp3View->header[3];
 
-    // If the version is not 3, return failure
-    if (mp3View->version != 3)
+    // If there is no parser for the version, return failure
+    if (get_frame_parser(mp3View->header) == NULL)
     {
         return e_failure;
     }
 
-    // Move the file pointer 10 bytes from the start (skip header information)
-    fseek(mp3View->fptr_file, 10, SEEK_SET);
-
     return e_success;
 }
+/**
+ * Grows the tag being loaded to size bytes in the arena; tag_size holds its size until the tag is loaded.
+ */
+static Status grow_tag(Mp3ViewInfo *mp3View, uint size)
+{
+    if (size <= mp3View->tag_size)
+    {
+        return e_success;
+    }
+    unsigned char *tag = arena_grow(mp3View->arena, mp3View->tag, mp3View->tag_size, size);
+    if (tag == NULL)
+    {
+        return e_failure;
+    }
+    mp3View->tag = tag;
+    mp3View->tag_size = size;
+    return e_success;
+}
+
+/**
+ * Walks the frames of a plain tag a window at a time and copies the bytes that are kept to the
+ * tag, stubbing binary frames that reach past the window. The rest of a large frame that is kept
+ * is read straight into the tag.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ *   window (unsigned char*): VIEW_WINDOW bytes the frame region is read into.
+ *   tag_size (uint): Size of the frame region in the file.
+ * 
+ * Returns:
+ *   uint: Size of the kept frame region, or UINT_MAX if an error occurs.
+ */
+static uint walk_window(Mp3ViewInfo *mp3View, unsigned char *window, uint tag_size)
+{
+    const FrameParser *parser = get_frame_parser(mp3View->header);
+    uint header_size = parser->header_size;
+
+    // The bytes [base, end) of the frame region are in the window, out bytes are kept
+    uint pos = 0, base = 0, out = 0;
+    uint end = tag_size < VIEW_WINDOW ? tag_size : VIEW_WINDOW;
+    if (stats_pread(mp3View->fd, window, end, ID3_HEADER_SIZE) != (ssize_t)end ||
+        frame_region_start(parser, mp3View->header, window, end, &pos) == e_failure ||
+        grow_tag(mp3View, pos + 1) == e_failure)
+    {
+        return UINT_MAX;
+    }
+
+    // The extended header, if any, is kept in front of the frames
+    memcpy(mp3View->tag, window, pos);
+    out = pos;
+
+    while (pos < tag_size)
+    {
+        // Bring in the next window once the next frame header isn't in it
+        if (pos + header_size > end)
+        {
+            uint want = tag_size - pos < VIEW_WINDOW ? tag_size - pos : VIEW_WINDOW;
+            if (stats_pread(mp3View->fd, window, want, ID3_HEADER_SIZE + pos) != (ssize_t)want)
+            {
+                return UINT_MAX;
+            }
+            base = pos;
+            end = pos + want;
+        }
+
+        // Stop at the padding; a malformed frame is left for the frame table to reject
+        unsigned char *frame = window + (pos - base);
+        FrameEntry entry;
+        if (end - pos < header_size || frame[0] == 0 ||
+            parser->read_header(frame, tag_size - pos - header_size, &entry) == e_failure)
+        {
+            break;
+        }
+        uint next = pos + entry.data + entry.size;
+
+        if (next > end && header_size == FRAME_HEADER_SIZE && !(entry.flags & FRAME_UNSYNC_FLAG) &&
+            is_binary_frame(entry.id) && entry.size > FRAME_STUB_PREFIX + 4)
+        {
+            // Skip the payload, only its first bytes are read for the stub
+            unsigned char head[FRAME_HEADER_SIZE + FRAME_EXTRA_MAX + FRAME_STUB_PREFIX];
+            uint need = entry.data + FRAME_STUB_PREFIX;
+            uint have = end - pos < need ? end - pos : need;
+            memcpy(head, frame, have);
+            if ((have < need &&
+                 stats_pread(mp3View->fd, head + have, need - have, ID3_HEADER_SIZE + pos + have) != (ssize_t)(need - have)) ||
+                grow_tag(mp3View, out + FRAME_HEADER_SIZE + 4 + FRAME_STUB_PREFIX + 1) == e_failure)
+            {
+                return UINT_MAX;
+            }
+            entry.offset = 0;
+            out += make_stub_frame(parser, mp3View->tag + out, &entry, head);
+            pos = end = next;
+            continue;
+        }
+
+        uint have = (next < end ? next : end) - pos;
+        if (grow_tag(mp3View, out + (next - pos) + 1) == e_failure)
+        {
+            return UINT_MAX;
+        }
+        memcpy(mp3View->tag + out, frame, have);
+        if (next > end)
+        {
+            if (stats_pread(mp3View->fd, mp3View->tag + out + have, next - end, ID3_HEADER_SIZE + end) != (ssize_t)(next - end))
+            {
+                return UINT_MAX;
+            }
+            end = next;
+        }
+        out += next - pos;
+        pos = next;
+    }
+
+    // Of what follows the last frame, a frame header is enough to tell padding from a malformed frame
+    uint rest = end > pos ? end - pos : 0;
+    rest = rest < header_size ? rest : header_size;
+    if (grow_tag(mp3View, out + rest + 1) == e_failure)
+    {
+        return UINT_MAX;
+    }
+    if (rest > 0)
+    {
+        memcpy(mp3View->tag + out, window + (pos - base), rest);
+    }
+    return out + rest;
+}
+
+/**
+ * Reads the frame region of the ID3 tag into memory, VIEW_WINDOW bytes per read, so a tag
+ * that fits in one window takes a single read. Binary frames (APIC, GEOB, PRIV) that reach
+ * past the bytes already read are never read: the walker jumps over them by offset and keeps
+ * a stub with their size and the first bytes of their payload. Only the kept bytes are taken
+ * from the arena, the windows are read into a buffer of their own. The extended header, if
+ * any, is kept in front of the frames. Unsynchronised tags and frames are decoded in memory,
+ * so the tag that is indexed, cached and shown is always plain. All frames are then indexed
+ * in one pass by the parser of the tag version. A tag larger than the rest of the file is refused.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ * 
+ * Returns:
+ *   Status: e_success if the tag is loaded, e_failure if an error occurs.
+ */
+Status load_tag(Mp3ViewInfo *mp3View)
+{
+    uint tag_size = syncsafe_to_int(mp3View->header + 6);
+    mp3View->tag = NULL;
+    mp3View->tag_size = 0;
+
+    // A tag that runs past the end of the file is refused before anything is allocated
+    struct stat st;
+    if (fstat(mp3View->fd, &st) != 0 || (off_t)tag_size + ID3_HEADER_SIZE > st.st_size)
+    {
+        return e_failure;
+    }
+
+    // Frame sizes of an unsynchronised ID3v2.2/v2.3 tag count the decoded bytes, so the
+    // whole tag is read at once and decoded before it is walked
+    if (mp3View->header[5] & ID3_UNSYNC_FLAG)
+    {
+        mp3View->tag = arena_alloc(mp3View->arena, tag_size + 1);
+        if (mp3View->tag == NULL || stats_pread(mp3View->fd, mp3View->tag, tag_size, ID3_HEADER_SIZE) != (ssize_t)tag_size)
+        {
+            return e_failure;
+        }
+        mp3View->tag_size = resync_tag(mp3View->header, mp3View->tag, tag_size);
+        return build_frame_index(&mp3View->index, mp3View->header, mp3View->tag, mp3View->tag_size);
+    }
+
+    unsigned char *window = malloc(VIEW_WINDOW);
+    uint size = window != NULL ? walk_window(mp3View, window, tag_size) : UINT_MAX;
+    free(window);
+    if (size == UINT_MAX)
+    {
+        return e_failure;
+    }
+
+    // ID3v2.4 frames with their own unsynchronisation flag are decoded in place
+    mp3View->tag_size = resync_tag(mp3View->header, mp3View->tag, size);
+    return build_frame_index(&mp3View->index, mp3View->header, mp3View->tag, mp3View->tag_size);
+}
+
+/**
+ * Releases the frame table and closes the MP3 file. The tag stays in the arena until it is reset.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ */
+void close_mp3file(Mp3ViewInfo *mp3View)
+{
+    mp3View->tag = NULL;
+    mp3View->tail = NULL;
+    mp3View->tail_size = 0;
+    free_frame_index(&mp3View->index);
+    close(mp3View->fd);
+}
+
+/**
+ * Gives the text of a field: from its ID3v2 frame, or from the tail tags when the tag has no
+ * such frame or leaves it empty.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ *   id (const char*): The frame identifier of the field (e.g., "TIT2").
+ * 
+ * Returns:
+ *   const char*: The null terminated UTF-8 text, or NULL if neither the tag nor the tail tags have it.
+ */
+const char *get_field_text(Mp3ViewInfo *mp3View, const char *id)
+{
+    const char *text = get_frame_text(mp3View, id);
+    const char *tail = text == NULL || text[0] == '\0' ? tail_field(&mp3View->tail_tags, id) : NULL;
+    return tail != NULL ? tail : text;
+}
 
 /**
  * Reads and displays information (like title, artist, album, etc.) from the MP3 file.
- * This function reads the corresponding tag (e.g., TIT2 for title) and prints it to the console.
+ * This function looks up the frame (e.g., TIT2 for title) in the frame table and prints
+ * its content to the console. Fields missing from the frame table come from the tail tags.
  * 
  * Parameters:
  *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
@@ -208,45 +830,160 @@ Status check_version(Mp3ViewInfo *mp3View)
  */
 Status read_info(Mp3ViewInfo *mp3View, char str[])
 {
-    char buffer[4];
-
-    // Read the next 4 bytes to check for the tag
-    fread(buffer, 4, 1, mp3View->fptr_file);
-
-    // If the tag doesn't match, return failure
-    if (strcmp(buffer, str) != 0)
+    // If neither the tag nor the tail tags have the field, return failure
+    const char *title = get_field_text(mp3View, str);
+    if (title == NULL)
     {
         return e_failure;
     }
 
-    // Read the size of the tag's content
+    // Print the title (or other content)
+    fprintf(mp3View->out, "%-15s\n", title);
+
+    return e_success;
+}
+
+/**
+ * Gives the text of a frame (e.g., TIT2 for title) decoded to UTF-8 from the encoding named
+ * by its first byte. Comments and lyrics start with a language and a description, their
+ * text comes after them. The frame is looked up in the frame table and decoded into the arena.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ *   id (const char*): The frame identifier.
+ * 
+ * Returns:
+ *   char*: The null terminated text, or NULL if the tag has no such frame (or if the text
+ *          doesn't fit in the arena, mp3View->text_error is then set to mp3_err_read).
+ */
+char *get_frame_text(Mp3ViewInfo *mp3View, const char *id)
+{
+    const FrameEntry *entry = find_frame(&mp3View->index, id);
+    if (entry == NULL || entry->size == 0)
+    {
+        return NULL;
+    }
+    const unsigned char *data;
     uint size;
-    fread(&size, 4, 1, mp3View->fptr_file);
+    frame_payload(entry, mp3View->tag, &data, &size);
+    unsigned char encoding = data[0];
+    data++;
+    size--;
 
-    // Rearrange bytes to match the system's endianness
-    little_to_big((char *)&size, sizeof(int));
+    // Skip the language and the description of a comment
+    if (strncmp(id, "COMM", 4) == 0 || strncmp(id, "USLT", 4) == 0)
+    {
+        uint skip = size < 3 ? size : 3;
+        skip += text_span(data + skip, size - skip, encoding);
+        data += skip;
+        size -= skip;
+    }
 
-    // Skip 3 bytes (for other data in the tag)
-    fseek(mp3View->fptr_file, 3, SEEK_CUR);
+    char *text = arena_alloc(mp3View->arena, TEXT_UTF8_MAX(size));
+    if (text == NULL)
+    {
+        mp3View->text_error = mp3_err_read;
+        return NULL;
+    }
+    text_to_utf8(text, data, size, encoding);
+    return text;
+}
 
-    // Read the title content
-    char title[size];
-    fread(title, size - 1, 1, mp3View->fptr_file);
+/**
+ * Appends the record of the file to mp3View->record: path, status, the text fields (from the
+ * tail tags when the ID3v2 tag lacks them), the number of pictures and the error, if any.
+ * Missing fields are left empty (null in JSON). A text that doesn't fit in the arena makes
+ * it an error record.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information,
+ *                           with the frame table built unless error is set.
+ *   error (const char*): Why the file could not be viewed, NULL on success.
+ * 
+ * Returns:
+ *   Status: e_success if the record has status ok, e_failure if it is an error record.
+ */
+Status format_record(Mp3ViewInfo *mp3View, const char *error)
+{
+    RecordBuffer *record = mp3View->record;
+    OutputFormat format = mp3View->format;
 
-    // If it's a comment, fix a special case in the title
-    if (strcmp(buffer, "COMM") == 0)
+    // A text that doesn't fit in the arena makes the file an error, not a missing field
+    const char *fields[VIEW_FIELDS] = { NULL };
+    Status status = e_failure;
+    if (error == NULL && decode_fields(mp3View, fields) != mp3_ok)
+    {
+        error = view_message(mp3_err_read);
+        memset(fields, 0, sizeof(fields));
+    }
+    else if (error == NULL)
     {
-        if (title[3] == 0)
-            title[3] = '.';
+        status = e_success;
     }
 
-    // Null-terminate the title string
-    title[size - 1] = '\0';
+    record_field(record, format, "path", mp3View->file_name, 1);
+    record_field(record, format, "status", error == NULL ? "ok" : "error", 0);
+    for (uint i = 0; i < VIEW_FIELDS; i++)
+    {
+        record_field(record, format, record_fields[i].name, fields[i], 0);
+    }
 
-    // Print the title (or other content)
-    printf("%-15s\n", title);
+    char pictures[12];
+    uint count = 0;
+    for (uint i = 0; error == NULL && i < mp3View->index.count; i++)
+    {
+        count += strncmp(mp3View->index.frames[i].id, "APIC", 4) == 0;
+    }
+    sprintf(pictures, "%u", count);
+    record_field(record, format, "pictures", error == NULL ? pictures : NULL, 0);
+    record_field(record, format, "error", error, 0);
+    record_end(record, format);
+    return status;
+}
 
-    return e_success;
+/**
+ * Decodes the text fields of a record, each from its ID3v2 frame or from the tail tags.
+ * 
+ * Parameters:
+ *   mp3View (Mp3ViewInfo*): A pointer to the structure containing MP3 file information.
+ *   fields (const char*[]): Set to the VIEW_FIELDS texts in record order, NULL for missing fields.
+ * 
+ * Returns:
+ *   Mp3Error: mp3_ok, or mp3_err_read if a text doesn't fit in the arena.
+ */
+Mp3Error decode_fields(Mp3ViewInfo *mp3View, const char *fields[VIEW_FIELDS])
+{
+    mp3View->text_error = mp3_ok;
+    for (uint i = 0; i < VIEW_FIELDS; i++)
+    {
+        fields[i] = get_field_text(mp3View, record_fields[i].frame_id);
+    }
+    return mp3View->text_error;
+}
+
+/**
+ * Appends the header line naming the record fields, for the CSV and TSV formats.
+ * 
+ * Parameters:
+ *   record (RecordBuffer*): The buffer.
+ *   format (OutputFormat): The record format.
+ */
+void format_header(RecordBuffer *record, OutputFormat format)
+{
+    if (format != format_csv && format != format_tsv)
+    {
+        return;
+    }
+
+    record_field(record, format, "path", "path", 1);
+    record_field(record, format, "status", "status", 0);
+    for (uint i = 0; i < sizeof(record_fields) / sizeof(record_fields[0]); i++)
+    {
+        record_field(record, format, record_fields[i].name, record_fields[i].name, 0);
+    }
+    record_field(record, format, "pictures", "pictures", 0);
+    record_field(record, format, "error", "error", 0);
+    record_end(record, format);
 }
 
 /**
@@ -262,7 +999,7 @@ void little_to_big(char *ptr, uint size)
     char temp;
 
     // Swap bytes to convert little-endian to big-endian
-    for (int i = 0; i < size / 2; i++)
+    for (uint i = 0; i < size / 2; i++)
     {
         temp = ptr[i];
         ptr[i] = ptr[size - i - 1];
@@ -2,14 +2,40 @@
 #define MP3_VIEW_H
 
 #include "types.h"
+#include "mp3_frame.h"
+#include "mp3_cache.h"
+#include "mp3_arena.h"
+#include "mp3_format.h"
+#include "mp3_tail.h"
+#include "mp3_lib.h"
 
 // Structure to store MP3 file viewing information
+// Text fields of a record: title, artist, album, year, genre and comment
+#define VIEW_FIELDS 6
+
 typedef struct Mp3ViewInfo
 {
     char *file_name;   // File name of the MP3 to be viewed
-    FILE *fptr_file;   // File pointer to the MP3 file
+    int fd;            // File descriptor of the MP3 file
+    FILE *out;         // Stream the details are printed to (e.g., stdout)
+    unsigned char header[10];  // ID3 tag header (identifier, version, flags, size)
     char mp3Id[4];     // ID3 tag identifier (e.g., "ID3")
-    short version;      // ID3 version (e.g., version 3)
+    short version;      // ID3 major version (2, 3 or 4)
+
+    unsigned char *tag;  // Frame region of the tag, read in a single call
+    uint tag_size;       // Size of the frame region
+    FrameIndex index;    // Table of all frames of the tag
+
+    unsigned char *tail; // ID3v1, Lyrics3 and APE tags at the end of the file, NULL if there are none
+    uint tail_size;      // Size of the tail tags
+    TailTags tail_tags;  // Fields of the tail tags, used for fields the ID3v2 tag doesn't have
+
+    TagCache *cache;     // Cache of parsed tags consulted before opening the file, NULL if not used
+    Arena *arena;        // Holds the tag and the frame texts, reset by the owner after each file
+    Mp3Error text_error; // mp3_err_read once a frame text didn't fit in the arena
+
+    OutputFormat format; // Labelled lines on out, or one record appended to record
+    RecordBuffer *record;  // Buffer the record is appended to when format isn't format_text
 } Mp3ViewInfo;
 
 // Function Prototypes
@@ -46,6 +72,102 @@ Status read_and_validation_view(char *argv[], Mp3ViewInfo *mp3View);
 Status view_info(Mp3ViewInfo *mp3View);
 
 
+/**
+ * Reads the tags of the file and builds the frame table, without printing anything.
+ * The cache is consulted first; a file with only ID3v1, Lyrics3 or APE tags is loaded from them.
+ * The file is closed before returning. view_release() is called once the tags are used.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ * 
+ * @returns Mp3Error: mp3_ok if the tags are loaded, the reason otherwise.
+ */
+Mp3Error view_load(Mp3ViewInfo *mp3View);
+
+
+/**
+ * Releases the frame table of the file loaded last. The tag and the texts stay in the arena until it is reset.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ */
+void view_release(Mp3ViewInfo *mp3View);
+
+
+/**
+ * Gives the line reported when a file can't be viewed, the same in every output format.
+ * 
+ * @param error (Mp3Error): The reason returned by view_load().
+ * 
+ * @returns const char*: The message (e.g., "Invalid ID3 version").
+ */
+const char *view_message(Mp3Error error);
+
+
+/**
+ * Displays the information of a tag that was already read into memory by the caller.
+ * The tag is moved into the arena first, with its binary frames larger than a read window stubbed,
+ * so it is shown the same as by view_info(). An unsynchronised tag is decoded in place first.
+ * The tag buffer and frame table are released afterwards.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure with header, tag (NULL if it could not be read) and tag_size filled in.
+ * 
+ * @returns Status: e_success if the information is successfully displayed, e_failure if an error occurs.
+ */
+Status view_loaded(Mp3ViewInfo *mp3View);
+
+
+/**
+ * Displays the title, artist, album, year, music genre and comments of the indexed tag.
+ * Nothing is printed when a text doesn't fit in the arena.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ * 
+ * @returns Status: e_success if the details were printed, e_failure if a text doesn't fit in the arena.
+ */
+Status print_info(Mp3ViewInfo *mp3View);
+
+
+/**
+ * Appends the record of the file to mp3View->record: path, status, the text fields,
+ * the number of pictures and the error, if any. A text that doesn't fit in the arena
+ * makes it an error record.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information, with the frame table built unless error is set.
+ * @param error (const char*): Why the file could not be viewed, NULL on success.
+ * 
+ * @returns Status: e_success if the record has status ok, e_failure if it is an error record.
+ */
+Status format_record(Mp3ViewInfo *mp3View, const char *error);
+
+
+/**
+ * Decodes the text fields of a record (from the tail tags when the ID3v2 tag lacks them).
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information, with the frame table built.
+ * @param fields (const char*[]): Set to the VIEW_FIELDS texts in record order, NULL for missing fields.
+ * 
+ * @returns Mp3Error: mp3_ok, or mp3_err_read if a text doesn't fit in the arena.
+ */
+Mp3Error decode_fields(Mp3ViewInfo *mp3View, const char *fields[VIEW_FIELDS]);
+
+
+/**
+ * Appends the header line naming the record fields, for the CSV and TSV formats.
+ * 
+ * @param record (RecordBuffer*): The buffer.
+ * @param format (OutputFormat): The record format.
+ */
+void format_header(RecordBuffer *record, OutputFormat format);
+
+
+/**
+ * Lists the pictures, objects and private frames of the tag with their MIME type (owner for
+ * private frames) and size.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ */
+void print_binary_frames(Mp3ViewInfo *mp3View);
+
+
 /**
  * Opens the MP3 file for reading.
  * 
@@ -67,17 +189,63 @@ Status check_ID(Mp3ViewInfo *mp3View);
 
 
 /**
- * Checks if the MP3 file has a valid ID3 version (version 3).
+ * Checks if the MP3 file has a supported ID3 version (ID3v2.2, v2.3 or v2.4).
  * 
  * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
  * 
- * @returns Status: e_success if the version is 3, e_failure if not.
+ * @returns Status: e_success if the version is supported, e_failure if not.
  */
 Status check_version(Mp3ViewInfo *mp3View);
 
 
+/**
+ * Reads the frame region of the ID3 tag into memory, one window per read, skipping the payload
+ * of large binary frames, undoes any unsynchronisation and builds the frame table. The audio data
+ * after the tag is never read. A tag larger than the rest of the file is refused.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ * 
+ * @returns Status: e_success if the tag is loaded, e_failure if an error occurs.
+ */
+Status load_tag(Mp3ViewInfo *mp3View);
+
+
+/**
+ * Releases the frame table and closes the MP3 file. The tag stays in the arena until it is reset.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ */
+void close_mp3file(Mp3ViewInfo *mp3View);
+
+
+/**
+ * Gives the text of a frame (e.g., TIT2 for title) decoded to UTF-8, whatever its encoding.
+ * For comments, the text after the language and the description.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ * @param id (const char*): The frame identifier.
+ * 
+ * @returns char*: The null terminated text, taken from the arena, or NULL if the tag has no such frame
+ *                 (or if the text doesn't fit in the arena, text_error is then set).
+ */
+char *get_frame_text(Mp3ViewInfo *mp3View, const char *id);
+
+
+/**
+ * Gives the text of a field: from its ID3v2 frame, or from the tail tags when the tag has no
+ * such frame or leaves it empty.
+ * 
+ * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
+ * @param id (const char*): The frame identifier of the field (e.g., "TIT2").
+ * 
+ * @returns const char*: The null terminated UTF-8 text, or NULL if neither the tag nor the tail tags have it.
+ */
+const char *get_field_text(Mp3ViewInfo *mp3View, const char *id);
+
+
 /**
  * Reads and displays the information of a specific frame (e.g., title, artist, album).
+ * The frame is looked up in the frame table, so the frames may come in any order.
  * 
  * @param mp3View (Mp3ViewInfo*): Structure containing MP3 file information.
  * @param str (char[]): Frame identifier (e.g., "TIT2" for title, "TPE1" for artist).
@@ -0,0 +1,645 @@
+/*
+ * Benchmark harness for the view, edit, scan and batch paths.
+ * 
+ * Runs each path over a corpus (e.g., one written by mp3_gen) once with a cold and once
+ * with a warm page cache, and prints files/sec, MB/sec, per-file latency percentiles and
+ * peak RSS as JSON, so runs of two releases can be compared with a diff.
+ * 
+ * Build (from Mp3_tag_reader):
+ *   gcc -O2 -o mp3_bench tools/mp3_bench.c $(ls *.c | grep -v '^main.c$') -pthread
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "../types.h"
+#include "../mp3_view.h"
+#include "../mp3_edit.h"
+#include "../mp3_scan.h"
+#include "../mp3_batch.h"
+#include "../mp3_copy.h"
+#include "../mp3_unsync.h"
+
+// Name of the scratch copy edited in edit mode
+#define BENCH_SCRATCH "bench.mp3"
+
+// Title written by the edit and batch passes
+#define BENCH_TITLE "Benchmark title"
+
+// Structure to store the options and the corpus of a benchmark
+typedef struct BenchInfo
+{
+    char *corpus;          // Directory of the corpus, absolute
+    char *scratch;         // Directory the edit copies are written to, absolute
+    int threads;           // Worker threads of the scan and batch passes
+    int modes;             // Bit set of the passes to run
+    int caches;            // 1 for cold, 2 for warm, 3 for both
+
+    char **files;          // Paths of the corpus files in sorted order
+    uint count;            // Number of files
+    unsigned long long bytes;  // Total size of the files
+} BenchInfo;
+
+// Passes the harness can run
+enum { mode_view, mode_edit, mode_scan, mode_batch, mode_count };
+
+static const char *mode_names[mode_count] = { "view", "edit", "scan", "batch" };
+
+// Structure to store the result of one pass, sent from the child process that ran it
+typedef struct BenchResult
+{
+    uint files;            // Files processed
+    uint failed;           // Files the path reported as failed
+    double seconds;        // Wall time of the timed part
+    int has_latency;       // 1 if the per-file latencies below were measured
+    double p50_us;         // Median per-file latency
+    double p99_us;         // 99th percentile per-file latency
+    double max_us;         // Slowest file
+    long peak_rss_kb;      // Peak resident set size of the pass
+} BenchResult;
+
+/**
+ * Returns the monotonic clock in nanoseconds.
+ * 
+ * Returns:
+ *   unsigned long long: The time.
+ */
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Compares two paths for qsort().
+ */
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Compares two latencies for qsort().
+ */
+static int compare_latency(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Drops the cached pages of a file, so the next read goes to the device.
+ * Dirty pages are written first, as the kernel only drops clean ones.
+ * 
+ * Parameters:
+ *   path (const char*): The file.
+ */
+static void drop_cache(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/**
+ * Reads a whole file once, so its pages are cached.
+ * 
+ * Parameters:
+ *   path (const char*): The file.
+ */
+static void warm_cache(const char *path)
+{
+    static char buffer[1 << 20];
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0)
+    {
+        while (read(fd, buffer, sizeof(buffer)) > 0)
+        {
+        }
+        close(fd);
+    }
+}
+
+/**
+ * Copies a corpus file to a scratch file that may be edited.
+ * 
+ * Parameters:
+ *   src (const char*): The corpus file.
+ *   dest (const char*): The scratch file.
+ * 
+ * Returns:
+ *   Status: e_success if the file was copied, e_failure if an error occurs.
+ */
+static Status copy_scratch(const char *src, const char *dest)
+{
+    int fd_src = open(src, O_RDONLY);
+    int fd_dest = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    Status status = e_failure;
+    struct stat st;
+    if (fd_src >= 0 && fd_dest >= 0 && fstat(fd_src, &st) == 0)
+    {
+        status = copy_file_part(fd_dest, fd_src, 0, st.st_size, NULL);
+    }
+    if (fd_src >= 0)
+    {
+        close(fd_src);
+    }
+    if (fd_dest >= 0)
+    {
+        close(fd_dest);
+    }
+    return status;
+}
+
+/**
+ * Views every file on this thread and measures each view_info() call.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ *   result (BenchResult*): Where the failures are counted.
+ *   latency (unsigned long long*): Where the time of each file is stored.
+ */
+static void run_view(BenchInfo *bench, BenchResult *result, unsigned long long *latency)
+{
+    Arena arena;
+    arena_init(&arena, arena_limit());
+    for (uint i = 0; i < bench->count; i++)
+    {
+        Mp3ViewInfo mp3View;
+        memset(&mp3View, 0, sizeof(mp3View));
+        mp3View.file_name = bench->files[i];
+        mp3View.out = stdout;
+        mp3View.arena = &arena;
+        mp3View.format = format_text;
+
+        unsigned long long start = now_ns();
+        result->failed += view_info(&mp3View) == e_failure;
+        latency[i] = now_ns() - start;
+        arena_reset(&arena);
+    }
+    arena_free(&arena);
+}
+
+/**
+ * Edits the title of a scratch copy of every file and measures each edit_info() call.
+ * Copying (and dropping the copy from the cache for a cold pass) is not timed.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ *   cold (int): Nonzero for a cold page cache.
+ *   result (BenchResult*): Where the failures are counted.
+ *   latency (unsigned long long*): Where the time of each file is stored.
+ */
+static void run_edit(BenchInfo *bench, int cold, BenchResult *result, unsigned long long *latency)
+{
+    Mp3EditInfo mp3Edit;
+    init_edit(&mp3Edit);
+    for (uint i = 0; i < bench->count; i++)
+    {
+        if (copy_scratch(bench->files[i], BENCH_SCRATCH) == e_failure)
+        {
+            result->failed++;
+            latency[i] = 0;
+            continue;
+        }
+        if (cold)
+        {
+            drop_cache(BENCH_SCRATCH);
+        }
+
+        mp3Edit.src_fname = BENCH_SCRATCH;
+        mp3Edit.out = stdout;
+        mp3Edit.edit_count = 1;
+        mp3Edit.edits[0].frame = "-t";
+        mp3Edit.edits[0].modify_data = BENCH_TITLE;
+        mp3Edit.edits[0].data_length = strlen(BENCH_TITLE) + 1;
+
+        unsigned long long start = now_ns();
+        result->failed += edit_info(&mp3Edit) == e_failure;
+        latency[i] = now_ns() - start;
+    }
+    free_edit(&mp3Edit);
+    unlink(BENCH_SCRATCH);
+}
+
+/**
+ * Runs the recursive scan over the corpus directory.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ *   result (BenchResult*): Where the failures are counted.
+ */
+static void run_scan(BenchInfo *bench, BenchResult *result)
+{
+    ScanInfo scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.dir_name = bench->corpus;
+    scan.threads = bench->threads;
+    scan.format = format_text;
+    scan_info(&scan);
+    result->failed = scan.failed;
+}
+
+/**
+ * Edits the scratch copies of all files from one manifest on the worker threads.
+ * The copies and the manifest are written by prepare_batch() beforehand.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ *   result (BenchResult*): Where the failures are counted.
+ */
+static void run_batch(BenchInfo *bench, BenchResult *result)
+{
+    BatchInfo batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.manifest = "bench.tsv";
+    batch.threads = bench->threads;
+    batch_info(&batch);
+    result->failed = batch.failed;
+}
+
+/**
+ * Writes the scratch copies and the manifest of the batch pass, untimed.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ * 
+ * Returns:
+ *   Status: e_success if everything was written, e_failure if an error occurs.
+ */
+static Status prepare_batch(BenchInfo *bench)
+{
+    FILE *manifest = fopen("bench.tsv", "w");
+    if (manifest == NULL)
+    {
+        return e_failure;
+    }
+    Status status = e_success;
+    for (uint i = 0; i < bench->count && status == e_success; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "bench_%u.mp3", i);
+        status = copy_scratch(bench->files[i], name);
+        fprintf(manifest, "%s\t-t\t%s\n", name, BENCH_TITLE);
+    }
+    if (fclose(manifest) != 0)
+    {
+        status = e_failure;
+    }
+    return status;
+}
+
+/**
+ * Removes the scratch copies and the manifest of the batch pass.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ */
+static void cleanup_batch(BenchInfo *bench)
+{
+    for (uint i = 0; i < bench->count; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "bench_%u.mp3", i);
+        unlink(name);
+    }
+    unlink("bench.tsv");
+}
+
+/**
+ * Runs one pass in this process: brings the page cache into the wanted state,
+ * silences stdout, runs the path and fills in the result.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ *   mode (int): The pass.
+ *   cold (int): Nonzero for a cold page cache.
+ *   result (BenchResult*): Where the result is stored.
+ */
+static void run_pass(BenchInfo *bench, int mode, int cold, BenchResult *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->files = bench->count;
+    if (mode == mode_batch && prepare_batch(bench) == e_failure)
+    {
+        result->failed = bench->count;
+        cleanup_batch(bench);
+        return;
+    }
+
+    for (uint i = 0; i < bench->count; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "bench_%u.mp3", i);
+        const char *path = mode == mode_batch ? name : bench->files[i];
+        if (cold)
+        {
+            drop_cache(path);
+        }
+        else
+        {
+            warm_cache(path);
+        }
+    }
+
+    // The details of every file go nowhere, only the timing matters
+    fflush(stdout);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0)
+    {
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+
+    unsigned long long *latency = calloc(bench->count + 1, sizeof(unsigned long long));
+    unsigned long long start = now_ns();
+    switch (mode)
+    {
+        case mode_view: run_view(bench, result, latency); break;
+        case mode_edit: run_edit(bench, cold, result, latency); break;
+        case mode_scan: run_scan(bench, result); break;
+        case mode_batch: run_batch(bench, result); break;
+    }
+    fflush(stdout);
+    if (mode != mode_edit)
+    {
+        result->seconds = (now_ns() - start) / 1e9;
+    }
+    else
+    {
+        // The untimed copies are left out of the edit pass
+        for (uint i = 0; i < bench->count; i++)
+        {
+            result->seconds += latency[i] / 1e9;
+        }
+    }
+
+    if ((mode == mode_view || mode == mode_edit) && bench->count > 0)
+    {
+        qsort(latency, bench->count, sizeof(unsigned long long), compare_latency);
+        uint p99 = (uint)(bench->count * 99ULL / 100);
+        result->has_latency = 1;
+        result->p50_us = latency[bench->count / 2] / 1e3;
+        result->p99_us = latency[p99 < bench->count ? p99 : bench->count - 1] / 1e3;
+        result->max_us = latency[bench->count - 1] / 1e3;
+    }
+    free(latency);
+    if (mode == mode_batch)
+    {
+        cleanup_batch(bench);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result->peak_rss_kb = usage.ru_maxrss;
+}
+
+/**
+ * Runs one pass in a child process, so its peak RSS and its silenced stdout are its own.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ *   mode (int): The pass.
+ *   cold (int): Nonzero for a cold page cache.
+ *   result (BenchResult*): Where the result is stored.
+ * 
+ * Returns:
+ *   Status: e_success if the pass ran, e_failure if the child could not run or died.
+ */
+static Status fork_pass(BenchInfo *bench, int mode, int cold, BenchResult *result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return e_failure;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return e_failure;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        run_pass(bench, mode, cold, result);
+        ssize_t written = write(fds[1], result, sizeof(*result));
+        _exit(written == sizeof(*result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+    int wstatus;
+    waitpid(pid, &wstatus, 0);
+    return got == sizeof(*result) && WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0 ? e_success : e_failure;
+}
+
+/**
+ * Prints the result of one pass as a JSON object.
+ * 
+ * Parameters:
+ *   bench (BenchInfo*): The benchmark.
+ *   mode (int): The pass.
+ *   cold (int): Nonzero for a cold page cache.
+ *   result (BenchResult*): The result.
+ *   last (int): Nonzero for the last object of the list.
+ */
+static void print_result(BenchInfo *bench, int mode, int cold, BenchResult *result, int last)
+{
+    double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+    printf("    {\"mode\": \"%s\", \"cache\": \"%s\", \"files\": %u, \"failed\": %u, \"seconds\": %.6f, "
+           "\"files_per_sec\": %.1f, \"mb_per_sec\": %.2f, ",
+           mode_names[mode], cold ? "cold" : "warm", result->files, result->failed, result->seconds,
+           result->files / seconds, bench->bytes / seconds / 1e6);
+    if (result->has_latency)
+    {
+        printf("\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, ", result->p50_us, result->p99_us, result->max_us);
+    }
+    else
+    {
+        printf("\"p50_us\": null, \"p99_us\": null, \"max_us\": null, ");
+    }
+    printf("\"peak_rss_kb\": %ld}%s\n", result->peak_rss_kb, last ? "" : ",");
+}
+
+/**
+ * Reads the command line into the benchmark options.
+ * 
+ * Parameters:
+ *   argc (int): Number of command-line arguments.
+ *   argv (char*[]): Command-line arguments.
+ *   bench (BenchInfo*): Where the options are stored.
+ * 
+ * Returns:
+ *   Status: e_success if every option is valid, e_failure otherwise.
+ */
+static Status parse_options(int argc, char *argv[], BenchInfo *bench)
+{
+    memset(bench, 0, sizeof(*bench));
+    bench->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bench->modes = (1 << mode_count) - 1;
+    bench->caches = 3;
+    const char *scratch = "/tmp";
+    if (argc < 2)
+    {
+        return e_failure;
+    }
+    bench->corpus = realpath(argv[1], NULL);
+    if (bench->corpus == NULL)
+    {
+        perror(argv[1]);
+        return e_failure;
+    }
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--mode=", 7) == 0)
+        {
+            bench->modes = 0;
+            char *list = argv[i] + 7;
+            for (char *name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
+            {
+                int known = 0;
+                for (int m = 0; m < mode_count; m++)
+                {
+                    if (strcmp(name, mode_names[m]) == 0)
+                    {
+                        bench->modes |= 1 << m;
+                        known = 1;
+                    }
+                }
+                if (!known)
+                {
+                    return e_failure;
+                }
+            }
+        }
+        else if (strncmp(argv[i], "--cache=", 8) == 0)
+        {
+            const char *value = argv[i] + 8;
+            bench->caches = strcmp(value, "cold") == 0 ? 1 : strcmp(value, "warm") == 0 ? 2 : strcmp(value, "both") == 0 ? 3 : 0;
+            if (bench->caches == 0)
+            {
+                return e_failure;
+            }
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            bench->threads = atoi(argv[i] + 10);
+            if (bench->threads < 1)
+            {
+                return e_failure;
+            }
+        }
+        else if (strncmp(argv[i], "--scratch=", 10) == 0)
+        {
+            scratch = argv[i] + 10;
+        }
+        else
+        {
+            return e_failure;
+        }
+    }
+
+    bench->scratch = realpath(scratch, NULL);
+    if (bench->scratch == NULL)
+    {
+        perror(scratch);
+        return e_failure;
+    }
+    return e_success;
+}
+
+/**
+ * Runs the selected passes over the corpus and prints the results as JSON on stdout.
+ */
+int main(int argc, char *argv[])
+{
+    BenchInfo bench;
+    if (parse_options(argc, argv, &bench) == e_failure)
+    {
+        fprintf(stderr, "USAGE :\n./mp3_bench <corpus_directory> [--mode=view,edit,scan,batch] [--cache=cold|warm|both]\n"
+                        "            [--threads=N] [--scratch=directory]\n");
+        return e_failure;
+    }
+
+    // The corpus is listed like the recursive scan does
+    ScanInfo scan;
+    memset(&scan, 0, sizeof(scan));
+    if (collect_files(&scan, bench.corpus) == e_failure || scan.count == 0)
+    {
+        fprintf(stderr, "ERROR: no MP3 files below %s\n", bench.corpus);
+        return e_failure;
+    }
+    qsort(scan.files, scan.count, sizeof(char *), compare_paths);
+    bench.files = scan.files;
+    bench.count = scan.count;
+    for (uint i = 0; i < bench.count; i++)
+    {
+        struct stat st;
+        if (stat(bench.files[i], &st) == 0)
+        {
+            bench.bytes += st.st_size;
+        }
+    }
+
+    // Scratch copies and rewrite outputs are made in the scratch directory
+    if (chdir(bench.scratch) != 0)
+    {
+        perror(bench.scratch);
+        return e_failure;
+    }
+
+    printf("{\n  \"corpus\": \"%s\",\n  \"files\": %u,\n  \"bytes\": %llu,\n  \"threads\": %d,\n  \"unsync\": \"%s\",\n  \"runs\": [\n",
+           bench.corpus, bench.count, bench.bytes, bench.threads, unsync_engine()->name);
+    int passes = 0, done = 0;
+    for (int mode = 0; mode < mode_count; mode++)
+    {
+        passes += (bench.modes >> mode & 1) * (bench.caches == 3 ? 2 : 1);
+    }
+    for (int mode = 0; mode < mode_count; mode++)
+    {
+        for (int cold = 1; cold >= 0 && bench.modes >> mode & 1; cold--)
+        {
+            if (!(bench.caches & (cold ? 1 : 2)))
+            {
+                continue;
+            }
+            BenchResult result;
+            if (fork_pass(&bench, mode, cold, &result) == e_failure)
+            {
+                fprintf(stderr, "ERROR: the %s pass did not finish\n", mode_names[mode]);
+                memset(&result, 0, sizeof(result));
+                result.files = bench.count;
+                result.failed = bench.count;
+            }
+            print_result(&bench, mode, cold, &result, ++done == passes);
+            fflush(stdout);
+        }
+    }
+    printf("  ]\n}\n");
+
+    for (uint i = 0; i < bench.count; i++)
+    {
+        free(bench.files[i]);
+    }
+    free(bench.files);
+    free(bench.corpus);
+    free(bench.scratch);
+    return e_success;
+}
@@ -0,0 +1,929 @@
+/*
+ * Synthetic MP3 corpus generator.
+ * 
+ * Writes reproducible ID3 v2.2, v2.3 and v2.4 tagged files with tunable frame counts, text
+ * sizes, encodings, padding, picture sizes and audio lengths, and optionally malformed
+ * variants. The same seed and options give the same bytes on every machine.
+ * 
+ * Build (from Mp3_tag_reader):
+ *   gcc -O2 -o mp3_gen tools/mp3_gen.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "../types.h"
+
+// Bytes of one fake MPEG audio frame (128 kbit/s, 44.1 kHz)
+#define AUDIO_FRAME_SIZE 417
+
+// Largest tag size a syncsafe header can describe
+#define MAX_TAG_SIZE 0x0FFFFFFF
+
+// Structure to store an inclusive range of values picked at random
+typedef struct Range
+{
+    uint min;
+    uint max;
+} Range;
+
+// Structure to store a growing byte buffer
+typedef struct Buffer
+{
+    unsigned char *data;
+    size_t len;
+    size_t capacity;
+} Buffer;
+
+// Text encodings of ID3 v2, numbered as in the encoding byte
+typedef enum
+{
+    enc_latin1,
+    enc_utf16,
+    enc_utf16be,
+    enc_utf8,
+    enc_mix
+} Encoding;
+
+// Kinds of malformed files
+typedef enum
+{
+    bad_none,
+    bad_magic,         // "ID3" replaced
+    bad_version,       // Major version the reader doesn't know
+    bad_syncsafe,      // High bit set in a byte of the header size
+    bad_tag_size,      // Header size larger than the file
+    bad_truncated,     // File ends inside the tag
+    bad_frame_size,    // A frame reaches past the end of the tag
+    bad_zero_frame,    // A frame of size 0 between valid frames
+    bad_frame_id,      // A frame with an invalid id between valid frames
+    bad_count
+} Malformed;
+
+static const char *malformed_names[bad_count] =
+{
+    "none", "magic", "version", "syncsafe", "tag_size", "truncated", "frame_size", "zero_frame", "frame_id",
+};
+
+static const char *encoding_names[] = { "latin1", "utf16", "utf16be", "utf8", "mix" };
+
+// Structure to store the generator options
+typedef struct GenOptions
+{
+    const char *dir;       // Directory the files are written to
+    uint count;            // Number of files
+    uint64_t seed;         // Seed of the random generator
+    int version;           // 2, 3 or 4, 0 to pick one per file
+    Encoding encoding;     // Text encoding, enc_mix to pick one per frame
+    Range frames;          // Extra text frames besides the six standard ones
+    Range text;            // Characters per text frame
+    Range padding;         // Bytes of padding
+    Range apic;            // Bytes of picture data, 0 for no picture
+    Range audio;           // Bytes of audio data
+    uint unsync;           // Percentage of files written unsynchronised
+    uint malformed;        // Percentage of files made malformed
+} GenOptions;
+
+// Standard frames in the order title, artist, album, year, genre, comment, and the picture
+static const char *std_ids[3][7] =
+{
+    { "TT2", "TP1", "TAL", "TYE", "TCO", "COM", "PIC" },
+    { "TIT2", "TPE1", "TALB", "TYER", "TCON", "COMM", "APIC" },
+    { "TIT2", "TPE1", "TALB", "TDRC", "TCON", "COMM", "APIC" },
+};
+
+// Extra text frames, TXXX (TXX) frames with numbered descriptions follow when these run out
+static const char *extra_ids[2][10] =
+{
+    { "TP2", "TCM", "TRK", "TPA", "TBP", "TEN", "TCR", "TPB", "TSS", "TOA" },
+    { "TPE2", "TCOM", "TRCK", "TPOS", "TBPM", "TENC", "TCOP", "TPUB", "TSSE", "TOPE" },
+};
+
+static const char *genres[] = { "Pop", "Rock", "Jazz", "Blues", "Classical", "Hip-Hop", "Electronic", "Folk" };
+
+// Code points the random text is made of, mostly ASCII with some Latin-1 and wider characters
+static const uint32_t alphabet[] =
+{
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't',
+    'u', 'v', 'w', 'x', 'y', 'z', 'A', 'E', 'I', 'O', 'U', 'S', 'T', ' ', ' ', ' ', ' ', '0', '1', '2',
+    0xE9, 0xE8, 0xFC, 0xF1, 0xC5, 0xDF,
+    0x3042, 0x97F3, 0x4E50, 0x0416, 0x1F3B5,
+};
+
+/**
+ * Returns the next number of the splitmix64 generator, the same sequence on every machine.
+ * 
+ * Parameters:
+ *   state (uint64_t*): State of the generator.
+ * 
+ * Returns:
+ *   uint64_t: The next random number.
+ */
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Picks a number from a range.
+ * 
+ * Parameters:
+ *   state (uint64_t*): State of the generator.
+ *   range (Range): The range.
+ * 
+ * Returns:
+ *   uint: A number from range.min to range.max.
+ */
+static uint pick(uint64_t *state, Range range)
+{
+    return range.min + (uint)(next_random(state) % ((uint64_t)range.max - range.min + 1));
+}
+
+/**
+ * Appends bytes to a buffer, growing it as needed.
+ * 
+ * Parameters:
+ *   buffer (Buffer*): The buffer.
+ *   data (const void*): The bytes, or NULL to append zero bytes.
+ *   size (size_t): Number of bytes.
+ */
+static void append(Buffer *buffer, const void *data, size_t size)
+{
+    if (buffer->len + size > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->len + size)
+        {
+            capacity *= 2;
+        }
+        unsigned char *grown = realloc(buffer->data, capacity);
+        if (grown == NULL)
+        {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(e_failure);
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+
+    if (data != NULL)
+    {
+        memcpy(buffer->data + buffer->len, data, size);
+    }
+    else
+    {
+        memset(buffer->data + buffer->len, 0, size);
+    }
+    buffer->len += size;
+}
+
+/**
+ * Appends one byte to a buffer.
+ * 
+ * Parameters:
+ *   buffer (Buffer*): The buffer.
+ *   byte (uint): The byte.
+ */
+static void append_byte(Buffer *buffer, uint byte)
+{
+    unsigned char value = byte;
+    append(buffer, &value, 1);
+}
+
+/**
+ * Stores a number as big-endian bytes, 7 bits per byte when syncsafe.
+ * 
+ * Parameters:
+ *   dest (unsigned char*): Where the bytes are stored.
+ *   value (uint): The number.
+ *   bytes (int): Number of bytes (3 or 4).
+ *   syncsafe (int): Nonzero for a syncsafe number.
+ */
+static void put_size(unsigned char *dest, uint value, int bytes, int syncsafe)
+{
+    int shift = syncsafe ? 7 : 8;
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        dest[i] = value & ((1u << shift) - 1);
+        value >>= shift;
+    }
+}
+
+/**
+ * Appends one code point in the given encoding. Code points Latin-1 can't hold become '?'.
+ * 
+ * Parameters:
+ *   buffer (Buffer*): The buffer.
+ *   encoding (Encoding): The encoding.
+ *   c (uint32_t): The code point.
+ */
+static void append_char(Buffer *buffer, Encoding encoding, uint32_t c)
+{
+    switch (encoding)
+    {
+        case enc_latin1:
+            append_byte(buffer, c < 0x100 ? c : '?');
+            break;
+        case enc_utf16:
+        case enc_utf16be:
+        {
+            // Little endian after the BOM for enc_utf16, big endian for enc_utf16be
+            uint units[2] = { c, 0 };
+            int count = 1;
+            if (c >= 0x10000)
+            {
+                units[0] = 0xD800 + ((c - 0x10000) >> 10);
+                units[1] = 0xDC00 + ((c - 0x10000) & 0x3FF);
+                count = 2;
+            }
+            for (int i = 0; i < count; i++)
+            {
+                if (encoding == enc_utf16)
+                {
+                    append_byte(buffer, units[i] & 0xFF);
+                    append_byte(buffer, units[i] >> 8);
+                }
+                else
+                {
+                    append_byte(buffer, units[i] >> 8);
+                    append_byte(buffer, units[i] & 0xFF);
+                }
+            }
+            break;
+        }
+        default:
+            if (c < 0x80)
+            {
+                append_byte(buffer, c);
+            }
+            else if (c < 0x800)
+            {
+                append_byte(buffer, 0xC0 | c >> 6);
+                append_byte(buffer, 0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000)
+            {
+                append_byte(buffer, 0xE0 | c >> 12);
+                append_byte(buffer, 0x80 | (c >> 6 & 0x3F));
+                append_byte(buffer, 0x80 | (c & 0x3F));
+            }
+            else
+            {
+                append_byte(buffer, 0xF0 | c >> 18);
+                append_byte(buffer, 0x80 | (c >> 12 & 0x3F));
+                append_byte(buffer, 0x80 | (c >> 6 & 0x3F));
+                append_byte(buffer, 0x80 | (c & 0x3F));
+            }
+            break;
+    }
+}
+
+/**
+ * Appends a string in the given encoding, with the BOM of enc_utf16 and a terminator when asked.
+ * 
+ * Parameters:
+ *   buffer (Buffer*): The buffer.
+ *   encoding (Encoding): The encoding.
+ *   text (const uint32_t*): The code points.
+ *   length (uint): Number of code points.
+ *   terminate (int): Nonzero to add a terminator.
+ */
+static void append_string(Buffer *buffer, Encoding encoding, const uint32_t *text, uint length, int terminate)
+{
+    if (encoding == enc_utf16)
+    {
+        append_byte(buffer, 0xFF);
+        append_byte(buffer, 0xFE);
+    }
+    for (uint i = 0; i < length; i++)
+    {
+        append_char(buffer, encoding, text[i]);
+    }
+    if (terminate)
+    {
+        append(buffer, NULL, encoding == enc_utf16 || encoding == enc_utf16be ? 2 : 1);
+    }
+}
+
+/**
+ * Picks the encoding of one frame. v2.2 and v2.3 only know Latin-1 and UTF-16 with a BOM.
+ * 
+ * Parameters:
+ *   options (const GenOptions*): The generator options.
+ *   state (uint64_t*): State of the generator.
+ *   version (int): Major version of the tag.
+ * 
+ * Returns:
+ *   Encoding: The encoding.
+ */
+static Encoding pick_encoding(const GenOptions *options, uint64_t *state, int version)
+{
+    Encoding encoding = options->encoding;
+    if (encoding == enc_mix)
+    {
+        encoding = next_random(state) % (version == 4 ? 4 : 2);
+    }
+    if (version < 4 && encoding > enc_utf16)
+    {
+        encoding = enc_utf16;
+    }
+    return encoding;
+}
+
+/**
+ * Unsynchronises bytes: a zero byte is inserted after every 0xFF that is followed by
+ * a byte of 0xE0 or more, a zero byte or the end of the data.
+ * 
+ * Parameters:
+ *   data (const unsigned char*): The bytes.
+ *   size (size_t): Number of bytes.
+ *   out (Buffer*): Where the unsynchronised bytes are appended.
+ */
+static void unsynchronise(const unsigned char *data, size_t size, Buffer *out)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        append_byte(out, data[i]);
+        if (data[i] == 0xFF && (i + 1 == size || data[i + 1] >= 0xE0 || data[i + 1] == 0))
+        {
+            append_byte(out, 0);
+        }
+    }
+}
+
+/**
+ * Appends size random bytes, taken little endian from the generator so every machine writes the same.
+ * 
+ * Parameters:
+ *   buffer (Buffer*): The buffer.
+ *   state (uint64_t*): State of the generator.
+ *   size (size_t): Number of bytes.
+ */
+static void append_random(Buffer *buffer, uint64_t *state, size_t size)
+{
+    uint64_t bits = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        if (i % 8 == 0)
+        {
+            bits = next_random(state);
+        }
+        append_byte(buffer, bits & 0xFF);
+        bits >>= 8;
+    }
+}
+
+/**
+ * Appends a frame header and payload. The payload is unsynchronised first for an
+ * unsynchronised v2.4 tag, where every frame carries the flag itself.
+ * 
+ * Parameters:
+ *   tag (Buffer*): The frame region.
+ *   version (int): Major version of the tag.
+ *   id (const char*): Frame id.
+ *   payload (Buffer*): The payload.
+ *   unsync (int): Nonzero when the tag is unsynchronised.
+ */
+static void append_frame(Buffer *tag, int version, const char *id, Buffer *payload, int unsync)
+{
+    Buffer scratch = { NULL, 0, 0 };
+    const unsigned char *data = payload->data;
+    size_t size = payload->len;
+    if (version == 4 && unsync)
+    {
+        unsynchronise(payload->data, payload->len, &scratch);
+        data = scratch.data;
+        size = scratch.len;
+    }
+
+    unsigned char header[10] = { 0 };
+    int header_size = version == 2 ? 6 : 10;
+    memcpy(header, id, version == 2 ? 3 : 4);
+    if (version == 2)
+    {
+        put_size(header + 3, size, 3, 0);
+    }
+    else
+    {
+        put_size(header + 4, size, 4, version == 4);
+        header[9] = version == 4 && unsync ? 0x02 : 0;
+    }
+    append(tag, header, header_size);
+    append(tag, data, size);
+    free(scratch.data);
+}
+
+/**
+ * Fills a text with random characters from the alphabet.
+ * 
+ * Parameters:
+ *   state (uint64_t*): State of the generator.
+ *   text (uint32_t*): Where the code points are stored.
+ *   length (uint): Number of code points.
+ */
+static void random_text(uint64_t *state, uint32_t *text, uint length)
+{
+    for (uint i = 0; i < length; i++)
+    {
+        text[i] = alphabet[next_random(state) % (sizeof(alphabet) / sizeof(alphabet[0]))];
+    }
+}
+
+/**
+ * Appends a text frame. The text starts with "<prefix> " so the standard frames are easy to
+ * recognise, and is filled up to length characters. TXXX frames get a description first.
+ * 
+ * Parameters:
+ *   tag (Buffer*): The frame region.
+ *   options (const GenOptions*): The generator options.
+ *   state (uint64_t*): State of the generator.
+ *   version (int): Major version of the tag.
+ *   id (const char*): Frame id.
+ *   prefix (const char*): ASCII start of the text, may be empty.
+ *   description (const char*): Description of a TXXX frame, NULL for other frames.
+ *   unsync (int): Nonzero when the tag is unsynchronised.
+ */
+static void text_frame(Buffer *tag, const GenOptions *options, uint64_t *state, int version,
+                       const char *id, const char *prefix, const char *description, int unsync)
+{
+    uint length = pick(state, options->text);
+    size_t prefix_len = strlen(prefix);
+    if (length < prefix_len)
+    {
+        length = prefix_len;
+    }
+
+    uint32_t *text = malloc((length + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < prefix_len; i++)
+    {
+        text[i] = (unsigned char)prefix[i];
+    }
+    random_text(state, text + prefix_len, length - prefix_len);
+    if (prefix_len > 0 && length > prefix_len)
+    {
+        text[prefix_len] = ' ';
+    }
+
+    Encoding encoding = pick_encoding(options, state, version);
+    Buffer payload = { NULL, 0, 0 };
+    append_byte(&payload, encoding);
+    if (description != NULL)
+    {
+        uint32_t desc[32];
+        uint desc_len = 0;
+        while (description[desc_len] != '\0' && desc_len < 32)
+        {
+            desc[desc_len] = (unsigned char)description[desc_len];
+            desc_len++;
+        }
+        append_string(&payload, encoding, desc, desc_len, 1);
+    }
+    append_string(&payload, encoding, text, length, 0);
+    append_frame(tag, version, id, &payload, unsync);
+
+    free(payload.data);
+    free(text);
+}
+
+/**
+ * Appends a comment frame: encoding, language, empty description and the text.
+ * 
+ * Parameters:
+ *   tag (Buffer*): The frame region.
+ *   options (const GenOptions*): The generator options.
+ *   state (uint64_t*): State of the generator.
+ *   version (int): Major version of the tag.
+ *   unsync (int): Nonzero when the tag is unsynchronised.
+ */
+static void comment_frame(Buffer *tag, const GenOptions *options, uint64_t *state, int version, int unsync)
+{
+    uint length = pick(state, options->text);
+    uint32_t *text = malloc((length + 1) * sizeof(uint32_t));
+    random_text(state, text, length);
+
+    Encoding encoding = pick_encoding(options, state, version);
+    Buffer payload = { NULL, 0, 0 };
+    append_byte(&payload, encoding);
+    append(&payload, "eng", 3);
+    append_string(&payload, encoding, NULL, 0, 1);
+    append_string(&payload, encoding, text, length, 0);
+    append_frame(tag, version, std_ids[version - 2][5], &payload, unsync);
+
+    free(payload.data);
+    free(text);
+}
+
+/**
+ * Appends a front cover picture frame of size bytes of fake JPEG data.
+ * 
+ * Parameters:
+ *   tag (Buffer*): The frame region.
+ *   state (uint64_t*): State of the generator.
+ *   version (int): Major version of the tag.
+ *   size (uint): Bytes of picture data, at least 4.
+ *   unsync (int): Nonzero when the tag is unsynchronised.
+ */
+static void picture_frame(Buffer *tag, uint64_t *state, int version, uint size, int unsync)
+{
+    Buffer payload = { NULL, 0, 0 };
+    append_byte(&payload, enc_latin1);
+    if (version == 2)
+    {
+        append(&payload, "JPG", 3);
+    }
+    else
+    {
+        append(&payload, "image/jpeg", 11);
+    }
+    append_byte(&payload, 3);   // Front cover
+    append(&payload, "Cover", 6);
+
+    static const unsigned char soi[4] = { 0xFF, 0xD8, 0xFF, 0xE0 };
+    static const unsigned char eoi[2] = { 0xFF, 0xD9 };
+    size = size < 6 ? 6 : size;
+    append(&payload, soi, 4);
+    append_random(&payload, state, size - 6);
+    append(&payload, eoi, 2);
+    append_frame(tag, version, std_ids[version - 2][6], &payload, unsync);
+    free(payload.data);
+}
+
+/**
+ * Appends size bytes of fake MPEG audio: frames with a valid sync word and random data.
+ * 
+ * Parameters:
+ *   file (Buffer*): The file.
+ *   state (uint64_t*): State of the generator.
+ *   size (uint): Bytes of audio data.
+ */
+static void audio_data(Buffer *file, uint64_t *state, uint size)
+{
+    static const unsigned char sync[4] = { 0xFF, 0xFB, 0x90, 0x64 };
+    size_t end = file->len + size;
+    while (file->len < end)
+    {
+        size_t left = end - file->len;
+        size_t frame = left < AUDIO_FRAME_SIZE ? left : AUDIO_FRAME_SIZE;
+        append(file, sync, frame < 4 ? frame : 4);
+        if (frame > 4)
+        {
+            append_random(file, state, frame - 4);
+        }
+    }
+}
+
+/**
+ * Builds the frame region of one file: the six standard frames, the extra text frames and
+ * the picture, with a broken frame in the middle for the frame level malformed kinds.
+ * 
+ * Parameters:
+ *   tag (Buffer*): Where the frames are appended.
+ *   options (const GenOptions*): The generator options.
+ *   state (uint64_t*): State of the generator.
+ *   version (int): Major version of the tag.
+ *   index (uint): Number of the file.
+ *   malformed (Malformed): Kind of damage.
+ *   unsync (int): Nonzero when the tag is unsynchronised.
+ */
+static void build_frames(Buffer *tag, const GenOptions *options, uint64_t *state, int version,
+                         uint index, Malformed malformed, int unsync)
+{
+    const char **ids = std_ids[version - 2];
+    char title[32], artist[32], album[32], year[8];
+    snprintf(title, sizeof(title), "Song %u", index);
+    snprintf(artist, sizeof(artist), "Artist %u", index % 97);
+    snprintf(album, sizeof(album), "Album %u", index % 31);
+    snprintf(year, sizeof(year), "%u", 1960 + index % 60);
+
+    text_frame(tag, options, state, version, ids[0], title, NULL, unsync);
+    text_frame(tag, options, state, version, ids[1], artist, NULL, unsync);
+    text_frame(tag, options, state, version, ids[2], album, NULL, unsync);
+
+    // The year and genre keep their exact text
+    GenOptions fixed = *options;
+    fixed.text = (Range){ 0, 0 };
+    text_frame(tag, &fixed, state, version, ids[3], year, NULL, unsync);
+    text_frame(tag, &fixed, state, version, ids[4], genres[index % (sizeof(genres) / sizeof(genres[0]))], NULL, unsync);
+
+    if (malformed == bad_zero_frame || malformed == bad_frame_id)
+    {
+        // A broken frame header between valid frames
+        unsigned char header[10] = { 0 };
+        const char *id = malformed == bad_zero_frame ? ids[0] : "t!x?";
+        memcpy(header, id, version == 2 ? 3 : 4);
+        if (malformed == bad_frame_id)
+        {
+            put_size(version == 2 ? header + 3 : header + 4, 4, version == 2 ? 3 : 4, version == 4);
+        }
+        append(tag, header, version == 2 ? 6 : 10);
+        if (malformed == bad_frame_id)
+        {
+            append(tag, "junk", 4);
+        }
+    }
+    comment_frame(tag, options, state, version, unsync);
+
+    uint extras = pick(state, options->frames);
+    for (uint i = 0; i < extras; i++)
+    {
+        if (i < 10)
+        {
+            text_frame(tag, options, state, version, extra_ids[version == 2 ? 0 : 1][i], "", NULL, unsync);
+        }
+        else
+        {
+            char description[16];
+            snprintf(description, sizeof(description), "EXTRA%u", i - 10);
+            text_frame(tag, options, state, version, version == 2 ? "TXX" : "TXXX", "", description, unsync);
+        }
+    }
+
+    uint picture = pick(state, options->apic);
+    if (picture > 0)
+    {
+        picture_frame(tag, state, version, picture, unsync);
+    }
+
+    if (malformed == bad_frame_size)
+    {
+        // The last frame claims far more bytes than the tag holds
+        unsigned char header[10] = { 0 };
+        memcpy(header, ids[2], version == 2 ? 3 : 4);
+        put_size(version == 2 ? header + 3 : header + 4, 0x7FFFF, version == 2 ? 3 : 4, version == 4);
+        append(tag, header, version == 2 ? 6 : 10);
+        append(tag, "\0Cut", 4);
+    }
+}
+
+/**
+ * Builds one complete file in memory.
+ * 
+ * Parameters:
+ *   file (Buffer*): Where the file is stored.
+ *   options (const GenOptions*): The generator options.
+ *   index (uint): Number of the file.
+ *   version (int*): Set to the major version used.
+ *   malformed (Malformed*): Set to the kind of damage, bad_none for a valid file.
+ *   unsync (int*): Set to nonzero when the tag is unsynchronised.
+ */
+static void build_file(Buffer *file, const GenOptions *options, uint index, int *version, Malformed *malformed, int *unsync)
+{
+    // Every file has its own stream, so a file doesn't change when the count does
+    uint64_t state = options->seed ^ ((uint64_t)index * 0xD1B54A32D192ED03ULL);
+    next_random(&state);
+
+    *version = options->version ? options->version : 2 + (int)(next_random(&state) % 3);
+    *malformed = bad_none;
+    if (next_random(&state) % 100 < options->malformed)
+    {
+        *malformed = 1 + next_random(&state) % (bad_count - 1);
+    }
+    *unsync = next_random(&state) % 100 < options->unsync;
+
+    Buffer frames = { NULL, 0, 0 };
+    build_frames(&frames, options, &state, *version, index, *malformed, *unsync);
+
+    // Whole tag unsynchronisation for v2.2 and v2.3, v2.4 did it per frame
+    Buffer body = { NULL, 0, 0 };
+    if (*unsync && *version < 4)
+    {
+        unsynchronise(frames.data, frames.len, &body);
+    }
+    else
+    {
+        append(&body, frames.data, frames.len);
+    }
+    append(&body, NULL, pick(&state, options->padding));
+
+    unsigned char header[10] = { 'I', 'D', '3', *version, 0, *unsync ? 0x80 : 0 };
+    uint tag_size = body.len > MAX_TAG_SIZE ? MAX_TAG_SIZE : body.len;
+    put_size(header + 6, tag_size, 4, 1);
+    switch (*malformed)
+    {
+        case bad_magic: memcpy(header, "ID4", 3); break;
+        case bad_version: header[3] = 9; break;
+        case bad_syncsafe: header[7] |= 0x80; break;
+        case bad_tag_size: put_size(header + 6, MAX_TAG_SIZE, 4, 1); break;
+        default: break;
+    }
+
+    file->len = 0;
+    append(file, header, sizeof(header));
+    if (*malformed == bad_truncated)
+    {
+        append(file, body.data, body.len / 2);
+    }
+    else
+    {
+        append(file, body.data, body.len);
+        audio_data(file, &state, pick(&state, options->audio));
+    }
+    free(frames.data);
+    free(body.data);
+}
+
+/**
+ * Reads a range given as "n" or "min-max".
+ * 
+ * Parameters:
+ *   text (const char*): The text.
+ *   range (Range*): Where the range is stored.
+ * 
+ * Returns:
+ *   Status: e_success if the range is valid, e_failure otherwise.
+ */
+static Status parse_range(const char *text, Range *range)
+{
+    char *end;
+    errno = 0;
+    unsigned long min = strtoul(text, &end, 10);
+    unsigned long max = min;
+    if (end != text && *end == '-')
+    {
+        const char *rest = end + 1;
+        max = strtoul(rest, &end, 10);
+        if (end == rest)
+        {
+            return e_failure;
+        }
+    }
+    if (end == text || *end != '\0' || errno != 0 || min > max || max > MAX_TAG_SIZE)
+    {
+        return e_failure;
+    }
+    range->min = min;
+    range->max = max;
+    return e_success;
+}
+
+/**
+ * Reads the command line into the generator options.
+ * 
+ * Parameters:
+ *   argc (int): Number of command-line arguments.
+ *   argv (char*[]): Command-line arguments.
+ *   options (GenOptions*): Where the options are stored.
+ * 
+ * Returns:
+ *   Status: e_success if every option is valid, e_failure otherwise.
+ */
+static Status parse_options(int argc, char *argv[], GenOptions *options)
+{
+    *options = (GenOptions)
+    {
+        .seed = 1, .version = 3, .encoding = enc_latin1,
+        .frames = { 0, 4 }, .text = { 8, 40 }, .padding = { 0, 2048 },
+        .apic = { 0, 0 }, .audio = { 32 * 1024, 256 * 1024 },
+    };
+    if (argc < 3)
+    {
+        return e_failure;
+    }
+    options->dir = argv[1];
+    char *end;
+    options->count = strtoul(argv[2], &end, 10);
+    if (*end != '\0' || options->count == 0)
+    {
+        return e_failure;
+    }
+
+    for (int i = 3; i < argc; i++)
+    {
+        char *value = strchr(argv[i], '=');
+        if (strncmp(argv[i], "--", 2) != 0 || value == NULL)
+        {
+            return e_failure;
+        }
+        *value++ = '\0';
+        const char *name = argv[i] + 2;
+
+        Range range;
+        if (strcmp(name, "seed") == 0)
+        {
+            options->seed = strtoull(value, &end, 0);
+            if (*end != '\0')
+            {
+                return e_failure;
+            }
+        }
+        else if (strcmp(name, "version") == 0)
+        {
+            if (strcmp(value, "mix") == 0)
+            {
+                options->version = 0;
+            }
+            else if (strlen(value) == 1 && value[0] >= '2' && value[0] <= '4')
+            {
+                options->version = value[0] - '0';
+            }
+            else
+            {
+                return e_failure;
+            }
+        }
+        else if (strcmp(name, "encoding") == 0)
+        {
+            int known = 0;
+            for (int e = enc_latin1; e <= enc_mix; e++)
+            {
+                if (strcmp(value, encoding_names[e]) == 0)
+                {
+                    options->encoding = e;
+                    known = 1;
+                }
+            }
+            if (!known)
+            {
+                return e_failure;
+            }
+        }
+        else if ((strcmp(name, "unsync") == 0 || strcmp(name, "malformed") == 0) &&
+                 parse_range(value, &range) == e_success && range.min == range.max && range.max <= 100)
+        {
+            *(name[0] == 'u' ? &options->unsync : &options->malformed) = range.max;
+        }
+        else if (parse_range(value, &range) == e_failure)
+        {
+            return e_failure;
+        }
+        else if (strcmp(name, "frames") == 0)
+        {
+            options->frames = range;
+        }
+        else if (strcmp(name, "text") == 0)
+        {
+            options->text = range;
+        }
+        else if (strcmp(name, "padding") == 0)
+        {
+            options->padding = range;
+        }
+        else if (strcmp(name, "apic") == 0)
+        {
+            options->apic = range;
+        }
+        else if (strcmp(name, "audio") == 0)
+        {
+            options->audio = range;
+        }
+        else
+        {
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+/**
+ * Writes the corpus. Every file is listed on stdout with its version, encoding option,
+ * unsynchronisation and kind of damage, tab separated, so tests can tell which files must fail.
+ */
+int main(int argc, char *argv[])
+{
+    GenOptions options;
+    if (parse_options(argc, argv, &options) == e_failure)
+    {
+        fprintf(stderr, "USAGE :\n./mp3_gen <directory> <count> [--seed=N] [--version=2|3|4|mix]\n"
+                        "          [--encoding=latin1|utf16|utf16be|utf8|mix] [--frames=MIN-MAX] [--text=MIN-MAX]\n"
+                        "          [--padding=MIN-MAX] [--apic=MIN-MAX] [--audio=MIN-MAX] [--unsync=PERCENT] [--malformed=PERCENT]\n");
+        return e_failure;
+    }
+    if (mkdir(options.dir, 0755) != 0 && errno != EEXIST)
+    {
+        perror(options.dir);
+        return e_failure;
+    }
+
+    Buffer file = { NULL, 0, 0 };
+    size_t path_size = strlen(options.dir) + 32;
+    char *path = malloc(path_size);
+    unsigned long long total = 0;
+    for (uint i = 0; i < options.count; i++)
+    {
+        int version, unsync;
+        Malformed malformed;
+        build_file(&file, &options, i, &version, &malformed, &unsync);
+
+        snprintf(path, path_size, "%s/gen%06u.mp3", options.dir, i);
+        FILE *fptr = fopen(path, "wb");
+        if (fptr == NULL || fwrite(file.data, 1, file.len, fptr) != file.len || fclose(fptr) != 0)
+        {
+            perror(path);
+            return e_failure;
+        }
+        total += file.len;
+        printf("%s\t2.%d\t%s\t%s\t%s\n", path, version, encoding_names[options.encoding],
+               unsync ? "unsync" : "sync", malformed_names[malformed]);
+    }
+    fprintf(stderr, "%u files, %llu bytes written to %s (seed %llu)\n",
+            options.count, total, options.dir, (unsigned long long)options.seed);
+
+    free(path);
+    free(file.data);
+    return e_success;
+}
@@ -12,6 +12,10 @@ typedef enum
 {
     view,         // Operation type for viewing MP3 file details
     edit,         // Operation type for editing MP3 file metadata
+    scan,         // Operation type for viewing every MP3 file below a directory
+    batch,        // Operation type for editing many MP3 files from a manifest
+    stream,       // Operation type for viewing or editing an MP3 file piped through stdin and stdout
+    serve,        // Operation type for serving view and edit requests over a Unix domain socket
     help,         // Operation type for showing help information
     unsupported   // Operation type for unsupported actions or errors
 } OperationType;